@@ -0,0 +1,132 @@
+#include <fmt/format.h>
+#include <ctre-unicode.hpp>
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "Command.hpp"
+#include "CommandGrammar.hpp"
+#include "MountPoint.hpp"
+#include "VolumeIndex.hpp"
+
+namespace {
+// every allocation of the program, parses are measured as the difference around them
+std::size_t allocations = 0;
+}// namespace
+
+auto operator new(std::size_t size) -> void *
+{
+  ++allocations;
+  if (auto *block = std::malloc(size == 0 ? 1 : size)) return block;
+  throw std::bad_alloc();
+}
+void operator delete(void *block) noexcept { std::free(block); }
+void operator delete(void *block, std::size_t) noexcept { std::free(block); }
+
+namespace {
+
+// The per-argument regex `mount <disk id>@<offset> <mount>...` was parsed with before the grammar
+auto RegexParse(std::span<const std::string> arguments) -> std::optional<Blt::MountInfo>
+{
+  auto info = Blt::MountInfo{};
+  if (arguments.size() < 4 or arguments.size() % 2 != 0 or arguments[1] != "mount") return std::nullopt;
+  info.Action = Blt::CommandAction::Mount;
+  for (std::size_t argument = 2; argument + 1 < arguments.size(); argument += 2) {
+    auto [match, diskIdCapture, offsetCapture] = ctre::match<"(.+)@(\\d+)">(arguments[argument]);
+    if (not match) return std::nullopt;
+    auto volume  = Blt::VolumeKey{.DiskId = Blt::NormalizeDiskId(diskIdCapture.to_view()), .PartitionOffset = 0};
+    auto view    = offsetCapture.to_view();
+    auto [_, ec] = std::from_chars(view.data(), view.data() + view.size(), volume.PartitionOffset, 10);
+    if (ec != std::error_code()) return std::nullopt;
+
+    auto mount = Blt::ParseMountPoint(arguments[argument + 1], true);
+    if (not mount) return std::nullopt;
+    info.Targets.push_back(Blt::WatchTarget{.Volume = std::move(volume), .Mount = std::move(*mount)});
+  }
+  return info;
+}
+
+// `mount` with `targets` volumes, half of them on a letter and half on a folder
+auto MakeArguments(int targets) -> std::vector<std::string>
+{
+  auto arguments = std::vector<std::string>{"BitLockerTool", "mount"};
+  for (int target = 0; target < targets; ++target) {
+    arguments.push_back(fmt::format("{{6A2F1C3B-{:04X}-4D2E-9F10-0123456789AB}}@{}", target, 16777216 + target));
+    arguments.push_back(target % 2 == 0 ? std::string(1, static_cast<char>('D' + target % 20))
+                                        : fmt::format("/mnt/volume-{}", target));
+  }
+  return arguments;
+}
+
+struct Measurement
+{
+  double Nanoseconds;
+  double Allocations;
+  bool Parsed;
+};
+
+template<typename Parse>
+auto Measure(Parse parse, int iterations) -> Measurement
+{
+  auto parsed      = true;
+  const auto start = std::chrono::steady_clock::now();
+  const auto first = allocations;
+  for (int iteration = 0; iteration < iterations; ++iteration) parsed = parse() and parsed;
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return Measurement{
+    .Nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+    .Allocations = static_cast<double>(allocations - first) / iterations,
+    .Parsed      = parsed,
+  };
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_ArgvBench  [targets]  [iterations]
+ *
+ * Parses `mount` with `targets` volume targets with the old per-argument regex, with the grammar alone (ParseArgv)
+ * and with the grammar plus the MountInfo it turns into (ParseArguments), checks that all of them accept it and prints
+ * the time and the heap allocations per parse.
+ */
+int main(int argc, char **argv)
+{
+  const int targets    = argc > 1 ? std::atoi(argv[1]) : 8;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 20000;
+  if (targets < 1 or static_cast<std::size_t>(targets) > Blt::ParsedArguments<char>::MaxTargets) {
+    fmt::println("targets is 1 to {}", Blt::ParsedArguments<char>::MaxTargets);
+    return EXIT_FAILURE;
+  }
+  const auto arguments = MakeArguments(targets);
+  const auto span      = std::span<const std::string>(arguments);
+
+  auto parsed        = Blt::ParsedArguments<char>();
+  const auto regex   = Measure([&] { return RegexParse(span).has_value(); }, iterations);
+  const auto grammar = Measure([&] { return not Blt::ParseArgv<char>(span, parsed); }, iterations);
+  const auto full    = Measure([&] { return Blt::ParseArguments(span).has_value(); }, iterations);
+  if (not regex.Parsed or not grammar.Parsed or not full.Parsed or parsed.TargetCount != std::size_t(targets)) {
+    fmt::println("parsers disagree: regex {}, grammar {}, mount info {}", regex.Parsed, grammar.Parsed, full.Parsed);
+    return EXIT_FAILURE;
+  }
+
+  fmt::println("targets {}, {} arguments, {} iterations", targets, arguments.size(), iterations);
+  const auto measurements = std::to_array<std::pair<std::string_view, Measurement>>(
+    {{"regex", regex}, {"grammar", grammar}, {"grammar+info", full}});
+  for (const auto &[name, measurement] : measurements)
+    fmt::println(
+      "{:<12}: {:.0f}ns per parse, {:.1f} allocations per parse",
+      name,
+      measurement.Nanoseconds,
+      measurement.Allocations);
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "AuditLog.hpp"
+
+namespace {
+
+struct Measurement
+{
+  double AppendsPerSecond;
+  uint64_t Commits;
+  std::chrono::microseconds P50;
+  std::chrono::microseconds P99;
+  bool Intact;
+};
+
+// `threads` operations at a time, each appending `records` records and waiting for every one to be durable like the
+// engine does before it completes an operation
+auto Measure(const std::filesystem::path &path, Blt::AuditPolicy policy, int threads, int records) -> Measurement
+{
+  std::filesystem::remove(path);
+  auto log = Blt::AuditLog::Open(path, policy);
+  if (not log) return Measurement{};
+
+  auto latencies   = std::vector<std::vector<std::chrono::microseconds>>(static_cast<std::size_t>(threads));
+  auto workers     = std::vector<std::thread>();
+  const auto start = std::chrono::steady_clock::now();
+  for (int thread = 0; thread < threads; ++thread) {
+    workers.emplace_back([&, thread] {
+      auto &measured = latencies[static_cast<std::size_t>(thread)];
+      for (int record = 0; record < records; ++record) {
+        const auto appended = std::chrono::steady_clock::now();
+        auto durable        = std::promise<bool>();
+        log->Append(
+          Blt::AuditRecord{
+            .Operation = static_cast<uint64_t>(thread * records + record),
+            .Action    = "mount",
+            .Target    = fmt::format("disk #{} partition #{}", thread, record),
+            .Mount     = "*",
+            .Outcome   = "success",
+            .Started   = std::chrono::system_clock::now(),
+          },
+          [&durable](bool done) { durable.set_value(done); });
+        durable.get_future().get();
+        measured.push_back(
+          std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - appended));
+      }
+    });
+  }
+  for (auto &worker : workers) worker.join();
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  log->Stop();
+  const auto verification = Blt::VerifyAuditLog(path);
+
+  auto all = std::vector<std::chrono::microseconds>();
+  for (const auto &measured : latencies) all.insert(all.end(), measured.begin(), measured.end());
+  std::ranges::sort(all);
+  return Measurement{
+    .AppendsPerSecond = static_cast<double>(all.size()) / std::chrono::duration<double>(elapsed).count(),
+    .Commits          = log->Commits(),
+    .P50              = all[all.size() / 2],
+    .P99              = all[all.size() * 99 / 100],
+    .Intact           = verification.Intact and verification.Records == all.size(),
+  };
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_AuditBench  [threads]  [records per thread]  [log file]
+ *
+ * Appends records from concurrent threads that each wait for their record to be durable, once with a flush per
+ * record and once group-committed with the default policy, verifies both logs and prints appends per second, the
+ * number of commits and the append-to-durable latency. Run it on the disk the audit log lives on, a tmpfs makes every
+ * flush free.
+ */
+int main(int argc, char **argv)
+{
+  const int threads = argc > 1 ? std::atoi(argv[1]) : 16;
+  const int records = argc > 2 ? std::atoi(argv[2]) : 200;
+  const auto path   = std::filesystem::path(argc > 3 ? argv[3] : "audit-bench.log");
+  if (threads < 1 or records < 1) {
+    fmt::println("threads and records are at least 1");
+    return EXIT_FAILURE;
+  }
+
+  // the writer still runs on its own thread, only that every commit holds one record and goes out right away
+  const auto perRecord = Blt::AuditPolicy{.Linger = std::chrono::microseconds(0), .MaxBatch = 1};
+  const auto single    = Measure(path, perRecord, threads, records);
+  const auto grouped   = Measure(path, Blt::AuditPolicy{}, threads, records);
+  std::filesystem::remove(path);
+  if (not single.Intact or not grouped.Intact) {
+    fmt::println("the log does not verify: per record {}, grouped {}", single.Intact, grouped.Intact);
+    return EXIT_FAILURE;
+  }
+
+  fmt::println("{} threads, {} records each, {}", threads, records, path.string());
+  const auto measurements = std::to_array<std::pair<std::string_view, Measurement>>(
+    {{"per record", single}, {"grouped", grouped}});
+  for (const auto &[name, measurement] : measurements)
+    fmt::println(
+      "{:<10}: {:.0f} appends/s, {} commits, p50 {}us, p99 {}us",
+      name,
+      measurement.AppendsPerSecond,
+      measurement.Commits,
+      measurement.P50.count(),
+      measurement.P99.count());
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <fmt/format.h>
+#include <boost/asio.hpp>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <array>
+#include <charconv>
+#include <string>
+#include <string_view>
+
+namespace Blt::Bench {
+
+namespace asio = boost::asio;
+
+/**
+ * In-memory stand-in for diskpart.exe, answers the commands issued by DiskPart.cpp with canned English output.
+ * Disk 0 is 1863 GB and carries partition 6 of 362 GB, the same layout as the README example.
+ */
+inline auto FakeDiskPartReply(std::string_view command, bool &exit) -> std::string
+{
+  constexpr auto prompt = std::string_view("\r\nDISKPART> ");
+  const auto argument   = [&command](std::string_view prefix) {
+    int number = -1;
+    std::from_chars(command.data() + prefix.size(), command.data() + command.size(), number, 10);
+    return number;
+  };
+
+  if (command == "list disk") {
+    return fmt::format(
+      "\r\n  Disk ###  Status         Size     Free     Dyn  Gpt\r\n"
+      "  --------  -------------  -------  -------  ---  ---\r\n"
+      "  Disk 0    Online         1863 GB  1024 KB        *\r\n"
+      "  Disk 1    Online          465 GB  1024 KB        *\r\n{}",
+      prompt);
+  } else if (command.starts_with("select disk ")) {
+    return fmt::format("\r\nDisk {} is now the selected disk.\r\n{}", argument("select disk "), prompt);
+  } else if (command == "list partition") {
+    return fmt::format(
+      "\r\n  Partition ###  Type              Size     Offset\r\n"
+      "  -------------  ----------------  -------  -------\r\n"
+      "  Partition 1    Recovery           499 MB  1024 KB\r\n"
+      "  Partition 6    Primary            362 GB   500 GB\r\n{}",
+      prompt);
+  } else if (command.starts_with("select partition ")) {
+    return fmt::format(
+      "\r\nPartition {} is now the selected partition.\r\n{}", argument("select partition "), prompt);
+  } else if (command == "detail disk") {
+    return fmt::format(
+      "\r\nSamsung SSD 970 EVO Plus 2TB\r\nDisk ID: {{8A3E2F4C-5B6D-4E7F-8091-A2B3C4D5E6F7}}\r\n"
+      "Type   : NVMe\r\nStatus : Online\r\n{}",
+      prompt);
+  } else if (command == "detail partition") {
+    return fmt::format(
+      "\r\nPartition 6\r\nType    : ebd0a0a2-b9e5-4433-87c0-68b6b72699c7\r\nHidden  : No\r\n"
+      "Offset in Bytes: 536870912000\r\n{}",
+      prompt);
+  } else if (command.starts_with("select volume=")) {
+    return fmt::format("\r\nVolume 3 is the selected volume.\r\n{}", prompt);
+  } else if (command.starts_with("assign letter=")) {
+    return fmt::format("\r\nDiskPart successfully assigned the drive letter or mount point.\r\n{}", prompt);
+  } else if (command.starts_with("remove letter=")) {
+    return fmt::format("\r\nDiskPart successfully removed the drive letter or mount point.\r\n{}", prompt);
+  } else if (command == "exit") {
+    exit = true;
+    return "\r\nLeaving DiskPart...\r\n";
+  }
+  return fmt::format("\r\nThe arguments specified for this command are not valid.\r\n{}", prompt);
+}
+
+/**
+ * Runs one fake diskpart session over a pipe pair, commands are terminated by either '\n' or '\0' because
+ * DiskPart.cpp writes string literals including their terminator.
+ * `reply` answers each command like FakeDiskPartReply does, an empty answer leaves the command unanswered.
+ */
+template<typename Reply = decltype(&FakeDiskPartReply)>
+auto FakeDiskPart(asio::readable_pipe &commandIn, asio::writable_pipe &responseOut, Reply reply = &FakeDiskPartReply)
+  -> asio::awaitable<void>
+{
+  constexpr auto banner = std::string_view(
+    "\r\nMicrosoft DiskPart version 10.0.19041.3636\r\n\r\n"
+    "Copyright (C) Microsoft Corporation.\r\n"
+    "On computer: BENCH\r\n\r\nDISKPART> ");
+
+  if (auto [ec, _] = co_await asio::async_write(responseOut, asio::buffer(banner), asio::as_tuple(asio::use_awaitable));
+      ec)
+    co_return;
+
+  std::string pending;
+  std::array<char, 512> chunk;
+  auto exit = false;
+  while (not exit) {
+    auto [ec, size] = co_await commandIn.async_read_some(asio::buffer(chunk), asio::as_tuple(asio::use_awaitable));
+    if (ec) co_return;
+    pending.append(chunk.data(), size);
+
+    for (auto end = pending.find_first_of(std::string_view("\n\0", 2)); end != std::string::npos and not exit;
+         end      = pending.find_first_of(std::string_view("\n\0", 2))) {
+      auto command = std::string_view(pending).substr(0, end);
+      while (not command.empty() and (command.back() == '\r' or command.back() == ' ')) command.remove_suffix(1);
+
+      if (auto answer = command.empty() ? std::string() : reply(command, exit); not answer.empty()) {
+        if (auto [write_ec, _] =
+              co_await asio::async_write(responseOut, asio::buffer(answer), asio::as_tuple(asio::use_awaitable));
+            write_ec)
+          co_return;
+      }
+      pending.erase(0, end + 1);
+    }
+  }
+  responseOut.close();
+}
+
+}// namespace Blt::Bench
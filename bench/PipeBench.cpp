@@ -0,0 +1,138 @@
+#include <fmt/format.h>
+#include <boost/asio.hpp>
+#include <boost/asio/connect_pipe.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "DiskPart.hpp"
+#include "FakeDiskPart.hpp"
+#include "Log.hpp"
+
+namespace asio = boost::asio;
+
+using namespace boost::asio::experimental::awaitable_operators;
+
+#if defined(BOOST_ASIO_HAS_IO_URING_AS_DEFAULT)
+constexpr auto backendName = "io_uring";
+#else
+constexpr auto backendName = "epoll";
+#endif
+
+namespace {
+
+auto MountSteps(Blt::DiskPartSession &session, asio::readable_pipe &diskpartOut, asio::writable_pipe &diskpartIn)
+  -> asio::awaitable<Blt::DiskPartError>
+{
+  using enum Blt::DiskPartError;
+  auto &buffer = session.Buffer();
+
+  if (auto error = co_await Blt::ReadComputerName(session, diskpartOut); error != Success) co_return error;
+  buffer.clear();
+  if (auto error = co_await Blt::ListDisk(session, diskpartIn); error != Success) co_return error;
+  buffer.clear();
+  if (auto error = co_await Blt::ReadListDisk(
+        session, diskpartOut, 0, Blt::capacityCast<Blt::CapacityBytes>(Blt::Gibibytes(1863)));
+      error != Success)
+    co_return error;
+  buffer.clear();
+  if (auto error = co_await Blt::SelectDisk(session, diskpartIn, 0); error != Success) co_return error;
+  buffer.clear();
+  if (auto error = co_await Blt::ReadSelectDisk(session, diskpartOut, 0); error != Success) co_return error;
+  buffer.clear();
+  if (auto error = co_await Blt::ListPartition(session, diskpartIn); error != Success) co_return error;
+  buffer.clear();
+  if (auto error = co_await Blt::ReadListPartition(
+        session, diskpartOut, 6, Blt::capacityCast<Blt::CapacityBytes>(Blt::Gibibytes(362)));
+      error != Success)
+    co_return error;
+  buffer.clear();
+  if (auto error = co_await Blt::SelectPartition(session, diskpartIn, 6); error != Success) co_return error;
+  buffer.clear();
+  if (auto error = co_await Blt::ReadSelectPartition(session, diskpartOut, 6); error != Success) co_return error;
+  buffer.clear();
+  if (auto error = co_await Blt::AssignLetter(session, diskpartIn, Blt::MountPoint{.Letter = 'X'}); error != Success)
+    co_return error;
+  buffer.clear();
+  if (auto error = co_await Blt::ReadAssignLetter(session, diskpartOut); error != Success) co_return error;
+  buffer.clear();
+  co_return co_await Blt::Exit(session, diskpartIn);
+}
+
+auto RunSessions(int rounds, std::vector<double> &latencies, int &failures) -> asio::awaitable<void>
+{
+  auto executor = co_await asio::this_coro::executor;
+  for (int round = 0; round < rounds; ++round) {
+    auto diskpartOut = asio::readable_pipe(executor);
+    auto responseOut = asio::writable_pipe(executor);
+    auto commandIn   = asio::readable_pipe(executor);
+    auto diskpartIn  = asio::writable_pipe(executor);
+    asio::connect_pipe(diskpartOut, responseOut);
+    asio::connect_pipe(commandIn, diskpartIn);
+
+    const auto start = std::chrono::steady_clock::now();
+    Blt::DiskPartSession session;
+    auto error =
+      co_await (MountSteps(session, diskpartOut, diskpartIn) && Blt::Bench::FakeDiskPart(commandIn, responseOut));
+    latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    if (error != Blt::DiskPartError::Success) ++failures;
+  }
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_PipeBench_<backend>  [sessions]  [rounds]
+ *
+ * Runs <sessions> concurrent mount conversations against in-memory diskpart stand-ins, each repeated <rounds> times.
+ * Every session holds four pipe descriptors, raise `ulimit -n` for more than ~250 sessions.
+ */
+int main(int argc, char **argv)
+{
+  const int sessions = argc > 1 ? std::atoi(argv[1]) : 128;
+  const int rounds   = argc > 2 ? std::atoi(argv[2]) : 50;
+
+  // the steps log every command, measure them with the background writer the tool runs with but keep the text out of
+  // the terminal
+  if (std::freopen("/dev/null", "w", stdout) == nullptr) return EXIT_FAILURE;
+  Blt::LogSink::Instance().Start(Blt::LogOptions{});
+
+  asio::io_context ioc;
+  std::vector<std::vector<double>> latencies(static_cast<std::size_t>(sessions));
+  std::vector<int> failures(static_cast<std::size_t>(sessions), 0);
+  for (std::size_t session = 0; session < latencies.size(); ++session) {
+    latencies[session].reserve(static_cast<std::size_t>(rounds));
+    asio::co_spawn(ioc, RunSessions(rounds, latencies[session], failures[session]), asio::detached);
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  ioc.run();
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<double> all;
+  for (auto &session : latencies) all.insert(all.end(), session.begin(), session.end());
+  std::ranges::sort(all);
+  const auto percentile = [&all](double p) {
+    return all.empty() ? 0.0 : all[static_cast<std::size_t>(p * static_cast<double>(all.size() - 1))];
+  };
+
+  Blt::LogSink::Instance().Stop();
+  fmt::println(
+    stderr,
+    "{}: {} sessions x {} rounds in {:.3f}s, {:.0f} sessions/s, p50 {:.1f}us, p99 {:.1f}us, failures {}",
+    backendName,
+    sessions,
+    rounds,
+    elapsed,
+    static_cast<double>(all.size()) / elapsed,
+    percentile(0.50),
+    percentile(0.99),
+    std::accumulate(failures.begin(), failures.end(), 0));
+  return EXIT_SUCCESS;
+}
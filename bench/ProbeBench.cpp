@@ -0,0 +1,88 @@
+#include <fmt/format.h>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/use_future.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ReadProbe.hpp"
+
+namespace asio = boost::asio;
+
+namespace {
+
+// Random bytes, so that a filesystem or a device that compresses or deduplicates can not shortcut the reads
+auto CreateImage(const std::filesystem::path &path, std::size_t mebibytes) -> bool
+{
+  auto image  = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  auto random = std::mt19937_64();
+  auto block  = std::vector<uint64_t>(1024 * 1024 / sizeof(uint64_t));
+  for (std::size_t written = 0; written < mebibytes and image; ++written) {
+    for (auto &word : block) word = random();
+    image.write(
+      reinterpret_cast<const char *>(block.data()), static_cast<std::streamsize>(block.size() * sizeof(uint64_t)));
+  }
+  return static_cast<bool>(image.flush());
+}
+
+auto Run(const std::filesystem::path &path, Blt::ProbeOptions options) -> Blt::ProbeResult
+{
+  asio::io_context ioc;
+  auto probe = asio::co_spawn(ioc, Blt::ProbeReads(path, options), asio::use_future);
+  ioc.run();
+  return probe.get();
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_ProbeBench  [image or device]  [image size in MiB]  [phase in milliseconds]
+ *
+ * Probes a loop image the way --probe probes a mounted volume, once with one read in flight per phase and once with
+ * the default depths, and prints what each measured. An image that does not exist is created with random bytes and
+ * removed afterwards, a device (/dev/loopN over the same image) is only read. Keep the image off tmpfs, which refuses
+ * O_DIRECT on older kernels, and larger than the drive's cache when the numbers are meant for the drive.
+ */
+int main(int argc, char **argv)
+{
+  const auto path      = std::filesystem::path(argc > 1 ? argv[1] : "probe-bench.img");
+  const auto mebibytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 256;
+  const auto phase     = std::chrono::milliseconds(argc > 3 ? std::atoi(argv[3]) : 500);
+  if (mebibytes < 1 or phase.count() < 10) {
+    fmt::println("the image is at least 1 MiB and a phase at least 10ms");
+    return EXIT_FAILURE;
+  }
+
+  const auto created = not std::filesystem::exists(path);
+  if (created and not CreateImage(path, mebibytes)) {
+    fmt::println("unable to write {}", path.string());
+    return EXIT_FAILURE;
+  }
+
+  const auto runs = std::to_array<std::pair<std::string_view, Blt::ProbeOptions>>({
+    {"depth 1", Blt::ProbeOptions{.Phase = phase, .SequentialDepth = 1, .RandomDepth = 1}},
+    {"default", Blt::ProbeOptions{.Phase = phase}},
+  });
+  auto failed = false;
+  fmt::println("{}, {}ms per phase", path.string(), phase.count());
+  for (const auto &[name, options] : runs) {
+    const auto probe = Run(path, options);
+    if (probe.Error != Blt::ProbeError::Success) {
+      fmt::println("{:<7}: {}", name, Blt::ToString(probe.Error));
+      failed = true;
+      continue;
+    }
+    fmt::println("{:<7}: {}", name, probe);
+  }
+  if (created) std::filesystem::remove(path);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
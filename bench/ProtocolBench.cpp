@@ -0,0 +1,272 @@
+#include <fmt/format.h>
+#include <boost/asio.hpp>
+#include <boost/asio/connect_pipe.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "DiskPart.hpp"
+#include "DiskPartProtocol.hpp"
+#include "FakeDiskPart.hpp"
+#include "Log.hpp"
+#include "Retry.hpp"
+#include "VolumeIndex.hpp"
+
+namespace asio = boost::asio;
+
+using namespace boost::asio::experimental::awaitable_operators;
+
+#ifdef _WIN32
+constexpr auto nullDevice = "NUL";
+#else
+constexpr auto nullDevice = "/dev/null";
+#endif
+
+namespace {
+
+// The mount loop as it was written out by hand before the protocol tables, kept to measure the engine against
+auto HandWrittenMount(
+  Blt::DiskPartSession &session,
+  asio::readable_pipe &diskpartOut,
+  asio::writable_pipe &diskpartIn,
+  const Blt::DiskPartTarget &target) -> asio::awaitable<Blt::DiskPartError>
+{
+  using Blt::DiskPartError;
+  using Blt::DiskPartState;
+  auto state     = DiskPartState::StartUp;
+  auto nextState = DiskPartState::StartUp;
+
+  auto &buffer               = session.Buffer();
+  auto closeStreamsWithError = [&diskpartOut, &diskpartIn](DiskPartError error) {
+    diskpartIn.close();
+    diskpartOut.close();
+    return error;
+  };
+  const auto &volume       = target.Volume;
+  auto diskId              = std::string();
+  uint64_t partitionOffset = 0;
+
+  auto retry      = Blt::StepRetry();
+  auto retryTimer = asio::steady_timer(co_await asio::this_coro::executor);
+
+  session.Fields.Disk      = target.DiskNumber;
+  session.Fields.Partition = target.PartitionNumber;
+  while (true) {
+    auto error           = DiskPartError::Success;
+    session.Fields.State = static_cast<int>(state);
+    switch (state) {
+    case DiskPartState::StartUp: {
+      error     = co_await Blt::ReadComputerName(session, diskpartOut);
+      nextState = volume ? DiskPartState::SelectDisk : DiskPartState::ListDisk;
+      break;
+    }
+    case DiskPartState::ListDisk: {
+      error     = co_await Blt::ListDisk(session, diskpartIn);
+      nextState = DiskPartState::ReadListDisk;
+      break;
+    }
+    case DiskPartState::ReadListDisk: {
+      error     = co_await Blt::ReadListDisk(session, diskpartOut, target.DiskNumber, target.DiskCapacity);
+      nextState = DiskPartState::SelectDisk;
+      break;
+    }
+    case DiskPartState::SelectDisk: {
+      error     = co_await Blt::SelectDisk(session, diskpartIn, target.DiskNumber);
+      nextState = DiskPartState::ReadSelectDisk;
+      break;
+    }
+    case DiskPartState::ReadSelectDisk: {
+      error     = co_await Blt::ReadSelectDisk(session, diskpartOut, target.DiskNumber);
+      nextState = volume ? DiskPartState::DetailDisk : DiskPartState::ListPartition;
+      break;
+    }
+    case DiskPartState::ListPartition: {
+      error     = co_await Blt::ListPartition(session, diskpartIn);
+      nextState = DiskPartState::ReadListPartition;
+      break;
+    }
+    case DiskPartState::ReadListPartition: {
+      error = co_await Blt::ReadListPartition(session, diskpartOut, target.PartitionNumber, target.PartitionCapacity);
+      nextState = DiskPartState::SelectPartition;
+      break;
+    }
+    case DiskPartState::SelectPartition: {
+      error     = co_await Blt::SelectPartition(session, diskpartIn, target.PartitionNumber);
+      nextState = DiskPartState::ReadSelectPartition;
+      break;
+    }
+    case DiskPartState::ReadSelectPartition: {
+      error     = co_await Blt::ReadSelectPartition(session, diskpartOut, target.PartitionNumber);
+      nextState = volume ? DiskPartState::DetailPartition : DiskPartState::AssignLetter;
+      break;
+    }
+    case DiskPartState::DetailDisk: {
+      error     = co_await Blt::DetailDisk(session, diskpartIn);
+      nextState = DiskPartState::ReadDetailDisk;
+      break;
+    }
+    case DiskPartState::ReadDetailDisk: {
+      error     = co_await Blt::ReadDetailDisk(session, diskpartOut, diskId);
+      nextState = DiskPartState::SelectPartition;
+      if (error == DiskPartError::Success and diskId != volume->DiskId) error = DiskPartError::MismatchDisk;
+      break;
+    }
+    case DiskPartState::DetailPartition: {
+      error     = co_await Blt::DetailPartition(session, diskpartIn);
+      nextState = DiskPartState::ReadDetailPartition;
+      break;
+    }
+    case DiskPartState::ReadDetailPartition: {
+      error     = co_await Blt::ReadDetailPartition(session, diskpartOut, partitionOffset);
+      nextState = DiskPartState::AssignLetter;
+      if (error == DiskPartError::Success and partitionOffset != volume->PartitionOffset)
+        error = DiskPartError::MismatchPartition;
+      break;
+    }
+    case DiskPartState::AssignLetter: {
+      error     = co_await Blt::AssignLetter(session, diskpartIn, target.Mount);
+      nextState = DiskPartState::ReadAssignLetter;
+      break;
+    }
+    case DiskPartState::ReadAssignLetter: {
+      error     = co_await Blt::ReadAssignLetter(session, diskpartOut);
+      nextState = DiskPartState::Exit;
+      break;
+    }
+    case DiskPartState::Exit: {
+      if (error = co_await Blt::Exit(session, diskpartIn); error != DiskPartError::Success)
+        co_return closeStreamsWithError(error);
+      co_return DiskPartError::Success;
+    }
+    default: {
+      co_return closeStreamsWithError(DiskPartError::ParseFailed);
+    }
+    }
+    buffer.clear();
+
+    if (error != DiskPartError::Success) {
+      auto delay = retry.Next(state, error);
+      if (not delay) co_return closeStreamsWithError(error);
+      retryTimer.expires_after(*delay);
+      if (auto [ec] = co_await retryTimer.async_wait(asio::as_tuple(asio::use_awaitable)); ec)
+        co_return closeStreamsWithError(error);
+      nextState = Blt::RetryEntryState(state);
+    }
+    state = nextState;
+  }
+}
+
+auto TableMount(
+  Blt::DiskPartSession &session,
+  asio::readable_pipe &diskpartOut,
+  asio::writable_pipe &diskpartIn,
+  Blt::DiskPartTarget &target) -> asio::awaitable<Blt::DiskPartError>
+{
+  co_return co_await Blt::RunDiskPartProtocol<Blt::DiskPartMountProtocol>(session, diskpartOut, diskpartIn, target);
+}
+
+struct Samples
+{
+  std::vector<double> Latencies;
+  int Failures = 0;
+
+  [[nodiscard]] auto Percentile(double p) -> double
+  {
+    std::ranges::sort(Latencies);
+    return Latencies.empty() ? 0.0
+                             : Latencies[static_cast<std::size_t>(p * static_cast<double>(Latencies.size() - 1))];
+  }
+};
+
+// One conversation against a fresh stand-in, the same pipe setup for both engines
+template<typename Conversation>
+auto Measure(Conversation conversation, Blt::DiskPartTarget target, Samples &samples) -> asio::awaitable<void>
+{
+  auto executor    = co_await asio::this_coro::executor;
+  auto diskpartOut = asio::readable_pipe(executor);
+  auto responseOut = asio::writable_pipe(executor);
+  auto commandIn   = asio::readable_pipe(executor);
+  auto diskpartIn  = asio::writable_pipe(executor);
+  asio::connect_pipe(diskpartOut, responseOut);
+  asio::connect_pipe(commandIn, diskpartIn);
+
+  const auto start = std::chrono::steady_clock::now();
+  Blt::DiskPartSession session;
+  auto error = co_await (
+    conversation(session, diskpartOut, diskpartIn, target) && Blt::Bench::FakeDiskPart(commandIn, responseOut));
+  samples.Latencies.push_back(
+    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+  if (error != Blt::DiskPartError::Success) ++samples.Failures;
+}
+
+auto Run(int rounds, const std::optional<Blt::VolumeKey> &volume, Samples &handWritten, Samples &table)
+  -> asio::awaitable<void>
+{
+  const auto mount  = Blt::MountPoint{.Letter = 'X'};
+  const auto target = Blt::DiskPartTarget{
+    .DiskNumber        = 0,
+    .DiskCapacity      = Blt::capacityCast<Blt::CapacityBytes>(Blt::Gibibytes(1863)),
+    .PartitionNumber   = 6,
+    .PartitionCapacity = Blt::capacityCast<Blt::CapacityBytes>(Blt::Gibibytes(362)),
+    .Mount             = mount,
+    .Volume            = volume,
+  };
+  // alternating, so neither engine gets the warmer caches
+  for (int round = 0; round < rounds; ++round) {
+    co_await Measure(HandWrittenMount, target, handWritten);
+    co_await Measure(TableMount, target, table);
+  }
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_ProtocolBench  [rounds]
+ *
+ * Runs the mount conversation against the in-memory diskpart stand-in with the old hand-written loop and with the
+ * protocol table engine, once locating the partition through the list tables and once by volume key, and prints the
+ * latency percentiles of each.
+ */
+int main(int argc, char **argv)
+{
+  const int rounds = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+  // the steps log every command, keep the text out of the terminal like PipeBench does
+  if (std::freopen(nullDevice, "w", stdout) == nullptr) return EXIT_FAILURE;
+  Blt::LogSink::Instance().Start(Blt::LogOptions{});
+
+  const auto volume = std::optional<Blt::VolumeKey>(
+    Blt::VolumeKey{
+      .DiskId = Blt::NormalizeDiskId("{8A3E2F4C-5B6D-4E7F-8091-A2B3C4D5E6F7}"), .PartitionOffset = 536870912000});
+  auto results = std::vector<std::pair<std::string, Samples>>();
+  for (const auto route : {std::string_view("tables"), std::string_view("volume")}) {
+    auto handWritten = Samples();
+    auto table       = Samples();
+    asio::io_context ioc;
+    asio::co_spawn(
+      ioc, Run(rounds, route == "volume" ? volume : std::nullopt, handWritten, table), asio::detached);
+    ioc.run();
+    results.emplace_back(fmt::format("{} hand-written", route), std::move(handWritten));
+    results.emplace_back(fmt::format("{} table", route), std::move(table));
+  }
+
+  Blt::LogSink::Instance().Stop();
+  for (auto &[name, samples] : results)
+    fmt::println(
+      stderr,
+      "{:<20} {} sessions, p50 {:.1f}us, p99 {:.1f}us, failures {}",
+      name,
+      samples.Latencies.size(),
+      samples.Percentile(0.50),
+      samples.Percentile(0.99),
+      samples.Failures);
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
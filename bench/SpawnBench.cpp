@@ -0,0 +1,145 @@
+#include <fmt/format.h>
+#include <boost/asio.hpp>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/process/v2.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Common.hpp"
+#include "Spawn.hpp"
+
+namespace asio = boost::asio;
+namespace proc = boost::process::v2;
+
+namespace {
+
+constexpr auto standInArgument = std::string_view("--stand-in");
+
+// Answers like diskpart does on startup, then waits for the parent to hang up
+auto RunStandIn() -> int
+{
+  constexpr auto prompt = std::string_view("DISKPART> ");
+  std::fwrite(prompt.data(), 1, prompt.size(), stdout);
+  std::fflush(stdout);
+  for (int byte = std::fgetc(stdin); byte != EOF and byte != '\n'; byte = std::fgetc(stdin)) {}
+  return EXIT_SUCCESS;
+}
+
+auto SelfPath() -> std::filesystem::path
+{
+#ifdef _WIN32
+  std::array<wchar_t, MAX_PATH> self;
+  const auto size = GetModuleFileNameW(nullptr, self.data(), static_cast<DWORD>(self.size()));
+  return std::filesystem::path(std::wstring_view(self.data(), size));
+#else
+  return std::filesystem::read_symlink("/proc/self/exe");
+#endif
+}
+
+using Launch = std::function<proc::process(asio::writable_pipe &, asio::readable_pipe &, boost::system::error_code &)>;
+
+// Time from asking for the child to the first byte it writes, the stand-in is reaped outside the measurement
+auto Measure(int runs, Launch launch, std::vector<double> &samples, int &failures) -> asio::awaitable<void>
+{
+  auto executor = co_await asio::this_coro::executor;
+  for (int run = 0; run < runs; ++run) {
+    auto in  = asio::writable_pipe(executor);
+    auto out = asio::readable_pipe(executor);
+    auto ec  = boost::system::error_code();
+
+    const auto start = std::chrono::steady_clock::now();
+    auto child       = launch(in, out, ec);
+    if (ec) {
+      ++failures;
+      continue;
+    }
+    std::array<char, 64> first;
+    auto [readError, size] = co_await out.async_read_some(asio::buffer(first), asio::as_tuple(asio::use_awaitable));
+    const auto elapsed     = std::chrono::steady_clock::now() - start;
+    if (readError or size == 0) ++failures;
+    samples.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+
+    co_await asio::async_write(in, asio::buffer("exit\n", 5), asio::as_tuple(asio::use_awaitable));
+    in.close();
+    co_await child.async_wait(asio::as_tuple(asio::use_awaitable));
+  }
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_SpawnBench  [runs]
+ *
+ * Starts itself as a trivial diskpart stand-in `runs` times per strategy and reports the time from the launch call
+ * to the stand-in's first output:
+ *   process        boost::process with its default launcher, what the tool used before
+ *   spawner        Spawner with the path, environment and pipes prepared by the previous launch
+ *   spawner-cold   a fresh Spawner per launch, resolving and opening pipes on the spot
+ */
+int main(int argc, char **argv)
+{
+  if (argc > 1 and argv[1] == standInArgument) return RunStandIn();
+  const int runs = argc > 1 ? std::atoi(argv[1]) : 200;
+
+  const auto self      = SelfPath();
+  const auto arguments = std::vector<std::string>{std::string(standInArgument)};
+  auto warm            = Blt::Spawner([&self] { return self; });
+  warm.Prepare(true);
+
+  asio::io_context ioc;
+  auto executor   = asio::any_io_executor(ioc.get_executor());
+  auto strategies = std::vector<std::pair<std::string_view, Launch>>{
+    {"process",
+     [&](asio::writable_pipe &in, asio::readable_pipe &out, boost::system::error_code &ec) {
+       return proc::default_process_launcher()(
+         executor, ec, self, std::vector<std::string>{arguments}, proc::process_stdio{in, out, {}});
+     }},
+    {"spawner",
+     [&](asio::writable_pipe &in, asio::readable_pipe &out, boost::system::error_code &ec) {
+       return warm.Launch(executor, arguments, Blt::SpawnStdio{.In = &in, .Out = &out}, nullptr, ec);
+     }},
+    {"spawner-cold",
+     [&](asio::writable_pipe &in, asio::readable_pipe &out, boost::system::error_code &ec) {
+       auto cold = Blt::Spawner([&self] { return self; });
+       return cold.Launch(executor, arguments, Blt::SpawnStdio{.In = &in, .Out = &out}, nullptr, ec);
+     }},
+  };
+
+  for (auto &[name, launch] : strategies) {
+    auto samples  = std::vector<double>();
+    auto failures = 0;
+    samples.reserve(static_cast<std::size_t>(runs));
+    asio::co_spawn(ioc, Measure(runs, launch, samples, failures), asio::detached);
+    ioc.run();
+    ioc.restart();
+
+    if (samples.empty()) {
+      fmt::println("{}: no samples, {} failures", name, failures);
+      continue;
+    }
+    std::ranges::sort(samples);
+    const auto at = [&samples](double p) {
+      return samples[static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1))];
+    };
+    fmt::println(
+      "{}: n {}, p50 {:.0f}us, p90 {:.0f}us, p99 {:.0f}us, max {:.0f}us, failures {}",
+      name,
+      samples.size(),
+      at(0.5),
+      at(0.9),
+      at(0.99),
+      samples.back(),
+      failures);
+  }
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
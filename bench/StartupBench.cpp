@@ -0,0 +1,105 @@
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <io.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace {
+
+constexpr auto standInVariable = "BLT_STARTUP_BENCH_STANDIN";
+constexpr auto marker          = std::string_view("time-to-first-command: ");
+
+// Plays diskpart just long enough for BitLockerTool to write its first command, then hangs up
+auto RunStandIn() -> int
+{
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+
+  constexpr auto banner = std::string_view("\r\nMicrosoft DiskPart version 10.0.19041.3636\r\n\r\n"
+                                           "Copyright (C) Microsoft Corporation.\r\n"
+                                           "On computer: BENCH\r\n\r\nDISKPART> ");
+  std::fwrite(banner.data(), 1, banner.size(), stdout);
+  std::fflush(stdout);
+
+  for (int byte = std::fgetc(stdin); byte != EOF and byte != '\n' and byte != '\0'; byte = std::fgetc(stdin)) {}
+  return EXIT_SUCCESS;
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_StartupBench.exe  <path to BitLockerTool.exe>  [runs]
+ *
+ * Starts BitLockerTool `runs` times with this executable standing in for diskpart and collects the
+ * time-to-first-command each run reports through BLT_STARTUP_TRACE. Must run elevated, BitLockerTool requires it.
+ */
+int main(int argc, char **argv)
+{
+  if (std::getenv(standInVariable)) return RunStandIn();
+
+  if (argc < 2) {
+    fmt::println(stderr, "usage: {} <BitLockerTool.exe> [runs]", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const int runs = argc > 2 ? std::atoi(argv[2]) : 50;
+
+  std::array<char, MAX_PATH> self;
+  const auto selfSize = GetModuleFileNameA(nullptr, self.data(), static_cast<DWORD>(self.size()));
+  if (selfSize == 0 or selfSize == self.size()) return EXIT_FAILURE;
+
+  _putenv_s(standInVariable, "1");
+  _putenv_s("BLT_STARTUP_TRACE", "1");
+  _putenv_s("BLT_DISKPART_PATH", self.data());
+
+  const auto command = fmt::format("\"\"{}\" mount 0:1863:GiB 6:362:GiB X 2>&1\"", argv[1]);
+  std::vector<double> firstCommand;
+  std::vector<double> wall;
+  for (int run = 0; run < runs; ++run) {
+    const auto start = std::chrono::steady_clock::now();
+    auto *output     = _popen(command.c_str(), "r");
+    if (not output) return EXIT_FAILURE;
+
+    std::array<char, 512> line;
+    while (std::fgets(line.data(), static_cast<int>(line.size()), output)) {
+      auto view = std::string_view(line.data());
+      if (auto position = view.find(marker); position != std::string_view::npos) {
+        view.remove_prefix(position + marker.size());
+        uint64_t micros = 0;
+        std::from_chars(view.data(), view.data() + view.size(), micros);
+        firstCommand.push_back(static_cast<double>(micros));
+      }
+    }
+    _pclose(output);
+    wall.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  const auto report = [](std::string_view name, std::vector<double> &samples) {
+    if (samples.empty()) {
+      fmt::println("{}: no samples", name);
+      return;
+    }
+    std::ranges::sort(samples);
+    const auto at = [&samples](double p) {
+      return samples[static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1))];
+    };
+    fmt::println("{}: n {}, p50 {:.0f}us, p90 {:.0f}us, max {:.0f}us",
+                 name, samples.size(), at(0.5), at(0.9), samples.back());
+  };
+  report("time-to-first-command", firstCommand);
+  report("run wall time", wall);
+  return EXIT_SUCCESS;
+}
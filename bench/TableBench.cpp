@@ -0,0 +1,116 @@
+#include <fmt/format.h>
+#include <ctre-unicode.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "Common.hpp"
+#include "DiskPartTable.hpp"
+
+namespace {
+
+// The per-row regex `list disk` / `list partition` were matched with before the ruler based decoder
+auto RegexListRows(std::u8string_view response, std::vector<Blt::ListRow> &rows) -> bool
+{
+  for (auto row : ctre::multiline_search_all<"[^\\s\\d]+\\h+(\\d+)\\h+.+?\\h+(\\d+)\\h(.+?)\\h+.+">(response)) {
+    int number;
+    auto numberView = Blt::toCompatView(row.get<1>());
+    if (auto [_, ec] = std::from_chars(numberView.data(), numberView.data() + numberView.size(), number, 10);
+        ec != std::error_code())
+      return false;
+
+    uint64_t capacityValue;
+    auto capacityView = Blt::toCompatView(row.get<2>());
+    if (auto [_, ec] =
+          std::from_chars(capacityView.data(), capacityView.data() + capacityView.size(), capacityValue, 10);
+        ec != std::error_code())
+      return false;
+
+    Blt::CapacityBytes capacity;
+    auto unit = Blt::toCompatView(row.get<3>());
+    if (unit == "B") {
+      capacity = Blt::CapacityBytes(capacityValue);
+    } else if (unit == "KB") {
+      capacity = Blt::capacityCast<Blt::CapacityBytes>(Blt::Kibibytes(capacityValue));
+    } else if (unit == "MB") {
+      capacity = Blt::capacityCast<Blt::CapacityBytes>(Blt::Mebibytes(capacityValue));
+    } else if (unit == "GB") {
+      capacity = Blt::capacityCast<Blt::CapacityBytes>(Blt::Gibibytes(capacityValue));
+    } else if (unit == "TB") {
+      capacity = Blt::capacityCast<Blt::CapacityBytes>(Blt::Gibibytes(capacityValue * 1024));
+    } else {
+      return false;
+    }
+    rows.push_back(Blt::ListRow{.Number = number, .Capacity = capacity});
+  }
+  return true;
+}
+
+auto TableListRows(std::u8string_view response, std::vector<Blt::ListRow> &rows) -> bool
+{
+  return Blt::ForEachListRow(response, [&rows](Blt::ListRow row) { rows.push_back(row); });
+}
+
+// A `list partition` answer with `rows` partitions, the way a backup server with many volumes on one disk prints it
+auto MakeTable(int rows) -> std::u8string
+{
+  auto text = std::string(
+    "\r\n  Partition ###  Type              Size     Offset\r\n"
+    "  -------------  ----------------  -------  -------\r\n");
+  for (int row = 0; row < rows; ++row)
+    text += fmt::format("  Partition {:<4} {:<16}  {:>4} GB  {:>4} GB\r\n", row + 1, "Primary", 100 + row, row * 100);
+  text += "\r\nDISKPART> ";
+  return std::u8string(text.begin(), text.end());
+}
+
+using Decoder = auto (*)(std::u8string_view, std::vector<Blt::ListRow> &) -> bool;
+
+auto Measure(Decoder decode, std::u8string_view table, int iterations, std::vector<Blt::ListRow> &rows) -> double
+{
+  const auto start = std::chrono::steady_clock::now();
+  for (int iteration = 0; iteration < iterations; ++iteration) {
+    rows.clear();
+    if (not decode(table, rows)) return -1;
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_TableBench  [rows]  [iterations]
+ *
+ * Decodes a synthetic `list partition` table of `rows` rows with the old regex and with the ruler based decoder,
+ * checks that both agree and prints the time per table and per row.
+ */
+int main(int argc, char **argv)
+{
+  const int rows       = argc > 1 ? std::atoi(argv[1]) : 128;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 2000;
+  const auto table     = MakeTable(rows);
+
+  auto regexRows     = std::vector<Blt::ListRow>();
+  auto tableRows     = std::vector<Blt::ListRow>();
+  const auto regex   = Measure(RegexListRows, table, iterations, regexRows);
+  const auto decoder = Measure(TableListRows, table, iterations, tableRows);
+
+  const auto same = std::ranges::equal(regexRows, tableRows, [](const Blt::ListRow &left, const Blt::ListRow &right) {
+    return left.Number == right.Number and left.Capacity == right.Capacity;
+  });
+  if (regex < 0 or decoder < 0 or not same or static_cast<int>(tableRows.size()) != rows) {
+    fmt::println("decoders disagree: regex {} rows, table {} rows", regexRows.size(), tableRows.size());
+    return EXIT_FAILURE;
+  }
+
+  fmt::println("rows {}, {} bytes, {} iterations", rows, table.size(), iterations);
+  fmt::println("regex: {:.0f}ns per table, {:.1f}ns per row", regex, regex / rows);
+  fmt::println("table: {:.0f}ns per table, {:.1f}ns per row", decoder, decoder / rows);
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "Accounting.hpp"
+
+#include <algorithm>
+
+#include "Log.hpp"
+
+namespace Blt {
+
+namespace {
+#ifndef _WIN32
+  auto microseconds(const timeval &time) -> std::chrono::microseconds
+  {
+    return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+  }
+#endif
+}// namespace
+
+auto ResourceUsage::operator+=(const ResourceUsage &other) -> ResourceUsage &
+{
+  UserTime += other.UserTime;
+  KernelTime += other.KernelTime;
+  PeakMemoryBytes = std::max(PeakMemoryBytes, other.PeakMemoryBytes);
+  ReadOperations += other.ReadOperations;
+  WriteOperations += other.WriteOperations;
+  ReadBytes += other.ReadBytes;
+  WriteBytes += other.WriteBytes;
+  Processes += other.Processes;
+  return *this;
+}
+
+#ifdef _WIN32
+ChildAccounting::ChildAccounting()
+  : job_(CreateJobObjectW(nullptr, nullptr))
+{}
+
+ChildAccounting::~ChildAccounting()
+{
+  // without JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE closing the job leaves its processes running
+  if (job_) CloseHandle(job_);
+}
+
+void ChildAccounting::Attach(NativeProcessHandle process)
+{
+  if (job_ and process and not AssignProcessToJobObject(job_, process))
+    Log(LogLevel::Debug, "unable to account for a helper: {}", GetLastError());
+}
+
+auto ChildAccounting::Collect() const -> ResourceUsage
+{
+  auto usage = ResourceUsage();
+  if (not job_) return usage;
+
+  auto accounting = JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION{};
+  if (QueryInformationJobObject(
+        job_, JobObjectBasicAndIoAccountingInformation, &accounting, sizeof(accounting), nullptr)) {
+    // 100ns ticks
+    usage.UserTime        = std::chrono::microseconds(accounting.BasicInfo.TotalUserTime.QuadPart / 10);
+    usage.KernelTime      = std::chrono::microseconds(accounting.BasicInfo.TotalKernelTime.QuadPart / 10);
+    usage.Processes       = accounting.BasicInfo.TotalProcesses;
+    usage.ReadOperations  = accounting.IoInfo.ReadOperationCount;
+    usage.WriteOperations = accounting.IoInfo.WriteOperationCount;
+    usage.ReadBytes       = accounting.IoInfo.ReadTransferCount;
+    usage.WriteBytes      = accounting.IoInfo.WriteTransferCount;
+  }
+
+  auto limits = JOBOBJECT_EXTENDED_LIMIT_INFORMATION{};
+  if (QueryInformationJobObject(job_, JobObjectExtendedLimitInformation, &limits, sizeof(limits), nullptr))
+    usage.PeakMemoryBytes = limits.PeakJobMemoryUsed;
+  return usage;
+}
+#else
+ChildAccounting::ChildAccounting() { getrusage(RUSAGE_CHILDREN, &before_); }
+
+ChildAccounting::~ChildAccounting() = default;
+
+void ChildAccounting::Attach(NativeProcessHandle) { ++attached_; }
+
+auto ChildAccounting::Collect() const -> ResourceUsage
+{
+  auto now = rusage{};
+  getrusage(RUSAGE_CHILDREN, &now);
+  return ResourceUsage{
+    .UserTime        = microseconds(now.ru_utime) - microseconds(before_.ru_utime),
+    .KernelTime      = microseconds(now.ru_stime) - microseconds(before_.ru_stime),
+    .PeakMemoryBytes = static_cast<uint64_t>(now.ru_maxrss) * 1024,
+    .ReadOperations  = 0,
+    .WriteOperations = 0,
+    .ReadBytes       = static_cast<uint64_t>(now.ru_inblock - before_.ru_inblock) * 512,
+    .WriteBytes      = static_cast<uint64_t>(now.ru_oublock - before_.ru_oublock) * 512,
+    .Processes       = attached_,
+  };
+}
+#endif
+
+void UsageSummary::Add(std::string_view helper, const ResourceUsage &usage)
+{
+  auto entry = std::ranges::find(helpers_, helper, &std::pair<std::string, ResourceUsage>::first);
+  if (entry == helpers_.end()) {
+    helpers_.emplace_back(std::string(helper), usage);
+  } else {
+    entry->second += usage;
+  }
+}
+
+void UsageSummary::Report() const
+{
+  if (helpers_.empty()) return;
+
+  auto total = ResourceUsage();
+  for (const auto &[helper, usage] : helpers_) {
+    Log(LogLevel::Info, "{}: {}", helper, usage);
+    total += usage;
+  }
+  Log(LogLevel::Info, "helpers in total: {}", total);
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Common.hpp"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace Blt {
+
+// What one or more helper processes cost, summed except for the peak which is the largest seen
+struct ResourceUsage
+{
+  std::chrono::microseconds UserTime{0};
+  std::chrono::microseconds KernelTime{0};
+  uint64_t PeakMemoryBytes = 0;
+  uint64_t ReadOperations  = 0;
+  uint64_t WriteOperations = 0;
+  uint64_t ReadBytes       = 0;
+  uint64_t WriteBytes      = 0;
+  uint32_t Processes       = 0;
+
+  auto operator+=(const ResourceUsage &other) -> ResourceUsage &;
+};
+
+#ifdef _WIN32
+using NativeProcessHandle = HANDLE;
+#else
+using NativeProcessHandle = int;
+#endif
+
+/**
+ * Accounts for the helpers launched for one operation.
+ * On Windows every attached process goes into a job object, which also covers whatever it spawns and keeps the
+ * numbers of processes that already exited. Peak memory is the job's peak commit.
+ * Elsewhere the usage is the growth of RUSAGE_CHILDREN since construction: it only counts children that have been
+ * reaped, children of concurrent operations that are reaped in between are included, and the peak is the largest
+ * resident set of any child so far because rusage keeps no per-child history. I/O is counted in 512 byte blocks with
+ * no operation counts.
+ */
+class ChildAccounting
+{
+public:
+  ChildAccounting();
+  ~ChildAccounting();
+
+  ChildAccounting(const ChildAccounting &)            = delete;
+  ChildAccounting &operator=(const ChildAccounting &) = delete;
+
+  // Right after the launch, anything the child did before is not accounted for
+  void Attach(NativeProcessHandle process);
+
+  // A boost::process v2 process, generic so this header does not pull in the process library
+  template<typename Process>
+  void AttachProcess(Process &process)
+  {
+#ifdef _WIN32
+    Attach(process.native_handle());
+#else
+    Attach(process.id());
+#endif
+  }
+
+  [[nodiscard]] auto Collect() const -> ResourceUsage;
+
+private:
+#ifdef _WIN32
+  HANDLE job_ = nullptr;
+#else
+  rusage before_{};
+  uint32_t attached_ = 0;
+#endif
+};
+
+// Usage per helper across the whole run, only touched from the io_context thread
+class UsageSummary
+{
+public:
+  void Add(std::string_view helper, const ResourceUsage &usage);
+
+  // One log record per helper and one for the total
+  void Report() const;
+
+private:
+  std::vector<std::pair<std::string, ResourceUsage>> helpers_;
+};
+
+}// namespace Blt
+
+template<>
+struct fmt::formatter<Blt::ResourceUsage> : fmt::formatter<std::string_view>
+{
+  auto format(const Blt::ResourceUsage &usage, fmt::format_context &context) const
+  {
+    constexpr auto mebibytes = [](uint64_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+    return fmt::format_to(
+      context.out(),
+      "{} processes, cpu {}us user {}us kernel, peak {:.1f} MiB, read {:.1f} MiB in {} ops, wrote {:.1f} MiB in {} ops",
+      usage.Processes,
+      usage.UserTime.count(),
+      usage.KernelTime.count(),
+      mebibytes(usage.PeakMemoryBytes),
+      mebibytes(usage.ReadBytes),
+      usage.ReadOperations,
+      mebibytes(usage.WriteBytes),
+      usage.WriteOperations);
+  }
+};
\ No newline at end of file
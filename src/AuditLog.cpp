@@ -0,0 +1,511 @@
+#include "AuditLog.hpp"
+
+#include <fmt/chrono.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Common.hpp"
+#include "Log.hpp"
+#include "SessionLock.hpp"
+
+namespace Blt {
+
+namespace {
+  constexpr auto auditHeader = std::string_view("# BitLockerTool audit log v1");
+  constexpr auto hashDigits  = std::size_t{16};
+  // the end of the file is read in one piece, a record is far shorter
+  constexpr auto tailBytes = std::size_t{64 * 1024};
+
+#ifdef _WIN32
+  using File = HANDLE;
+#else
+  using File = int;
+#endif
+
+  auto fnv(uint64_t hash, std::string_view bytes) -> uint64_t
+  {
+    for (auto byte : bytes) {
+      hash ^= static_cast<unsigned char>(byte);
+      hash *= 0x100000001b3;
+    }
+    return hash;
+  }
+
+  // FNV-1a of the previous line's hash, the sequence and the payload, exactly as the line spells them
+  auto chainHash(uint64_t previous, uint64_t sequence, std::string_view payload) -> uint64_t
+  {
+    auto prefix    = std::array<char, 48>();
+    const auto end = fmt::format_to_n(prefix.data(), prefix.size(), "{:016x} {} ", previous, sequence).out;
+    return fnv(fnv(0xcbf29ce484222325, std::string_view(prefix.data(), end)), payload);
+  }
+
+  struct AuditLine
+  {
+    uint64_t Hash;
+    uint64_t Sequence;
+    std::string_view Payload;
+  };
+
+  auto parseLine(std::string_view line) -> std::optional<AuditLine>
+  {
+    auto parsed = AuditLine();
+    if (line.size() < hashDigits + 4 or line[hashDigits] != ' ') return std::nullopt;
+    if (std::from_chars(line.data(), line.data() + hashDigits, parsed.Hash, 16).ec != std::errc()) return std::nullopt;
+
+    const auto *sequenceEnd = line.data() + line.size();
+    const auto [end, error] = std::from_chars(line.data() + hashDigits + 1, sequenceEnd, parsed.Sequence, 10);
+    if (error != std::errc() or end == sequenceEnd or *end != ' ') return std::nullopt;
+    parsed.Payload = line.substr(static_cast<std::size_t>(end - line.data()) + 1);
+    return parsed;
+  }
+
+  auto formatPayload(const AuditRecord &record) -> std::string
+  {
+    auto out = fmt::memory_buffer();
+    fmt::format_to(
+      std::back_inserter(out),
+      R"({{"time":"{:%FT%TZ}","op":{},"action":)",
+      std::chrono::floor<std::chrono::milliseconds>(record.Started),
+      record.Operation);
+    AppendJsonString(out, record.Action);
+    out.append(std::string_view(R"(,"target":)"));
+    AppendJsonString(out, record.Target);
+    out.append(std::string_view(R"(,"mount":)"));
+    AppendJsonString(out, record.Mount);
+    out.append(std::string_view(R"(,"outcome":)"));
+    AppendJsonString(out, record.Outcome);
+    fmt::format_to(
+      std::back_inserter(out),
+      R"(,"diskpart":{},"elapsed_us":{},"states":[)",
+      fmt::underlying(record.DiskPart),
+      record.Elapsed.count());
+
+    // [state, microseconds into the session] in the order they were entered
+    auto separator = std::string_view();
+    for (const auto &step : record.Trace.Recorded()) {
+      fmt::format_to(
+        std::back_inserter(out),
+        "{}[{},{}]",
+        separator,
+        step.State,
+        std::chrono::duration_cast<std::chrono::microseconds>(step.Entered).count());
+      separator = ",";
+    }
+    fmt::format_to(
+      std::back_inserter(out), R"(],"states_untraced":{}}})", record.Trace.Entered - record.Trace.Recorded().size());
+    return fmt::to_string(out);
+  }
+
+#ifdef _WIN32
+  auto openFile(const std::filesystem::path &path) -> File
+  {
+    return CreateFileW(
+      path.c_str(),
+      GENERIC_READ | GENERIC_WRITE,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      nullptr,
+      OPEN_ALWAYS,
+      FILE_ATTRIBUTE_NORMAL,
+      nullptr);
+  }
+
+  auto isOpen(File file) -> bool { return file != INVALID_HANDLE_VALUE; }
+
+  void closeFile(File file) { CloseHandle(file); }
+
+  auto fileSize(File file) -> std::optional<uint64_t>
+  {
+    auto size = LARGE_INTEGER{};
+    if (not GetFileSizeEx(file, &size)) return std::nullopt;
+    return static_cast<uint64_t>(size.QuadPart);
+  }
+
+  auto readAt(File file, uint64_t offset, std::span<char> bytes) -> bool
+  {
+    while (not bytes.empty()) {
+      auto overlapped       = OVERLAPPED{};
+      overlapped.Offset     = static_cast<DWORD>(offset);
+      overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+      auto read             = DWORD{0};
+      if (not ReadFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &read, &overlapped) or read == 0)
+        return false;
+      bytes = bytes.subspan(read);
+      offset += read;
+    }
+    return true;
+  }
+
+  auto writeAt(File file, uint64_t offset, std::string_view bytes) -> bool
+  {
+    while (not bytes.empty()) {
+      auto overlapped       = OVERLAPPED{};
+      overlapped.Offset     = static_cast<DWORD>(offset);
+      overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+      auto written          = DWORD{0};
+      if (not WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written, &overlapped)) return false;
+      bytes.remove_prefix(written);
+      offset += written;
+    }
+    return true;
+  }
+
+  auto syncData(File file) -> bool { return FlushFileBuffers(file); }
+
+  auto truncateTo(File file, uint64_t size) -> bool
+  {
+    auto end               = FILE_END_OF_FILE_INFO{};
+    end.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+    return SetFileInformationByHandle(file, FileEndOfFileInfo, &end, sizeof(end));
+  }
+
+  auto lastError() -> std::string { return fmt::format("error {}", GetLastError()); }
+
+  // A byte far past any record, locked ranges are enforced against reads and a verify must not wait for a commit
+  class CommitGuard
+  {
+  public:
+    explicit CommitGuard(File file)
+      : file_(file)
+    {
+      auto overlapped       = OVERLAPPED{};
+      overlapped.OffsetHigh = 0x7fffffff;
+      locked_               = LockFileEx(file_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped);
+    }
+    ~CommitGuard()
+    {
+      if (not locked_) return;
+      auto overlapped       = OVERLAPPED{};
+      overlapped.OffsetHigh = 0x7fffffff;
+      UnlockFileEx(file_, 0, 1, 0, &overlapped);
+    }
+
+    CommitGuard(const CommitGuard &)            = delete;
+    CommitGuard &operator=(const CommitGuard &) = delete;
+
+    explicit operator bool() const { return locked_; }
+
+  private:
+    File file_;
+    BOOL locked_;
+  };
+#else
+  auto openFile(const std::filesystem::path &path) -> File
+  {
+    return ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0640);
+  }
+
+  auto isOpen(File file) -> bool { return file >= 0; }
+
+  void closeFile(File file) { ::close(file); }
+
+  auto fileSize(File file) -> std::optional<uint64_t>
+  {
+    struct stat status;
+    if (::fstat(file, &status) != 0) return std::nullopt;
+    return static_cast<uint64_t>(status.st_size);
+  }
+
+  auto readAt(File file, uint64_t offset, std::span<char> bytes) -> bool
+  {
+    while (not bytes.empty()) {
+      const auto read = ::pread(file, bytes.data(), bytes.size(), static_cast<off_t>(offset));
+      if (read < 0 and errno == EINTR) continue;
+      if (read <= 0) return false;
+      bytes = bytes.subspan(static_cast<std::size_t>(read));
+      offset += static_cast<uint64_t>(read);
+    }
+    return true;
+  }
+
+  auto writeAt(File file, uint64_t offset, std::string_view bytes) -> bool
+  {
+    while (not bytes.empty()) {
+      const auto written = ::pwrite(file, bytes.data(), bytes.size(), static_cast<off_t>(offset));
+      if (written < 0 and errno == EINTR) continue;
+      if (written < 0) return false;
+      bytes.remove_prefix(static_cast<std::size_t>(written));
+      offset += static_cast<uint64_t>(written);
+    }
+    return true;
+  }
+
+  auto syncData(File file) -> bool { return ::fdatasync(file) == 0; }
+
+  auto truncateTo(File file, uint64_t size) -> bool { return ::ftruncate(file, static_cast<off_t>(size)) == 0; }
+
+  auto lastError() -> std::string { return std::strerror(errno); }
+
+  class CommitGuard
+  {
+  public:
+    explicit CommitGuard(File file)
+      : file_(file)
+    {
+      do locked_ = ::flock(file_, LOCK_EX) == 0;
+      while (not locked_ and errno == EINTR);
+    }
+    ~CommitGuard()
+    {
+      if (locked_) ::flock(file_, LOCK_UN);
+    }
+
+    CommitGuard(const CommitGuard &)            = delete;
+    CommitGuard &operator=(const CommitGuard &) = delete;
+
+    explicit operator bool() const { return locked_; }
+
+  private:
+    File file_;
+    bool locked_;
+  };
+#endif
+}// namespace
+
+auto AuditLog::Open(std::filesystem::path path, AuditPolicy policy) -> std::unique_ptr<AuditLog>
+{
+  auto ec = std::error_code();
+  if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+
+  auto file = openFile(path);
+  if (not isOpen(file)) {
+    Log(LogLevel::Error, "unable to open audit log {}: {}", path.string(), lastError());
+    return nullptr;
+  }
+  auto head = std::optional<Head>();
+  if (auto guard = CommitGuard(file)) head = readHead(file, path);
+  if (not head) {
+    closeFile(file);
+    return nullptr;
+  }
+  return std::unique_ptr<AuditLog>(new AuditLog(file, std::move(path), policy, *head));
+}
+
+AuditLog::AuditLog(NativeFile file, std::filesystem::path path, AuditPolicy policy, Head head)
+  : file_(file)
+  , path_(std::move(path))
+  , policy_(policy)
+  , head_(head)
+{
+  writer_ = std::thread([this] { writerLoop(); });
+}
+
+AuditLog::~AuditLog()
+{
+  Stop();
+  closeFile(file_);
+}
+
+void AuditLog::Append(const AuditRecord &record, AuditCompletion completion)
+{
+  auto payload = formatPayload(record);
+  {
+    auto lock = std::lock_guard(mutex_);
+    if (not stopping_) {
+      queue_.push_back(Pending{.Payload = std::move(payload), .Completion = std::move(completion)});
+      queued_.notify_one();
+      return;
+    }
+  }
+  Log(LogLevel::Error, "audit log is closed, op {} was not recorded", record.Operation);
+  completion(false);
+}
+
+void AuditLog::Stop()
+{
+  {
+    auto lock = std::lock_guard(mutex_);
+    if (stopping_) return;
+    stopping_ = true;
+  }
+  queued_.notify_one();
+  writer_.join();
+}
+
+auto AuditLog::Commits() const -> uint64_t
+{
+  auto lock = std::lock_guard(mutex_);
+  return commits_;
+}
+
+void AuditLog::writerLoop()
+{
+  auto batch = std::vector<Pending>();
+  while (true) {
+    {
+      auto lock = std::unique_lock(mutex_);
+      queued_.wait(lock, [this] { return stopping_ or not queue_.empty(); });
+      // Stop commits what is queued before the writer goes
+      if (queue_.empty()) break;
+      // the first record is in, operations finishing right after it share its flush
+      if (not stopping_ and policy_.Linger.count() > 0)
+        queued_.wait_for(lock, policy_.Linger, [this] { return stopping_ or queue_.size() >= policy_.MaxBatch; });
+      // a commit takes at most MaxBatch records, the rest are next in line
+      const auto taken = std::min(queue_.size(), std::max<std::size_t>(policy_.MaxBatch, 1));
+      if (taken == queue_.size()) {
+        batch.swap(queue_);
+      } else {
+        const auto end = queue_.begin() + static_cast<std::ptrdiff_t>(taken);
+        batch.assign(std::make_move_iterator(queue_.begin()), std::make_move_iterator(end));
+        queue_.erase(queue_.begin(), end);
+      }
+    }
+
+    const auto durable = commit(batch);
+    if (not durable) Log(LogLevel::Error, "unable to commit {} audit records to {}", batch.size(), path_.string());
+    {
+      auto lock = std::lock_guard(mutex_);
+      ++commits_;
+    }
+    for (auto &pending : batch) pending.Completion(durable);
+    batch.clear();
+  }
+}
+
+auto AuditLog::commit(std::vector<Pending> &batch) -> bool
+{
+  auto guard = CommitGuard(file_);
+  if (not guard) return false;
+
+  // another process committed since, continue its chain
+  const auto size = fileSize(file_);
+  if (not size) return false;
+  if (*size != head_.End) {
+    auto head = readHead(file_, path_);
+    if (not head) return false;
+    head_ = *head;
+  }
+
+  auto out = fmt::memory_buffer();
+  if (head_.End == 0) fmt::format_to(std::back_inserter(out), "{}\n", auditHeader);
+  auto head = head_;
+  for (const auto &pending : batch) {
+    ++head.Sequence;
+    head.Hash = chainHash(head.Hash, head.Sequence, pending.Payload);
+    fmt::format_to(std::back_inserter(out), "{:016x} {} {}\n", head.Hash, head.Sequence, pending.Payload);
+  }
+  if (not writeAt(file_, head_.End, std::string_view(out.data(), out.size())) or not syncData(file_)) {
+    // whatever made it stays unacknowledged, the next commit re-reads the end and cuts it off
+    head_.End = std::numeric_limits<uint64_t>::max();
+    return false;
+  }
+  head.End = head_.End + out.size();
+  head_    = head;
+  return true;
+}
+
+auto AuditLog::readHead(NativeFile file, const std::filesystem::path &path) -> std::optional<Head>
+{
+  const auto size = fileSize(file);
+  if (not size) return std::nullopt;
+  if (*size == 0) return Head();
+
+  const auto start = *size - std::min<uint64_t>(*size, tailBytes);
+  auto tail        = std::string(static_cast<std::size_t>(*size - start), '\0');
+  auto header      = std::string(std::min<std::size_t>(auditHeader.size(), static_cast<std::size_t>(*size)), '\0');
+  if (not readAt(file, 0, header) or not readAt(file, start, tail)) {
+    Log(LogLevel::Error, "unable to read audit log {}: {}", path.string(), lastError());
+    return std::nullopt;
+  }
+  if (not auditHeader.starts_with(header)) {
+    Log(LogLevel::Error, "{} is not an audit log", path.string());
+    return std::nullopt;
+  }
+
+  // a commit that did not get to its flush was never acknowledged, its records are not part of the log
+  const auto lastNewline = tail.rfind('\n');
+  const auto intact      = lastNewline == std::string::npos ? uint64_t{0} : start + lastNewline + 1;
+  if (intact < *size) {
+    if (lastNewline == std::string::npos and start != 0) {
+      Log(LogLevel::Error, "audit log {} ends in a line longer than {} bytes", path.string(), tailBytes);
+      return std::nullopt;
+    }
+    Log(LogLevel::Warning, "audit log {} ends in {} bytes of an unfinished commit", path.string(), *size - intact);
+    if (not truncateTo(file, intact) or not syncData(file)) return std::nullopt;
+  }
+  if (intact == auditHeader.size() + 1 or intact == 0) return Head{.End = intact};
+
+  const auto lineEnd   = static_cast<std::size_t>(intact - start) - 1;
+  const auto lineStart = tail.rfind('\n', lineEnd - 1);
+  const auto line      = std::string_view(tail).substr(lineStart + 1, lineEnd - lineStart - 1);
+  const auto last      = lineStart == std::string::npos ? std::nullopt : parseLine(line);
+  if (not last) {
+    Log(LogLevel::Error, "audit log {} does not end in a record, run verify-audit", path.string());
+    return std::nullopt;
+  }
+  return Head{.Hash = last->Hash, .Sequence = last->Sequence, .End = intact};
+}
+
+auto VerifyAuditLog(const std::filesystem::path &path) -> AuditVerification
+{
+  auto verification = AuditVerification();
+  auto file         = std::ifstream(path, std::ios::binary);
+  if (not file) {
+    verification.Problem = "the file can not be opened";
+    return verification;
+  }
+  const auto content = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  auto rest          = std::string_view(content);
+  if (rest.empty()) {
+    verification.Intact = true;
+    return verification;
+  }
+  if (not rest.starts_with(auditHeader) or rest.substr(auditHeader.size(), 1) != "\n") {
+    verification.BrokenLine = 1;
+    verification.Problem    = "the header is missing";
+    return verification;
+  }
+  rest.remove_prefix(auditHeader.size() + 1);
+
+  auto hash = uint64_t{0};
+  for (std::size_t lineNumber = 2; not rest.empty(); ++lineNumber) {
+    const auto end = rest.find('\n');
+    if (end == std::string_view::npos) {
+      // the next commit cuts it off, nobody was told it is durable
+      verification.Problem = fmt::format("ends in {} bytes of an unfinished commit", rest.size());
+      break;
+    }
+    const auto line   = parseLine(rest.substr(0, end));
+    const auto broken = [&](std::string problem) {
+      verification.BrokenLine = lineNumber;
+      verification.Problem    = std::move(problem);
+      return verification;
+    };
+    if (not line) return broken("not a record");
+    if (line->Sequence != verification.Records + 1)
+      return broken(fmt::format("sequence {} where {} was next", line->Sequence, verification.Records + 1));
+    if (line->Hash != chainHash(hash, line->Sequence, line->Payload))
+      return broken("the chain hash does not match, the record or one before it was changed");
+
+    hash = line->Hash;
+    ++verification.Records;
+    rest.remove_prefix(end + 1);
+  }
+  verification.Intact = true;
+  return verification;
+}
+
+auto DefaultAuditLogPath() -> std::filesystem::path
+{
+  if (const auto *path = std::getenv("BLT_AUDIT_LOG"); path and *path) return path;
+  return DefaultSessionLockPath().replace_filename("audit.log");
+}
+
+}// namespace Blt
\ No newline at end of file
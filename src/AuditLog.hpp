@@ -0,0 +1,173 @@
+#pragma once
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "DiskPart.hpp"
+#include "DiskPartSession.hpp"
+
+namespace Blt {
+
+// One volume operation as the audit log keeps it
+struct AuditRecord
+{
+  // the op= its log records carry
+  uint64_t Operation = 0;
+  // mount, unmount or unlock
+  std::string_view Action;
+  // how the volume was named: `disk #0 partition #6` or `<disk id>@<partition offset>`
+  std::string Target;
+  std::string Mount;
+  std::string Outcome;
+  DiskPartError DiskPart = DiskPartError::Success;
+  std::chrono::system_clock::time_point Started;
+  std::chrono::microseconds Elapsed{0};
+  // empty for operations without a diskpart session
+  SessionTrace Trace;
+};
+
+/**
+ * When a commit goes out. Records appended while a commit is being flushed are queued and go out together in the next
+ * one, so the more operations run at once the more records share a flush, without any waiting on an idle log. A
+ * record is durable at most Linger plus two writes and flushes after it was appended.
+ */
+struct AuditPolicy
+{
+  // how long a commit waits for more records once the first one is in, worth it only where a flush takes far longer
+  std::chrono::microseconds Linger{0};
+  // the most records one commit takes, a commit that has them goes out without waiting for the linger
+  std::size_t MaxBatch = 256;
+};
+
+using AuditCompletion = std::move_only_function<void(bool durable)>;
+
+/**
+ * Append-only, hash-chained record of every volume operation, for compliance rather than for diagnosis.
+ * Appends from any thread are queued for a writer thread that group-commits them: every record queued when a commit
+ * starts goes out in one write followed by one fdatasync (FlushFileBuffers on Windows), however many operations ran
+ * concurrently. A record's completion is called from the writer once the commit holding it is durable, or with false
+ * when it could not be written.
+ * Every line is `<chain hash> <sequence> <JSON>` and its hash covers the previous line's hash, so a line that is
+ * edited, removed or reordered breaks the chain at that point (VerifyAuditLog). FNV-1a only guards against accidents
+ * and naive edits, whoever can write the file can recompute the chain.
+ * Processes append to the same file in turn: a commit holds an OS lock on the file (flock, LockFileEx) and continues
+ * the chain from whatever is at its end then. A commit torn by a crash was never reported durable, the next commit
+ * cuts it off.
+ */
+class AuditLog
+{
+public:
+  // nullptr when the file can not be opened or its end is not an intact record
+  static auto Open(std::filesystem::path path, AuditPolicy policy = {}) -> std::unique_ptr<AuditLog>;
+
+  AuditLog(const AuditLog &)            = delete;
+  AuditLog &operator=(const AuditLog &) = delete;
+  ~AuditLog();
+
+  // `completion` is called exactly once, on the writer thread or right here after Stop
+  void Append(const AuditRecord &record, AuditCompletion completion);
+
+  /**
+   * Append for completion tokens, the handler gets whether the record is durable and is dispatched on its associated
+   * executor, which it keeps alive until then.
+   */
+  template<typename CompletionToken>
+  auto AsyncAppend(AuditRecord record, CompletionToken &&token)
+  {
+    return boost::asio::async_initiate<CompletionToken, void(bool)>(
+      [this](auto handler, AuditRecord appended) {
+        auto work = boost::asio::make_work_guard(boost::asio::get_associated_executor(handler));
+        Append(appended, [handler = std::move(handler), work = std::move(work)](bool durable) mutable {
+          boost::asio::dispatch(
+            work.get_executor(), [handler = std::move(handler), durable]() mutable { std::move(handler)(durable); });
+          work.reset();
+        });
+      },
+      token,
+      std::move(record));
+  }
+
+  // Commits what is queued and joins the writer, appends after it fail right away. Idempotent
+  void Stop();
+
+  // How many commits went out so far, one write and one flush each
+  [[nodiscard]] auto Commits() const -> uint64_t;
+
+private:
+#ifdef _WIN32
+  using NativeFile = void *;
+#else
+  using NativeFile = int;
+#endif
+
+  struct Pending
+  {
+    std::string Payload;
+    AuditCompletion Completion;
+  };
+
+  // The last intact record, where the next commit continues the chain
+  struct Head
+  {
+    uint64_t Hash     = 0;
+    uint64_t Sequence = 0;
+    // bytes up to and including its newline
+    uint64_t End = 0;
+  };
+
+  AuditLog(NativeFile file, std::filesystem::path path, AuditPolicy policy, Head head);
+
+  // Under the file lock, cuts off a torn commit. nullopt when the end of the file is not an intact record
+  static auto readHead(NativeFile file, const std::filesystem::path &path) -> std::optional<Head>;
+
+  void writerLoop();
+  auto commit(std::vector<Pending> &batch) -> bool;
+
+  NativeFile file_;
+  std::filesystem::path path_;
+  AuditPolicy policy_;
+  // writer thread only, what this process committed last, re-read when another process appended since
+  Head head_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable queued_;
+  // guarded by mutex_
+  std::vector<Pending> queue_;
+  bool stopping_    = false;
+  uint64_t commits_ = 0;
+  std::thread writer_;
+};
+
+struct AuditVerification
+{
+  bool Intact         = false;
+  std::size_t Records = 0;
+  // 1-based line of the first record that does not continue the chain, 0 when all do
+  std::size_t BrokenLine = 0;
+  std::string Problem;
+};
+
+// Walks the whole chain from the header, what the verify-audit action runs
+auto VerifyAuditLog(const std::filesystem::path &path) -> AuditVerification;
+
+// audit.log next to the session lock (ProgramData on Windows), BLT_AUDIT_LOG overrides it
+auto DefaultAuditLogPath() -> std::filesystem::path;
+
+}// namespace Blt
\ No newline at end of file
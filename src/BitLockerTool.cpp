@@ -1,514 +1,49 @@
-#include <fmt/format.h>
-#include <boost/asio.hpp>
-#include "boost/asio/experimental/awaitable_operators.hpp"
-#include <boost/asio/as_tuple.hpp>
-#include <boost/asio/use_awaitable.hpp>
-#include <boost/asio/readable_pipe.hpp>
-#include <boost/process/v2.hpp>
-#include <ctre-unicode.hpp>
+#include <boost/asio/use_future.hpp>
 
-#include <chrono>
-#include <string>
-#include <variant>
+#include <cstdlib>
 
-#include "DiskPart.hpp"
-#include "Common.hpp"
+#include "AuditLog.hpp"
 #include "Command.hpp"
-#include "Unit.hpp"
-
-namespace proc = boost::process::v2;
-namespace asio = boost::asio;
-
-using namespace boost::asio::experimental::awaitable_operators;
-using namespace std::chrono_literals;
-using result_type = std::variant<
-  std::tuple<boost::system::error_code, int>,
-  std::tuple<boost::system::error_code, Blt::DiskPartError>,
-  std::tuple<boost::system::error_code>>;
-
-
-namespace Blt {
-
-auto DiskPartMount(
-  asio::io_context &ioc,
-  asio::cancellation_signal &cancel,
-  asio::readable_pipe &diskpartOut,
-  asio::writable_pipe &diskpartIn,
-  int desireDiskNumber,
-  CapacityBytes desireDiskCapacity,
-  int desirePartitionNumber,
-  CapacityBytes desirePartitionCapacity,
-  char assignLetter) -> asio::awaitable<DiskPartError>
-{
-  auto state     = DiskPartState::StartUp;
-  auto nextState = DiskPartState::StartUp;
-
-  std::u8string buffer;
-  constexpr auto toCompatView = [](auto capture) -> std::string_view {
-    auto view          = capture.to_view();
-    using ViewCharType = typename std::remove_cvref_t<decltype(view)>::value_type;
-    return std::string_view(reinterpret_cast<const char *>(view.data()), view.size() * sizeof(ViewCharType));
-  };
-  auto closeStreamsWithError = [&diskpartOut, &diskpartIn](DiskPartError error) {
-    diskpartIn.close();
-    diskpartOut.close();
-    return error;
-  };
-  while (true) {
-    switch (state) {
-    case DiskPartState::StartUp: {
-      if (auto error = co_await ReadComputerName(buffer, diskpartOut); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-      nextState = DiskPartState::ListDisk;
-      break;
-    }
-    case DiskPartState::ListDisk: {
-      if (auto error = co_await ListDisk(buffer, diskpartIn); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-      nextState = DiskPartState::ReadListDisk;
-      break;
-    }
-    case DiskPartState::ReadListDisk: {
-      if (auto error = co_await ReadListDisk(buffer, diskpartOut, desireDiskNumber, desireDiskCapacity);
-          error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::SelectDisk;
-      break;
-    }
-    case DiskPartState::SelectDisk: {
-      if (auto error = co_await SelectDisk(buffer, diskpartIn, desireDiskNumber); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::ReadSelectDisk;
-      break;
-    }
-    case DiskPartState::ReadSelectDisk: {
-      if (auto error = co_await ReadSelectDisk(buffer, diskpartOut, desireDiskNumber); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::ListPartition;
-      break;
-    }
-    case DiskPartState::ListPartition: {
-      if (auto error = co_await ListPartition(buffer, diskpartIn); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::ReadListPartition;
-      break;
-    }
-    case DiskPartState::ReadListPartition: {
-      if (auto error = co_await ReadListPartition(buffer, diskpartOut, desirePartitionNumber, desirePartitionCapacity);
-          error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::SelectPartition;
-      break;
-    }
-    case DiskPartState::SelectPartition: {
-      if (auto error = co_await SelectPartition(buffer, diskpartIn, desirePartitionNumber);
-          error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::ReadSelectPartition;
-      break;
-    }
-    case DiskPartState::ReadSelectPartition: {
-      if (auto error = co_await ReadSelectPartition(buffer, diskpartOut, desirePartitionNumber);
-          error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::AssignLetter;
-      break;
-    }
-    case DiskPartState::AssignLetter: {
-      if (auto error = co_await AssignLetter(buffer, diskpartIn, assignLetter); error != DiskPartError::Success) {
-        co_return closeStreamsWithError(error);
-      }
-
-      nextState = DiskPartState::ReadAssignLetter;
-      break;
-    }
-    case DiskPartState::ReadAssignLetter: {
-      if (auto error = co_await ReadAssignLetter(buffer, diskpartOut); error != DiskPartError::Success) {
-        co_return closeStreamsWithError(error);
-      }
-
-      nextState = DiskPartState::Exit;
-      break;
-    }
-    case DiskPartState::Exit: {
-      if (auto error = co_await Exit(diskpartIn); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      co_return DiskPartError::Success;
-    }
-    }
-    buffer.clear();
-    state = nextState;
-  }
-  std::unreachable();
-}
-
-
-auto DiskPartUnmount(
-  asio::io_context &ioc,
-  asio::cancellation_signal &cancel,
-  asio::readable_pipe &diskpartOut,
-  asio::writable_pipe &diskpartIn,
-  int desireDiskNumber,
-  CapacityBytes desireDiskCapacity,
-  int desirePartitionNumber,
-  CapacityBytes desirePartitionCapacity,
-  char assignLetter) -> asio::awaitable<DiskPartError>
-{
-  auto state     = DiskPartState::StartUp;
-  auto nextState = DiskPartState::StartUp;
-
-  std::u8string buffer;
-  constexpr auto toCompatView = [](auto capture) -> std::string_view {
-    auto view          = capture.to_view();
-    using ViewCharType = typename std::remove_cvref_t<decltype(view)>::value_type;
-    return std::string_view(reinterpret_cast<const char *>(view.data()), view.size() * sizeof(ViewCharType));
-  };
-
-  auto closeStreamsWithError = [&diskpartOut, &diskpartIn](DiskPartError error) {
-    diskpartIn.close();
-    diskpartOut.close();
-    return error;
-  };
-
-  while (true) {
-    switch (state) {
-    case DiskPartState::StartUp: {
-      if (auto error = co_await ReadComputerName(buffer, diskpartOut); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-      nextState = DiskPartState::ListDisk;
-      break;
-    }
-    case DiskPartState::ListDisk: {
-      if (auto error = co_await ListDisk(buffer, diskpartIn); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-      nextState = DiskPartState::ReadListDisk;
-      break;
-    }
-    case DiskPartState::ReadListDisk: {
-      if (auto error = co_await ReadListDisk(buffer, diskpartOut, desireDiskNumber, desireDiskCapacity);
-          error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::SelectDisk;
-      break;
-    }
-    case DiskPartState::SelectDisk: {
-      if (auto error = co_await SelectDisk(buffer, diskpartIn, desireDiskNumber); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::ReadSelectDisk;
-      break;
-    }
-    case DiskPartState::ReadSelectDisk: {
-      if (auto error = co_await ReadSelectDisk(buffer, diskpartOut, desireDiskNumber); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::ListPartition;
-      break;
-    }
-    case DiskPartState::ListPartition: {
-      if (auto error = co_await ListPartition(buffer, diskpartIn); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::ReadListPartition;
-      break;
-    }
-    case DiskPartState::ReadListPartition: {
-      if (auto error = co_await ReadListPartition(buffer, diskpartOut, desirePartitionNumber, desirePartitionCapacity);
-          error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::SelectPartition;
-      break;
-    }
-    case DiskPartState::SelectPartition: {
-      if (auto error = co_await SelectPartition(buffer, diskpartIn, desirePartitionNumber);
-          error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::ReadSelectPartition;
-      break;
-    }
-    case DiskPartState::ReadSelectPartition: {
-      if (auto error = co_await ReadSelectPartition(buffer, diskpartOut, desirePartitionNumber);
-          error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      nextState = DiskPartState::RemoveLetter;
-      break;
-    }
-    case DiskPartState::RemoveLetter: {
-      if (auto error = co_await RemoveLetter(buffer, diskpartIn, assignLetter); error != DiskPartError::Success) {
-        co_return closeStreamsWithError(error);
-      }
-
-      nextState = DiskPartState::ReadRemoveLetter;
-      break;
-    }
-    case DiskPartState::ReadRemoveLetter: {
-      if (auto error = co_await ReadRemoveLetter(buffer, diskpartOut); error != DiskPartError::Success) {
-        co_return closeStreamsWithError(error);
-      }
-
-      nextState = DiskPartState::Exit;
-      break;
-    }
-    case DiskPartState::Exit: {
-      if (auto error = co_await Exit(diskpartIn); error != DiskPartError::Success)
-        co_return closeStreamsWithError(error);
-
-      co_return DiskPartError::Success;
-    }
-    }
-    buffer.clear();
-    state = nextState;
-  }
-  std::unreachable();
-}
-
-}// namespace Blt
-
-auto Mount(
-  asio::io_context &ioc, const Blt::MountInfo &info, std::string_view diskpartPath, std::string_view bdeunlockPath)
-  -> asio::awaitable<void>
-{
-  asio::steady_timer timeout{co_await asio::this_coro::executor, 100s};
-  asio::cancellation_signal sig;
-  auto diskpartOut = asio::readable_pipe(co_await asio::this_coro::executor);
-  auto diskpartIn  = asio::writable_pipe(co_await asio::this_coro::executor);
-  auto result      = co_await (
-    proc::async_execute(
-      proc::process(
-        co_await asio::this_coro::executor, diskpartPath, {}, proc::process_stdio{diskpartIn, diskpartOut, {}}),
-      asio::bind_cancellation_slot(sig.slot(), asio::as_tuple(asio::use_awaitable)))
-    || Blt::DiskPartMount(
-      ioc,
-      sig,
-      diskpartOut,
-      diskpartIn,
-      info.Disk.Number,
-      info.Disk.Capacity,
-      info.Partition.Number,
-      info.Partition.Capacity,
-      info.Letter)
-    || timeout.async_wait(asio::as_tuple(asio::use_awaitable)));
-
-  if (const auto processResult = std::get_if<0>(&result)) {
-    timeout.cancel();
-    auto [ec, exitCode] = *processResult;
-    if (ec == boost::system::errc::success && exitCode == 0) {
-      fmt::println("start process success: {}", exitCode);
-    }
-  } else if (const auto readResult = std::get_if<1>(&result)) {
-    timeout.cancel();
-    sig.emit(asio::cancellation_type::terminal);
-    Blt::DiskPartError opError = *readResult;
-    switch (opError) {
-    case Blt::DiskPartError::Success: {
-      fmt::println("prompt bitlocker password");
-      std::array<char, 3> buffer = {info.Letter, ':', '\0'};
-      SHELLEXECUTEINFOA execInfo{
-        .cbSize       = sizeof(SHELLEXECUTEINFOA),
-        .fMask        = SEE_MASK_DEFAULT | SEE_MASK_UNICODE | SEE_MASK_NOCLOSEPROCESS,
-        .hwnd         = nullptr,
-        .lpVerb       = "runas",
-        .lpFile       = bdeunlockPath.data(),
-        .lpParameters = buffer.data(),
-        .lpDirectory  = nullptr,
-        .nShow        = SW_SHOWDEFAULT,
-        .hInstApp     = nullptr,
-        .hProcess     = nullptr,
-      };
-
-      ShellExecuteEx(&execInfo);
-
-      if (execInfo.hProcess) {
-        if (WaitForSingleObject(execInfo.hProcess, INFINITE) == WAIT_OBJECT_0) {
-          unsigned long exitcode;
-          if (GetExitCodeProcess(execInfo.hProcess, &exitcode) != 0)
-            fmt::println("bdeunlock exit with code {}", exitcode);
-          CloseHandle(execInfo.hProcess);
-        } else {
-          fmt::println("something went wrong when waiting for bdeunlock");
-        }
-      }
-
-      fmt::println("mount complete");
-      break;
-    }
-    default: {
-      fmt::println("it went to shit");
-      break;
-    }
-    }
-    co_return;
-  } else if (const auto timeoutResult = std::get_if<2>(&result)) {
-    auto [timeoutError] = *timeoutResult;
-    if (timeoutError == boost::system::errc::success) {
-      fmt::println("something went wrong, timed out");
-      sig.emit(asio::cancellation_type::terminal);
-    } else {
-      fmt::println("unexpected error relates to timeout");
-      sig.emit(asio::cancellation_type::terminal);
-    }
-  }
-
-  co_return;
-}
-
-auto Unmount(
-  asio::io_context &ioc, const Blt::MountInfo &info, std::string_view diskpartPath, std::string_view managebdePath)
-  -> asio::awaitable<void>
-{
-  // bdeunlockPath
-  // "manage-bde -lock -ForceDismount x:"
-  fmt::println("locking partition");
-  std::array<char, 24> buffer = {'-', 'l', 'o', 'c', 'k', ' ', '-', 'F', 'o', 'r', 'c', 'e',
-                                 'D', 'i', 's', 'm', 'o', 'u', 'n', 't', ' ', 'x', ':'};
-  buffer[21]                  = info.Letter;
-
-  SHELLEXECUTEINFOA execInfo{
-    .cbSize       = sizeof(SHELLEXECUTEINFOA),
-    .fMask        = SEE_MASK_DEFAULT | SEE_MASK_UNICODE | SEE_MASK_NOCLOSEPROCESS,
-    .hwnd         = nullptr,
-    .lpVerb       = "runas",
-    .lpFile       = managebdePath.data(),
-    .lpParameters = buffer.data(),
-    .lpDirectory  = nullptr,
-    .nShow        = SW_HIDE,
-    .hInstApp     = nullptr,
-    .hProcess     = nullptr,
-  };
-
-  if (not ShellExecuteEx(&execInfo)) {
-    co_return;
-  }
-  if (execInfo.hProcess) {
-    if (WaitForSingleObject(execInfo.hProcess, INFINITE) == WAIT_OBJECT_0) {
-      unsigned long exitcode;
-      if (GetExitCodeProcess(execInfo.hProcess, &exitcode) != 0) fmt::println("manage-bde exit with code {}", exitcode);
-      CloseHandle(execInfo.hProcess);
-    } else {
-      fmt::println("something went wrong when waiting for manage-bde");
-    }
-  }
-  asio::steady_timer timeout{co_await asio::this_coro::executor, 100s};
-  asio::cancellation_signal sig;
-  auto diskpartOut = asio::readable_pipe(co_await asio::this_coro::executor);
-  auto diskpartIn  = asio::writable_pipe(co_await asio::this_coro::executor);
-  auto result      = co_await (
-    proc::async_execute(
-      proc::process(
-        co_await asio::this_coro::executor, diskpartPath, {}, proc::process_stdio{diskpartIn, diskpartOut, {}}),
-      asio::bind_cancellation_slot(sig.slot(), asio::as_tuple(asio::use_awaitable)))
-    || Blt::DiskPartUnmount(
-      ioc,
-      sig,
-      diskpartOut,
-      diskpartIn,
-      info.Disk.Number,
-      info.Disk.Capacity,
-      info.Partition.Number,
-      info.Partition.Capacity,
-      info.Letter)
-    || timeout.async_wait(asio::as_tuple(asio::use_awaitable)));
-
-  if (const auto processResult = std::get_if<0>(&result)) {
-    timeout.cancel();
-    auto [ec, exitCode] = *processResult;
-    if (ec == boost::system::errc::success && exitCode == 0) {
-      fmt::println("start process success: {}", exitCode);
-    }
-  } else if (const auto readResult = std::get_if<1>(&result)) {
-    timeout.cancel();
-    sig.emit(asio::cancellation_type::terminal);
-    Blt::DiskPartError opError = *readResult;
-    switch (opError) {
-    case Blt::DiskPartError::Success: {
-      fmt::println("unmount complete");
-      break;
-    }
-    default: {
-      fmt::println("it went to shit");
-      break;
-    }
-    }
-    co_return;
-  } else if (const auto timeoutResult = std::get_if<2>(&result)) {
-    auto [timeoutError] = *timeoutResult;
-    if (timeoutError == boost::system::errc::success) {
-      fmt::println("something went wrong, timed out");
-      sig.emit(asio::cancellation_type::terminal);
-    } else {
-      fmt::println("unexpected error relates to timeout");
-      sig.emit(asio::cancellation_type::terminal);
-    }
-  }
-
-  co_return;
-}
+#include "Common.hpp"
+#include "Engine.hpp"
+#include "Log.hpp"
 
 /**
  * BitLockerTool.exe  unmount   0:1863:GiB                6:362:GiB                  X
  * BitLockerTool.exe  mount     0:1863:GiB                6:362:GiB                  X
  *                    <action>  <disk>:<capacity>:<unit>  <disk>:<capacity>:<unit>   <letter>
+ *
+ * BitLockerTool.exe  mount     {8A3E2F4C-...}@16777216    X
+ *                    <action>  <disk id>@<partition offset>  <letter>
+ * BitLockerTool.exe  index
+ * BitLockerTool.exe  watch     {8A3E2F4C-...}@16777216    X  [<disk id>@<partition offset>  <letter>]...
+ * BitLockerTool.exe  unlock    keys.txt | agent:<socket>  X  [<letter>]...
+ * BitLockerTool.exe  verify-audit
+ *
+ * Mount and unmount take up to 64 targets of one kind, one after the other, and report the first failure.
+ * --timeout=<seconds> anywhere after the program bounds each diskpart session instead of 100s (300s for index).
+ * --probe=<milliseconds> on mount and watch reads back every attached volume unbuffered, that long sequentially and
+ * that long at random offsets, and logs MB/s, IOPS and random read latency.
+ * With BLT_UNLOCK_KEYS set mount and watch unlock through the same key source instead of prompting with bdeunlock.
+ * BLT_UNLOCK_COMMAND replaces manage-bde, BLT_UNLOCK_PARALLELISM bounds concurrent unlocks (4).
+ * BLT_LOG_FORMAT=json writes one JSON object per record, BLT_LOG_LEVEL=debug|info|warning|error filters them.
+ * Ctrl-C terminates the running diskpart and closes its pipes, what is still running 5s later is abandoned.
+ * Concurrent invocations wait their turn for diskpart through session.lock in ProgramData (BLT_SESSION_LOCK).
+ * Every mount, unmount and unlock is appended to audit.log next to it (BLT_AUDIT_LOG) before the command returns,
+ * verify-audit walks its chain and fails at the first record that does not continue it.
+ * Orchestrators load BitLockerToolApi.dll (BitLockerToolApi.h) and run the same operations without a process each.
  */
 int main()
 {
-  auto comInitialized        = false;
-  auto comInitializedHResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
-  if (comInitialized = (comInitializedHResult == S_OK); not comInitialized) return -1;
-
-  blt_defer{
-    if (comInitialized) CoUninitialize();
+  // records are written by a background thread from here on, Stop flushes what is still queued on every return
+  Blt::LogSink::Instance().Start(Blt::LogOptionsFromEnvironment());
+  blt_defer {
+    Blt::LogSink::Instance().Stop();
   };
 
+  // only parse here, everything else is resolved by the action that needs it
   auto parseResult = Blt::ParseCommandLine();
 
-  PWSTR windowPath;
-  SHGetKnownFolderPath(FOLDERID_Windows, 0, nullptr, &windowPath);
-  auto windowPathView = std::wstring_view(static_cast<const wchar_t *>(windowPath), wcslen(windowPath));
-  blt_defer{
-    CoTaskMemFree(windowPath);
-  };
-
-  auto getSystem32Executable = [&windowPathView](std::array<char, MAX_PATH> &utf8buffer, std::string_view executable) {
-    constexpr static std::wstring_view systemPath = L"\\System32\\";
-    std::array<wchar_t, MAX_PATH> buffer;
-    std::copy(windowPathView.cbegin(), windowPathView.cend(), buffer.data());
-    std::copy(systemPath.cbegin(), systemPath.cend(), buffer.data() + windowPathView.size());
-    std::copy(executable.cbegin(), executable.cend(), buffer.data() + windowPathView.size() + systemPath.size());
-    const auto pathSize = windowPathView.size() + systemPath.size() + executable.size();
-    buffer[pathSize]    = L'\0';
-
-    auto written =
-      WideCharToMultiByte(CP_UTF8, 0, buffer.data(), static_cast<int>(pathSize), utf8buffer.data(), static_cast<int>(utf8buffer.size()), nullptr, nullptr);
-    assert(written);
-    assert(utf8buffer.size() >= (written + 1));
-    utf8buffer[written] = '\0';
-
-    return written;
-  };
-
-  std::array<char, MAX_PATH> diskpartBuffer;
-  auto diskpartPath = std::string_view(diskpartBuffer.data(), getSystem32Executable(diskpartBuffer, "diskpart.exe"));
-
-  std::array<char, MAX_PATH> bdeunlockBuffer;
-  auto bdeunlockPath =
-    std::string_view(bdeunlockBuffer.data(), getSystem32Executable(bdeunlockBuffer, "bdeunlock.exe"));
-
-  std::array<char, MAX_PATH> managebdeBuffer;
-  auto managebdePath =
-    std::string_view(managebdeBuffer.data(), getSystem32Executable(managebdeBuffer, "manage-bde.exe"));
-
   if (not parseResult) {
     switch (parseResult.error()) {
     case Blt::ParseCommandLineError::GetCommandLineFailed: {
@@ -517,6 +52,9 @@ int main()
     case Blt::ParseCommandLineError::UnknownAction: {
       break;
     }
+    case Blt::ParseCommandLineError::UnsupportedCapacityUnit: {
+      break;
+    }
     case Blt::ParseCommandLineError::ParseFailed: {
       break;
     }
@@ -524,28 +62,43 @@ int main()
     return static_cast<int>(parseResult.error());
   }
 
-  asio::io_context ioc;
-  boost::system::error_code ec;
-  constexpr auto exceptionHandler = [](std::exception_ptr e) {
-    if (e) try {
-        std::rethrow_exception(e);
-      } catch (std::exception &ex) {
-        fmt::println("Error ===> {}", ex.what());
-      }
-  };
-
-  switch (parseResult->Action) {
-  case Blt::CommandAction::Mount: {
-    asio::co_spawn(ioc, Mount(ioc, *parseResult, diskpartPath, bdeunlockPath), exceptionHandler);
-    break;
-  }
-  case Blt::CommandAction::Unmount: {
-    asio::co_spawn(ioc, Unmount(ioc, *parseResult, diskpartPath, managebdePath), exceptionHandler);
-    break;
-  }
+  // the chain is read as it is, nothing an engine sets up is needed for it
+  if (parseResult->Action == Blt::CommandAction::VerifyAudit) {
+    const auto path         = Blt::DefaultAuditLogPath();
+    const auto verification = Blt::VerifyAuditLog(path);
+    if (not verification.Intact) {
+      Blt::Log(
+        Blt::LogLevel::Error,
+        "{} line {}: {}, {} records before it are intact",
+        path.string(),
+        verification.BrokenLine,
+        verification.Problem,
+        verification.Records);
+      return EXIT_FAILURE;
+    }
+    if (not verification.Problem.empty())
+      Blt::Log(Blt::LogLevel::Warning, "{}: {}", path.string(), verification.Problem);
+    Blt::Log(Blt::LogLevel::Info, "{} records in {} are intact", verification.Records, path.string());
+    return EXIT_SUCCESS;
   }
 
-  ioc.run();
+  // one operation on an engine of its own, the same engine BitLockerToolApi.dll hands to orchestrators
+  auto options = Blt::EngineOptions{.HandleSignals = true};
+  if (const auto *keys = std::getenv("BLT_UNLOCK_KEYS"); keys and parseResult->Action != Blt::CommandAction::Unlock)
+    options.Keys = keys;
+  if (const auto *standIn = std::getenv("BLT_UNLOCK_COMMAND")) options.UnlockCommand = standIn;
+  if (const auto *parallelism = std::getenv("BLT_UNLOCK_PARALLELISM"))
+    options.UnlockParallelism = std::strtoul(parallelism, nullptr, 10);
+
+  auto engine = Blt::Engine::Create(std::move(options));
+  if (not engine) return EXIT_FAILURE;
 
+  const auto result = engine->AsyncSubmit(std::move(*parseResult), boost::asio::use_future).get();
+  engine->Shutdown();
+
+  if (result.Status != Blt::OperationStatus::Success) {
+    Blt::Log(Blt::LogLevel::Debug, "finished with {}", Blt::ToString(result.Status));
+    return EXIT_FAILURE;
+  }
   return EXIT_SUCCESS;
 }
\ No newline at end of file
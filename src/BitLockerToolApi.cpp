@@ -0,0 +1,205 @@
+#include "BitLockerToolApi.h"
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Command.hpp"
+#include "Engine.hpp"
+#include "Log.hpp"
+#include "MountPoint.hpp"
+#include "Unit.hpp"
+#include "VolumeIndex.hpp"
+
+struct blt_engine
+{
+  std::unique_ptr<Blt::Engine> Engine;
+};
+
+namespace {
+  static_assert(BLT_STATUS_SUCCESS == static_cast<int>(Blt::OperationStatus::Success));
+  static_assert(BLT_STATUS_DISKPART_FAILED == static_cast<int>(Blt::OperationStatus::DiskPartFailed));
+  static_assert(BLT_STATUS_INTERNAL_ERROR == static_cast<int>(Blt::OperationStatus::InternalError));
+  static_assert(BLT_STATUS_SHUT_DOWN == static_cast<int>(Blt::OperationStatus::ShutDown));
+
+  // The log sink runs while any engine is alive, started by the first and flushed and joined after the last one
+  std::mutex sinkMutex;
+  std::size_t sinkUsers = 0;
+
+  void acquireSink()
+  {
+    auto lock = std::scoped_lock(sinkMutex);
+    if (sinkUsers++ == 0) Blt::LogSink::Instance().Start(Blt::LogOptionsFromEnvironment());
+  }
+
+  void releaseSink()
+  {
+    auto lock = std::scoped_lock(sinkMutex);
+    if (--sinkUsers == 0) Blt::LogSink::Instance().Stop();
+  }
+
+  auto submit(blt_engine *engine, Blt::MountInfo request, blt_completion completion, void *context, uint64_t *id)
+    -> blt_status
+  {
+    const auto submitted = engine->Engine->Submit(
+      std::move(request), [completion, context](Blt::OperationId operation, const Blt::OperationResult &result) {
+        const auto attached = result.Mount.Letter != 0 or result.Mount.IsFolder();
+        const auto mount    = attached ? fmt::format("{}", result.Mount) : std::string();
+        auto reported       = blt_result{
+          .size           = sizeof(blt_result),
+          .id             = operation,
+          .status         = static_cast<blt_status>(result.Status),
+          .diskpart_error = static_cast<int32_t>(result.DiskPart),
+          .mount          = mount.c_str(),
+        };
+        reported.processes         = result.Usage.Processes;
+        reported.user_time_us      = static_cast<uint64_t>(result.Usage.UserTime.count());
+        reported.kernel_time_us    = static_cast<uint64_t>(result.Usage.KernelTime.count());
+        reported.peak_memory_bytes = result.Usage.PeakMemoryBytes;
+        reported.read_operations   = result.Usage.ReadOperations;
+        reported.write_operations  = result.Usage.WriteOperations;
+        reported.read_bytes        = result.Usage.ReadBytes;
+        reported.write_bytes       = result.Usage.WriteBytes;
+        if (result.Probe and result.Probe->Error == Blt::ProbeError::Success) {
+          reported.sequential_mbps     = result.Probe->SequentialMBps.Mean;
+          reported.sequential_mbps_low = result.Probe->SequentialMBps.Low;
+          reported.random_iops         = result.Probe->RandomIops.Mean;
+          reported.random_iops_low     = result.Probe->RandomIops.Low;
+          reported.random_p50_us       = static_cast<uint32_t>(result.Probe->RandomP50.count());
+          reported.random_p99_us       = static_cast<uint32_t>(result.Probe->RandomP99.count());
+        }
+        completion(&reported, context);
+      });
+    if (not submitted) return BLT_STATUS_SHUT_DOWN;
+    if (id) *id = *submitted;
+    return BLT_STATUS_SUCCESS;
+  }
+}// namespace
+
+extern "C" {
+
+uint32_t blt_api_version(void)
+{
+  return BLT_API_VERSION;
+}
+
+blt_engine *blt_engine_create(const blt_engine_options *options)
+{
+  // every field is there since version 1
+  if (options and not BLT_HAS_FIELD(options, blt_engine_options, grace_ms)) return nullptr;
+
+  auto engineOptions = Blt::EngineOptions();
+  if (options) {
+    if (options->keys) engineOptions.Keys = options->keys;
+    if (options->unlock_command) engineOptions.UnlockCommand = options->unlock_command;
+    if (options->unlock_parallelism) engineOptions.UnlockParallelism = options->unlock_parallelism;
+    if (options->grace_ms) engineOptions.Grace = std::chrono::milliseconds(options->grace_ms);
+  }
+  // started ahead of the engine, so why it could not be created goes through the sink as well
+  acquireSink();
+  // nothing thrown crosses the C boundary
+  try {
+    auto engine = Blt::Engine::Create(std::move(engineOptions));
+    if (engine) return new blt_engine{.Engine = std::move(engine)};
+  } catch (std::exception &ex) {
+    Blt::Log(Blt::LogLevel::Error, "unable to create the engine: {}", ex.what());
+  }
+  releaseSink();
+  return nullptr;
+}
+
+void blt_engine_destroy(blt_engine *engine)
+{
+  if (not engine) return;
+  // the engine logs its shutdown, the sink stops after it
+  delete engine;
+  releaseSink();
+}
+
+blt_status
+  blt_submit(blt_engine *engine, const blt_request *request, blt_completion completion, void *context, uint64_t *id)
+{
+  if (not engine or not request or not completion or not BLT_HAS_FIELD(request, blt_request, mount))
+    return BLT_STATUS_INVALID_REQUEST;
+
+  auto info = Blt::MountInfo{};
+  switch (request->action) {
+  case BLT_ACTION_MOUNT: {
+    info.Action = Blt::CommandAction::Mount;
+    break;
+  }
+  case BLT_ACTION_UNMOUNT: {
+    info.Action = Blt::CommandAction::Unmount;
+    break;
+  }
+  case BLT_ACTION_INDEX: {
+    info.Action = Blt::CommandAction::Index;
+    break;
+  }
+  default: {
+    return BLT_STATUS_INVALID_REQUEST;
+  }
+  }
+
+  try {
+    if (info.Action != Blt::CommandAction::Index) {
+      if (request->disk_id) {
+        info.Volume = Blt::VolumeKey{
+          .DiskId = Blt::NormalizeDiskId(request->disk_id), .PartitionOffset = request->partition_offset};
+      } else {
+        info.Disk =
+          Blt::DriveId{.Number = request->disk_number, .Capacity = Blt::CapacityBytes(request->disk_capacity)};
+        info.Partition = Blt::PatitionId{
+          .Number = request->partition_number, .Capacity = Blt::CapacityBytes(request->partition_capacity)};
+      }
+      auto mount =
+        request->mount ? Blt::ParseMountPoint(request->mount, info.Action == Blt::CommandAction::Mount) : std::nullopt;
+      if (not mount) return BLT_STATUS_INVALID_REQUEST;
+      info.Mount = std::move(*mount);
+    }
+    return submit(engine, std::move(info), completion, context, id);
+  } catch (std::exception &ex) {
+    Blt::Log(Blt::LogLevel::Error, "unable to submit: {}", ex.what());
+    return BLT_STATUS_INTERNAL_ERROR;
+  }
+}
+
+blt_status blt_submit_arguments(
+  blt_engine *engine,
+  size_t count,
+  const char *const *arguments,
+  blt_completion completion,
+  void *context,
+  uint64_t *id)
+{
+  if (not engine or not completion or (count > 0 and not arguments)) return BLT_STATUS_INVALID_REQUEST;
+
+  try {
+    // ParseArguments expects the program name first
+    auto line = std::vector<std::string>{"BitLockerTool"};
+    for (size_t argument = 0; argument < count; ++argument) {
+      if (not arguments[argument]) return BLT_STATUS_INVALID_REQUEST;
+      line.emplace_back(arguments[argument]);
+    }
+    auto info = Blt::ParseArguments(line);
+    if (not info) return BLT_STATUS_INVALID_REQUEST;
+    return submit(engine, std::move(*info), completion, context, id);
+  } catch (std::exception &ex) {
+    Blt::Log(Blt::LogLevel::Error, "unable to submit: {}", ex.what());
+    return BLT_STATUS_INTERNAL_ERROR;
+  }
+}
+
+const char *blt_status_string(blt_status status)
+{
+  // every name is a literal, data() is NUL terminated
+  return Blt::ToString(static_cast<Blt::OperationStatus>(status)).data();
+}
+}
\ No newline at end of file
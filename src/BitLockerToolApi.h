@@ -0,0 +1,161 @@
+#pragma once
+
+/*
+ * C interface of the BitLockerTool engine (BitLockerToolApi.dll), the same mount/unmount/index/watch/unlock
+ * operations the command line runs, without a process per operation.
+ *
+ * Every struct starts with its own size, callers set it to sizeof the struct they were compiled against so later
+ * versions can append fields. Any size from version 1's on is accepted, a field appended since is only read when the
+ * size covers it (BLT_HAS_FIELD). The same goes for a blt_result, a version 1 library reports a shorter one.
+ * Strings are UTF-8 and only have to live until the call that takes them returns.
+ * All functions may be called from any thread. Completions run on the engine's own thread (or on the calling thread
+ * when blt_submit returns BLT_STATUS_SHUT_DOWN) and must not call blt_engine_destroy.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifdef BLT_API_EXPORTS
+#define BLT_API __declspec(dllexport)
+#else
+#define BLT_API __declspec(dllimport)
+#endif
+#else
+#define BLT_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLT_API_VERSION 3
+
+/* whether the struct `pointer` points to, which starts with its size, reaches to the end of `field` */
+#define BLT_HAS_FIELD(pointer, type, field) ((pointer)->size >= offsetof(type, field) + sizeof((pointer)->field))
+
+typedef struct blt_engine blt_engine;
+
+typedef enum blt_action {
+  BLT_ACTION_MOUNT   = 1,
+  BLT_ACTION_UNMOUNT = 2,
+  BLT_ACTION_INDEX   = 3,
+} blt_action;
+
+/* values match Blt::OperationStatus */
+typedef enum blt_status {
+  BLT_STATUS_SUCCESS         = 0,
+  BLT_STATUS_INVALID_REQUEST = 1,
+  BLT_STATUS_NOT_INDEXED     = 2,
+  BLT_STATUS_NO_MOUNT_POINT  = 3,
+  BLT_STATUS_SPAWN_FAILED    = 4,
+  BLT_STATUS_DISKPART_FAILED = 5,
+  BLT_STATUS_TIMED_OUT       = 6,
+  BLT_STATUS_INTERRUPTED     = 7,
+  BLT_STATUS_UNLOCK_FAILED   = 8,
+  BLT_STATUS_ABANDONED       = 9,
+  BLT_STATUS_SHUT_DOWN       = 10,
+  BLT_STATUS_INTERNAL_ERROR  = 11,
+} blt_status;
+
+typedef struct blt_engine_options {
+  uint32_t size;
+  /* key source spec (a key file or agent:<socket>), NULL for the interactive bdeunlock prompt */
+  const char *keys;
+  /* stand-in for manage-bde that reads the secret from stdin, NULL for manage-bde */
+  const char *unlock_command;
+  /* 0 for the default of 4 */
+  uint32_t unlock_parallelism;
+  /* how long blt_engine_destroy waits for running sessions, 0 for the default of 5000 */
+  uint32_t grace_ms;
+} blt_engine_options;
+
+typedef struct blt_request {
+  uint32_t size;
+  blt_action action;
+  /* the partition by numbers and capacities in bytes, ignored when disk_id is set */
+  int32_t disk_number;
+  uint64_t disk_capacity;
+  int32_t partition_number;
+  uint64_t partition_capacity;
+  /* or by identity, resolved through the volume index */
+  const char *disk_id;
+  uint64_t partition_offset;
+  /* "X", an absolute folder or "*" (mount only), unused by index */
+  const char *mount;
+} blt_request;
+
+typedef struct blt_result {
+  uint32_t size;
+  uint64_t id;
+  blt_status status;
+  /* the DiskPartError a BLT_STATUS_DISKPART_FAILED ended on, 0 otherwise */
+  int32_t diskpart_error;
+  /* where a mount attached the volume, "" when it did not, valid during the completion only */
+  const char *mount;
+  /*
+   * Since version 2, BLT_HAS_FIELD(result, blt_result, random_p99_us) first: what a mount with
+   * --probe=<milliseconds> (blt_submit_arguments) measured reading the volume back, 0 without a probe or when it
+   * failed. The lows are the 10th percentile of the phase's windows.
+   */
+  double sequential_mbps;
+  double sequential_mbps_low;
+  double random_iops;
+  double random_iops_low;
+  uint32_t random_p50_us;
+  uint32_t random_p99_us;
+  /*
+   * Since version 3, BLT_HAS_FIELD(result, blt_result, write_bytes) first: what the helper processes the operation
+   * started used, summed over them and over every target of the request, the peak is the largest of them. On Linux
+   * I/O is counted in 512 byte blocks and there are no operation counts.
+   */
+  uint32_t processes;
+  uint64_t user_time_us;
+  uint64_t kernel_time_us;
+  uint64_t peak_memory_bytes;
+  uint64_t read_operations;
+  uint64_t write_operations;
+  uint64_t read_bytes;
+  uint64_t write_bytes;
+} blt_result;
+
+typedef void (*blt_completion)(const blt_result *result, void *context);
+
+BLT_API uint32_t blt_api_version(void);
+
+/*
+ * NULL when options are malformed or the key source can not be opened. The first engine starts the log sink with the
+ * BLT_LOG_* settings of the environment, the last one destroyed flushes and stops it.
+ */
+BLT_API blt_engine *blt_engine_create(const blt_engine_options *options);
+
+/*
+ * Interrupts what is still running, waits at most the grace for it and calls the completion of everything it had to
+ * abandon with BLT_STATUS_ABANDONED. Every completion has been called when it returns.
+ */
+BLT_API void blt_engine_destroy(blt_engine *engine);
+
+/*
+ * Starts an operation, BLT_STATUS_SUCCESS when `completion` will report its outcome and `id` (may be NULL) is set.
+ * BLT_STATUS_SHUT_DOWN once the engine is being destroyed, the completion has been called with it by then.
+ */
+BLT_API blt_status
+  blt_submit(blt_engine *engine, const blt_request *request, blt_completion completion, void *context, uint64_t *id);
+
+/*
+ * The command line without the program name, e.g. {"watch", "{8A3E...}@16777216", "X"}. Covers every action,
+ * watch and unlock included.
+ */
+BLT_API blt_status blt_submit_arguments(
+  blt_engine *engine,
+  size_t count,
+  const char *const *arguments,
+  blt_completion completion,
+  void *context,
+  uint64_t *id);
+
+BLT_API const char *blt_status_string(blt_status status);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
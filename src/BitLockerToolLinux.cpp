@@ -0,0 +1,372 @@
+#include <fmt/format.h>
+#include <fmt/chrono.h>
+#include <boost/asio.hpp>
+#include "boost/asio/experimental/awaitable_operators.hpp"
+#include <boost/asio/use_awaitable.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Accounting.hpp"
+#include "AuditLog.hpp"
+#include "Command.hpp"
+#include "Common.hpp"
+#include "DeviceWatch.hpp"
+#include "Interrupt.hpp"
+#include "Log.hpp"
+#include "Luks.hpp"
+#include "MountPoint.hpp"
+#include "ReadProbe.hpp"
+#include "Spawn.hpp"
+#include "Unlock.hpp"
+#include "VolumeIndex.hpp"
+
+namespace asio = boost::asio;
+
+using namespace boost::asio::experimental::awaitable_operators;
+using namespace std::chrono_literals;
+
+// Adds what the helpers cost to the run's totals, true when every volume made it
+auto RecordResults(const std::vector<Blt::LuksResult> &results, Blt::UsageSummary &usage) -> bool
+{
+  for (const auto &result : results) usage.Add("luks", result.Usage);
+  const auto done = std::ranges::count(results, Blt::LuksError::Success, &Blt::LuksResult::Error);
+  return done == static_cast<std::ptrdiff_t>(results.size());
+}
+
+// One record per volume, the run's records are committed together when it stops the audit log
+void AuditResults(
+  Blt::AuditLog *audit,
+  std::string_view action,
+  const std::vector<Blt::LuksResult> &results,
+  std::chrono::system_clock::time_point started,
+  std::chrono::steady_clock::duration elapsed)
+{
+  if (not audit) return;
+  auto record = Blt::AuditRecord{
+    .Action  = action,
+    .Started = started,
+    .Elapsed = std::chrono::duration_cast<std::chrono::microseconds>(elapsed),
+  };
+  for (const auto &result : results) {
+    record.Target  = result.Device.empty() ? std::string() : fmt::format("/dev/{}", result.Device);
+    record.Mount   = fmt::format("{}", result.Mount);
+    record.Outcome = result.Error == Blt::LuksError::Success
+                     ? std::string("success")
+                     : fmt::format("luks error {}", fmt::underlying(result.Error));
+    audit->Append(record, [](bool) {});
+  }
+}
+
+// --probe, reads back every volume that attached, one at a time so the probes do not measure each other
+auto Probe(const std::vector<Blt::LuksResult> &results, std::optional<std::chrono::milliseconds> phase)
+  -> asio::awaitable<void>
+{
+  if (not phase) co_return;
+  for (const auto &result : results) {
+    if (result.Error != Blt::LuksError::Success) continue;
+    const auto path = Blt::ProbePath(result.Mount);
+    if (not path) {
+      Blt::Log(Blt::LogLevel::Warning, "nothing is mounted at {} to probe", result.Mount);
+      continue;
+    }
+    const auto probe = co_await Blt::ProbeReads(*path, Blt::ProbeOptions{.Phase = *phase});
+    if (probe.Error == Blt::ProbeError::Success)
+      Blt::Log(Blt::LogLevel::Info, "{} ({}) reads {}", result.Mount, path->string(), probe);
+    else
+      Blt::Log(Blt::LogLevel::Warning, "probe of {} {}", path->string(), Blt::ToString(probe.Error));
+  }
+}
+
+auto Mount(
+  Blt::LuksBackend &backend,
+  std::vector<Blt::LuksTarget> targets,
+  std::size_t parallelism,
+  std::optional<std::chrono::milliseconds> probe,
+  Blt::UsageSummary &usage,
+  Blt::AuditLog *audit,
+  bool &failed) -> asio::awaitable<void>
+{
+  const auto count   = targets.size();
+  const auto started = std::chrono::system_clock::now();
+  const auto start   = std::chrono::steady_clock::now();
+  const auto results = co_await backend.AttachAll(std::move(targets), parallelism);
+  failed             = not RecordResults(results, usage);
+  AuditResults(audit, "mount", results, started, std::chrono::steady_clock::now() - start);
+  Blt::Log(
+    Blt::LogLevel::Info,
+    "attached {} of {} volumes",
+    std::ranges::count(results, Blt::LuksError::Success, &Blt::LuksResult::Error),
+    count);
+  co_await Probe(results, probe);
+}
+
+// one after the other like the Windows engine, a volume that fails to detach does not keep the rest mounted
+auto Unmount(
+  Blt::LuksBackend &backend,
+  std::vector<Blt::LuksTarget> targets,
+  Blt::UsageSummary &usage,
+  Blt::AuditLog *audit,
+  bool &failed) -> asio::awaitable<void>
+{
+  auto results = std::vector<Blt::LuksResult>();
+  for (auto &target : targets) {
+    const auto started = std::chrono::system_clock::now();
+    const auto start   = std::chrono::steady_clock::now();
+    results.push_back(co_await backend.Detach(std::move(target)));
+    AuditResults(audit, "unmount", {results.back()}, started, std::chrono::steady_clock::now() - start);
+  }
+  failed = not RecordResults(results, usage);
+}
+
+auto Watch(
+  Blt::LuksBackend &backend,
+  const std::vector<Blt::WatchTarget> &targets,
+  const std::filesystem::path &sysBlock,
+  std::optional<std::chrono::milliseconds> probe,
+  Blt::Interrupt &interrupt,
+  Blt::UsageSummary &usage,
+  Blt::AuditLog *audit) -> asio::awaitable<void>
+{
+  auto watch = Blt::DeviceWatch(co_await asio::this_coro::executor);
+  Blt::Log(Blt::LogLevel::Info, "waiting for {} volumes to arrive", targets.size());
+
+  co_await (watch.Run([&](std::string device) -> asio::awaitable<void> {
+    // the disk that settled is resolved on its own, every volume that arrived with it is attached at once
+    const auto volumes = Blt::BuildVolumeIndexFromSysfs(sysBlock, device);
+    auto arrived       = std::vector<Blt::LuksTarget>();
+    for (const auto &target : targets) {
+      if (const auto location = volumes.Resolve(target.Volume))
+        arrived.push_back(Blt::LuksTarget{.Location = *location, .Volume = target.Volume, .Mount = target.Mount});
+    }
+    const auto count = arrived.size();
+    if (count == 0) co_return;
+    const auto started = std::chrono::system_clock::now();
+    const auto start   = std::chrono::steady_clock::now();
+    const auto results = co_await backend.AttachAll(std::move(arrived), count);
+    RecordResults(results, usage);
+    AuditResults(audit, "mount", results, started, std::chrono::steady_clock::now() - start);
+    co_await Probe(results, probe);
+  }) || interrupt.Wait());
+  co_await watch.Drain();
+}
+
+/**
+ * BitLockerTool  mount    0:64:MiB  1:63:MiB  /mnt/data
+ * BitLockerTool  mount    <disk id>@<partition offset>  /mnt/data|*  [<disk id>@<partition offset>  /mnt/...|*]...
+ * BitLockerTool  unmount  0:64:MiB  1:63:MiB  /mnt/data  [<disk>:<capacity>:<unit>  <part>:<capacity>:<unit>  /mnt]...
+ * BitLockerTool  index
+ * BitLockerTool  watch    <disk id>@<partition offset>  /mnt/data|*  [<disk id>@<partition offset>  /mnt/...|*]...
+ * BitLockerTool  verify-audit
+ *
+ * The Linux build attaches LUKS volumes and takes the same arguments as the Windows build, with folders instead of
+ * drive letters and partition 0 for an image without a partition table. Identities are resolved straight from sysfs.
+ * Keys come from BLT_UNLOCK_KEYS (a key file or agent:<socket>) and are looked up by `<disk id>@<partition offset>`,
+ * the mount folder or /dev/<name>. BLT_UNLOCK_PARALLELISM bounds concurrent attaches (4).
+ * BLT_CRYPTSETUP_PATH, BLT_MOUNT_PATH and BLT_UMOUNT_PATH replace the helpers and BLT_SYSFS_BLOCK replaces /sys/block,
+ * which is how the backend runs against loop images and stand-in scripts.
+ * Every attach and detach is appended to audit.log next to the volume index (BLT_AUDIT_LOG), verify-audit walks its
+ * chain and fails at the first record that does not continue it.
+ * --probe=<milliseconds> on mount and watch reads back every attached volume's device with O_DIRECT through io_uring,
+ * that long sequentially and that long at random offsets, and logs MB/s, IOPS and random read latency.
+ */
+int main(int argc, char **argv)
+{
+  // a helper that exits before it read its stdin fails the write with EPIPE instead of killing the tool mid-attach
+  std::signal(SIGPIPE, SIG_IGN);
+
+  // records are written by a background thread from here on, Stop flushes what is still queued on every return
+  Blt::LogSink::Instance().Start(Blt::LogOptionsFromEnvironment());
+  blt_defer {
+    Blt::LogSink::Instance().Stop();
+  };
+
+  auto parseResult = Blt::ParseArguments(std::span<const char *const>(argv, static_cast<std::size_t>(argc)));
+  if (not parseResult) return static_cast<int>(parseResult.error());
+
+  const auto *sysBlockOverride = std::getenv("BLT_SYSFS_BLOCK");
+  const auto sysBlock =
+    std::filesystem::path(sysBlockOverride and *sysBlockOverride ? sysBlockOverride : "/sys/block");
+
+  switch (parseResult->Action) {
+  case Blt::CommandAction::Index: {
+    const auto index = Blt::BuildVolumeIndexFromSysfs(sysBlock);
+    const auto path  = Blt::DefaultVolumeIndexPath();
+    if (not index.Save(path)) {
+      Blt::Log(Blt::LogLevel::Error, "unable to write volume index {}", path.string());
+      return EXIT_FAILURE;
+    }
+    Blt::Log(Blt::LogLevel::Info, "indexed {} volumes into {}", index.Size(), path.string());
+    return EXIT_SUCCESS;
+  }
+  case Blt::CommandAction::Unlock: {
+    Blt::Log(Blt::LogLevel::Error, "unlock is for BitLocker volumes, mount opens and mounts a LUKS volume in one go");
+    return EXIT_FAILURE;
+  }
+  case Blt::CommandAction::VerifyAudit: {
+    const auto path         = Blt::DefaultAuditLogPath();
+    const auto verification = Blt::VerifyAuditLog(path);
+    if (not verification.Intact) {
+      Blt::Log(
+        Blt::LogLevel::Error,
+        "{} line {}: {}, {} records before it are intact",
+        path.string(),
+        verification.BrokenLine,
+        verification.Problem,
+        verification.Records);
+      return EXIT_FAILURE;
+    }
+    if (not verification.Problem.empty())
+      Blt::Log(Blt::LogLevel::Warning, "{}: {}", path.string(), verification.Problem);
+    Blt::Log(Blt::LogLevel::Info, "{} records in {} are intact", verification.Records, path.string());
+    return EXIT_SUCCESS;
+  }
+  default: {
+    break;
+  }
+  }
+
+  // identities are resolved against what sysfs shows now, there is no stale index to trip over
+  const auto volumes = Blt::BuildVolumeIndexFromSysfs(sysBlock);
+  auto targets       = std::vector<Blt::LuksTarget>();
+  if (parseResult->Action != Blt::CommandAction::Watch
+      and (not parseResult->Targets.empty() or not parseResult->Numbered.empty())) {
+    for (const auto &target : parseResult->Numbered) {
+      const auto location = Blt::VolumeLocation{
+        .DiskNumber        = target.Disk.Number,
+        .DiskCapacity      = target.Disk.Capacity,
+        .PartitionNumber   = target.Partition.Number,
+        .PartitionCapacity = target.Partition.Capacity,
+      };
+      targets.push_back(Blt::LuksTarget{.Location = location, .Volume = std::nullopt, .Mount = target.Mount});
+    }
+    for (const auto &target : parseResult->Targets) {
+      const auto location = volumes.Resolve(target.Volume);
+      if (not location) {
+        Blt::Log(
+          Blt::LogLevel::Error,
+          "{}@{} is not attached to this machine",
+          target.Volume.DiskId,
+          target.Volume.PartitionOffset);
+        return EXIT_FAILURE;
+      }
+      targets.push_back(Blt::LuksTarget{.Location = *location, .Volume = target.Volume, .Mount = target.Mount});
+    }
+  } else if (parseResult->Action != Blt::CommandAction::Watch) {
+    auto location = Blt::VolumeLocation{
+      .DiskNumber        = parseResult->Disk.Number,
+      .DiskCapacity      = parseResult->Disk.Capacity,
+      .PartitionNumber   = parseResult->Partition.Number,
+      .PartitionCapacity = parseResult->Partition.Capacity,
+    };
+    if (const auto &volume = parseResult->Volume) {
+      const auto resolved = volumes.Resolve(*volume);
+      if (not resolved) {
+        Blt::Log(
+          Blt::LogLevel::Error, "{}@{} is not attached to this machine", volume->DiskId, volume->PartitionOffset);
+        return EXIT_FAILURE;
+      }
+      location = *resolved;
+    }
+    targets.push_back(
+      Blt::LuksTarget{.Location = location, .Volume = parseResult->Volume, .Mount = parseResult->Mount});
+  }
+
+  // unmount needs no key, mount and watch without one fail per volume with NoKey
+  auto keys = Blt::KeySource();
+  if (const auto *spec = std::getenv("BLT_UNLOCK_KEYS")) {
+    auto source = Blt::KeySource::Open(spec);
+    if (not source) {
+      Blt::Log(Blt::LogLevel::Error, "unable to read keys from {}", spec);
+      return EXIT_FAILURE;
+    }
+    keys = std::move(*source);
+  }
+  const auto *parallelism = std::getenv("BLT_UNLOCK_PARALLELISM");
+
+  Blt::Spawner cryptsetup{[] { return Blt::FindExecutable("cryptsetup", "BLT_CRYPTSETUP_PATH"); }};
+  Blt::Spawner mount{[] { return Blt::FindExecutable("mount", "BLT_MOUNT_PATH"); }};
+  Blt::Spawner umount{[] { return Blt::FindExecutable("umount", "BLT_UMOUNT_PATH"); }};
+  Blt::MountPool mountPool{Blt::FreeDriveLetters, Blt::DefaultMountRoot()};
+  Blt::LuksBackend backend{
+    Blt::LuksCommands{.Cryptsetup = cryptsetup, .Mount = mount, .Umount = umount},
+    std::move(keys),
+    mountPool,
+    sysBlock};
+
+  // an unusable audit log does not keep volumes from mounting, the warning is all there is
+  auto audit = Blt::AuditLog::Open(Blt::DefaultAuditLogPath());
+  if (not audit) Blt::Log(Blt::LogLevel::Warning, "operations are not audited");
+  asio::io_context ioc;
+  Blt::UsageSummary usage;
+  auto failed                     = false;
+  constexpr auto exceptionHandler = [](std::exception_ptr e) {
+    if (e) try {
+        std::rethrow_exception(e);
+      } catch (std::exception &ex) {
+        Blt::Log(Blt::LogLevel::Error, "Error ===> {}", ex.what());
+      }
+  };
+  // helpers are not raced against the interrupt here, whatever still runs 5s after Ctrl-C is abandoned
+  Blt::Interrupt interrupt{ioc, 5s};
+  interrupt.Listen();
+  const auto finished = [&interrupt, exceptionHandler](std::exception_ptr e) {
+    exceptionHandler(e);
+    interrupt.Done();
+  };
+
+  switch (parseResult->Action) {
+  case Blt::CommandAction::Mount: {
+    asio::co_spawn(
+      ioc,
+      Mount(
+        backend,
+        std::move(targets),
+        parallelism ? std::strtoul(parallelism, nullptr, 10) : 4,
+        parseResult->Probe,
+        usage,
+        audit.get(),
+        failed),
+      finished);
+    break;
+  }
+  case Blt::CommandAction::Unmount: {
+    asio::co_spawn(ioc, Unmount(backend, std::move(targets), usage, audit.get(), failed), finished);
+    break;
+  }
+  case Blt::CommandAction::Watch: {
+    asio::co_spawn(
+      ioc,
+      Watch(backend, parseResult->Targets, sysBlock, parseResult->Probe, interrupt, usage, audit.get()),
+      finished);
+    break;
+  }
+  default: {
+    break;
+  }
+  }
+
+  ioc.run();
+  // commits what the run appended
+  if (audit) audit->Stop();
+  usage.Report();
+
+  if (interrupt.Requested()) {
+    Blt::Log(
+      interrupt.Forced() ? Blt::LogLevel::Error : Blt::LogLevel::Warning,
+      "interrupted, teardown took {}{}",
+      interrupt.Teardown(),
+      interrupt.Forced() ? " and was cut short" : "");
+    return EXIT_FAILURE;
+  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
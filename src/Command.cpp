@@ -1,22 +1,132 @@
 #include "Command.hpp"
 
-#include <array>
-#include <cassert>
-#include <charconv>
-#include <ctre-unicode.hpp>
-#include <system_error>
 #include <expected>
+#include <optional>
+#include <string_view>
+#include <utility>
 
-#include "Unit.hpp"
-
+#include "Log.hpp"
 
 namespace Blt {
 
-[[nodiscard]] auto ParseCommandLine() -> std::expected<MountInfo, ParseCommandLineError>
+namespace {
+  auto utf8(std::string_view argument) -> std::string_view { return argument; }
+
+#ifdef _WIN32
+  // Only what ends up in the request is converted, never what the parse merely looks at
+  auto utf8(std::wstring_view argument) -> std::string
+  {
+    const auto length = static_cast<int>(argument.size());
+    auto converted    = std::string(
+      static_cast<std::size_t>(WideCharToMultiByte(CP_UTF8, 0, argument.data(), length, nullptr, 0, nullptr, nullptr)),
+      '\0');
+    WideCharToMultiByte(
+      CP_UTF8, 0, argument.data(), length, converted.data(), static_cast<int>(converted.size()), nullptr, nullptr);
+    return converted;
+  }
+#endif
+
+  template<typename Char>
+  auto mountPoint(const ParsedTarget<Char> &target, bool automatic) -> std::expected<MountPoint, ArgumentError>
+  {
+    if (auto mount = ParseMountPoint(utf8(target.Mount), automatic)) return std::move(*mount);
+    return std::unexpected(ArgumentError{
+      ParseCommandLineError::ParseFailed, target.MountArgument, 0, "a drive letter or an absolute folder"});
+  }
+
+  template<typename Char>
+  auto toMountInfo(const ParsedArguments<Char> &parsed) -> std::expected<MountInfo, ArgumentError>
+  {
+    auto info      = MountInfo{};
+    info.Action    = parsed.Rule->Action;
+    info.Keys      = utf8(parsed.Keys);
+    const auto all = parsed.Parsed();
+    if (const auto timeout = parsed.Option(CommandOption::SessionTimeout))
+      info.SessionTimeout = std::chrono::seconds(*timeout);
+    if (const auto probe = parsed.Option(CommandOption::Probe)) info.Probe = std::chrono::milliseconds(*probe);
+
+    // every target of a request has the same shape, only its vector grows
+    const auto shape = all.empty() ? TargetShape::None : all.front().Shape;
+    if (shape == TargetShape::Mount) info.Mounts.reserve(all.size());
+    if (shape == TargetShape::Volume) info.Targets.reserve(all.size());
+    if (shape == TargetShape::Numbered) info.Numbered.reserve(all.size());
+
+    for (const auto &target : all) {
+      auto mount = mountPoint(target, parsed.Rule->Automatic);
+      if (not mount) return std::unexpected(mount.error());
+
+      if (target.Shape == TargetShape::Mount) {
+        info.Mounts.push_back(std::move(*mount));
+      } else if (target.Shape == TargetShape::Volume) {
+        info.Targets.push_back(WatchTarget{
+          .Volume =
+            VolumeKey{.DiskId = NormalizeDiskId(utf8(target.DiskId)), .PartitionOffset = target.PartitionOffset},
+          .Mount  = std::move(*mount),
+        });
+      } else {
+        info.Numbered.push_back(NumberedTarget{
+          .Disk      = DriveId{.Number = target.DiskNumber, .Capacity = target.DiskCapacity},
+          .Partition = PatitionId{.Number = target.PartitionNumber, .Capacity = target.PartitionCapacity},
+          .Mount     = std::move(*mount),
+        });
+      }
+    }
+
+    // a single mount or unmount target is the request itself, the way every caller knew it before there were several
+    if (info.Action == CommandAction::Mount or info.Action == CommandAction::Unmount) {
+      if (info.Numbered.size() == 1) {
+        info.Disk      = info.Numbered.front().Disk;
+        info.Partition = info.Numbered.front().Partition;
+        info.Mount     = std::move(info.Numbered.front().Mount);
+        info.Numbered.clear();
+      } else if (info.Targets.size() == 1) {
+        info.Volume = std::move(info.Targets.front().Volume);
+        info.Mount  = std::move(info.Targets.front().Mount);
+        info.Targets.clear();
+      }
+    }
+    return info;
+  }
+
+  template<typename Char, typename Argument>
+  auto parse(std::span<const Argument> arguments) -> std::expected<MountInfo, ParseCommandLineError>
+  {
+    // a few KiB of views, a thread's stack has room for it and the heap is not involved
+    auto parsed = ParsedArguments<Char>();
+    auto error  = ParseArgv<Char>(arguments, parsed);
+    auto info   = std::expected<MountInfo, ArgumentError>();
+    if (not error) {
+      info = toMountInfo(parsed);
+      if (not info) error = info.error();
+    }
+    if (error) {
+      Log(
+        LogLevel::Error,
+        "argument {} at offset {}: expected {}",
+        error->Argument,
+        error->Offset,
+        error->Expected);
+      return std::unexpected(error->Code);
+    }
+    return std::move(*info);
+  }
+}// namespace
+
+[[nodiscard]] auto ParseArguments(std::span<const std::string> arguments)
+  -> std::expected<MountInfo, ParseCommandLineError>
 {
-  MountInfo actionInfo;
-  actionInfo.Action = CommandAction::Unknown;
+  return parse<char>(arguments);
+}
+
+[[nodiscard]] auto ParseArguments(std::span<const char *const> arguments)
+  -> std::expected<MountInfo, ParseCommandLineError>
+{
+  return parse<char>(arguments);
+}
 
+#ifdef _WIN32
+[[nodiscard]] auto ParseCommandLine() -> std::expected<MountInfo, ParseCommandLineError>
+{
   LPWSTR *szArglist;
   int nArgs;
 
@@ -29,135 +139,7 @@ namespace Blt {
     LocalFree(szArglist);
   };
 
-  /*
-  0: program
-  1: action
-  2: drive_number:capacity:unit
-  3: partition_number:capacity:unit
-  4: letter
-  */
-  std::array<char, 1024> buffer;
-  if (nArgs >= 2) {
-    auto written = WideCharToMultiByte(
-      CP_UTF8, 0, szArglist[1], static_cast<int>(wcslen(szArglist[1])), buffer.data(), static_cast<int>(buffer.size()), nullptr, nullptr);
-    assert(written);
-    auto actionView = std::string_view(buffer.data(), written);
-
-    if (actionView == "mount") {
-      actionInfo.Action = CommandAction::Mount;
-    } else if (actionView == "unmount") {
-      actionInfo.Action = CommandAction::Unmount;
-    }
-  }
-  constexpr auto getCapacity =
-    [](std::string_view capacityStr, uint64_t capacityValue) -> std::expected<CapacityBytes, ParseCommandLineError> {
-    using ReturnType = std::expected<CapacityBytes, ParseCommandLineError>;
-    if (capacityStr == "KiB") {
-      return ReturnType(std::in_place, capacityCast<CapacityBytes>(Kibibytes(capacityValue)));
-    } else if (capacityStr == "MiB") {
-      return ReturnType(std::in_place, capacityCast<CapacityBytes>(Mebibytes(capacityValue)));
-    } else if (capacityStr == "GiB") {
-      return ReturnType(std::in_place, capacityCast<CapacityBytes>(Gibibytes(capacityValue)));
-    } else {
-      return ReturnType(std::unexpect, ParseCommandLineError::ParseFailed);
-    }
-  };
-
-  uint64_t capacityValue;
-  switch (actionInfo.Action) {
-  case CommandAction::Mount:
-    [[fallthrough]];
-  case CommandAction::Unmount: {
-    assert(nArgs == 5);
-    {
-      {
-        auto written = WideCharToMultiByte(
-          CP_UTF8, 0, szArglist[2], static_cast<int>(wcslen(szArglist[2])), buffer.data(), static_cast<int>(buffer.size()), nullptr, nullptr);
-        assert(written);
-        auto driveView                                        = std::string_view(buffer.data(), written);
-        auto [_, numberCapture, capacityCapture, unitCapture] = ctre::search<"^(\\d+):(\\d+):(.+)">(driveView);
-        {
-          auto view    = numberCapture.to_view();
-          auto [_, ec] = std::from_chars(view.data(), view.data() + view.size(), actionInfo.Disk.Number, 10);
-          if (ec != std::error_code())
-            return std::expected<MountInfo, ParseCommandLineError>(std::unexpect, ParseCommandLineError::ParseFailed);
-        }
-        {
-          auto view    = capacityCapture.to_view();
-          auto [_, ec] = std::from_chars(view.data(), view.data() + view.size(), capacityValue, 10);
-          if (ec != std::error_code())
-            return std::expected<MountInfo, ParseCommandLineError>(std::unexpect, ParseCommandLineError::ParseFailed);
-        }
-
-        {
-          if (auto capacityResult = getCapacity(unitCapture.to_view(), capacityValue); capacityResult) {
-            actionInfo.Disk.Capacity = *capacityResult;
-          } else {
-            return std::expected<MountInfo, ParseCommandLineError>(std::unexpect, capacityResult.error());
-          }
-        }
-      }
-      {
-        auto written = WideCharToMultiByte(
-          CP_UTF8,
-          0,
-          szArglist[3],
-          static_cast<int>(wcslen(szArglist[3])),
-          buffer.data(),
-          static_cast<int>(buffer.size()),
-          nullptr,
-          nullptr);
-        assert(written);
-        auto partitionView                                    = std::string_view(buffer.data(), written);
-        auto [_, numberCapture, capacityCapture, unitCapture] = ctre::search<"^(\\d+):(\\d+):(.+)">(partitionView);
-        {
-          auto view    = numberCapture.to_view();
-          auto [_, ec] = std::from_chars(view.data(), view.data() + view.size(), actionInfo.Partition.Number, 10);
-          if (ec != std::error_code())
-            return std::expected<MountInfo, ParseCommandLineError>(std::unexpect, ParseCommandLineError::ParseFailed);
-        }
-        {
-          auto view    = capacityCapture.to_view();
-          auto [_, ec] = std::from_chars(view.data(), view.data() + view.size(), capacityValue, 10);
-          if (ec != std::error_code())
-            return std::expected<MountInfo, ParseCommandLineError>(std::unexpect, ParseCommandLineError::ParseFailed);
-        }
-        {
-          if (auto capacityResult = getCapacity(unitCapture.to_view(), capacityValue); capacityResult) {
-            actionInfo.Partition.Capacity = *capacityResult;
-          } else {
-            return std::expected<MountInfo, ParseCommandLineError>(std::unexpect, capacityResult.error());
-          }
-        }
-      }
-      {
-        auto written = WideCharToMultiByte(
-          CP_UTF8,
-          0,
-          szArglist[4],
-          static_cast<int>(wcslen(szArglist[4])),
-          buffer.data(),
-          static_cast<int>(buffer.size()),
-          nullptr,
-          nullptr);
-        assert(written);
-        auto letterView               = std::string_view(buffer.data(), written);
-        constexpr auto validateLetter = [](char letter) {
-          return (letter >= 'a' and letter < 'z') or (letter >= 'A' and letter <= 'Z');
-        };
-        if (letterView.size() == 1 and validateLetter(letterView[0])) {
-          actionInfo.Letter = letterView[0];
-        } else {
-          return std::expected<MountInfo, ParseCommandLineError>(std::unexpect, ParseCommandLineError::ParseFailed);
-        }
-      }
-    }
-    break;
-  }
-  case CommandAction::Unknown: {
-    return std::expected<MountInfo, ParseCommandLineError>(std::unexpect, ParseCommandLineError::UnknownAction);
-  }
-  }
-  return std::expected<MountInfo, ParseCommandLineError>(std::in_place, actionInfo);
+  return parse<wchar_t>(std::span<const LPWSTR>(szArglist, static_cast<std::size_t>(nArgs)));
 }
+#endif
 }// namespace Blt
\ No newline at end of file
@@ -1,18 +1,20 @@
 #pragma once
 
 #include "Common.hpp"
+#include "CommandGrammar.hpp"
+#include "MountPoint.hpp"
 #include "Unit.hpp"
+#include "VolumeIndex.hpp"
 
+#include <chrono>
 #include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
 
 namespace Blt {
 
-enum struct CommandAction {
-  Unknown,
-  Mount,
-  Unmount
-};
-
 struct DriveId
 {
   int Number;
@@ -25,21 +27,48 @@ struct PatitionId
   CapacityBytes Capacity;
 };
 
+struct WatchTarget
+{
+  VolumeKey Volume;
+  MountPoint Mount;
+};
+
+struct NumberedTarget
+{
+  DriveId Disk;
+  PatitionId Partition;
+  MountPoint Mount;
+};
+
 struct MountInfo
 {
   CommandAction Action;
   DriveId Disk;
   PatitionId Partition;
-  char Letter;
+  MountPoint Mount;
+  // set when the target was given by identity, Disk and Partition are filled in from the volume index
+  std::optional<VolumeKey> Volume;
+  // watch, volumes to mount as soon as their disk shows up. mount and unmount, volumes to handle in one run
+  std::vector<WatchTarget> Targets;
+  // mount and unmount, disks and partitions by number to handle in one run
+  std::vector<NumberedTarget> Numbered;
+  // unlock only, key source spec (see KeySource) and the drive letters or folders to unlock with it
+  std::string Keys;
+  std::vector<MountPoint> Mounts;
+  // --timeout, how long each diskpart session may take instead of the action's default
+  std::optional<std::chrono::seconds> SessionTimeout;
+  // --probe, mount and watch only, how long each phase of the read probe of an attached volume takes
+  std::optional<std::chrono::milliseconds> Probe;
 };
 
-enum struct ParseCommandLineError {
-  GetCommandLineFailed = 1,
-  UnknownAction,
-  UnsupportedCapacityUnit,
-  ParseFailed,
-};
+// `arguments` as a C runtime would split them, the program first, all of them UTF-8. See ParseArgv for the grammar
+auto ParseArguments(std::span<const std::string> arguments) -> std::expected<MountInfo, ParseCommandLineError>;
+// The same straight from main's argv
+auto ParseArguments(std::span<const char *const> arguments) -> std::expected<MountInfo, ParseCommandLineError>;
 
+#ifdef _WIN32
+// The process' own command line through CommandLineToArgvW, parsed as UTF-16 without converting it first
 auto ParseCommandLine() -> std::expected<MountInfo, ParseCommandLineError>;
+#endif
 
 }// namespace Blt
\ No newline at end of file
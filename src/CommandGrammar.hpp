@@ -0,0 +1,446 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "Unit.hpp"
+
+namespace Blt {
+
+enum struct CommandAction {
+  Unknown,
+  Mount,
+  Unmount,
+  Index,
+  Watch,
+  Unlock,
+  // walks the audit log's chain, the CLIs run it without an engine
+  VerifyAudit
+};
+
+enum struct ParseCommandLineError {
+  GetCommandLineFailed = 1,
+  UnknownAction,
+  UnsupportedCapacityUnit,
+  ParseFailed,
+};
+
+// How a target is written on the command line, a request writes all of its targets the same way
+enum struct TargetShape : uint8_t {
+  None = 0,
+  // <disk>:<capacity>:<unit> <partition>:<capacity>:<unit> <mount>
+  Numbered = 1 << 0,
+  // <disk id>@<partition offset> <mount>
+  Volume = 1 << 1,
+  // <mount>
+  Mount = 1 << 2,
+};
+
+constexpr auto operator|(TargetShape lhs, TargetShape rhs) -> TargetShape
+{
+  return static_cast<TargetShape>(static_cast<uint8_t>(lhs) | static_cast<uint8_t>(rhs));
+}
+
+constexpr auto Allows(TargetShape shapes, TargetShape shape) -> bool
+{
+  return (static_cast<uint8_t>(shapes) & static_cast<uint8_t>(shape)) != 0;
+}
+
+// What follows an action's name
+struct ActionRule
+{
+  std::string_view Name;
+  CommandAction Action;
+  // one argument ahead of the targets, taken as is: unlock's key source spec
+  bool LeadingKeys       = false;
+  TargetShape Shapes     = TargetShape::None;
+  std::size_t MinTargets = 0;
+  // `*` lets the mount pool pick, only where a mount starts
+  bool Automatic = false;
+};
+
+inline constexpr auto CommandActions = std::to_array<ActionRule>({
+  {.Name       = "mount",
+   .Action     = CommandAction::Mount,
+   .Shapes     = TargetShape::Numbered | TargetShape::Volume,
+   .MinTargets = 1,
+   .Automatic  = true},
+  {.Name       = "unmount",
+   .Action     = CommandAction::Unmount,
+   .Shapes     = TargetShape::Numbered | TargetShape::Volume,
+   .MinTargets = 1},
+  {.Name = "index", .Action = CommandAction::Index},
+  {.Name = "watch", .Action = CommandAction::Watch, .Shapes = TargetShape::Volume, .MinTargets = 1, .Automatic = true},
+  {.Name        = "unlock",
+   .Action      = CommandAction::Unlock,
+   .LeadingKeys = true,
+   .Shapes      = TargetShape::Mount,
+   .MinTargets  = 1},
+  {.Name = "verify-audit", .Action = CommandAction::VerifyAudit},
+});
+
+enum struct CommandOption {
+  // --timeout=<seconds>, how long one diskpart session may take
+  SessionTimeout,
+  // --probe=<milliseconds>, read from every volume a mount attached for this long per phase (ReadProbe)
+  Probe,
+};
+
+// `--<name>=<number>` anywhere after the program, a repeated option keeps the last value
+struct OptionRule
+{
+  std::string_view Name;
+  CommandOption Option;
+  uint64_t Min = 0;
+  uint64_t Max = std::numeric_limits<uint64_t>::max();
+};
+
+inline constexpr auto CommandOptions = std::to_array<OptionRule>({
+  {.Name = "timeout", .Option = CommandOption::SessionTimeout, .Min = 1, .Max = 24 * 60 * 60},
+  {.Name = "probe", .Option = CommandOption::Probe, .Min = 10, .Max = 60 * 1000},
+});
+
+/**
+ * Where an argument list stops fitting the grammar: `Argument` indexes argv (argv's size when arguments are missing at
+ * the end) and `Offset` is the first character of it that does not fit.
+ */
+struct ArgumentError
+{
+  ParseCommandLineError Code;
+  std::size_t Argument;
+  std::size_t Offset;
+  std::string_view Expected;
+};
+
+// One target as written, views into argv
+template<typename Char>
+struct ParsedTarget
+{
+  TargetShape Shape = TargetShape::None;
+  int DiskNumber    = 0;
+  CapacityBytes DiskCapacity{};
+  int PartitionNumber = 0;
+  CapacityBytes PartitionCapacity{};
+  std::basic_string_view<Char> DiskId;
+  uint64_t PartitionOffset = 0;
+  std::basic_string_view<Char> Mount;
+  // argv index of Mount
+  std::size_t MountArgument = 0;
+};
+
+// Fixed capacity, a parse never touches the heap
+template<typename Char>
+struct ParsedArguments
+{
+  static constexpr std::size_t MaxTargets = 64;
+
+  const ActionRule *Rule = nullptr;
+  std::basic_string_view<Char> Keys;
+  std::array<ParsedTarget<Char>, MaxTargets> Targets{};
+  std::size_t TargetCount = 0;
+  std::array<std::optional<uint64_t>, CommandOptions.size()> Options{};
+
+  [[nodiscard]] auto Parsed() const -> std::span<const ParsedTarget<Char>> { return {Targets.data(), TargetCount}; }
+  [[nodiscard]] constexpr auto Option(CommandOption option) const -> std::optional<uint64_t>
+  {
+    return Options[static_cast<std::size_t>(option)];
+  }
+};
+
+namespace Detail {
+  template<std::size_t Rules>
+  constexpr auto HasUniqueNames(const std::array<ActionRule, Rules> &rules) -> bool
+  {
+    for (std::size_t rule = 0; rule < Rules; ++rule)
+      for (std::size_t other = rule + 1; other < Rules; ++other)
+        if (rules[rule].Name == rules[other].Name) return false;
+    return true;
+  }
+
+  // A rule that needs targets takes some shape of them, a bare mount is never mixed with the target shapes
+  template<std::size_t Rules>
+  constexpr auto HasReachableTargets(const std::array<ActionRule, Rules> &rules) -> bool
+  {
+    for (const auto &rule : rules) {
+      if (rule.MinTargets > 0 and rule.Shapes == TargetShape::None) return false;
+      if (Allows(rule.Shapes, TargetShape::Mount) and rule.Shapes != TargetShape::Mount) return false;
+    }
+    return true;
+  }
+
+  template<std::size_t Options>
+  constexpr auto IsIndexedByOption(const std::array<OptionRule, Options> &options) -> bool
+  {
+    for (std::size_t option = 0; option < Options; ++option)
+      if (static_cast<std::size_t>(options[option].Option) != option or options[option].Min > options[option].Max)
+        return false;
+    return true;
+  }
+
+  static_assert(HasUniqueNames(CommandActions), "an action name selects one rule");
+  static_assert(HasReachableTargets(CommandActions), "every target a rule needs can be written");
+  static_assert(IsIndexedByOption(CommandOptions), "options are listed in CommandOption order");
+
+  constexpr auto ShapeLength(TargetShape shape) -> std::size_t
+  {
+    switch (shape) {
+    case TargetShape::Numbered:
+      return 3;
+    case TargetShape::Volume:
+      return 2;
+    default:
+      return 1;
+    }
+  }
+
+  // Every name and keyword of the grammar is ASCII, so comparing per code unit works for narrow and wide argv alike
+  template<typename Char>
+  constexpr auto Equals(std::basic_string_view<Char> argument, std::string_view keyword) -> bool
+  {
+    if (argument.size() != keyword.size()) return false;
+    for (std::size_t at = 0; at < keyword.size(); ++at)
+      if (argument[at] != static_cast<Char>(keyword[at])) return false;
+    return true;
+  }
+
+  template<typename Char>
+  constexpr auto IsDigit(Char unit) -> bool
+  {
+    return unit >= Char('0') and unit <= Char('9');
+  }
+
+  template<typename Char>
+  constexpr auto IsLetter(Char unit) -> bool
+  {
+    return (unit >= Char('a') and unit <= Char('z')) or (unit >= Char('A') and unit <= Char('Z'));
+  }
+
+  template<typename Char>
+  constexpr auto Find(std::basic_string_view<Char> argument, char unit) -> std::size_t
+  {
+    return argument.find(static_cast<Char>(unit));
+  }
+
+  // Decimal digits from `at` up to the first non-digit, `at` ends on it. nullopt without a digit or past `max`
+  template<typename Char>
+  constexpr auto Digits(std::basic_string_view<Char> argument, std::size_t &at, uint64_t max) -> std::optional<uint64_t>
+  {
+    const auto begin = at;
+    uint64_t value   = 0;
+    for (; at < argument.size() and IsDigit(argument[at]); ++at) {
+      const auto digit = static_cast<uint64_t>(argument[at] - Char('0'));
+      if (value > (max - digit) / 10) return std::nullopt;
+      value = value * 10 + digit;
+    }
+    if (at == begin) return std::nullopt;
+    return value;
+  }
+
+  template<typename Char>
+  constexpr auto IsAbsoluteFolder(std::basic_string_view<Char> argument) -> bool
+  {
+#ifdef _WIN32
+    const auto separator = [](Char unit) { return unit == Char('\\') or unit == Char('/'); };
+    if (argument.size() >= 2 and separator(argument[0]) and separator(argument[1])) return true;
+    return argument.size() >= 3 and IsLetter(argument[0]) and argument[1] == Char(':') and separator(argument[2]);
+#else
+    return not argument.empty() and argument[0] == Char('/');
+#endif
+  }
+
+  template<typename Char>
+  constexpr auto NumberedArgument(
+    std::basic_string_view<Char> argument, std::size_t index, int &number, CapacityBytes &capacity)
+    -> std::optional<ArgumentError>
+  {
+    constexpr auto expected = std::string_view("<number>:<capacity>:<KiB|MiB|GiB>");
+    auto at                 = std::size_t(0);
+    const auto parsedNumber = Digits(argument, at, static_cast<uint64_t>(std::numeric_limits<int>::max()));
+    if (not parsedNumber or at == argument.size() or argument[at] != Char(':'))
+      return ArgumentError{ParseCommandLineError::ParseFailed, index, at, expected};
+    const auto parsedCapacity = Digits(argument, ++at, std::numeric_limits<uint64_t>::max() >> 30);
+    if (not parsedCapacity or at == argument.size() or argument[at] != Char(':'))
+      return ArgumentError{ParseCommandLineError::ParseFailed, index, at, expected};
+
+    const auto unit = argument.substr(++at);
+    if (Equals(unit, "KiB")) {
+      capacity = capacityCast<CapacityBytes>(Kibibytes(*parsedCapacity));
+    } else if (Equals(unit, "MiB")) {
+      capacity = capacityCast<CapacityBytes>(Mebibytes(*parsedCapacity));
+    } else if (Equals(unit, "GiB")) {
+      capacity = capacityCast<CapacityBytes>(Gibibytes(*parsedCapacity));
+    } else {
+      return ArgumentError{ParseCommandLineError::UnsupportedCapacityUnit, index, at, "KiB, MiB or GiB"};
+    }
+    number = static_cast<int>(*parsedNumber);
+    return std::nullopt;
+  }
+
+  template<typename Char>
+  constexpr auto VolumeArgument(std::basic_string_view<Char> argument, std::size_t index, ParsedTarget<Char> &target)
+    -> std::optional<ArgumentError>
+  {
+    const auto separator = argument.rfind(static_cast<Char>('@'));
+    if (separator == 0 or separator == std::basic_string_view<Char>::npos)
+      return ArgumentError{ParseCommandLineError::ParseFailed, index, 0, "<disk id>@<partition offset>"};
+    auto at     = separator + 1;
+    auto offset = Digits(argument, at, std::numeric_limits<uint64_t>::max());
+    if (not offset or at != argument.size())
+      return ArgumentError{ParseCommandLineError::ParseFailed, index, at, "a partition offset in bytes"};
+    target.DiskId          = argument.substr(0, separator);
+    target.PartitionOffset = *offset;
+    return std::nullopt;
+  }
+
+  template<typename Char>
+  constexpr auto MountPointArgument(std::basic_string_view<Char> argument, std::size_t index, bool automatic)
+    -> std::optional<ArgumentError>
+  {
+    if (argument.size() == 1 and argument[0] == Char('*')) {
+      if (automatic) return std::nullopt;
+      return ArgumentError{
+        ParseCommandLineError::ParseFailed,
+        index,
+        0,
+        "a drive letter or an absolute folder, `*` only where a mount starts"};
+    }
+    if (argument.size() == 1 and IsLetter(argument[0])) return std::nullopt;
+    if (not IsAbsoluteFolder(argument))
+      return ArgumentError{ParseCommandLineError::ParseFailed, index, 0, "a drive letter or an absolute folder"};
+    // the path goes into a quoted diskpart argument, which has no escape for a quote
+    if (const auto quote = Find(argument, '"'); quote != std::basic_string_view<Char>::npos)
+      return ArgumentError{ParseCommandLineError::ParseFailed, index, quote, "a folder without a quote"};
+    return std::nullopt;
+  }
+
+  template<typename Char>
+  constexpr auto OptionArgument(std::basic_string_view<Char> argument, std::size_t index, ParsedArguments<Char> &out)
+    -> std::optional<ArgumentError>
+  {
+    const auto equals = Find(argument, '=');
+    const auto name   = argument.substr(2, equals == std::basic_string_view<Char>::npos ? equals : equals - 2);
+    for (const auto &rule : CommandOptions) {
+      if (not Equals(name, rule.Name)) continue;
+      if (equals == std::basic_string_view<Char>::npos)
+        return ArgumentError{ParseCommandLineError::ParseFailed, index, argument.size(), "=<number>"};
+      auto at    = equals + 1;
+      auto value = Digits(argument, at, rule.Max);
+      if (not value or at != argument.size() or *value < rule.Min)
+        return ArgumentError{ParseCommandLineError::ParseFailed, index, equals + 1, "a number in the option's range"};
+      out.Options[static_cast<std::size_t>(rule.Option)] = *value;
+      return std::nullopt;
+    }
+    return ArgumentError{
+      ParseCommandLineError::ParseFailed, index, 2, "an option: --timeout=<seconds> or --probe=<milliseconds>"};
+  }
+}// namespace Detail
+
+/**
+ * One pass over `argv` (the program first) along CommandActions and CommandOptions, for narrow and wide arguments
+ * alike and without converting either: `<action> [<keys>] <target>...` with `--<option>=<number>` anywhere after the
+ * program. Numbers and capacities are decoded on the way, everything else stays a view into argv.
+ * The first argument that does not fit ends the parse with its position, nothing is allocated either way.
+ */
+template<typename Char, typename Argument>
+constexpr auto ParseArgv(std::span<const Argument> argv, ParsedArguments<Char> &out) -> std::optional<ArgumentError>
+{
+  using View           = std::basic_string_view<Char>;
+  out                  = ParsedArguments<Char>();
+  auto shape           = TargetShape::None;
+  auto position        = std::size_t(0);
+  auto keysPending     = false;
+  const auto actions   = std::string_view("mount, unmount, index, watch, unlock or verify-audit");
+  const auto &expected = [](TargetShape shapes) -> std::string_view {
+    if (shapes == (TargetShape::Numbered | TargetShape::Volume))
+      return "<disk>:<capacity>:<unit> or <disk id>@<partition offset>";
+    if (shapes == TargetShape::Volume) return "<disk id>@<partition offset>";
+    if (shapes == TargetShape::Mount) return "a drive letter or an absolute folder";
+    return "no further argument";
+  };
+
+  for (std::size_t index = 1; index < argv.size(); ++index) {
+    const auto argument = View(argv[index]);
+    if (argument.size() > 2 and argument[0] == Char('-') and argument[1] == Char('-')) {
+      if (auto error = Detail::OptionArgument(argument, index, out)) return error;
+      continue;
+    }
+
+    if (not out.Rule) {
+      for (const auto &rule : CommandActions)
+        if (Detail::Equals(argument, rule.Name)) out.Rule = &rule;
+      if (not out.Rule) return ArgumentError{ParseCommandLineError::UnknownAction, index, 0, actions};
+      keysPending = out.Rule->LeadingKeys;
+      continue;
+    }
+    if (keysPending) {
+      if (argument.empty()) return ArgumentError{ParseCommandLineError::ParseFailed, index, 0, "a key source"};
+      out.Keys    = argument;
+      keysPending = false;
+      continue;
+    }
+
+    const auto shapes = out.Rule->Shapes;
+    if (position == 0) {
+      // `@` never appears in a numbered target and a mount never starts with a digit
+      auto next = TargetShape::None;
+      if (Allows(shapes, TargetShape::Volume) and Detail::Find(argument, '@') != View::npos) {
+        next = TargetShape::Volume;
+      } else if (Allows(shapes, TargetShape::Numbered) and not argument.empty() and Detail::IsDigit(argument[0])) {
+        next = TargetShape::Numbered;
+      } else if (Allows(shapes, TargetShape::Mount)) {
+        next = TargetShape::Mount;
+      }
+      if (next == TargetShape::None)
+        return ArgumentError{ParseCommandLineError::ParseFailed, index, 0, expected(shapes)};
+      if (shape != TargetShape::None and next != shape)
+        return ArgumentError{ParseCommandLineError::ParseFailed, index, 0, expected(shape)};
+      if (out.TargetCount == ParsedArguments<Char>::MaxTargets)
+        return ArgumentError{ParseCommandLineError::ParseFailed, index, 0, "at most 64 targets"};
+      shape                              = next;
+      out.Targets[out.TargetCount]       = ParsedTarget<Char>();
+      out.Targets[out.TargetCount].Shape = shape;
+    }
+
+    auto &target = out.Targets[out.TargetCount];
+    auto error   = std::optional<ArgumentError>();
+    if (position + 1 == Detail::ShapeLength(shape)) {
+      error                = Detail::MountPointArgument(argument, index, out.Rule->Automatic);
+      target.Mount         = argument;
+      target.MountArgument = index;
+    } else if (shape == TargetShape::Volume) {
+      error = Detail::VolumeArgument(argument, index, target);
+    } else if (position == 0) {
+      error = Detail::NumberedArgument(argument, index, target.DiskNumber, target.DiskCapacity);
+    } else {
+      error = Detail::NumberedArgument(argument, index, target.PartitionNumber, target.PartitionCapacity);
+    }
+    if (error) return error;
+    if (++position == Detail::ShapeLength(shape)) {
+      ++out.TargetCount;
+      position = 0;
+    }
+  }
+
+  const auto end = argv.size();
+  if (not out.Rule) return ArgumentError{ParseCommandLineError::UnknownAction, end, 0, actions};
+  if (keysPending) return ArgumentError{ParseCommandLineError::ParseFailed, end, 0, "a key source"};
+  if (position != 0) {
+    if (shape == TargetShape::Numbered and position == 1)
+      return ArgumentError{ParseCommandLineError::ParseFailed, end, 0, "<partition>:<capacity>:<unit>"};
+    return ArgumentError{
+      ParseCommandLineError::ParseFailed,
+      end,
+      0,
+      out.Rule->Automatic ? "a drive letter, an absolute folder or `*`" : "a drive letter or an absolute folder"};
+  }
+  if (out.TargetCount < out.Rule->MinTargets)
+    return ArgumentError{ParseCommandLineError::ParseFailed, end, 0, expected(out.Rule->Shapes)};
+  return std::nullopt;
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#ifdef _WIN32
 #ifndef NOMINMAX
 #define NOMINMAX
 #endif
@@ -9,10 +10,16 @@
 
 #include <Shlobj.h>
 #include <shellapi.h>
+#endif
 
 #include <string_view>
 
 namespace Blt {
+constexpr auto toCompatView(std::u8string_view view) -> std::string_view
+{
+  return std::string_view(reinterpret_cast<const char *>(view.data()), view.size());
+}
+
 constexpr auto toCompatView(auto capture) -> std::string_view
 {
   auto view          = capture.to_view();
@@ -0,0 +1,353 @@
+#include "DeviceWatch.hpp"
+
+#include <fmt/format.h>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#include "Common.hpp"
+#include "Log.hpp"
+
+#ifdef __linux__
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+#include <linux/netlink.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#include <boost/asio/post.hpp>
+
+#include <cfgmgr32.h>
+#include <winioctl.h>
+#endif
+
+namespace Blt {
+
+namespace asio = boost::asio;
+
+namespace {
+#ifdef __linux__
+  /**
+   * Kernel name of the block device a uevent announces, empty for anything else.
+   * A uevent is "add@/devices/...\0ACTION=add\0SUBSYSTEM=block\0DEVNAME=sdb\0...", attaching a loop device or
+   * inserting media into a card reader only produces a change event for a node that already existed.
+   */
+  auto ueventBlockDevice(std::string_view message) -> std::string_view
+  {
+    auto action    = std::string_view();
+    auto subsystem = std::string_view();
+    auto name      = std::string_view();
+    for (auto begin = message.find('\0'); begin < message.size();) {
+      const auto end   = std::min(message.find('\0', begin + 1), message.size());
+      const auto field = message.substr(begin + 1, end - begin - 1);
+      if (field.starts_with("ACTION=")) action = field.substr(7);
+      if (field.starts_with("SUBSYSTEM=")) subsystem = field.substr(10);
+      if (field.starts_with("DEVNAME=")) name = field.substr(8);
+      begin = end;
+    }
+    if (subsystem != "block" or (action != "add" and action != "change")) return {};
+    return name;
+  }
+
+  // Kernel names of every block device there is, what a watch that lost events has to look at again
+  auto blockDevices() -> std::vector<std::string>
+  {
+    auto ec      = std::error_code();
+    auto devices = std::vector<std::string>();
+    for (const auto &entry : std::filesystem::directory_iterator("/sys/class/block", ec))
+      devices.push_back(entry.path().filename().string());
+    return devices;
+  }
+#endif
+
+#ifdef _WIN32
+  // GUID_DEVINTERFACE_DISK, spelled out so this file does not depend on where initguid.h lands in the include order
+  constexpr GUID diskInterface = {0x53f56307, 0xb6bf, 0x11d0, {0x94, 0xf2, 0x00, 0xa0, 0xc9, 0x1e, 0xfb, 0x8b}};
+
+  struct NotificationContext
+  {
+    DeviceWatch *Watch;
+    asio::any_io_executor Executor;
+  };
+
+  // Runs on a system thread pool thread, the device is handed over to the watch's executor
+  DWORD CALLBACK onDeviceNotification(
+    HCMNOTIFICATION, PVOID context, CM_NOTIFY_ACTION action, PCM_NOTIFY_EVENT_DATA data, DWORD)
+  {
+    if (action != CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL) return ERROR_SUCCESS;
+
+    const auto *link = data->u.DeviceInterface.SymbolicLink;
+    const auto size  = WideCharToMultiByte(CP_UTF8, 0, link, -1, nullptr, 0, nullptr, nullptr);
+    if (size <= 1) return ERROR_SUCCESS;
+    auto device = std::string(static_cast<std::size_t>(size - 1), '\0');
+    WideCharToMultiByte(CP_UTF8, 0, link, -1, device.data(), size, nullptr, nullptr);
+
+    auto *notification = static_cast<NotificationContext *>(context);
+    asio::post(notification->Executor, [watch = notification->Watch, device = std::move(device)]() mutable {
+      watch->Notify(std::move(device));
+    });
+    return ERROR_SUCCESS;
+  }
+#endif
+}// namespace
+
+DeviceWatch::DeviceWatch(asio::any_io_executor executor, std::chrono::milliseconds settle)
+  : executor_(std::move(executor))
+  , settle_(settle)
+  , drained_(executor_, asio::steady_timer::time_point::max())
+{}
+
+auto DeviceWatch::Run(SettledHandler onSettled) -> asio::awaitable<void>
+{
+  onSettled_ = std::move(onSettled);
+  co_await listen();
+}
+
+void DeviceWatch::Notify(std::string device)
+{
+  if (draining_) return;
+  auto [entry, _] = pending_.try_emplace(device, asio::steady_timer(executor_));
+  auto &pending   = entry->second;
+  if (pending.InFlight) {
+    pending.Dirty = true;
+    return;
+  }
+
+  // restarting the timer aborts the previous wait, only the newest event of a burst reaches the handler
+  pending.Settle.expires_after(settle_);
+  ++active_;
+  asio::co_spawn(executor_, settle(std::move(device), ++pending.Generation), asio::detached);
+}
+
+auto DeviceWatch::Drain() -> asio::awaitable<void>
+{
+  draining_ = true;
+  for (auto &[_, pending] : pending_) pending.Settle.cancel();
+  if (active_ > 0) co_await drained_.async_wait(asio::as_tuple(asio::use_awaitable));
+}
+
+auto DeviceWatch::settle(std::string device, uint64_t generation) -> asio::awaitable<void>
+{
+  blt_defer {
+    if (--active_ == 0 and draining_) drained_.cancel();
+  };
+  auto &pending = pending_.at(device);
+  if (auto [ec] = co_await pending.Settle.async_wait(asio::as_tuple(asio::use_awaitable));
+      ec or generation != pending.Generation)
+    co_return;
+
+  pending.InFlight = true;
+  blt_defer {
+    pending.InFlight = false;
+  };
+  while (true) {
+    pending.Dirty = false;
+    co_await onSettled_(device);
+    if (not pending.Dirty or draining_) break;
+
+    pending.Settle.expires_after(settle_);
+    // Drain cancels the wait, the events that came in meanwhile are dropped with it
+    if (auto [ec] = co_await pending.Settle.async_wait(asio::as_tuple(asio::use_awaitable)); ec or draining_) break;
+  }
+}
+
+#ifdef __linux__
+auto DeviceWatch::listen() -> asio::awaitable<void>
+{
+  alignas(inotify_event) std::array<char, 8192> buffer;
+
+  if (auto fd = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT); fd >= 0) {
+    auto address = sockaddr_nl{.nl_family = AF_NETLINK, .nl_pad = 0, .nl_pid = 0, .nl_groups = 1};
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) {
+      auto uevents = asio::posix::stream_descriptor(executor_, fd);
+      while (true) {
+        auto [ec, size] = co_await uevents.async_read_some(asio::buffer(buffer), asio::as_tuple(asio::use_awaitable));
+        // Run was cancelled, not a failure of the socket
+        if (ec == asio::error::operation_aborted) co_return;
+        // a burst of uevents (a hub with its disks) overflowed the socket's buffer, the socket itself still works
+        if (ec == asio::error::no_buffer_space) {
+          Log(LogLevel::Warning, "uevents were lost, looking at every block device again");
+          for (auto &device : blockDevices()) Notify(std::move(device));
+          continue;
+        }
+        if (ec == asio::error::eof or ec == asio::error::bad_descriptor) {
+          Log(LogLevel::Error, "uevent socket: {}", ec.message());
+          co_return;
+        }
+        if (ec) {
+          Log(LogLevel::Warning, "uevent socket: {}", ec.message());
+          continue;
+        }
+        if (auto device = ueventBlockDevice(std::string_view(buffer.data(), size)); not device.empty())
+          Notify(std::string(device));
+      }
+    }
+    ::close(fd);
+  }
+
+  // no uevent socket in this network namespace, /dev is devtmpfs and still reports new nodes through inotify
+  auto fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) co_return;
+  auto nodes = asio::posix::stream_descriptor(executor_, fd);
+  if (::inotify_add_watch(fd, "/dev", IN_CREATE | IN_ATTRIB) < 0) {
+    Log(LogLevel::Error, "unable to watch /dev");
+    co_return;
+  }
+  while (true) {
+    auto [ec, size] = co_await nodes.async_read_some(asio::buffer(buffer), asio::as_tuple(asio::use_awaitable));
+    if (ec == asio::error::operation_aborted) co_return;
+    if (ec == asio::error::eof or ec == asio::error::bad_descriptor) {
+      Log(LogLevel::Error, "inotify: {}", ec.message());
+      co_return;
+    }
+    if (ec) {
+      Log(LogLevel::Warning, "inotify: {}", ec.message());
+      continue;
+    }
+    for (std::size_t offset = 0; offset + sizeof(inotify_event) <= size;) {
+      const auto *event = reinterpret_cast<const inotify_event *>(buffer.data() + offset);
+      offset += sizeof(inotify_event) + event->len;
+      // the queue overflowed and the kernel dropped events, like a uevent socket that ran out of buffer
+      if (event->mask & IN_Q_OVERFLOW) {
+        Log(LogLevel::Warning, "inotify events were lost, looking at every block device again");
+        for (auto &device : blockDevices()) Notify(std::move(device));
+        continue;
+      }
+      if (event->len == 0) continue;
+
+      auto device = std::string(event->name);
+      if (auto ignored = std::error_code(); std::filesystem::exists("/sys/class/block/" + device, ignored))
+        Notify(std::move(device));
+    }
+  }
+}
+
+auto ProbeDevice(std::string_view device) -> VolumeIndex
+{
+  return BuildVolumeIndexFromSysfs("/sys/block", device);
+}
+#elif defined(_WIN32)
+auto DeviceWatch::listen() -> asio::awaitable<void>
+{
+  auto context = NotificationContext{.Watch = this, .Executor = executor_};
+  auto filter  = CM_NOTIFY_FILTER{};
+
+  filter.cbSize                      = sizeof(filter);
+  filter.FilterType                  = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+  filter.u.DeviceInterface.ClassGuid = diskInterface;
+
+  HCMNOTIFICATION notification = nullptr;
+  if (auto result = CM_Register_Notification(&filter, &context, onDeviceNotification, &notification);
+      result != CR_SUCCESS) {
+    Log(LogLevel::Error, "unable to register for disk arrival: {}", result);
+    co_return;
+  }
+  // waits for callbacks that are still running, so nothing touches `context` after this
+  blt_defer {
+    CM_Unregister_Notification(notification);
+  };
+
+  auto idle = asio::steady_timer(executor_, asio::steady_timer::time_point::max());
+  co_await idle.async_wait(asio::as_tuple(asio::use_awaitable));
+}
+
+auto ProbeDevice(std::string_view device) -> VolumeIndex
+{
+  auto index = VolumeIndex();
+
+  auto path = std::wstring(device.size(), L'\0');
+  path.resize(static_cast<std::size_t>(MultiByteToWideChar(
+    CP_UTF8, 0, device.data(), static_cast<int>(device.size()), path.data(), static_cast<int>(path.size()))));
+  auto disk = CreateFileW(
+    path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+  if (disk == INVALID_HANDLE_VALUE) return index;
+  blt_defer {
+    CloseHandle(disk);
+  };
+
+  DWORD returned = 0;
+  auto number    = STORAGE_DEVICE_NUMBER{};
+  auto length    = GET_LENGTH_INFORMATION{};
+  if (
+    not DeviceIoControl(disk, IOCTL_STORAGE_GET_DEVICE_NUMBER, nullptr, 0, &number, sizeof(number), &returned, nullptr)
+    or not DeviceIoControl(disk, IOCTL_DISK_GET_LENGTH_INFO, nullptr, 0, &length, sizeof(length), &returned, nullptr))
+    return index;
+
+  // room for 128 entries, the size of a default GPT partition array
+  alignas(DRIVE_LAYOUT_INFORMATION_EX)
+    std::array<std::byte, sizeof(DRIVE_LAYOUT_INFORMATION_EX) + 127 * sizeof(PARTITION_INFORMATION_EX)> storage;
+  if (not DeviceIoControl(
+        disk,
+        IOCTL_DISK_GET_DRIVE_LAYOUT_EX,
+        nullptr,
+        0,
+        storage.data(),
+        static_cast<DWORD>(storage.size()),
+        &returned,
+        nullptr))
+    return index;
+  const auto *layout = reinterpret_cast<const DRIVE_LAYOUT_INFORMATION_EX *>(storage.data());
+
+  // spelled the way `detail disk` prints it, see NormalizeDiskId
+  auto diskId = std::string();
+  if (layout->PartitionStyle == PARTITION_STYLE_GPT) {
+    const auto &guid = layout->Gpt.DiskId;
+    diskId           = fmt::format(
+      "{:08X}-{:04X}-{:04X}-{:02X}{:02X}-{:02X}{:02X}{:02X}{:02X}{:02X}{:02X}",
+      guid.Data1,
+      guid.Data2,
+      guid.Data3,
+      guid.Data4[0],
+      guid.Data4[1],
+      guid.Data4[2],
+      guid.Data4[3],
+      guid.Data4[4],
+      guid.Data4[5],
+      guid.Data4[6],
+      guid.Data4[7]);
+  } else if (layout->PartitionStyle == PARTITION_STYLE_MBR) {
+    diskId = fmt::format("{:08X}", layout->Mbr.Signature);
+  } else {
+    return index;
+  }
+
+  for (DWORD entry = 0; entry < layout->PartitionCount; ++entry) {
+    const auto &partition = layout->PartitionEntry[entry];
+    // MBR layouts pad the table with unused entries numbered 0
+    if (partition.PartitionNumber == 0) continue;
+
+    index.Insert(
+      VolumeKey{.DiskId = diskId, .PartitionOffset = static_cast<uint64_t>(partition.StartingOffset.QuadPart)},
+      VolumeLocation{
+        .DiskNumber        = static_cast<int>(number.DeviceNumber),
+        .DiskCapacity      = CapacityBytes(static_cast<uint64_t>(length.Length.QuadPart)),
+        .PartitionNumber   = static_cast<int>(partition.PartitionNumber),
+        .PartitionCapacity = CapacityBytes(static_cast<uint64_t>(partition.PartitionLength.QuadPart)),
+      });
+  }
+  return index;
+}
+#else
+auto DeviceWatch::listen() -> asio::awaitable<void>
+{
+  Log(LogLevel::Warning, "device arrival notifications are not supported on this platform");
+  co_return;
+}
+
+auto ProbeDevice(std::string_view) -> VolumeIndex { return {}; }
+#endif
+
+}// namespace Blt
\ No newline at end of file
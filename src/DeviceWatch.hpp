@@ -0,0 +1,71 @@
+#pragma once
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "VolumeIndex.hpp"
+
+namespace Blt {
+
+/**
+ * Reports block devices as they appear, without polling: kernel uevents (inotify on /dev when the uevent socket is
+ * unavailable) on Linux, CM_Register_Notification for disk interfaces on Windows.
+ * Events for one device are debounced, a partition table scan easily produces a handful of them, and the handler
+ * never runs twice at the same time for the same device. Events that land while it runs schedule one more pass.
+ */
+class DeviceWatch
+{
+public:
+  // `device` is the kernel name on Linux (sdb, loop0p1) and the interface path on Windows
+  using SettledHandler = std::function<boost::asio::awaitable<void>(std::string device)>;
+
+  explicit DeviceWatch(
+    boost::asio::any_io_executor executor, std::chrono::milliseconds settle = std::chrono::milliseconds(750));
+
+  DeviceWatch(const DeviceWatch &)            = delete;
+  DeviceWatch &operator=(const DeviceWatch &) = delete;
+
+  // Runs until cancelled or the event source is closed, events the kernel dropped make every block device settle again
+  auto Run(SettledHandler onSettled) -> boost::asio::awaitable<void>;
+
+  // Entry point for event sources, must be called on the watch's executor
+  void Notify(std::string device);
+
+  // After Run was cancelled: drops pending devices and waits for the handlers still running, then the watch may go
+  auto Drain() -> boost::asio::awaitable<void>;
+
+private:
+  struct PendingDevice
+  {
+    boost::asio::steady_timer Settle;
+    uint64_t Generation = 0;
+    bool InFlight       = false;
+    bool Dirty          = false;
+  };
+
+  auto settle(std::string device, uint64_t generation) -> boost::asio::awaitable<void>;
+  auto listen() -> boost::asio::awaitable<void>;
+
+  boost::asio::any_io_executor executor_;
+  std::chrono::milliseconds settle_;
+  SettledHandler onSettled_;
+  std::unordered_map<std::string, PendingDevice> pending_;
+  // settle coroutines alive, each holds a reference into pending_
+  std::size_t active_ = 0;
+  bool draining_      = false;
+  boost::asio::steady_timer drained_;
+};
+
+// Identities of the volumes on the disk `device` belongs to, read straight from the OS without diskpart
+auto ProbeDevice(std::string_view device) -> VolumeIndex;
+
+}// namespace Blt
\ No newline at end of file
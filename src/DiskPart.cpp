@@ -4,142 +4,138 @@
 #include <boost/asio.hpp>
 #include <boost/asio/as_tuple.hpp>
 #include <boost/asio/use_awaitable.hpp>
-#include <ctre-unicode.hpp>
+
+#include <cassert>
+#include <charconv>
 
 #include "Common.hpp"
+#include "DiskPartLocale.hpp"
+#include "Log.hpp"
 #include "Unit.hpp"
+#include "VolumeIndex.hpp"
 
 namespace Blt {
 
 namespace asio = boost::asio;
 
-auto ReadComputerName(std::u8string &buffer, asio::readable_pipe &diskpartOut) -> asio::awaitable<DiskPartError>
+namespace {
+  auto readResponse(DiskPartSession &session, asio::readable_pipe &diskpartOut) -> asio::awaitable<DiskPartError>
+  {
+    auto [ec, size] = co_await asio::async_read_until(
+      diskpartOut,
+      asio::dynamic_buffer(session.Buffer(), DiskPartSession::MaxResponseBytes),
+      "DISKPART>",
+      asio::as_tuple(asio::use_awaitable));
+    if (ec != boost::system::errc::success) {
+      Log(LogLevel::Error, session.Fields, "{}", ec.what());
+      co_return DiskPartError::IO;
+    }
+    co_return DiskPartError::Success;
+  }
+}// namespace
+
+auto ReadComputerName(DiskPartSession &session, asio::readable_pipe &diskpartOut) -> asio::awaitable<DiskPartError>
 {
+  auto &buffer = session.Buffer();
+
   auto [ec, size] = co_await asio::async_read_until(
     diskpartOut, asio::dynamic_buffer(buffer, 1024), "DISKPART>", asio::as_tuple(asio::use_awaitable));
   if (ec == boost::system::errc::success) {
-    auto [_, computerName] = ctre::search<"On computer: (.*?)\r\n">(buffer);
-    fmt::println("Computer: {}", toCompatView(computerName));
+    auto scan      = ResponseScan(buffer);
+    session.Locale = scan.Locale();
+    Log(
+      LogLevel::Info,
+      session.Fields,
+      "Computer: {} ({})",
+      toCompatView(scan.LineAfter(DiskPartResponse::Banner)),
+      ToString(session.Locale));
     co_return DiskPartError::Success;
   } else {
-    fmt::println("{}", ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
     co_return DiskPartError::IO;
   }
 }
 
-auto ListDisk(std::u8string &buffer, asio::writable_pipe &diskpartIn) -> asio::awaitable<DiskPartError>
+auto ListDisk(DiskPartSession &session, asio::writable_pipe &diskpartIn) -> asio::awaitable<DiskPartError>
 {
   auto [ec, size] =
     co_await asio::async_write(diskpartIn, asio::buffer("list disk"), asio::as_tuple(asio::use_awaitable));
   if (ec == boost::system::errc::success) {
-    fmt::println("listing disk");
+    Log(LogLevel::Info, session.Fields, "listing disk");
     co_return DiskPartError::Success;
   } else {
-    fmt::println("{}", ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
     co_return DiskPartError::IO;
   }
 }
 
 auto ReadListDisk(
-  std::u8string &buffer, asio::readable_pipe &diskpartOut, int desireDiskNumber, CapacityBytes desireDiskCapacity)
+  DiskPartSession &session, asio::readable_pipe &diskpartOut, int desireDiskNumber, CapacityBytes desireDiskCapacity)
   -> asio::awaitable<DiskPartError>
 {
+  auto &buffer = session.Buffer();
+
   if (auto [read_ec, size] = co_await asio::async_read_until(
         diskpartOut, asio::dynamic_buffer(buffer, 1024), "DISKPART>", asio::as_tuple(asio::use_awaitable));
       read_ec != boost::system::errc::success) {
-    fmt::println("{}", read_ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", read_ec.what());
     co_return DiskPartError::IO;
   }
 
-  // should we assume GiB or should we parse this
-  auto diskRange = ctre::multiline_search_all<"Disk\\h+(\\d+)\\h+.+?\\h+(\\d+)\\h(.+?)\\h+.+">(buffer);
   auto foundDisk = false;
-  for (auto disk : diskRange) {
-    int diskNumber;
-    {
-      auto compatView = toCompatView(disk.get<1>());
-      if (auto [_, convert_ec] =
-            std::from_chars(compatView.data(), compatView.data() + compatView.size(), diskNumber, 10);
-          convert_ec != std::error_code()) {
-        // assert(false && "unable to parse diskpart output for diskNumber");
-        co_return DiskPartError::ParseFailed;
-      }
-    }
-
-    int diskCapacityValue;
-    {
-      auto compatView = toCompatView(disk.get<2>());
-      if (auto [_, ec] =
-            std::from_chars(compatView.data(), compatView.data() + compatView.size(), diskCapacityValue, 10);
-          ec != std::error_code()) {
-        // assert(false && "unable to parse diskpart output for diskNumber");
-        co_return DiskPartError::ParseFailed;
-      }
-    }
-
-    CapacityBytes diskCapacity;
-    {
-      auto capacityStr = toCompatView(disk.get<3>());
-      if (capacityStr == "KB") {
-        diskCapacity = capacityCast<CapacityBytes>(Kibibytes(diskCapacityValue));
-      } else if (capacityStr == "MB") {
-        diskCapacity = capacityCast<CapacityBytes>(Mebibytes(diskCapacityValue));
-      } else if (capacityStr == "GB") {
-        diskCapacity = capacityCast<CapacityBytes>(Gibibytes(diskCapacityValue));
-      } else {
-        co_return DiskPartError::ParseFailed;
-      }
-    }
+  if (not ForEachListRow(buffer, [&](ListRow disk) {
+        if (disk.Number == desireDiskNumber and disk.Capacity == desireDiskCapacity) {
+          Log(LogLevel::Info, session.Fields, "Found desire disk: #{}", disk.Number);
+          foundDisk = true;
+        }
+      }))
+    co_return DiskPartError::ParseFailed;
 
-    if (diskNumber == desireDiskNumber and diskCapacity == desireDiskCapacity) {
-      fmt::println("Found desire disk: #{}", diskNumber);
-      foundDisk = true;
-    }
-  }
   if (not foundDisk) {
     // assert(false);
+    if (ResponseScan(buffer).IsServiceBusy()) co_return DiskPartError::ServiceBusy;
     co_return DiskPartError::MismatchDisk;
   }
   co_return DiskPartError::Success;
 }
 
-auto SelectDisk(std::u8string &buffer, asio::writable_pipe &diskpartIn, int desireDiskNumber)
+auto SelectDisk(DiskPartSession &session, asio::writable_pipe &diskpartIn, int desireDiskNumber)
   -> asio::awaitable<DiskPartError>
 {
+  auto &buffer = session.Buffer();
+
   fmt::format_to(std::back_inserter(buffer), "select disk {}\n", desireDiskNumber);
   auto [ec, size] = co_await asio::async_write(diskpartIn, asio::buffer(buffer), asio::as_tuple(asio::use_awaitable));
   if (ec == boost::system::errc::success) {
-    fmt::println("selecting disk #{}", desireDiskNumber);
+    Log(LogLevel::Info, session.Fields, "selecting disk #{}", desireDiskNumber);
     co_return DiskPartError::Success;
   } else {
-    fmt::println("{}", ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
     co_return DiskPartError::IO;
   }
 }
 
-auto ReadSelectDisk(std::u8string &buffer, asio::readable_pipe &diskpartOut, int desireDiskNumber)
+auto ReadSelectDisk(DiskPartSession &session, asio::readable_pipe &diskpartOut, int desireDiskNumber)
   -> asio::awaitable<DiskPartError>
 {
+  auto &buffer = session.Buffer();
+
   if (auto [read_ec, size] = co_await asio::async_read_until(
         diskpartOut, asio::dynamic_buffer(buffer, 1024), "DISKPART>", asio::as_tuple(asio::use_awaitable));
       read_ec != boost::system::errc::success) {
-    fmt::println("{}", read_ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", read_ec.what());
     co_return DiskPartError::IO;
   }
 
-  auto [_, diskNumberCapture] = ctre::search<"Disk (\\d+) is now the selected disk.\r\n">(buffer);
-  int diskNumber;
-  {
-    auto compatView = toCompatView(diskNumberCapture);
-
-    if (auto [_, ec] = std::from_chars(compatView.data(), compatView.data() + compatView.size(), diskNumber, 10);
-        ec != std::error_code()) {
-      // assert(false && "unable to parse diskpart output for diskNumber");
-      co_return DiskPartError::ParseFailed;
-    }
+  auto scan       = ResponseScan(buffer);
+  auto diskNumber = scan.NumberBefore(DiskPartResponse::DiskSelected);
+  if (not diskNumber) diskNumber = scan.NumberBefore(DiskPartResponse::Selected);
+  if (not diskNumber) {
+    // assert(false && "unable to parse diskpart output for diskNumber");
+    co_return scan.IsServiceBusy() ? DiskPartError::ServiceBusy : DiskPartError::ParseFailed;
   }
-  if (diskNumber == desireDiskNumber) {
-    fmt::println("disk #{} selected", diskNumber);
+  if (*diskNumber == desireDiskNumber) {
+    Log(LogLevel::Info, session.Fields, "disk #{} selected", *diskNumber);
     co_return DiskPartError::Success;
   } else {
     // assert(false && "selected disk is different from desired disk");
@@ -147,118 +143,89 @@ auto ReadSelectDisk(std::u8string &buffer, asio::readable_pipe &diskpartOut, int
   }
 }
 
-auto ListPartition(std::u8string &buffer, asio::writable_pipe &diskpartIn) -> asio::awaitable<DiskPartError>
+auto ListPartition(DiskPartSession &session, asio::writable_pipe &diskpartIn) -> asio::awaitable<DiskPartError>
 {
   auto [ec, size] =
     co_await asio::async_write(diskpartIn, asio::buffer("list partition"), asio::as_tuple(asio::use_awaitable));
   if (ec == boost::system::errc::success) {
-    fmt::println("listing partition");
+    Log(LogLevel::Info, session.Fields, "listing partition");
     co_return DiskPartError::Success;
   } else {
-    fmt::println("{}", ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
     co_return DiskPartError::IO;
   }
 }
 
 auto ReadListPartition(
-  std::u8string &buffer,
+  DiskPartSession &session,
   asio::readable_pipe &diskpartOut,
   int desirePartitionNumber,
   CapacityBytes desirePartitionCapacity) -> asio::awaitable<DiskPartError>
 {
+  auto &buffer = session.Buffer();
+
   if (auto [read_ec, size] = co_await asio::async_read_until(
         diskpartOut, asio::dynamic_buffer(buffer, 1024 * 2), "DISKPART>", asio::as_tuple(asio::use_awaitable));
       read_ec != boost::system::errc::success) {
-    fmt::println("{}", read_ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", read_ec.what());
     co_return DiskPartError::IO;
   }
 
-  // should we assume GiB or should we parse this
-  auto partitionRange = ctre::multiline_search_all<"Partition\\h+(\\d+)\\h+.+?\\h+(\\d+)\\h(.+?)\\h+.+">(buffer);
   auto foundPartition = false;
-  for (auto partition : partitionRange) {
-    int partitionNumber;
-    {
-      auto compatView = toCompatView(partition.get<1>());
-      if (auto [_, ec] = std::from_chars(compatView.data(), compatView.data() + compatView.size(), partitionNumber, 10);
-          ec != std::error_code()) {
-        // assert(false && "unable to parse partitionpart output for partitionNumber");
-        co_return DiskPartError::ParseFailed;
-      }
-    }
-
-    int partitionCapacityValue;
-    {
-      auto compatView = toCompatView(partition.get<2>());
-      auto [_, ec] =
-        std::from_chars(compatView.data(), compatView.data() + compatView.size(), partitionCapacityValue, 10);
-      if (ec != std::error_code()) {
-        // assert(false && "unable to parse partitionpart output for partitionNumber");
-        co_return DiskPartError::ParseFailed;
-      }
-    }
+  if (not ForEachListRow(buffer, [&](ListRow partition) {
+        if (not foundPartition and partition.Number == desirePartitionNumber
+            and partition.Capacity == desirePartitionCapacity) {
+          Log(LogLevel::Info, session.Fields, "found desired partition #{}", partition.Number);
+          foundPartition = true;
+        }
+      }))
+    co_return DiskPartError::ParseFailed;
 
-    CapacityBytes partitionCapacity;
-    {
-      auto capacityStr = toCompatView(partition.get<3>());
-      if (capacityStr == "KB") {
-        partitionCapacity = capacityCast<CapacityBytes>(Kibibytes(partitionCapacityValue));
-      } else if (capacityStr == "MB") {
-        partitionCapacity = capacityCast<CapacityBytes>(Mebibytes(partitionCapacityValue));
-      } else if (capacityStr == "GB") {
-        partitionCapacity = capacityCast<CapacityBytes>(Gibibytes(partitionCapacityValue));
-      } else {
-        co_return DiskPartError::ParseFailed;
-      }
-    }
-    if (desirePartitionNumber == partitionNumber and desirePartitionCapacity == partitionCapacity) {
-      fmt::println("found desired partition #{}", partitionNumber);
-      foundPartition = true;
-      co_return DiskPartError::Success;
-    }
-  }
   if (not foundPartition) {
+    if (ResponseScan(buffer).IsServiceBusy()) co_return DiskPartError::ServiceBusy;
     assert(false);
     co_return DiskPartError::MismatchPartition;
   }
+  co_return DiskPartError::Success;
 }
 
-auto SelectPartition(std::u8string &buffer, asio::writable_pipe &diskpartIn, int desirePartitionNumber)
+auto SelectPartition(DiskPartSession &session, asio::writable_pipe &diskpartIn, int desirePartitionNumber)
   -> asio::awaitable<DiskPartError>
 {
+  auto &buffer = session.Buffer();
+
   fmt::format_to(std::back_inserter(buffer), "select partition {}\n", desirePartitionNumber);
   auto [ec, size] = co_await asio::async_write(diskpartIn, asio::buffer(buffer), asio::as_tuple(asio::use_awaitable));
   if (ec == boost::system::errc::success) {
-    fmt::println("selecting partition #{}", desirePartitionNumber);
+    Log(LogLevel::Info, session.Fields, "selecting partition #{}", desirePartitionNumber);
     co_return DiskPartError::Success;
   } else {
-    fmt::println("{}", ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
     co_return DiskPartError::IO;
   }
 }
 
-auto ReadSelectPartition(std::u8string &buffer, asio::readable_pipe &diskpartOut, int desirePartitionNumber)
+auto ReadSelectPartition(DiskPartSession &session, asio::readable_pipe &diskpartOut, int desirePartitionNumber)
   -> asio::awaitable<DiskPartError>
 {
+  auto &buffer = session.Buffer();
+
   if (auto [read_ec, size] = co_await asio::async_read_until(
         diskpartOut, asio::dynamic_buffer(buffer, 1024 * 5), "DISKPART>", asio::as_tuple(asio::use_awaitable));
       read_ec != boost::system::errc::success) {
-    fmt::println("{}", read_ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", read_ec.what());
     co_return DiskPartError::IO;
   }
 
-  auto [_, selectedPartitionCapture] = ctre::search<"Partition (\\d+) is now the selected partition">(buffer);
-  int partitionNumber;
-  {
-    auto compatView = toCompatView(selectedPartitionCapture);
-    if (auto [_, ec] = std::from_chars(compatView.data(), compatView.data() + compatView.size(), partitionNumber, 10);
-        ec != std::error_code()) {
-      // assert(false && "unable to parse diskpart output for selected partition number");
-      co_return DiskPartError::ParseFailed;
-    }
+  auto scan            = ResponseScan(buffer);
+  auto partitionNumber = scan.NumberBefore(DiskPartResponse::PartitionSelected);
+  if (not partitionNumber) partitionNumber = scan.NumberBefore(DiskPartResponse::Selected);
+  if (not partitionNumber) {
+    // assert(false && "unable to parse diskpart output for selected partition number");
+    co_return scan.IsServiceBusy() ? DiskPartError::ServiceBusy : DiskPartError::ParseFailed;
   }
-  if (partitionNumber == desirePartitionNumber) {
-    fmt::println("partition #{} selected", partitionNumber);
+  if (*partitionNumber == desirePartitionNumber) {
+    Log(LogLevel::Info, session.Fields, "partition #{} selected", *partitionNumber);
     co_return DiskPartError::Success;
   } else {
     // assert(false && "unspected diskpart select undesirable partion number");
@@ -266,80 +233,208 @@ auto ReadSelectPartition(std::u8string &buffer, asio::readable_pipe &diskpartOut
   }
 }
 
-auto AssignLetter(std::u8string &buffer, asio::writable_pipe &diskpartIn, char assignLetter)
+auto SelectVolume(DiskPartSession &session, asio::writable_pipe &diskpartIn, const MountPoint &mount)
+  -> asio::awaitable<DiskPartError>
+{
+  auto &buffer = session.Buffer();
+
+  if (mount.IsFolder()) {
+    fmt::format_to(std::back_inserter(buffer), "select volume=\"{}\"\n", mount.Folder);
+  } else {
+    fmt::format_to(std::back_inserter(buffer), "select volume={}\n", mount.Letter);
+  }
+  auto [ec, size] = co_await asio::async_write(diskpartIn, asio::buffer(buffer), asio::as_tuple(asio::use_awaitable));
+  if (ec == boost::system::errc::success) {
+    Log(LogLevel::Info, session.Fields, "selecting the volume at {}", mount);
+    co_return DiskPartError::Success;
+  } else {
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
+    co_return DiskPartError::IO;
+  }
+}
+
+auto ReadSelectVolume(DiskPartSession &session, asio::readable_pipe &diskpartOut) -> asio::awaitable<DiskPartError>
+{
+  auto &buffer = session.Buffer();
+
+  if (auto error = co_await readResponse(session, diskpartOut); error != DiskPartError::Success) co_return error;
+
+  auto scan = ResponseScan(buffer);
+  if (scan.Find(DiskPartResponse::VolumeSelected) or scan.Find(DiskPartResponse::Selected)) {
+    Log(LogLevel::Info, session.Fields, "volume selected");
+    co_return DiskPartError::Success;
+  }
+  Log(LogLevel::Warning, session.Fields, "diskpart: {}", toCompatView(std::u8string_view(buffer)));
+  co_return scan.IsServiceBusy() ? DiskPartError::ServiceBusy : DiskPartError::SelectVolumeFailed;
+}
+
+auto AssignLetter(DiskPartSession &session, asio::writable_pipe &diskpartIn, const MountPoint &mount)
   -> asio::awaitable<DiskPartError>
 {
-  fmt::format_to(std::back_inserter(buffer), "assign letter={}\n", assignLetter);
+  auto &buffer = session.Buffer();
+
+  if (mount.IsFolder()) {
+    fmt::format_to(std::back_inserter(buffer), "assign mount=\"{}\"\n", mount.Folder);
+  } else {
+    fmt::format_to(std::back_inserter(buffer), "assign letter={}\n", mount.Letter);
+  }
   auto [ec, size] = co_await asio::async_write(diskpartIn, asio::buffer(buffer), asio::as_tuple(asio::use_awaitable));
   if (ec == boost::system::errc::success) {
-    fmt::println("assigning partition to letter {:?}", assignLetter);
+    Log(LogLevel::Info, session.Fields, "assigning partition to {}", mount);
     co_return DiskPartError::Success;
   } else {
-    fmt::println("{}", ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
     co_return DiskPartError::IO;
   }
 }
 
-auto ReadAssignLetter(std::u8string &buffer, asio::readable_pipe &diskpartOut) -> asio::awaitable<DiskPartError>
+auto ReadAssignLetter(DiskPartSession &session, asio::readable_pipe &diskpartOut) -> asio::awaitable<DiskPartError>
 {
+  auto &buffer = session.Buffer();
+
   auto [ec, size] = co_await asio::async_read_until(
     diskpartOut, asio::dynamic_buffer(buffer, 1024 * 5), "DISKPART>", asio::as_tuple(asio::use_awaitable));
   if (ec == boost::system::errc::success) {
-    if (ctre::multiline_search<"DiskPart successfully assigned the drive letter or mount point.">(buffer)) {
-      fmt::println("successfully assign drive letter");
+    auto scan = ResponseScan(buffer);
+    if (scan.Find(DiskPartResponse::LetterAssigned)) {
+      Log(LogLevel::Info, session.Fields, "successfully assign drive letter");
       co_return DiskPartError::Success;
     } else {
-      fmt::println("diskpart: {}", std::string_view(reinterpret_cast<const char *>(buffer.data()), buffer.size()));
+      Log(LogLevel::Warning, session.Fields, "diskpart: {}", toCompatView(std::u8string_view(buffer)));
       // assert(false && "unexpected unsuccessfully assign drive letter");
+      if (scan.IsServiceBusy()) co_return DiskPartError::ServiceBusy;
       co_return DiskPartError::AssignLetterFailed;
     }
   } else {
-    fmt::println("{}", ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
     co_return DiskPartError::IO;
   }
 }
 
-auto RemoveLetter(std::u8string &buffer, asio::writable_pipe &diskpartIn, char removeLetter)
+auto RemoveLetter(DiskPartSession &session, asio::writable_pipe &diskpartIn, const MountPoint &mount)
   -> asio::awaitable<DiskPartError>
 {
-  fmt::format_to(std::back_inserter(buffer), "remove letter={}\n", removeLetter);
+  auto &buffer = session.Buffer();
+
+  if (mount.IsFolder()) {
+    fmt::format_to(std::back_inserter(buffer), "remove mount=\"{}\"\n", mount.Folder);
+  } else {
+    fmt::format_to(std::back_inserter(buffer), "remove letter={}\n", mount.Letter);
+  }
   auto [ec, size] = co_await asio::async_write(diskpartIn, asio::buffer(buffer), asio::as_tuple(asio::use_awaitable));
   if (ec == boost::system::errc::success) {
-    fmt::println("removing partition to letter {:?}", removeLetter);
+    Log(LogLevel::Info, session.Fields, "removing partition from {}", mount);
     co_return DiskPartError::Success;
   } else {
-    fmt::println("{}", ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
     co_return DiskPartError::IO;
   }
 }
 
-auto ReadRemoveLetter(std::u8string &buffer, asio::readable_pipe &diskpartOut) -> asio::awaitable<DiskPartError>
+auto ReadRemoveLetter(DiskPartSession &session, asio::readable_pipe &diskpartOut) -> asio::awaitable<DiskPartError>
 {
+  auto &buffer = session.Buffer();
+
   auto [ec, size] = co_await asio::async_read_until(
     diskpartOut, asio::dynamic_buffer(buffer, 1024 * 5), "DISKPART>", asio::as_tuple(asio::use_awaitable));
   if (ec == boost::system::errc::success) {
-    if (ctre::multiline_search<"DiskPart successfully removed the drive letter or mount point.">(buffer)) {
-      fmt::println("successfully remove drive letter");
+    auto scan = ResponseScan(buffer);
+    if (scan.Find(DiskPartResponse::LetterRemoved)) {
+      Log(LogLevel::Info, session.Fields, "successfully remove drive letter");
       co_return DiskPartError::Success;
     } else {
-      fmt::println("diskpart: {}", std::string_view(reinterpret_cast<const char *>(buffer.data()), buffer.size()));
+      Log(LogLevel::Warning, session.Fields, "diskpart: {}", toCompatView(std::u8string_view(buffer)));
       // assert(false && "unexpected unsuccessfully remove drive letter");
+      if (scan.IsServiceBusy()) co_return DiskPartError::ServiceBusy;
       co_return DiskPartError::RemoveLetterFailed;
     }
   } else {
-    fmt::println("{}", ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
+    co_return DiskPartError::IO;
+  }
+}
+
+auto ReadListRows(DiskPartSession &session, asio::readable_pipe &diskpartOut, std::vector<ListRow> &rows)
+  -> asio::awaitable<DiskPartError>
+{
+  auto &buffer = session.Buffer();
+
+  if (auto error = co_await readResponse(session, diskpartOut); error != DiskPartError::Success) co_return error;
+
+  rows.clear();
+  if (not ForEachListRow(buffer, [&rows](ListRow row) { rows.push_back(row); })) co_return DiskPartError::ParseFailed;
+  if (rows.empty() and ResponseScan(buffer).IsServiceBusy()) co_return DiskPartError::ServiceBusy;
+  co_return DiskPartError::Success;
+}
+
+auto DetailDisk(DiskPartSession &session, asio::writable_pipe &diskpartIn) -> asio::awaitable<DiskPartError>
+{
+  auto [ec, size] =
+    co_await asio::async_write(diskpartIn, asio::buffer("detail disk"), asio::as_tuple(asio::use_awaitable));
+  if (ec == boost::system::errc::success) {
+    Log(LogLevel::Info, session.Fields, "reading disk identity");
+    co_return DiskPartError::Success;
+  } else {
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
+    co_return DiskPartError::IO;
+  }
+}
+
+auto ReadDetailDisk(DiskPartSession &session, asio::readable_pipe &diskpartOut, std::string &diskId)
+  -> asio::awaitable<DiskPartError>
+{
+  auto &buffer = session.Buffer();
+
+  if (auto error = co_await readResponse(session, diskpartOut); error != DiskPartError::Success) co_return error;
+
+  auto scan = ResponseScan(buffer);
+  auto id   = toCompatView(scan.LineAfter(DiskPartResponse::DiskId));
+  while (not id.empty() and id.back() == ' ') id.remove_suffix(1);
+  if (id.empty()) co_return scan.IsServiceBusy() ? DiskPartError::ServiceBusy : DiskPartError::ParseFailed;
+
+  diskId = NormalizeDiskId(id);
+  Log(LogLevel::Info, session.Fields, "disk id {}", diskId);
+  co_return DiskPartError::Success;
+}
+
+auto DetailPartition(DiskPartSession &session, asio::writable_pipe &diskpartIn) -> asio::awaitable<DiskPartError>
+{
+  auto [ec, size] =
+    co_await asio::async_write(diskpartIn, asio::buffer("detail partition"), asio::as_tuple(asio::use_awaitable));
+  if (ec == boost::system::errc::success) {
+    Log(LogLevel::Info, session.Fields, "reading partition offset");
+    co_return DiskPartError::Success;
+  } else {
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
     co_return DiskPartError::IO;
   }
 }
 
-auto Exit(asio::writable_pipe &diskpartIn) -> asio::awaitable<DiskPartError>
+auto ReadDetailPartition(DiskPartSession &session, asio::readable_pipe &diskpartOut, uint64_t &partitionOffset)
+  -> asio::awaitable<DiskPartError>
+{
+  auto &buffer = session.Buffer();
+
+  if (auto error = co_await readResponse(session, diskpartOut); error != DiskPartError::Success) co_return error;
+
+  auto scan   = ResponseScan(buffer);
+  auto offset = toCompatView(scan.LineAfter(DiskPartResponse::PartitionOffset));
+  if (auto [_, ec] = std::from_chars(offset.data(), offset.data() + offset.size(), partitionOffset, 10);
+      offset.empty() or ec != std::errc()) {
+    co_return scan.IsServiceBusy() ? DiskPartError::ServiceBusy : DiskPartError::ParseFailed;
+  }
+  Log(LogLevel::Info, session.Fields, "partition offset {}", partitionOffset);
+  co_return DiskPartError::Success;
+}
+
+auto Exit(DiskPartSession &session, asio::writable_pipe &diskpartIn) -> asio::awaitable<DiskPartError>
 {
   auto [ec, size] = co_await asio::async_write(diskpartIn, asio::buffer("exit"), asio::as_tuple(asio::use_awaitable));
   if (ec == boost::system::errc::success) {
-    fmt::println("exiting diskpart");
+    Log(LogLevel::Info, session.Fields, "exiting diskpart");
     co_return DiskPartError::Success;
   } else {
-    fmt::println("{}", ec.what());
+    Log(LogLevel::Error, session.Fields, "{}", ec.what());
     co_return DiskPartError::IO;
   }
 }
@@ -1,10 +1,16 @@
 #pragma once
 
-#include <string>
 #include <boost/asio/readable_pipe.hpp>
 #include <boost/asio/writable_pipe.hpp>
 #include <boost/asio/awaitable.hpp>
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DiskPartSession.hpp"
+#include "DiskPartTable.hpp"
+#include "MountPoint.hpp"
 #include "Unit.hpp"
 
 namespace Blt {
@@ -23,6 +29,12 @@ enum struct DiskPartState {
   ReadAssignLetter,
   RemoveLetter,
   ReadRemoveLetter,
+  DetailDisk,
+  ReadDetailDisk,
+  DetailPartition,
+  ReadDetailPartition,
+  SelectVolume,
+  ReadSelectVolume,
   Exit
 };
 
@@ -37,53 +49,84 @@ enum struct DiskPartError {
   RemoveLetterFailed,
   ParseFailed,
   IO,
+  ServiceBusy,
+  SelectVolumeFailed,
 };
 
 
-auto ReadComputerName(std::u8string &buffer, boost::asio::readable_pipe &diskpartOut)
+auto ReadComputerName(DiskPartSession &session, boost::asio::readable_pipe &diskpartOut)
   -> boost::asio::awaitable<DiskPartError>;
 
-auto ListDisk(std::u8string &buffer, boost::asio::writable_pipe &diskpartIn) -> boost::asio::awaitable<DiskPartError>;
+auto ListDisk(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn)
+  -> boost::asio::awaitable<DiskPartError>;
 
 auto ReadListDisk(
-  std::u8string &buffer, boost::asio::readable_pipe &diskpartOut, int desireDiskNumber, CapacityBytes desireDiskCapacity)
-  -> boost::asio::awaitable<DiskPartError>;
+  DiskPartSession &session,
+  boost::asio::readable_pipe &diskpartOut,
+  int desireDiskNumber,
+  CapacityBytes desireDiskCapacity) -> boost::asio::awaitable<DiskPartError>;
 
-auto SelectDisk(std::u8string &buffer, boost::asio::writable_pipe &diskpartIn, int desireDiskNumber)
+auto SelectDisk(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn, int desireDiskNumber)
   -> boost::asio::awaitable<DiskPartError>;
 
-auto ReadSelectDisk(std::u8string &buffer, boost::asio::readable_pipe &diskpartOut, int desireDiskNumber)
+auto ReadSelectDisk(DiskPartSession &session, boost::asio::readable_pipe &diskpartOut, int desireDiskNumber)
   -> boost::asio::awaitable<DiskPartError>;
 
-auto ListPartition(std::u8string &buffer, boost::asio::writable_pipe &diskpartIn)
+auto ListPartition(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn)
   -> boost::asio::awaitable<DiskPartError>;
 
-auto SelectPartition(std::u8string &buffer, boost::asio::writable_pipe &diskpartIn, int desirePartitionNumber)
+auto SelectPartition(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn, int desirePartitionNumber)
   -> boost::asio::awaitable<DiskPartError>;
 
 auto ReadListPartition(
-  std::u8string &buffer,
+  DiskPartSession &session,
   boost::asio::readable_pipe &diskpartOut,
   int desirePartitionNumber,
   CapacityBytes desirePartitionCapacity) -> boost::asio::awaitable<DiskPartError>;
 
-auto SelectPartition(std::u8string &buffer, boost::asio::writable_pipe &diskpartIn, int desirePartitionNumber)
+auto SelectPartition(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn, int desirePartitionNumber)
   -> boost::asio::awaitable<DiskPartError>;
 
-auto ReadSelectPartition(std::u8string &buffer, boost::asio::readable_pipe &diskpartOut, int desirePartitionNumber)
+auto ReadSelectPartition(DiskPartSession &session, boost::asio::readable_pipe &diskpartOut, int desirePartitionNumber)
   -> boost::asio::awaitable<DiskPartError>;
 
-auto AssignLetter(std::u8string &buffer, boost::asio::writable_pipe &diskpartIn, char assignLetter)
+// `select volume=` by where the volume is attached, the selection `remove` works on
+auto SelectVolume(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn, const MountPoint &mount)
   -> boost::asio::awaitable<DiskPartError>;
 
-auto ReadAssignLetter(std::u8string &buffer, boost::asio::readable_pipe &diskpartOut)
+auto ReadSelectVolume(DiskPartSession &session, boost::asio::readable_pipe &diskpartOut)
   -> boost::asio::awaitable<DiskPartError>;
 
-auto RemoveLetter(std::u8string &buffer, boost::asio::writable_pipe &diskpartIn, char removeLetter)
+// `assign letter=` or, for a folder, `assign mount=`
+auto AssignLetter(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn, const MountPoint &mount)
   -> boost::asio::awaitable<DiskPartError>;
 
-auto ReadRemoveLetter(std::u8string &buffer, boost::asio::readable_pipe &diskpartOut) -> boost::asio::awaitable<DiskPartError>;
+auto ReadAssignLetter(DiskPartSession &session, boost::asio::readable_pipe &diskpartOut)
+  -> boost::asio::awaitable<DiskPartError>;
+
+auto RemoveLetter(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn, const MountPoint &mount)
+  -> boost::asio::awaitable<DiskPartError>;
+
+auto ReadRemoveLetter(DiskPartSession &session, boost::asio::readable_pipe &diskpartOut)
+  -> boost::asio::awaitable<DiskPartError>;
+
+// Every row of the `list disk` / `list partition` response, for callers that need more than one target
+auto ReadListRows(DiskPartSession &session, boost::asio::readable_pipe &diskpartOut, std::vector<ListRow> &rows)
+  -> boost::asio::awaitable<DiskPartError>;
+
+auto DetailDisk(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn)
+  -> boost::asio::awaitable<DiskPartError>;
+
+// GPT GUID or MBR signature of the selected disk, normalized like NormalizeDiskId
+auto ReadDetailDisk(DiskPartSession &session, boost::asio::readable_pipe &diskpartOut, std::string &diskId)
+  -> boost::asio::awaitable<DiskPartError>;
+
+auto DetailPartition(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn)
+  -> boost::asio::awaitable<DiskPartError>;
+
+auto ReadDetailPartition(DiskPartSession &session, boost::asio::readable_pipe &diskpartOut, uint64_t &partitionOffset)
+  -> boost::asio::awaitable<DiskPartError>;
 
-auto Exit(boost::asio::writable_pipe &diskpartIn) -> boost::asio::awaitable<DiskPartError>;
+auto Exit(DiskPartSession &session, boost::asio::writable_pipe &diskpartIn) -> boost::asio::awaitable<DiskPartError>;
 
 }// namespace Blt
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "DiskPartConversation.hpp"
+
+#include <fmt/format.h>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "DiskPartProtocol.hpp"
+#include "Log.hpp"
+#include "Startup.hpp"
+#include "TargetLookup.hpp"
+
+namespace asio = boost::asio;
+
+using namespace boost::asio::experimental::awaitable_operators;
+
+namespace Blt {
+
+auto DiskPartMount(
+  DiskPartSession &session,
+  asio::io_context &ioc,
+  asio::cancellation_signal &cancel,
+  asio::readable_pipe &diskpartOut,
+  asio::writable_pipe &diskpartIn,
+  int desireDiskNumber,
+  CapacityBytes desireDiskCapacity,
+  int desirePartitionNumber,
+  CapacityBytes desirePartitionCapacity,
+  const MountPoint &mount,
+  const std::optional<VolumeKey> &volume) -> asio::awaitable<DiskPartError>
+{
+  auto target = DiskPartTarget{
+    .DiskNumber          = desireDiskNumber,
+    .DiskCapacity        = desireDiskCapacity,
+    .PartitionNumber     = desirePartitionNumber,
+    .PartitionCapacity   = desirePartitionCapacity,
+    .Mount               = mount,
+    .Volume              = volume,
+    .FirstCommandWritten = MarkFirstCommandWritten,
+  };
+  if (volume) co_return co_await RunDiskPartProtocol<DiskPartMountProtocol>(session, diskpartOut, diskpartIn, target);
+
+  // a target given by numbers is confirmed by whichever answers first, the OS or diskpart's list tables
+  auto hedge   = TargetHedge(desireDiskNumber, desireDiskCapacity, desirePartitionNumber, desirePartitionCapacity);
+  target.Hedge = &hedge;
+  co_return co_await (
+    RunDiskPartProtocol<DiskPartMountProtocol>(session, diskpartOut, diskpartIn, target)
+    && hedge.Run(session.Fields));
+}
+
+auto DiskPartUnmount(
+  DiskPartSession &session,
+  asio::io_context &ioc,
+  asio::cancellation_signal &cancel,
+  asio::readable_pipe &diskpartOut,
+  asio::writable_pipe &diskpartIn,
+  int desireDiskNumber,
+  CapacityBytes desireDiskCapacity,
+  int desirePartitionNumber,
+  CapacityBytes desirePartitionCapacity,
+  const MountPoint &mount,
+  const std::optional<VolumeKey> &volume,
+  bool journaled) -> asio::awaitable<DiskPartError>
+{
+  auto target = DiskPartTarget{
+    .DiskNumber          = desireDiskNumber,
+    .DiskCapacity        = desireDiskCapacity,
+    .PartitionNumber     = desirePartitionNumber,
+    .PartitionCapacity   = desirePartitionCapacity,
+    .Mount               = mount,
+    .Volume              = volume,
+    .Journaled           = journaled,
+    .FirstCommandWritten = MarkFirstCommandWritten,
+  };
+  if (volume or journaled)
+    co_return co_await RunDiskPartProtocol<DiskPartUnmountProtocol>(session, diskpartOut, diskpartIn, target);
+
+  auto hedge   = TargetHedge(desireDiskNumber, desireDiskCapacity, desirePartitionNumber, desirePartitionCapacity);
+  target.Hedge = &hedge;
+  co_return co_await (
+    RunDiskPartProtocol<DiskPartUnmountProtocol>(session, diskpartOut, diskpartIn, target)
+    && hedge.Run(session.Fields));
+}
+
+auto DiskPartIndex(
+  DiskPartSession &session, asio::readable_pipe &diskpartOut, asio::writable_pipe &diskpartIn, VolumeIndex &index)
+  -> asio::awaitable<DiskPartError>
+{
+  auto &buffer               = session.Buffer();
+  auto closeStreamsWithError = [&diskpartOut, &diskpartIn](DiskPartError error) {
+    diskpartIn.close();
+    diskpartOut.close();
+    return error;
+  };
+  // one command and its response, the buffer is reset after each like the mount loop does
+  auto exchange = [&buffer](asio::awaitable<DiskPartError> command, asio::awaitable<DiskPartError> response)
+    -> asio::awaitable<DiskPartError> {
+    auto error = co_await std::move(command);
+    buffer.clear();
+    if (error == DiskPartError::Success) error = co_await std::move(response);
+    buffer.clear();
+    co_return error;
+  };
+
+  auto error = co_await ReadComputerName(session, diskpartOut);
+  buffer.clear();
+  if (error != DiskPartError::Success) co_return closeStreamsWithError(error);
+
+  auto disks = std::vector<ListRow>();
+  error      = co_await exchange(ListDisk(session, diskpartIn), ReadListRows(session, diskpartOut, disks));
+  if (error != DiskPartError::Success) co_return closeStreamsWithError(error);
+
+  auto partitions          = std::vector<ListRow>();
+  auto diskId              = std::string();
+  uint64_t partitionOffset = 0;
+  for (const auto &disk : disks) {
+    session.Fields.Disk      = disk.Number;
+    session.Fields.Partition = -1;
+
+    error = co_await exchange(
+      SelectDisk(session, diskpartIn, disk.Number), ReadSelectDisk(session, diskpartOut, disk.Number));
+    if (error == DiskPartError::Success)
+      error = co_await exchange(DetailDisk(session, diskpartIn), ReadDetailDisk(session, diskpartOut, diskId));
+    if (error == DiskPartError::Success)
+      error = co_await exchange(ListPartition(session, diskpartIn), ReadListRows(session, diskpartOut, partitions));
+    if (error == DiskPartError::IO) co_return closeStreamsWithError(error);
+    if (error != DiskPartError::Success) {
+      Log(LogLevel::Warning, session.Fields, "skipping disk #{}: {}", disk.Number, fmt::underlying(error));
+      continue;
+    }
+
+    for (const auto &partition : partitions) {
+      session.Fields.Partition = partition.Number;
+
+      error = co_await exchange(
+        SelectPartition(session, diskpartIn, partition.Number),
+        ReadSelectPartition(session, diskpartOut, partition.Number));
+      if (error == DiskPartError::Success)
+        error = co_await exchange(
+          DetailPartition(session, diskpartIn), ReadDetailPartition(session, diskpartOut, partitionOffset));
+      if (error == DiskPartError::IO) co_return closeStreamsWithError(error);
+      if (error != DiskPartError::Success) {
+        Log(
+          LogLevel::Warning,
+          session.Fields,
+          "skipping partition #{} of disk #{}: {}",
+          partition.Number,
+          disk.Number,
+          fmt::underlying(error));
+        continue;
+      }
+
+      index.Insert(
+        VolumeKey{.DiskId = diskId, .PartitionOffset = partitionOffset},
+        VolumeLocation{
+          .DiskNumber        = disk.Number,
+          .DiskCapacity      = disk.Capacity,
+          .PartitionNumber   = partition.Number,
+          .PartitionCapacity = partition.Capacity,
+        });
+      Log(
+        LogLevel::Info,
+        session.Fields,
+        "{}@{} is disk #{} partition #{}",
+        diskId,
+        partitionOffset,
+        disk.Number,
+        partition.Number);
+    }
+  }
+
+  if (error = co_await Exit(session, diskpartIn); error != DiskPartError::Success)
+    co_return closeStreamsWithError(error);
+  co_return DiskPartError::Success;
+}
+
+}// namespace Blt
\ No newline at end of file
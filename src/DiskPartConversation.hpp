@@ -0,0 +1,62 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/readable_pipe.hpp>
+#include <boost/asio/writable_pipe.hpp>
+
+#include <optional>
+
+#include "DiskPart.hpp"
+#include "DiskPartSession.hpp"
+#include "MountPoint.hpp"
+#include "Unit.hpp"
+#include "VolumeIndex.hpp"
+
+namespace Blt {
+
+/**
+ * The whole diskpart conversation of a mount: locate the partition by the list tables, or by `detail` when a volume
+ * key is given, and assign it the mount point. Failed steps are re-issued as StepRetry allows, the pipes are closed
+ * on the error that ends the conversation.
+ */
+auto DiskPartMount(
+  DiskPartSession &session,
+  boost::asio::io_context &ioc,
+  boost::asio::cancellation_signal &cancel,
+  boost::asio::readable_pipe &diskpartOut,
+  boost::asio::writable_pipe &diskpartIn,
+  int desireDiskNumber,
+  CapacityBytes desireDiskCapacity,
+  int desirePartitionNumber,
+  CapacityBytes desirePartitionCapacity,
+  const MountPoint &mount,
+  const std::optional<VolumeKey> &volume) -> boost::asio::awaitable<DiskPartError>;
+
+// The conversation of an unmount, `journaled` goes straight to `select volume` and skips the list tables
+auto DiskPartUnmount(
+  DiskPartSession &session,
+  boost::asio::io_context &ioc,
+  boost::asio::cancellation_signal &cancel,
+  boost::asio::readable_pipe &diskpartOut,
+  boost::asio::writable_pipe &diskpartIn,
+  int desireDiskNumber,
+  CapacityBytes desireDiskCapacity,
+  int desirePartitionNumber,
+  CapacityBytes desirePartitionCapacity,
+  const MountPoint &mount,
+  const std::optional<VolumeKey> &volume,
+  bool journaled) -> boost::asio::awaitable<DiskPartError>;
+
+/**
+ * Walks every disk and partition once and records where each volume identity currently is.
+ * Disks or partitions without an identity (no media, unreadable) are skipped, only a broken pipe ends the walk.
+ */
+auto DiskPartIndex(
+  DiskPartSession &session,
+  boost::asio::readable_pipe &diskpartOut,
+  boost::asio::writable_pipe &diskpartIn,
+  VolumeIndex &index) -> boost::asio::awaitable<DiskPartError>;
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "DiskPartLocale.hpp"
+
+#include <charconv>
+
+#include "MultiPattern.hpp"
+
+namespace Blt {
+
+namespace {
+  struct LocalePattern
+  {
+    DiskPartLocale Locale;
+    DiskPartResponse Kind;
+    std::u8string_view Text;
+  };
+
+  // Keep the fragments short and distinctive, surrounding wording differs between Windows builds.
+  // diskpart's redirected output follows the console output code page, main() switches it to UTF-8.
+  constexpr auto localePatterns = std::to_array<LocalePattern>({
+    {DiskPartLocale::English, DiskPartResponse::Banner, u8"On computer: "},
+    {DiskPartLocale::English, DiskPartResponse::DiskSelected, u8" is now the selected disk"},
+    {DiskPartLocale::English, DiskPartResponse::PartitionSelected, u8" is now the selected partition"},
+    {DiskPartLocale::English, DiskPartResponse::VolumeSelected, u8" is the selected volume"},
+    {DiskPartLocale::English, DiskPartResponse::LetterAssigned, u8"successfully assigned the drive letter"},
+    {DiskPartLocale::English, DiskPartResponse::LetterRemoved, u8"successfully removed the drive letter"},
+    {DiskPartLocale::English, DiskPartResponse::ServiceError, u8"Virtual Disk Service error"},
+    {DiskPartLocale::English, DiskPartResponse::ServiceError, u8"DiskPart has encountered an error"},
+    {DiskPartLocale::English, DiskPartResponse::BusyReason, u8"busy"},
+    {DiskPartLocale::English, DiskPartResponse::BusyReason, u8"not ready"},
+    {DiskPartLocale::English, DiskPartResponse::BusyReason, u8"in use"},
+    {DiskPartLocale::English, DiskPartResponse::BusyReason, u8"timed out"},
+    {DiskPartLocale::English, DiskPartResponse::DiskId, u8"Disk ID: "},
+    {DiskPartLocale::English, DiskPartResponse::PartitionOffset, u8"Offset in Bytes: "},
+
+    {DiskPartLocale::German, DiskPartResponse::Banner, u8"Auf Computer: "},
+    {DiskPartLocale::German, DiskPartResponse::DiskSelected, u8" ist jetzt der gewählte Datenträger"},
+    {DiskPartLocale::German, DiskPartResponse::PartitionSelected, u8" ist jetzt die gewählte Partition"},
+    {DiskPartLocale::German, DiskPartResponse::VolumeSelected, u8" ist jetzt das gewählte Volume"},
+    {DiskPartLocale::German, DiskPartResponse::LetterAssigned, u8"erfolgreich zugewiesen"},
+    {DiskPartLocale::German, DiskPartResponse::LetterRemoved, u8"erfolgreich entfernt"},
+    {DiskPartLocale::German, DiskPartResponse::ServiceError, u8"Fehler des Dienstes für virtuelle Datenträger"},
+    {DiskPartLocale::German, DiskPartResponse::ServiceError, u8"Fehler in DiskPart"},
+    {DiskPartLocale::German, DiskPartResponse::BusyReason, u8"nicht bereit"},
+    {DiskPartLocale::German, DiskPartResponse::BusyReason, u8"ausgelastet"},
+    {DiskPartLocale::German, DiskPartResponse::BusyReason, u8"verwendet"},
+    {DiskPartLocale::German, DiskPartResponse::DiskId, u8"Datenträger-ID: "},
+    {DiskPartLocale::German, DiskPartResponse::PartitionOffset, u8"Offset in Byte: "},
+
+    {DiskPartLocale::Japanese, DiskPartResponse::Banner, u8"コンピューター: "},
+    {DiskPartLocale::Japanese, DiskPartResponse::Selected, u8"が選択されました"},
+    {DiskPartLocale::Japanese, DiskPartResponse::LetterAssigned, u8"正常に割り当てました"},
+    {DiskPartLocale::Japanese, DiskPartResponse::LetterRemoved, u8"正常に削除しました"},
+    {DiskPartLocale::Japanese, DiskPartResponse::ServiceError, u8"仮想ディスク サービス エラー"},
+    {DiskPartLocale::Japanese, DiskPartResponse::ServiceError, u8"DiskPart でエラーが発生しました"},
+    {DiskPartLocale::Japanese, DiskPartResponse::BusyReason, u8"使用中"},
+    {DiskPartLocale::Japanese, DiskPartResponse::BusyReason, u8"準備ができていません"},
+    {DiskPartLocale::Japanese, DiskPartResponse::DiskId, u8"ディスク ID: "},
+    {DiskPartLocale::Japanese, DiskPartResponse::PartitionOffset, u8"オフセット (バイト): "},
+  });
+
+  constexpr auto localePatternTexts = [] {
+    std::array<std::u8string_view, localePatterns.size()> texts;
+    for (std::size_t index = 0; index < localePatterns.size(); ++index) texts[index] = localePatterns[index].Text;
+    return texts;
+  }();
+
+  constexpr auto responseMatcher =
+    MultiPattern<localePatternTexts.size(), MultiPatternNodeCount(localePatternTexts)>(localePatternTexts);
+
+  constexpr auto isHorizontalSpace(char8_t byte) -> bool { return byte == u8' ' or byte == u8'\t'; }
+}// namespace
+
+ResponseScan::ResponseScan(std::u8string_view response)
+  : response_(response)
+{
+  responseMatcher.Scan(response, [this](std::size_t index, std::size_t begin, std::size_t end) {
+    const auto &pattern = localePatterns[index];
+    auto &match         = matches_[static_cast<std::size_t>(pattern.Kind)];
+    if (match) return;
+    const auto &serviceError = matches_[static_cast<std::size_t>(DiskPartResponse::ServiceError)];
+    if (pattern.Kind == DiskPartResponse::BusyReason and not serviceError) return;
+    match = ResponseMatch{.Begin = begin, .End = end, .Locale = pattern.Locale};
+  });
+}
+
+auto ResponseScan::Find(DiskPartResponse kind) const -> std::optional<ResponseMatch>
+{
+  return matches_[static_cast<std::size_t>(kind)];
+}
+
+auto ResponseScan::NumberBefore(DiskPartResponse kind) const -> std::optional<int>
+{
+  const auto match = Find(kind);
+  if (not match) return std::nullopt;
+
+  auto end = match->Begin;
+  while (end > 0 and isHorizontalSpace(response_[end - 1])) --end;
+  auto begin = end;
+  while (begin > 0 and response_[begin - 1] >= u8'0' and response_[begin - 1] <= u8'9') --begin;
+
+  int number;
+  const auto digits = reinterpret_cast<const char *>(response_.data());
+  if (auto [_, ec] = std::from_chars(digits + begin, digits + end, number, 10); ec != std::errc()) return std::nullopt;
+  return number;
+}
+
+auto ResponseScan::LineAfter(DiskPartResponse kind) const -> std::u8string_view
+{
+  const auto match = Find(kind);
+  if (not match) return {};
+
+  auto line = response_.substr(match->End);
+  return line.substr(0, line.find_first_of(u8"\r\n"));
+}
+
+auto ResponseScan::IsServiceBusy() const -> bool { return Find(DiskPartResponse::BusyReason).has_value(); }
+
+auto ResponseScan::Locale() const -> DiskPartLocale
+{
+  const auto banner = Find(DiskPartResponse::Banner);
+  return banner ? banner->Locale : DiskPartLocale::Unknown;
+}
+
+auto ToString(DiskPartLocale locale) -> std::string_view
+{
+  switch (locale) {
+  case DiskPartLocale::English:
+    return "English";
+  case DiskPartLocale::German:
+    return "German";
+  case DiskPartLocale::Japanese:
+    return "Japanese";
+  default:
+    return "Unknown";
+  }
+}
+
+}// namespace Blt
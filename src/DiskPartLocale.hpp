@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+namespace Blt {
+
+enum struct DiskPartLocale {
+  Unknown,
+  English,
+  German,
+  Japanese,
+};
+
+// Recognisable fragments of diskpart responses, the same kind is spelled differently in every locale
+enum struct DiskPartResponse {
+  Banner,
+  DiskSelected,
+  PartitionSelected,
+  VolumeSelected,
+  // locales that use one sentence for both select disk and select partition
+  Selected,
+  LetterAssigned,
+  LetterRemoved,
+  ServiceError,
+  BusyReason,
+  // labels in `detail disk` / `detail partition`, the value follows on the same line
+  DiskId,
+  PartitionOffset,
+  Count,
+};
+
+struct ResponseMatch
+{
+  std::size_t Begin;
+  std::size_t End;
+  DiskPartLocale Locale;
+};
+
+/**
+ * Result of a single pass of the multi-locale response matcher over one diskpart response.
+ * Only the first occurrence of each response kind is kept, except that a BusyReason only counts when it follows a
+ * ServiceError.
+ */
+class ResponseScan
+{
+public:
+  explicit ResponseScan(std::u8string_view response);
+
+  [[nodiscard]] auto Find(DiskPartResponse kind) const -> std::optional<ResponseMatch>;
+
+  // The integer right before a match, e.g. the 0 in "Disk 0 is now the selected disk"
+  [[nodiscard]] auto NumberBefore(DiskPartResponse kind) const -> std::optional<int>;
+
+  // Rest of the line after a match, e.g. the computer name after the banner label
+  [[nodiscard]] auto LineAfter(DiskPartResponse kind) const -> std::u8string_view;
+
+  [[nodiscard]] auto IsServiceBusy() const -> bool;
+
+  // Locale of the banner, Unknown when the response did not contain one
+  [[nodiscard]] auto Locale() const -> DiskPartLocale;
+
+private:
+  std::u8string_view response_;
+  std::array<std::optional<ResponseMatch>, static_cast<std::size_t>(DiskPartResponse::Count)> matches_;
+};
+
+auto ToString(DiskPartLocale locale) -> std::string_view;
+
+}// namespace Blt
@@ -0,0 +1,93 @@
+#include "DiskPartProtocol.hpp"
+
+namespace asio = boost::asio;
+
+namespace Blt {
+
+auto PerformDiskPartStep(
+  DiskPartSession &session,
+  DiskPartState state,
+  asio::readable_pipe &diskpartOut,
+  asio::writable_pipe &diskpartIn,
+  DiskPartTarget &target) -> asio::awaitable<DiskPartError>
+{
+  switch (state) {
+  case DiskPartState::StartUp:
+    co_return co_await ReadComputerName(session, diskpartOut);
+  case DiskPartState::ListDisk:
+    co_return co_await ListDisk(session, diskpartIn);
+  case DiskPartState::ReadListDisk: {
+    const auto error = co_await ReadListDisk(session, diskpartOut, target.DiskNumber, target.DiskCapacity);
+    if (target.Hedge) target.Hedge->Compare(session.Fields, state, error);
+    co_return error;
+  }
+  case DiskPartState::SelectDisk:
+    co_return co_await SelectDisk(session, diskpartIn, target.DiskNumber);
+  case DiskPartState::ReadSelectDisk:
+    co_return co_await ReadSelectDisk(session, diskpartOut, target.DiskNumber);
+  case DiskPartState::ListPartition:
+    co_return co_await ListPartition(session, diskpartIn);
+  case DiskPartState::ReadListPartition: {
+    const auto error =
+      co_await ReadListPartition(session, diskpartOut, target.PartitionNumber, target.PartitionCapacity);
+    if (target.Hedge) target.Hedge->Compare(session.Fields, state, error);
+    co_return error;
+  }
+  case DiskPartState::SelectPartition:
+    co_return co_await SelectPartition(session, diskpartIn, target.PartitionNumber);
+  case DiskPartState::ReadSelectPartition:
+    co_return co_await ReadSelectPartition(session, diskpartOut, target.PartitionNumber);
+  case DiskPartState::AssignLetter:
+    co_return co_await AssignLetter(session, diskpartIn, target.Mount);
+  case DiskPartState::ReadAssignLetter:
+    co_return co_await ReadAssignLetter(session, diskpartOut);
+  case DiskPartState::RemoveLetter:
+    co_return co_await RemoveLetter(session, diskpartIn, target.Mount);
+  case DiskPartState::ReadRemoveLetter:
+    co_return co_await ReadRemoveLetter(session, diskpartOut);
+  case DiskPartState::DetailDisk:
+    co_return co_await DetailDisk(session, diskpartIn);
+  case DiskPartState::ReadDetailDisk: {
+    auto error = co_await ReadDetailDisk(session, diskpartOut, target.DiskId);
+    if (error == DiskPartError::Success and target.Volume and target.DiskId != target.Volume->DiskId) {
+      Log(
+        LogLevel::Error,
+        session.Fields,
+        "disk #{} is {} now, the volume index is stale, run `index` again",
+        target.DiskNumber,
+        target.DiskId);
+      error = DiskPartError::MismatchDisk;
+    }
+    co_return error;
+  }
+  case DiskPartState::DetailPartition:
+    co_return co_await DetailPartition(session, diskpartIn);
+  case DiskPartState::ReadDetailPartition: {
+    auto error = co_await ReadDetailPartition(session, diskpartOut, target.PartitionOffset);
+    if (
+      error == DiskPartError::Success and target.Volume and target.PartitionOffset != target.Volume->PartitionOffset) {
+      Log(
+        LogLevel::Error,
+        session.Fields,
+        "partition #{} starts at {} now, the volume index is stale, run `index` again",
+        target.PartitionNumber,
+        target.PartitionOffset);
+      error = DiskPartError::MismatchPartition;
+    }
+    co_return error;
+  }
+  case DiskPartState::SelectVolume:
+    co_return co_await SelectVolume(session, diskpartIn, target.Mount);
+  case DiskPartState::ReadSelectVolume: {
+    auto error = co_await ReadSelectVolume(session, diskpartOut);
+    if (error == DiskPartError::SelectVolumeFailed)
+      Log(LogLevel::Warning, session.Fields, "no volume at {}, validating the target instead", target.Mount);
+    co_return error;
+  }
+  case DiskPartState::Exit:
+    co_return co_await Exit(session, diskpartIn);
+  }
+  std::unreachable();
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <fmt/format.h>
+#include <fmt/chrono.h>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/readable_pipe.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/writable_pipe.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "DiskPart.hpp"
+#include "DiskPartSession.hpp"
+#include "Log.hpp"
+#include "MountPoint.hpp"
+#include "Common.hpp"
+#include "Retry.hpp"
+#include "SessionClock.hpp"
+#include "TargetLookup.hpp"
+#include "Unit.hpp"
+#include "VolumeIndex.hpp"
+
+namespace Blt {
+
+// What a conversation works towards, the steps take their arguments from here
+struct DiskPartTarget
+{
+  int DiskNumber;
+  CapacityBytes DiskCapacity;
+  int PartitionNumber;
+  CapacityBytes PartitionCapacity;
+  const MountPoint &Mount;
+  // set when the numbers came from the volume index, `detail` confirms them instead of scanning the list tables
+  const std::optional<VolumeKey> &Volume;
+  // the volume is known to be attached at Mount, an unmount selects it directly
+  bool Journaled = false;
+  // called once, after the first command was written, with the session's fields
+  void (*FirstCommandWritten)(const LogFields &fields) = nullptr;
+  // the direct lookup racing the list tables, only for a target given by numbers
+  TargetHedge *Hedge = nullptr;
+
+  // what the detail steps read back
+  std::string DiskId;
+  uint64_t PartitionOffset = 0;
+};
+
+/**
+ * One row of a protocol: the step of `State` and where the conversation continues after it succeeded.
+ * Which successor applies depends on how the target was given and, for a target given by numbers, on whether the
+ * direct lookup has confirmed it yet: `NextConfirmed` skips the list tables. An error equal to `Tolerated` is an
+ * answer rather than a failure, the conversation falls back to `Recover`.
+ */
+struct DiskPartTransition
+{
+  DiskPartState State;
+  DiskPartState Next;
+  DiskPartState NextByVolume = Next;
+  std::optional<DiskPartState> NextJournaled = std::nullopt;
+  std::optional<DiskPartState> NextConfirmed = std::nullopt;
+  DiskPartError Tolerated                    = DiskPartError::Success;
+  DiskPartState Recover                      = Next;
+  DiskPartState RecoverByVolume              = Recover;
+};
+
+template<std::size_t Steps>
+using DiskPartProtocol = std::array<DiskPartTransition, Steps>;
+
+// Sends the command of `state` or reads its response, the one coroutine every protocol runs its steps through
+auto PerformDiskPartStep(
+  DiskPartSession &session,
+  DiskPartState state,
+  boost::asio::readable_pipe &diskpartOut,
+  boost::asio::writable_pipe &diskpartIn,
+  DiskPartTarget &target) -> boost::asio::awaitable<DiskPartError>;
+
+constexpr auto IsDiskPartCommand(DiskPartState state) -> bool
+{
+  switch (state) {
+  case DiskPartState::ListDisk:
+  case DiskPartState::SelectDisk:
+  case DiskPartState::ListPartition:
+  case DiskPartState::SelectPartition:
+  case DiskPartState::AssignLetter:
+  case DiskPartState::RemoveLetter:
+  case DiskPartState::DetailDisk:
+  case DiskPartState::DetailPartition:
+  case DiskPartState::SelectVolume:
+  case DiskPartState::Exit:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Every command is declared right before the state that reads its response
+constexpr auto DiskPartResponseOf(DiskPartState command) -> DiskPartState
+{
+  return command == DiskPartState::Exit ? command : static_cast<DiskPartState>(static_cast<int>(command) + 1);
+}
+
+namespace Detail {
+  inline constexpr auto DiskPartStateCount = static_cast<std::size_t>(DiskPartState::Exit) + 1;
+
+  constexpr auto StateIndex(DiskPartState state) -> std::size_t
+  {
+    return static_cast<std::size_t>(state);
+  }
+
+  constexpr auto Successors(const DiskPartTransition &step) -> std::array<DiskPartState, 6>
+  {
+    return {
+      step.Next,
+      step.NextByVolume,
+      step.NextJournaled.value_or(step.Next),
+      step.NextConfirmed.value_or(step.Next),
+      step.Recover,
+      step.RecoverByVolume,
+    };
+  }
+
+  constexpr auto NextOf(const DiskPartTransition &step, bool byVolume, bool journaled, bool confirmed) -> DiskPartState
+  {
+    if (journaled and step.NextJournaled) return *step.NextJournaled;
+    if (byVolume) return step.NextByVolume;
+    if (confirmed and step.NextConfirmed) return *step.NextConfirmed;
+    return step.Next;
+  }
+
+  // Position of each state in the protocol, `Steps` for the states it does not have
+  template<std::size_t Steps>
+  constexpr auto ProtocolSlots(const DiskPartProtocol<Steps> &protocol) -> std::array<std::size_t, DiskPartStateCount>
+  {
+    auto slots = std::array<std::size_t, DiskPartStateCount>();
+    slots.fill(Steps);
+    for (std::size_t slot = 0; slot < Steps; ++slot) slots[StateIndex(protocol[slot].State)] = slot;
+    return slots;
+  }
+
+  template<std::size_t Steps>
+  constexpr auto HasUniqueStates(const DiskPartProtocol<Steps> &protocol) -> bool
+  {
+    auto seen = std::array<bool, DiskPartStateCount>();
+    for (const auto &step : protocol) {
+      if (seen[StateIndex(step.State)]) return false;
+      seen[StateIndex(step.State)] = true;
+    }
+    return true;
+  }
+
+  // Every successor and every state a retry re-enters at is a row of the protocol, Exit included
+  template<std::size_t Steps>
+  constexpr auto IsClosed(const DiskPartProtocol<Steps> &protocol) -> bool
+  {
+    const auto slots = ProtocolSlots(protocol);
+    if (slots[StateIndex(DiskPartState::Exit)] == Steps) return false;
+    for (const auto &step : protocol) {
+      if (slots[StateIndex(RetryEntryState(step.State))] == Steps) return false;
+      for (auto next : Successors(step))
+        if (slots[StateIndex(next)] == Steps) return false;
+    }
+    return true;
+  }
+
+  // A command is followed by its own response and a response by a command, Exit ends the conversation
+  template<std::size_t Steps>
+  constexpr auto AlternatesCommands(const DiskPartProtocol<Steps> &protocol) -> bool
+  {
+    for (const auto &step : protocol) {
+      for (auto next : Successors(step)) {
+        if (step.State == DiskPartState::Exit) {
+          if (next != DiskPartState::Exit) return false;
+        } else if (IsDiskPartCommand(step.State)) {
+          if (next != DiskPartResponseOf(step.State) or RetryEntryState(next) != step.State) return false;
+        } else if (not IsDiskPartCommand(next)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  template<std::size_t Steps>
+  constexpr auto Exits(
+    const DiskPartProtocol<Steps> &protocol,
+    DiskPartState state,
+    bool byVolume,
+    bool journaled,
+    bool confirmed,
+    std::size_t depth) -> bool
+  {
+    if (state == DiskPartState::Exit) return true;
+    // longer than the protocol has rows, the route went around in a cycle
+    const auto slot = ProtocolSlots(protocol)[StateIndex(state)];
+    if (depth == Steps or slot == Steps) return false;
+
+    const auto &step = protocol[slot];
+    if (not Exits(protocol, NextOf(step, byVolume, journaled, confirmed), byVolume, journaled, confirmed, depth + 1))
+      return false;
+    // the direct lookup may confirm the target after any step
+    if (not confirmed and not Exits(protocol, state, byVolume, journaled, true, depth)) return false;
+    if (step.Tolerated == DiskPartError::Success) return true;
+    const auto recover = byVolume ? step.RecoverByVolume : step.Recover;
+    return Exits(protocol, recover, byVolume, journaled, confirmed, depth + 1);
+  }
+
+  // Every route from StartUp, for any way the target can be given and any tolerated answer, reaches Exit
+  template<std::size_t Steps>
+  constexpr auto AlwaysExits(const DiskPartProtocol<Steps> &protocol) -> bool
+  {
+    for (auto byVolume : {false, true})
+      for (auto journaled : {false, true})
+        if (not Exits(protocol, DiskPartState::StartUp, byVolume, journaled, false, 0)) return false;
+    return true;
+  }
+}// namespace Detail
+
+/**
+ * Runs a conversation from StartUp to Exit along `Protocol`, the only loop every diskpart operation goes through.
+ * The protocol is a constant expression, so its row for a state is an array lookup and its graph is checked when the
+ * engine is instantiated for it. Failed steps are re-issued through StepRetry, what it gives up on closes both pipes.
+ */
+template<const auto &Protocol>
+auto RunDiskPartProtocol(
+  DiskPartSession &session,
+  boost::asio::readable_pipe &diskpartOut,
+  boost::asio::writable_pipe &diskpartIn,
+  DiskPartTarget &target) -> boost::asio::awaitable<DiskPartError>
+{
+  static_assert(Protocol.front().State == DiskPartState::StartUp, "a protocol starts at StartUp");
+  static_assert(Detail::HasUniqueStates(Protocol), "a state has one row per protocol");
+  static_assert(Detail::IsClosed(Protocol), "successors and retry entries are states of the protocol");
+  static_assert(Detail::AlternatesCommands(Protocol), "a command is followed by its response, a response by a command");
+  static_assert(Detail::AlwaysExits(Protocol), "every route from StartUp reaches Exit without a cycle");
+  static constexpr auto slots = Detail::ProtocolSlots(Protocol);
+
+  namespace asio = boost::asio;
+  auto &buffer               = session.Buffer();
+  auto closeStreamsWithError = [&diskpartOut, &diskpartIn](DiskPartError error) {
+    diskpartIn.close();
+    diskpartOut.close();
+    return error;
+  };
+
+  auto retry          = StepRetry();
+  auto retryTimer     = SessionTimer(co_await asio::this_coro::executor);
+  auto commandWritten = false;
+  // whichever way the conversation ends, it has no use for a direct answer that is still outstanding
+  blt_defer {
+    if (target.Hedge) target.Hedge->Cancel();
+  };
+
+  session.Fields.Disk      = target.DiskNumber;
+  session.Fields.Partition = target.PartitionNumber;
+  auto state               = DiskPartState::StartUp;
+  while (true) {
+    const auto &step     = Protocol[slots[Detail::StateIndex(state)]];
+    session.Fields.State = static_cast<int>(state);
+    session.Trace.Enter(session.Fields.State);
+    auto error = co_await PerformDiskPartStep(session, state, diskpartOut, diskpartIn, target);
+    if (state == DiskPartState::Exit)
+      co_return error == DiskPartError::Success ? error : closeStreamsWithError(error);
+    if (IsDiskPartCommand(state) and not std::exchange(commandWritten, true) and target.FirstCommandWritten)
+      target.FirstCommandWritten(session.Fields);
+    buffer.clear();
+
+    const auto confirmed = target.Hedge and target.Hedge->Confirmed();
+    auto nextState       = Detail::NextOf(step, target.Volume.has_value(), target.Journaled, confirmed);
+    if (error != DiskPartError::Success and error == step.Tolerated) {
+      nextState = target.Volume ? step.RecoverByVolume : step.Recover;
+      Log(
+        LogLevel::Debug,
+        session.Fields,
+        "step {} answered {}, continuing at step {}",
+        fmt::underlying(state),
+        fmt::underlying(error),
+        fmt::underlying(nextState));
+      error = DiskPartError::Success;
+    }
+
+    if (error != DiskPartError::Success) {
+      auto delay = retry.Next(state, error);
+      if (not delay) co_return closeStreamsWithError(error);
+
+      Log(
+        LogLevel::Warning,
+        session.Fields,
+        "step {} failed with {}, re-issuing in {}",
+        fmt::underlying(state),
+        fmt::underlying(error),
+        *delay);
+      retryTimer.expires_after(*delay);
+      if (auto [ec] = co_await retryTimer.async_wait(asio::as_tuple(asio::use_awaitable)); ec)
+        co_return closeStreamsWithError(error);
+      nextState = RetryEntryState(state);
+    }
+    state = nextState;
+  }
+}
+
+// Attaches the target: located through the list tables, or by index with `detail` confirming it
+inline constexpr auto DiskPartMountProtocol = std::to_array<DiskPartTransition>({
+  {.State         = DiskPartState::StartUp,
+   .Next          = DiskPartState::ListDisk,
+   .NextByVolume  = DiskPartState::SelectDisk,
+   .NextConfirmed = DiskPartState::SelectDisk},
+  {.State = DiskPartState::ListDisk, .Next = DiskPartState::ReadListDisk},
+  {.State = DiskPartState::ReadListDisk, .Next = DiskPartState::SelectDisk},
+  {.State = DiskPartState::SelectDisk, .Next = DiskPartState::ReadSelectDisk},
+  {.State         = DiskPartState::ReadSelectDisk,
+   .Next          = DiskPartState::ListPartition,
+   .NextByVolume  = DiskPartState::DetailDisk,
+   .NextConfirmed = DiskPartState::SelectPartition},
+  {.State = DiskPartState::ListPartition, .Next = DiskPartState::ReadListPartition},
+  {.State = DiskPartState::ReadListPartition, .Next = DiskPartState::SelectPartition},
+  {.State = DiskPartState::SelectPartition, .Next = DiskPartState::ReadSelectPartition},
+  {.State        = DiskPartState::ReadSelectPartition,
+   .Next         = DiskPartState::AssignLetter,
+   .NextByVolume = DiskPartState::DetailPartition},
+  {.State = DiskPartState::DetailDisk, .Next = DiskPartState::ReadDetailDisk},
+  {.State = DiskPartState::ReadDetailDisk, .Next = DiskPartState::SelectPartition},
+  {.State = DiskPartState::DetailPartition, .Next = DiskPartState::ReadDetailPartition},
+  {.State = DiskPartState::ReadDetailPartition, .Next = DiskPartState::AssignLetter},
+  {.State = DiskPartState::AssignLetter, .Next = DiskPartState::ReadAssignLetter},
+  {.State = DiskPartState::ReadAssignLetter, .Next = DiskPartState::Exit},
+  {.State = DiskPartState::Exit, .Next = DiskPartState::Exit},
+});
+
+// Detaches the target, a journaled unmount selects the attached volume and only validates the target when it is gone
+inline constexpr auto DiskPartUnmountProtocol = std::to_array<DiskPartTransition>({
+  {.State         = DiskPartState::StartUp,
+   .Next          = DiskPartState::ListDisk,
+   .NextByVolume  = DiskPartState::SelectDisk,
+   .NextJournaled = DiskPartState::SelectVolume,
+   .NextConfirmed = DiskPartState::SelectDisk},
+  {.State = DiskPartState::SelectVolume, .Next = DiskPartState::ReadSelectVolume},
+  {.State           = DiskPartState::ReadSelectVolume,
+   .Next            = DiskPartState::RemoveLetter,
+   .Tolerated       = DiskPartError::SelectVolumeFailed,
+   .Recover         = DiskPartState::ListDisk,
+   .RecoverByVolume = DiskPartState::SelectDisk},
+  {.State = DiskPartState::ListDisk, .Next = DiskPartState::ReadListDisk},
+  {.State = DiskPartState::ReadListDisk, .Next = DiskPartState::SelectDisk},
+  {.State = DiskPartState::SelectDisk, .Next = DiskPartState::ReadSelectDisk},
+  {.State         = DiskPartState::ReadSelectDisk,
+   .Next          = DiskPartState::ListPartition,
+   .NextByVolume  = DiskPartState::DetailDisk,
+   .NextConfirmed = DiskPartState::SelectPartition},
+  {.State = DiskPartState::ListPartition, .Next = DiskPartState::ReadListPartition},
+  {.State = DiskPartState::ReadListPartition, .Next = DiskPartState::SelectPartition},
+  {.State = DiskPartState::SelectPartition, .Next = DiskPartState::ReadSelectPartition},
+  {.State        = DiskPartState::ReadSelectPartition,
+   .Next         = DiskPartState::RemoveLetter,
+   .NextByVolume = DiskPartState::DetailPartition},
+  {.State = DiskPartState::DetailDisk, .Next = DiskPartState::ReadDetailDisk},
+  {.State = DiskPartState::ReadDetailDisk, .Next = DiskPartState::SelectPartition},
+  {.State = DiskPartState::DetailPartition, .Next = DiskPartState::ReadDetailPartition},
+  {.State = DiskPartState::ReadDetailPartition, .Next = DiskPartState::RemoveLetter},
+  {.State = DiskPartState::RemoveLetter, .Next = DiskPartState::ReadRemoveLetter},
+  {.State = DiskPartState::ReadRemoveLetter, .Next = DiskPartState::Exit},
+  {.State = DiskPartState::Exit, .Next = DiskPartState::Exit},
+});
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <string>
+
+#include "DiskPartLocale.hpp"
+#include "Log.hpp"
+#include "SessionClock.hpp"
+
+namespace Blt {
+
+using SessionBuffer = std::pmr::u8string;
+
+/**
+ * The states a conversation entered in order and when, relative to the session's start. Kept inline so tracing a
+ * session costs no allocation, a conversation that retries through more states than fit keeps the first ones and
+ * only counts the rest.
+ */
+struct SessionTrace
+{
+  static constexpr std::size_t Capacity = 64;
+
+  struct Step
+  {
+    // a DiskPartState, as LogFields keeps it
+    int State;
+    SessionClock::duration Entered;
+  };
+
+  SessionClock::time_point Started = SessionClock::now();
+  std::array<Step, Capacity> Steps{};
+  std::size_t Entered = 0;
+
+  void Enter(int state) noexcept
+  {
+    if (Entered < Capacity) Steps[Entered] = Step{.State = state, .Entered = SessionClock::now() - Started};
+    ++Entered;
+  }
+
+  [[nodiscard]] auto Recorded() const noexcept -> std::span<const Step>
+  {
+    return {Steps.data(), std::min(Entered, Capacity)};
+  }
+};
+
+/**
+ * Everything one diskpart conversation allocates: the response buffer and formatted commands.
+ * The arena is monotonic, nothing is returned to the heap until the session itself goes away.
+ * The coroutine frames of the steps come from asio's per-thread frame cache, which is sized for a session's whole
+ * coroutine stack (BOOST_ASIO_RECYCLING_ALLOCATOR_CACHE_SIZE), so after the first session they are reused too.
+ */
+class DiskPartSession
+{
+public:
+  // the largest dynamic_buffer limit used by a step, reserved up front so the buffer never regrows
+  static constexpr std::size_t MaxResponseBytes  = 1024 * 5;
+  static constexpr std::size_t InitialArenaBytes = 1024 * 16;
+
+  explicit DiskPartSession(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+    : arena_(initial_.data(), initial_.size(), upstream)
+    , buffer_(&arena_)
+  {
+    buffer_.reserve(MaxResponseBytes);
+  }
+
+  DiskPartSession(const DiskPartSession &)            = delete;
+  DiskPartSession &operator=(const DiskPartSession &) = delete;
+
+  [[nodiscard]] auto Resource() noexcept -> std::pmr::memory_resource * { return &arena_; }
+  [[nodiscard]] auto Buffer() noexcept -> SessionBuffer & { return buffer_; }
+
+  DiskPartLocale Locale = DiskPartLocale::Unknown;
+  // attached to every record a step logs, the state machine keeps state, disk and partition current
+  LogFields Fields = {.Operation = NextLogOperation()};
+  // every state RunDiskPartProtocol entered, what the audit log records
+  SessionTrace Trace;
+
+private:
+  alignas(std::max_align_t) std::array<std::byte, InitialArenaBytes> initial_;
+  std::pmr::monotonic_buffer_resource arena_;
+  SessionBuffer buffer_;
+};
+
+}// namespace Blt
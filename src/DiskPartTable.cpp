@@ -0,0 +1,154 @@
+#include "DiskPartTable.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <system_error>
+
+#include "Common.hpp"
+
+namespace Blt {
+
+namespace {
+  auto isPadding(char8_t byte) -> bool { return byte == u8' ' or byte == u8'\t' or byte == u8'\r'; }
+
+  auto trim(std::u8string_view view) -> std::u8string_view
+  {
+    while (not view.empty() and isPadding(view.front())) view.remove_prefix(1);
+    while (not view.empty() and isPadding(view.back())) view.remove_suffix(1);
+    return view;
+  }
+
+  auto isRuler(std::u8string_view line) -> bool
+  {
+    line = trim(line);
+    if (line.empty() or line.front() != u8'-') return false;
+    for (auto byte : line)
+      if (byte != u8'-' and byte != u8' ') return false;
+    return true;
+  }
+
+  auto isBlank(std::u8string_view line) -> bool { return trim(line).empty(); }
+
+  // Bytes in the UTF-8 sequence `lead` starts, a stray continuation byte counts on its own
+  auto sequenceLength(char8_t lead) -> std::size_t
+  {
+    if (lead < 0xC0) return 1;
+    if (lead < 0xE0) return 2;
+    if (lead < 0xF0) return 3;
+    return 4;
+  }
+
+  auto decode(std::u8string_view sequence) -> char32_t
+  {
+    const auto lead = static_cast<char32_t>(sequence[0]);
+    switch (sequence.size()) {
+    case 2:
+      return ((lead & 0x1F) << 6) | (sequence[1] & 0x3F);
+    case 3:
+      return ((lead & 0x0F) << 12) | ((sequence[1] & 0x3F) << 6) | (sequence[2] & 0x3F);
+    case 4:
+      return ((lead & 0x07) << 18) | ((sequence[1] & 0x3F) << 12) | ((sequence[2] & 0x3F) << 6) | (sequence[3] & 0x3F);
+    default:
+      return lead;
+    }
+  }
+
+  // Console cells a code point takes, the East Asian wide ranges a Japanese diskpart prints in
+  auto displayWidth(char32_t codePoint) -> std::size_t
+  {
+    const auto wide = (codePoint >= 0x1100 and codePoint <= 0x115F) or (codePoint >= 0x2E80 and codePoint <= 0xA4CF)
+                      or (codePoint >= 0xAC00 and codePoint <= 0xD7A3) or (codePoint >= 0xF900 and codePoint <= 0xFAFF)
+                      or (codePoint >= 0xFE30 and codePoint <= 0xFE4F) or (codePoint >= 0xFF00 and codePoint <= 0xFF60)
+                      or (codePoint >= 0xFFE0 and codePoint <= 0xFFE6);
+    return wide ? 2 : 1;
+  }
+}// namespace
+
+auto FindTableLayout(std::u8string_view response) -> std::optional<TableLayout>
+{
+  for (auto rest = response; not rest.empty();) {
+    const auto end  = rest.find(u8'\n');
+    const auto line = rest.substr(0, end);
+    rest.remove_prefix(end == std::u8string_view::npos ? rest.size() : end + 1);
+    if (not isRuler(line)) continue;
+
+    // the ruler is plain ASCII, a byte is a cell
+    auto layout = TableLayout();
+    for (std::size_t cell = 0; cell < line.size() and layout.Count < TableLayout::MaxColumns;) {
+      if (line[cell] != u8'-') {
+        ++cell;
+        continue;
+      }
+      const auto begin = cell;
+      while (cell < line.size() and line[cell] == u8'-') ++cell;
+      layout.Columns[layout.Count++] = TableColumn{.Begin = begin, .End = cell};
+    }
+
+    auto rowsEnd = std::size_t{0};
+    for (auto rows = rest; not rows.empty();) {
+      const auto rowEnd = rows.find(u8'\n');
+      if (isBlank(rows.substr(0, rowEnd))) break;
+      const auto consumed = rowEnd == std::u8string_view::npos ? rows.size() : rowEnd + 1;
+      rows.remove_prefix(consumed);
+      rowsEnd += consumed;
+    }
+    layout.Rows = rest.substr(0, rowsEnd);
+    return layout;
+  }
+  return std::nullopt;
+}
+
+void SliceRow(const TableLayout &layout, std::u8string_view row, TableCells &cells)
+{
+  // byte offset of the first code point at or after each column's start cell
+  auto starts = std::array<std::size_t, TableLayout::MaxColumns + 1>();
+  auto next   = std::size_t{0};
+  if (std::ranges::all_of(row, [](char8_t byte) { return byte < 0x80; })) {
+    // an English table, a byte is a cell
+    for (; next < layout.Count; ++next) starts[next] = std::min(layout.Columns[next].Begin, row.size());
+  } else {
+    auto cell = std::size_t{0};
+    for (std::size_t byte = 0; byte < row.size() and next < layout.Count;) {
+      while (next < layout.Count and cell >= layout.Columns[next].Begin) starts[next++] = byte;
+      const auto length = std::min(sequenceLength(row[byte]), row.size() - byte);
+      cell += displayWidth(decode(row.substr(byte, length)));
+      byte += length;
+    }
+  }
+  while (next <= layout.Count) starts[next++] = row.size();
+
+  for (std::size_t column = 0; column < layout.Count; ++column)
+    cells[column] = trim(row.substr(starts[column], starts[column + 1] - starts[column]));
+}
+
+auto DecodeCapacity(std::u8string_view cell) -> std::optional<CapacityBytes>
+{
+  const auto text = toCompatView(cell);
+  auto value      = uint64_t{0};
+  auto [unit, ec] = std::from_chars(text.data(), text.data() + text.size(), value, 10);
+  if (ec != std::errc()) return std::nullopt;
+  while (unit != text.data() + text.size() and *unit == ' ') ++unit;
+
+  const auto suffix = std::string_view(unit, text.data() + text.size());
+  if (suffix == "B") return CapacityBytes(value);
+  if (suffix == "KB") return capacityCast<CapacityBytes>(Kibibytes(value));
+  if (suffix == "MB") return capacityCast<CapacityBytes>(Mebibytes(value));
+  if (suffix == "GB") return capacityCast<CapacityBytes>(Gibibytes(value));
+  // Unit.hpp has no tebibyte ratio
+  if (suffix == "TB") return capacityCast<CapacityBytes>(Gibibytes(value * 1024));
+  return std::nullopt;
+}
+
+auto DecodeRowNumber(std::u8string_view cell) -> std::optional<int>
+{
+  const auto text   = toCompatView(cell);
+  const auto space  = text.find_last_of(' ');
+  const auto digits = space == std::string_view::npos ? text : text.substr(space + 1);
+  auto number       = 0;
+  auto [end, ec]    = std::from_chars(digits.data(), digits.data() + digits.size(), number, 10);
+  if (ec != std::errc() or end != digits.data() + digits.size()) return std::nullopt;
+  return number;
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+#include "Unit.hpp"
+
+namespace Blt {
+
+// One row of a `list disk` or `list partition` table
+struct ListRow
+{
+  int Number;
+  CapacityBytes Capacity;
+};
+
+// Where one column sits on the console, in display cells
+struct TableColumn
+{
+  std::size_t Begin;
+  std::size_t End;
+};
+
+/**
+ * The column layout of a diskpart table, read once from the `--------  -------` ruler under its header.
+ * Rows are then cut at the rulers' start cells instead of being matched, so a cell may contain spaces ("Online" vs
+ * "No Media", "Datenträger 0") and nothing backtracks.
+ */
+struct TableLayout
+{
+  static constexpr std::size_t MaxColumns = 8;
+
+  std::array<TableColumn, MaxColumns> Columns{};
+  std::size_t Count = 0;
+  // from the line after the ruler up to the first blank line
+  std::u8string_view Rows;
+};
+
+using TableCells = std::array<std::u8string_view, TableLayout::MaxColumns>;
+
+// nullopt when `response` holds no ruler line, like the "There are no partitions" answer
+auto FindTableLayout(std::u8string_view response) -> std::optional<TableLayout>;
+
+/**
+ * Cuts one row into the cells under each column, without the padding around them. Positions are counted in code
+ * points, a wide CJK code point takes two cells like it does on the console. Whatever is left of the first column
+ * (the `*` diskpart puts in front of the selected disk) is dropped.
+ */
+void SliceRow(const TableLayout &layout, std::u8string_view row, TableCells &cells);
+
+// "1863 GB" or "499 MB", diskpart's B/KB/MB/GB/TB are powers of 1024
+auto DecodeCapacity(std::u8string_view cell) -> std::optional<CapacityBytes>;
+
+// The number at the end of "Disk 0", "Partition 6" or "Datenträger 0"
+auto DecodeRowNumber(std::u8string_view cell) -> std::optional<int>;
+
+/**
+ * Calls onRow for every row of a `list disk` / `list partition` table, false when a row does not decode.
+ * Both tables have the number in the first column and the size in the third in every locale.
+ */
+template<typename TOnRow>
+auto ForEachListRow(std::u8string_view response, TOnRow &&onRow) -> bool
+{
+  constexpr std::size_t numberColumn = 0;
+  constexpr std::size_t sizeColumn   = 2;
+
+  const auto layout = FindTableLayout(response);
+  if (not layout) return true;
+  if (layout->Count <= sizeColumn) return false;
+
+  auto cells = TableCells();
+  for (auto rows = layout->Rows; not rows.empty();) {
+    const auto end = rows.find(u8'\n');
+    const auto row = rows.substr(0, end);
+    rows.remove_prefix(end == std::u8string_view::npos ? rows.size() : end + 1);
+
+    SliceRow(*layout, row, cells);
+    const auto number   = DecodeRowNumber(cells[numberColumn]);
+    const auto capacity = DecodeCapacity(cells[sizeColumn]);
+    if (not number or not capacity) return false;
+    onRow(ListRow{.Number = *number, .Capacity = *capacity});
+  }
+  return true;
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,856 @@
+#include "Engine.hpp"
+
+#include <fmt/format.h>
+#include <fmt/chrono.h>
+#include <boost/asio.hpp>
+#include "boost/asio/experimental/awaitable_operators.hpp"
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/readable_pipe.hpp>
+#include <boost/process/v2.hpp>
+
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "Common.hpp"
+#include "DeviceWatch.hpp"
+#include "DiskPartConversation.hpp"
+#include "DiskPartSession.hpp"
+#include "Log.hpp"
+#include "SessionClock.hpp"
+#include "VolumeIndex.hpp"
+
+namespace proc = boost::process::v2;
+namespace asio = boost::asio;
+
+using namespace boost::asio::experimental::awaitable_operators;
+using namespace std::chrono_literals;
+
+namespace Blt {
+
+namespace {
+  auto utf8Path(std::string_view path) -> std::filesystem::path
+  {
+    return std::filesystem::path(std::u8string(path.begin(), path.end()));
+  }
+
+  // Numbers and capacities of a `<disk id>@<offset>` target from the volume index, false when it is not indexed
+  auto resolveVolume(MountInfo &info) -> bool
+  {
+    const auto &volume = info.Volume;
+    if (not volume) return true;
+
+    auto index    = VolumeIndex::Load(DefaultVolumeIndexPath());
+    auto location = index ? index->Resolve(*volume) : std::nullopt;
+    if (not location) {
+      Log(
+        LogLevel::Error,
+        "{}@{} is not in the volume index, run `index` first",
+        volume->DiskId,
+        volume->PartitionOffset);
+      return false;
+    }
+    info.Disk      = DriveId{.Number = location->DiskNumber, .Capacity = location->DiskCapacity};
+    info.Partition = PatitionId{.Number = location->PartitionNumber, .Capacity = location->PartitionCapacity};
+    return true;
+  }
+
+  // The journal has this target attached at this mount point and the volume found there is still the one attached
+  auto isJournaled(const MountJournal &journal, const MountInfo &info) -> bool
+  {
+    const auto *record = journal.Find(info.Mount);
+    if (not record or record->VolumeName.empty()) return false;
+
+    const auto sameTarget = info.Volume ? record->Volume == info.Volume
+                                        : record->DiskNumber == info.Disk.Number
+                                            and record->DiskCapacity == info.Disk.Capacity
+                                            and record->PartitionNumber == info.Partition.Number
+                                            and record->PartitionCapacity == info.Partition.Capacity;
+    return sameTarget and MountedVolumeName(info.Mount) == record->VolumeName;
+  }
+
+  // The volume the way the request named it and where it was asked to go
+  auto auditRecord(std::string_view action, const MountInfo &info) -> AuditRecord
+  {
+    auto record   = AuditRecord{.Action = action, .Started = std::chrono::system_clock::now()};
+    record.Target = info.Volume ? fmt::format("{}@{}", info.Volume->DiskId, info.Volume->PartitionOffset)
+                                : fmt::format("disk #{} partition #{}", info.Disk.Number, info.Partition.Number);
+    record.Mount  = fmt::format("{}", info.Mount);
+    return record;
+  }
+
+  void finishRecord(AuditRecord &record, std::chrono::steady_clock::time_point started, const OperationResult &result)
+  {
+    record.Elapsed  = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+    record.Outcome  = ToString(result.Status);
+    record.DiskPart = result.DiskPart;
+  }
+}// namespace
+
+auto Engine::Create(EngineOptions options) -> std::unique_ptr<Engine>
+{
+  // without a key source unlocking stays the interactive bdeunlock prompt
+  auto keys = std::optional<KeySource>();
+  if (options.Keys) {
+    keys = KeySource::Open(*options.Keys);
+    if (not keys) {
+      Log(LogLevel::Error, "unable to read keys from {}", *options.Keys);
+      return nullptr;
+    }
+  }
+
+  return std::unique_ptr<Engine>(new Engine(std::move(options), std::move(keys)));
+}
+
+Engine::Engine(EngineOptions options, std::optional<KeySource> keys)
+  : options_(std::move(options))
+  , diskpartSpawner_([this] { return utf8Path(diskpart_.Path()); })
+  , bdeunlockSpawner_([this] { return utf8Path(bdeunlock_.Path()); })
+  , managebdeSpawner_([this] { return utf8Path(managebde_.Path()); })
+  , unlockCommandSpawner_([this] { return std::filesystem::path(options_.UnlockCommand.value_or(std::string())); })
+  , pool_(FreeDriveLetters, DefaultMountRoot())
+  , journal_(MountJournal::Open(DefaultMountJournalPath()))
+  // diskpart sessions of concurrent operations and processes queue up in arrival order, without the lock file they
+  // run unserialized
+  , sessions_(SessionLock::Open(DefaultSessionLockPath()))
+  , audit_(AuditLog::Open(DefaultAuditLogPath(), options_.Audit))
+  , work_(ioc_.get_executor())
+  , interrupt_(ioc_, options_.Grace)
+{
+  // diskpart encodes redirected output with the console output code page, the response matchers expect UTF-8. 0
+  // without a console, there is nothing to switch then
+  consoleOutputCodePage_ = GetConsoleOutputCP();
+  if (consoleOutputCodePage_ != 0 and consoleOutputCodePage_ != CP_UTF8) SetConsoleOutputCP(CP_UTF8);
+  if (keys) unlock_.emplace(std::move(*keys), unlockCommand(), options_.UnlockParallelism);
+  if (options_.HandleSignals) interrupt_.Listen();
+  if (not audit_) Log(LogLevel::Warning, "operations are not audited, {} is unusable", DefaultAuditLogPath().string());
+  thread_ = std::thread([this] { run(); });
+}
+
+Engine::~Engine()
+{
+  Shutdown();
+}
+
+auto Engine::Submit(MountInfo request, Completion completion) -> std::optional<OperationId>
+{
+  const auto id = nextId_.fetch_add(1, std::memory_order_relaxed);
+  {
+    auto lock = std::unique_lock(mutex_);
+    if (not shuttingDown_) {
+      pending_.emplace(id, std::move(completion));
+      lock.unlock();
+      asio::co_spawn(ioc_, perform(std::move(request)), [this, id](std::exception_ptr e, OperationResult result) {
+        if (e) try {
+            std::rethrow_exception(e);
+          } catch (std::exception &ex) {
+            Log(LogLevel::Error, "Error ===> {}", ex.what());
+            result = OperationResult{.Status = OperationStatus::InternalError};
+          }
+        complete(id, std::move(result));
+      });
+      return id;
+    }
+  }
+  completion(id, OperationResult{.Status = OperationStatus::ShutDown});
+  return std::nullopt;
+}
+
+void Engine::Shutdown()
+{
+  std::call_once(shutdown_, [this] {
+    {
+      auto lock     = std::lock_guard(mutex_);
+      shuttingDown_ = true;
+    }
+    asio::post(ioc_, [this] {
+      auto lock = std::unique_lock(mutex_);
+      if (pending_.empty()) {
+        lock.unlock();
+        interrupt_.Done();
+      } else {
+        lock.unlock();
+        interrupt_.Request();
+      }
+    });
+    work_.reset();
+    thread_.join();
+    // every operation that completed waited for its record, only those abandoned mid-append are still queued
+    if (audit_) audit_->Stop();
+    // the console belongs to the process hosting the engine, it gets its code page back once no diskpart runs
+    if (consoleOutputCodePage_ != 0 and consoleOutputCodePage_ != CP_UTF8) SetConsoleOutputCP(consoleOutputCodePage_);
+
+    if (interrupt_.Requested()) {
+      Log(
+        interrupt_.Forced() ? LogLevel::Error : LogLevel::Warning,
+        "interrupted, teardown took {}{}",
+        interrupt_.Teardown(),
+        interrupt_.Forced() ? " and was cut short" : "");
+    }
+    usage_.Report();
+  });
+}
+
+void Engine::run()
+{
+  ioc_.run();
+
+  // stopped by the teardown deadline, what is left never completes on its own
+  auto abandoned = std::map<OperationId, Completion>();
+  {
+    auto lock     = std::lock_guard(mutex_);
+    shuttingDown_ = true;
+    abandoned.swap(pending_);
+  }
+  for (auto &[id, completion] : abandoned) completion(id, OperationResult{.Status = OperationStatus::Abandoned});
+}
+
+void Engine::complete(OperationId id, OperationResult result)
+{
+  auto completion = Completion();
+  auto idle       = false;
+  {
+    auto lock = std::lock_guard(mutex_);
+    auto node = pending_.extract(id);
+    if (node) completion = std::move(node.mapped());
+    idle = pending_.empty();
+  }
+  if (completion) completion(id, result);
+  // the teardown is over once the last operation it interrupted is
+  if (idle and interrupt_.Requested()) interrupt_.Done();
+}
+
+auto Engine::perform(MountInfo request) -> asio::awaitable<OperationResult>
+{
+  switch (request.Action) {
+  case CommandAction::Mount: {
+    if (not request.Targets.empty() or not request.Numbered.empty()) co_return co_await performEach(std::move(request));
+    if (not resolveVolume(request)) co_return OperationResult{.Status = OperationStatus::NotIndexed};
+    co_return co_await attach(std::move(request));
+  }
+  case CommandAction::Unmount: {
+    if (not request.Targets.empty() or not request.Numbered.empty()) co_return co_await performEach(std::move(request));
+    if (not resolveVolume(request)) co_return OperationResult{.Status = OperationStatus::NotIndexed};
+    co_return co_await detach(std::move(request));
+  }
+  case CommandAction::Index: {
+    auto usage   = ResourceUsage();
+    auto result  = co_await indexVolumes(request.SessionTimeout.value_or(300s), usage);
+    result.Usage = usage;
+    co_return result;
+  }
+  case CommandAction::Watch: {
+    co_return co_await watchTargets(std::move(request));
+  }
+  case CommandAction::Unlock: {
+    co_return co_await unlockVolumes(std::move(request));
+  }
+  case CommandAction::VerifyAudit:
+  case CommandAction::Unknown: {
+    break;
+  }
+  }
+  co_return OperationResult{.Status = OperationStatus::InvalidRequest};
+}
+
+auto Engine::performEach(MountInfo request) -> asio::awaitable<OperationResult>
+{
+  auto singles = std::vector<MountInfo>();
+  for (auto &target : request.Numbered) {
+    singles.push_back(MountInfo{
+      .Action         = request.Action,
+      .Disk           = target.Disk,
+      .Partition      = target.Partition,
+      .Mount          = std::move(target.Mount),
+      .SessionTimeout = request.SessionTimeout,
+      .Probe          = request.Probe,
+    });
+  }
+  for (auto &target : request.Targets) {
+    singles.push_back(MountInfo{
+      .Action         = request.Action,
+      .Mount          = std::move(target.Mount),
+      .Volume         = std::move(target.Volume),
+      .SessionTimeout = request.SessionTimeout,
+      .Probe          = request.Probe,
+    });
+  }
+  // `*` targets never pick a letter a later target of the same request names. Each target hands its reservation to
+  // its own attach, which keeps the letter or gives it back, the targets that never got there give theirs back here
+  auto reserved = std::vector<std::optional<MountPoint>>(singles.size());
+  for (std::size_t index = 0; index < singles.size() and request.Action == CommandAction::Mount; ++index) {
+    if (pool_.Reserve(singles[index].Mount)) reserved[index] = singles[index].Mount;
+  }
+  blt_defer {
+    for (const auto &mount : reserved) {
+      if (mount) pool_.Release(*mount);
+    }
+  };
+
+  // one after the other, the first failure is what the whole request reports and what every target used is summed
+  auto result = OperationResult{.Status = OperationStatus::Success};
+  auto usage  = ResourceUsage();
+  for (std::size_t index = 0; index < singles.size(); ++index) {
+    auto &single       = singles[index];
+    auto outcome        = OperationResult{.Status = OperationStatus::NotIndexed};
+    const auto resolved = resolveVolume(single);
+    if (resolved and request.Action == CommandAction::Mount) {
+      if (auto mount = std::exchange(reserved[index], std::nullopt)) pool_.Release(*mount);
+      outcome = co_await attach(std::move(single));
+    } else if (resolved) {
+      outcome = co_await detach(std::move(single));
+    }
+    usage += outcome.Usage;
+    if (result.Status == OperationStatus::Success) result = std::move(outcome);
+    if (interrupt_.Requested()) break;
+  }
+  result.Usage = usage;
+  co_return result;
+}
+
+auto Engine::attach(MountInfo info) -> asio::awaitable<OperationResult>
+{
+  auto record        = auditRecord("mount", info);
+  const auto probe   = info.Probe;
+  const auto started = std::chrono::steady_clock::now();
+  auto usage         = ResourceUsage();
+  auto result        = co_await attachVolume(std::move(info), record, usage);
+  result.Usage       = usage;
+  // a `*` mount is recorded where it ended up
+  if (result.Status == OperationStatus::Success or result.Status == OperationStatus::UnlockFailed)
+    record.Mount = fmt::format("{}", result.Mount);
+  finishRecord(record, started, result);
+  // only an unlocked volume can be read, the probe is not part of the mount's time
+  if (probe and result.Status == OperationStatus::Success)
+    result.Probe = co_await probeVolume(result.Mount, *probe, LogFields{.Operation = record.Operation});
+  co_await audit({std::move(record)});
+  co_return result;
+}
+
+auto Engine::detach(MountInfo info) -> asio::awaitable<OperationResult>
+{
+  auto record        = auditRecord("unmount", info);
+  const auto started = std::chrono::steady_clock::now();
+  auto usage         = ResourceUsage();
+  auto result        = co_await detachVolume(std::move(info), record, usage);
+  result.Usage       = usage;
+  finishRecord(record, started, result);
+  co_await audit({std::move(record)});
+  co_return result;
+}
+
+auto Engine::attachVolume(MountInfo info, AuditRecord &record, ResourceUsage &usage)
+  -> asio::awaitable<OperationResult>
+{
+  // an explicit letter is kept out of the pool so a concurrent `*` mount never picks it
+  const auto reserved = not info.Mount.Automatic and pool_.Reserve(info.Mount);
+
+  asio::cancellation_signal sig;
+  DiskPartSession session;
+  // the outcome belongs to the session's operation, not to whichever state it ended in
+  const auto fields =
+    LogFields{.Operation = session.Fields.Operation, .Disk = info.Disk.Number, .Partition = info.Partition.Number};
+  blt_defer {
+    record.Operation = session.Fields.Operation;
+    record.Trace     = session.Trace;
+  };
+
+  auto mount = info.Mount;
+  if (mount.Automatic) {
+    auto acquired = pool_.Acquire();
+    if (not acquired) {
+      Log(LogLevel::Error, fields, "no free drive letter or mount folder left");
+      co_return OperationResult{.Status = OperationStatus::NoMountPoint};
+    }
+    mount = std::move(*acquired);
+  }
+  // a pooled or reserved target goes back unless the volume ended up attached to it, or diskpart refused it because
+  // something else holds it now
+  auto release = info.Mount.Automatic or reserved;
+  blt_defer {
+    if (release) pool_.Release(mount);
+  };
+
+  const auto sessionTimeout = info.SessionTimeout.value_or(100s);
+  auto lease                = std::optional<SessionLease>();
+  if (not co_await awaitSession(lease, sessionTimeout))
+    co_return OperationResult{.Status = OperationStatus::Interrupted};
+  SessionTimer timeout{co_await asio::this_coro::executor, sessionTimeout};
+  auto diskpartOut = asio::readable_pipe(co_await asio::this_coro::executor);
+  auto diskpartIn  = asio::writable_pipe(co_await asio::this_coro::executor);
+  ChildAccounting diskpartAccounting;
+  auto spawnError      = boost::system::error_code();
+  auto diskpartProcess = diskpartSpawner_.Launch(
+    co_await asio::this_coro::executor,
+    {},
+    SpawnStdio{.In = &diskpartIn, .Out = &diskpartOut},
+    &diskpartAccounting,
+    spawnError);
+  if (spawnError) {
+    Log(LogLevel::Error, fields, "unable to start diskpart: {}", spawnError.message());
+    co_return OperationResult{.Status = OperationStatus::SpawnFailed};
+  }
+
+  // bdeunlock is only needed after the diskpart session, resolve it while diskpart starts up
+  asio::post(co_await asio::this_coro::executor, [this] { bdeunlockSpawner_.Prepare(false); });
+
+  auto result = co_await (
+    proc::async_execute(
+      std::move(diskpartProcess), asio::bind_cancellation_slot(sig.slot(), asio::as_tuple(asio::use_awaitable)))
+    || DiskPartMount(
+      session,
+      ioc_,
+      sig,
+      diskpartOut,
+      diskpartIn,
+      info.Disk.Number,
+      info.Disk.Capacity,
+      info.Partition.Number,
+      info.Partition.Capacity,
+      mount,
+      info.Volume)
+    || timeout.async_wait(asio::as_tuple(asio::use_awaitable))
+    || interrupt_.Wait(&sig));
+  recordUsage(fields, "diskpart", diskpartAccounting.Collect(), usage);
+  // written while the lease is held, a compaction of another process replays the journal before rewriting it
+  auto journaled = false;
+  if (const auto *attached = std::get_if<1>(&result); attached and *attached == DiskPartError::Success) {
+    journaled = journal_.Append(MountRecord{
+      .DiskNumber        = info.Disk.Number,
+      .DiskCapacity      = info.Disk.Capacity,
+      .PartitionNumber   = info.Partition.Number,
+      .PartitionCapacity = info.Partition.Capacity,
+      .Volume            = info.Volume,
+      .VolumeName        = MountedVolumeName(mount),
+      .Mount             = mount,
+    });
+  }
+  // the next session may start while this one unlocks
+  lease.reset();
+
+  if (const auto processResult = std::get_if<0>(&result)) {
+    timeout.cancel();
+    auto [ec, exitCode] = *processResult;
+    if (ec == boost::system::errc::success && exitCode == 0) {
+      Log(LogLevel::Info, fields, "start process success: {}", exitCode);
+    }
+    // diskpart went away before the conversation was over
+    co_return OperationResult{.Status = OperationStatus::DiskPartFailed, .DiskPart = DiskPartError::IO};
+  } else if (const auto readResult = std::get_if<1>(&result)) {
+    timeout.cancel();
+    sig.emit(asio::cancellation_type::terminal);
+    DiskPartError opError = *readResult;
+    release = release and opError != DiskPartError::Success and opError != DiskPartError::AssignLetterFailed;
+    if (opError != DiskPartError::Success) {
+      Log(LogLevel::Error, fields, "it went to shit");
+      co_return OperationResult{.Status = OperationStatus::DiskPartFailed, .DiskPart = opError};
+    }
+
+    Log(LogLevel::Info, fields, "attached at {}", mount);
+    if (not journaled) Log(LogLevel::Warning, fields, "unable to update the mount journal");
+
+    auto attached =
+      OperationResult{.Status = OperationStatus::Success, .DiskPart = DiskPartError::Success, .Mount = mount};
+    if (unlock_) {
+      for (const auto &unlocked : co_await unlock_->Run({fmt::format("{}", mount)})) {
+        recordUsage(fields, "unlock", unlocked.Usage, usage);
+        if (unlocked.Error != UnlockError::Success) attached.Status = OperationStatus::UnlockFailed;
+      }
+      Log(LogLevel::Info, fields, "mount complete");
+      co_return attached;
+    }
+
+    Log(LogLevel::Info, fields, "prompt bitlocker password");
+    ChildAccounting bdeunlockAccounting;
+    const auto volume = std::array{fmt::format("{}", mount)};
+    auto prompt =
+      bdeunlockSpawner_.Launch(co_await asio::this_coro::executor, volume, {}, &bdeunlockAccounting, spawnError);
+    if (spawnError) {
+      Log(LogLevel::Error, fields, "unable to start bdeunlock: {}", spawnError.message());
+      attached.Status = OperationStatus::UnlockFailed;
+      co_return attached;
+    }
+
+    // awaited instead of blocking in WaitForSingleObject, the io_context keeps serving other operations
+    if (auto [waitError, exitCode] = co_await prompt.async_wait(asio::as_tuple(asio::use_awaitable)); waitError) {
+      Log(LogLevel::Error, fields, "something went wrong when waiting for bdeunlock");
+      attached.Status = OperationStatus::UnlockFailed;
+    } else {
+      Log(LogLevel::Info, fields, "bdeunlock exit with code {}", exitCode);
+      if (exitCode != 0) attached.Status = OperationStatus::UnlockFailed;
+    }
+    recordUsage(fields, "bdeunlock", bdeunlockAccounting.Collect(), usage);
+
+    Log(LogLevel::Info, fields, "mount complete");
+    co_return attached;
+  } else if (const auto timeoutResult = std::get_if<2>(&result)) {
+    auto [timeoutError] = *timeoutResult;
+    if (timeoutError == boost::system::errc::success) {
+      Log(LogLevel::Error, fields, "something went wrong, timed out");
+      sig.emit(asio::cancellation_type::terminal);
+    } else {
+      Log(LogLevel::Error, fields, "unexpected error relates to timeout");
+      sig.emit(asio::cancellation_type::terminal);
+    }
+    co_return OperationResult{.Status = OperationStatus::TimedOut};
+  }
+
+  timeout.cancel();
+  Log(LogLevel::Warning, fields, "diskpart session torn down after {}", interrupt_.Teardown());
+  co_return OperationResult{.Status = OperationStatus::Interrupted};
+}
+
+auto Engine::detachVolume(MountInfo info, AuditRecord &record, ResourceUsage &usage)
+  -> asio::awaitable<OperationResult>
+{
+  // read before the lock, the volume name is the one check the fast path keeps
+  const auto journaled = isJournaled(journal_, info);
+
+  Log(LogLevel::Info, "locking partition");
+  ChildAccounting managebdeAccounting;
+  const auto arguments = std::array<std::string, 3>{"-lock", "-ForceDismount", fmt::format("{}", info.Mount)};
+  auto spawnError      = boost::system::error_code();
+  auto lock =
+    managebdeSpawner_.Launch(co_await asio::this_coro::executor, arguments, {}, &managebdeAccounting, spawnError);
+  if (spawnError) {
+    Log(LogLevel::Error, "unable to start manage-bde: {}", spawnError.message());
+    co_return OperationResult{.Status = OperationStatus::SpawnFailed};
+  }
+  if (auto [waitError, exitCode] = co_await lock.async_wait(asio::as_tuple(asio::use_awaitable)); waitError) {
+    Log(LogLevel::Error, "something went wrong when waiting for manage-bde");
+  } else {
+    Log(LogLevel::Info, "manage-bde exit with code {}", exitCode);
+  }
+  recordUsage({}, "manage-bde", managebdeAccounting.Collect(), usage);
+  if (interrupt_.Requested()) co_return OperationResult{.Status = OperationStatus::Interrupted};
+
+  const auto sessionTimeout = info.SessionTimeout.value_or(100s);
+  auto lease                = std::optional<SessionLease>();
+  if (not co_await awaitSession(lease, sessionTimeout))
+    co_return OperationResult{.Status = OperationStatus::Interrupted};
+  SessionTimer timeout{co_await asio::this_coro::executor, sessionTimeout};
+  asio::cancellation_signal sig;
+  DiskPartSession session;
+  const auto fields =
+    LogFields{.Operation = session.Fields.Operation, .Disk = info.Disk.Number, .Partition = info.Partition.Number};
+  blt_defer {
+    record.Operation = session.Fields.Operation;
+    record.Trace     = session.Trace;
+  };
+  auto diskpartOut = asio::readable_pipe(co_await asio::this_coro::executor);
+  auto diskpartIn  = asio::writable_pipe(co_await asio::this_coro::executor);
+  ChildAccounting diskpartAccounting;
+  auto diskpartProcess = diskpartSpawner_.Launch(
+    co_await asio::this_coro::executor,
+    {},
+    SpawnStdio{.In = &diskpartIn, .Out = &diskpartOut},
+    &diskpartAccounting,
+    spawnError);
+  if (spawnError) {
+    Log(LogLevel::Error, fields, "unable to start diskpart: {}", spawnError.message());
+    co_return OperationResult{.Status = OperationStatus::SpawnFailed};
+  }
+
+  auto result = co_await (
+    proc::async_execute(
+      std::move(diskpartProcess), asio::bind_cancellation_slot(sig.slot(), asio::as_tuple(asio::use_awaitable)))
+    || DiskPartUnmount(
+      session,
+      ioc_,
+      sig,
+      diskpartOut,
+      diskpartIn,
+      info.Disk.Number,
+      info.Disk.Capacity,
+      info.Partition.Number,
+      info.Partition.Capacity,
+      info.Mount,
+      info.Volume,
+      journaled)
+    || timeout.async_wait(asio::as_tuple(asio::use_awaitable))
+    || interrupt_.Wait(&sig));
+  recordUsage(fields, "diskpart", diskpartAccounting.Collect(), usage);
+  // the removal compacts the journal, which has to happen under the lease
+  auto removed = true;
+  if (const auto *detached = std::get_if<1>(&result); detached and *detached == DiskPartError::Success)
+    removed = journal_.Remove(info.Mount);
+  lease.reset();
+
+  if (const auto processResult = std::get_if<0>(&result)) {
+    timeout.cancel();
+    auto [ec, exitCode] = *processResult;
+    if (ec == boost::system::errc::success && exitCode == 0) {
+      Log(LogLevel::Info, fields, "start process success: {}", exitCode);
+    }
+    co_return OperationResult{.Status = OperationStatus::DiskPartFailed, .DiskPart = DiskPartError::IO};
+  } else if (const auto readResult = std::get_if<1>(&result)) {
+    timeout.cancel();
+    sig.emit(asio::cancellation_type::terminal);
+    DiskPartError opError = *readResult;
+    if (opError != DiskPartError::Success) {
+      Log(LogLevel::Error, fields, "it went to shit");
+      co_return OperationResult{.Status = OperationStatus::DiskPartFailed, .DiskPart = opError};
+    }
+    if (not removed) Log(LogLevel::Warning, fields, "unable to update the mount journal");
+    // `*` mounts may take the letter or the pooled folder again
+    pool_.Release(info.Mount);
+    Log(LogLevel::Info, fields, "unmount complete{}", journaled ? ", journaled" : "");
+    co_return OperationResult{
+      .Status = OperationStatus::Success, .DiskPart = DiskPartError::Success, .Mount = info.Mount};
+  } else if (const auto timeoutResult = std::get_if<2>(&result)) {
+    auto [timeoutError] = *timeoutResult;
+    if (timeoutError == boost::system::errc::success) {
+      Log(LogLevel::Error, fields, "something went wrong, timed out");
+      sig.emit(asio::cancellation_type::terminal);
+    } else {
+      Log(LogLevel::Error, fields, "unexpected error relates to timeout");
+      sig.emit(asio::cancellation_type::terminal);
+    }
+    co_return OperationResult{.Status = OperationStatus::TimedOut};
+  }
+
+  timeout.cancel();
+  Log(LogLevel::Warning, fields, "diskpart session torn down after {}", interrupt_.Teardown());
+  co_return OperationResult{.Status = OperationStatus::Interrupted};
+}
+
+auto Engine::indexVolumes(std::chrono::seconds sessionTimeout, ResourceUsage &usage) -> asio::awaitable<OperationResult>
+{
+  auto lease = std::optional<SessionLease>();
+  if (not co_await awaitSession(lease, sessionTimeout))
+    co_return OperationResult{.Status = OperationStatus::Interrupted};
+  SessionTimer timeout{co_await asio::this_coro::executor, sessionTimeout};
+  asio::cancellation_signal sig;
+  DiskPartSession session;
+  VolumeIndex index;
+  auto diskpartOut = asio::readable_pipe(co_await asio::this_coro::executor);
+  auto diskpartIn  = asio::writable_pipe(co_await asio::this_coro::executor);
+  ChildAccounting diskpartAccounting;
+  auto spawnError      = boost::system::error_code();
+  auto diskpartProcess = diskpartSpawner_.Launch(
+    co_await asio::this_coro::executor,
+    {},
+    SpawnStdio{.In = &diskpartIn, .Out = &diskpartOut},
+    &diskpartAccounting,
+    spawnError);
+  if (spawnError) {
+    Log(LogLevel::Error, "unable to start diskpart: {}", spawnError.message());
+    co_return OperationResult{.Status = OperationStatus::SpawnFailed};
+  }
+
+  auto result = co_await (
+    proc::async_execute(
+      std::move(diskpartProcess), asio::bind_cancellation_slot(sig.slot(), asio::as_tuple(asio::use_awaitable)))
+    || DiskPartIndex(session, diskpartOut, diskpartIn, index)
+    || timeout.async_wait(asio::as_tuple(asio::use_awaitable))
+    || interrupt_.Wait(&sig));
+  recordUsage(LogFields{.Operation = session.Fields.Operation}, "diskpart", diskpartAccounting.Collect(), usage);
+
+  timeout.cancel();
+  sig.emit(asio::cancellation_type::terminal);
+  if (const auto indexResult = std::get_if<1>(&result); indexResult and *indexResult == DiskPartError::Success) {
+    const auto path = DefaultVolumeIndexPath();
+    if (index.Save(path)) {
+      Log(LogLevel::Info, "indexed {} volumes into {}", index.Size(), path.string());
+      co_return OperationResult{.Status = OperationStatus::Success};
+    }
+    Log(LogLevel::Error, "unable to write volume index {}", path.string());
+    co_return OperationResult{.Status = OperationStatus::InternalError};
+  }
+
+  Log(LogLevel::Error, "indexing failed, the previous volume index is kept");
+  if (const auto indexResult = std::get_if<1>(&result))
+    co_return OperationResult{.Status = OperationStatus::DiskPartFailed, .DiskPart = *indexResult};
+  if (std::get_if<2>(&result)) co_return OperationResult{.Status = OperationStatus::TimedOut};
+  if (std::get_if<3>(&result)) co_return OperationResult{.Status = OperationStatus::Interrupted};
+  co_return OperationResult{.Status = OperationStatus::DiskPartFailed, .DiskPart = DiskPartError::IO};
+}
+
+auto Engine::watchTargets(MountInfo info) -> asio::awaitable<OperationResult>
+{
+  auto watch = DeviceWatch(co_await asio::this_coro::executor);
+  // held for as long as the target waits, a target that never attached gives its letter back when the watch ends
+  auto reserved = std::vector<bool>();
+  for (const auto &target : info.Targets) reserved.push_back(pool_.Reserve(target.Mount));
+  blt_defer {
+    for (std::size_t index = 0; index < reserved.size(); ++index) {
+      if (reserved[index]) pool_.Release(info.Targets[index].Mount);
+    }
+  };
+  Log(LogLevel::Info, "waiting for {} volumes to arrive", info.Targets.size());
+
+  // what every attach of the watch used
+  auto usage = ResourceUsage();
+  co_await (watch.Run([&](std::string device) -> asio::awaitable<void> {
+    // only the disk that just settled is probed, diskpart is not started for anything else
+    const auto volumes = ProbeDevice(device);
+    for (std::size_t index = 0; index < info.Targets.size(); ++index) {
+      const auto &target  = info.Targets[index];
+      const auto location = volumes.Resolve(target.Volume);
+      if (not location) continue;
+
+      Log(
+        LogLevel::Info,
+        "{}@{} arrived as disk #{} partition #{}",
+        target.Volume.DiskId,
+        target.Volume.PartitionOffset,
+        location->DiskNumber,
+        location->PartitionNumber);
+      const auto attached = co_await attach(MountInfo{
+        .Action         = CommandAction::Mount,
+        .Disk           = DriveId{.Number = location->DiskNumber, .Capacity = location->DiskCapacity},
+        .Partition      = PatitionId{.Number = location->PartitionNumber, .Capacity = location->PartitionCapacity},
+        .Mount          = target.Mount,
+        .Volume         = target.Volume,
+        .SessionTimeout = info.SessionTimeout,
+        .Probe          = info.Probe,
+      });
+      usage += attached.Usage;
+      // the volume holds the letter now, its unmount gives it back
+      if (attached.Status == OperationStatus::Success or attached.Status == OperationStatus::UnlockFailed)
+        reserved[index] = false;
+    }
+  }) || interrupt_.Wait());
+  // a mount that was running when the interrupt came tears its own session down, wait for it before the watch goes
+  co_await watch.Drain();
+  // a watch only ends through an interrupt
+  co_return OperationResult{.Status = OperationStatus::Interrupted, .Usage = usage};
+}
+
+auto Engine::unlockVolumes(MountInfo info) -> asio::awaitable<OperationResult>
+{
+  // one operation for the whole request, what its volumes log and record is found under it
+  const auto fields = LogFields{.Operation = NextLogOperation()};
+  auto keys         = KeySource::Open(info.Keys);
+  if (not keys) {
+    Log(LogLevel::Error, fields, "unable to read keys from {}", info.Keys);
+    co_return OperationResult{.Status = OperationStatus::InvalidRequest};
+  }
+  auto stage   = UnlockStage(std::move(*keys), unlockCommand(), options_.UnlockParallelism);
+  auto volumes = std::vector<std::string>();
+  for (const auto &mount : info.Mounts) volumes.push_back(fmt::format("{}", mount));
+
+  const auto started = std::chrono::steady_clock::now();
+  auto record =
+    AuditRecord{.Operation = fields.Operation, .Action = "unlock", .Started = std::chrono::system_clock::now()};
+  const auto results  = co_await stage.Run(std::move(volumes));
+  const auto unlocked = std::ranges::count(results, UnlockError::Success, &UnlockResult::Error);
+  auto usage = ResourceUsage();
+  for (const auto &result : results) recordUsage(fields, "unlock", result.Usage, usage);
+  // one record per volume, queued together they share a commit
+  auto records = std::vector<AuditRecord>();
+  for (const auto &result : results) {
+    record.Target = result.Volume;
+    record.Mount  = result.Volume;
+    finishRecord(
+      record,
+      started,
+      OperationResult{
+        .Status = result.Error == UnlockError::Success ? OperationStatus::Success : OperationStatus::UnlockFailed});
+    records.push_back(record);
+  }
+  co_await audit(std::move(records));
+  Log(LogLevel::Info, fields, "unlocked {} of {} volumes", unlocked, results.size());
+  co_return OperationResult{
+    .Status = unlocked == static_cast<std::ptrdiff_t>(results.size()) ? OperationStatus::Success
+                                                                      : OperationStatus::UnlockFailed,
+    .Usage  = usage};
+}
+
+auto Engine::awaitSession(std::optional<SessionLease> &lease, std::chrono::seconds sessionTimeout)
+  -> asio::awaitable<bool>
+{
+  if (not sessions_) co_return true;
+  auto turn = co_await (sessions_->Acquire(sessionTimeout) || interrupt_.Wait());
+  if (auto *acquired = std::get_if<0>(&turn)) {
+    lease = std::move(*acquired);
+    co_return true;
+  }
+  Log(LogLevel::Warning, "interrupted while waiting for the diskpart session");
+  co_return false;
+}
+
+auto Engine::audit(std::vector<AuditRecord> records) -> asio::awaitable<void>
+{
+  if (not audit_ or records.empty()) co_return;
+  // the writer commits in queue order, the last completion comes after those of the records before it. Failed
+  // commits are logged by the writer
+  for (std::size_t index = 0; index + 1 < records.size(); ++index) audit_->Append(records[index], [](bool) {});
+  const auto operation = records.back().Operation;
+  if (not co_await audit_->AsyncAppend(std::move(records.back()), asio::use_awaitable))
+    Log(LogLevel::Error, LogFields{.Operation = operation}, "the audit log does not have this operation");
+}
+
+auto Engine::probeVolume(const MountPoint &mount, std::chrono::milliseconds phase, const LogFields &fields)
+  -> asio::awaitable<ProbeResult>
+{
+  const auto path = ProbePath(mount);
+  if (not path) {
+    Log(LogLevel::Warning, fields, "no volume to probe at {}", mount);
+    co_return ProbeResult{.Error = ProbeError::OpenFailed};
+  }
+
+  auto probed = co_await (ProbeReads(*path, ProbeOptions{.Phase = phase}) || interrupt_.Wait());
+  auto *probe = std::get_if<0>(&probed);
+  if (not probe) co_return ProbeResult{.Error = ProbeError::Interrupted};
+  if (probe->Error == ProbeError::Success) {
+    Log(LogLevel::Info, fields, "{} reads {}", mount, *probe);
+  } else {
+    Log(LogLevel::Warning, fields, "probe of {} {} after {} bytes", mount, ToString(probe->Error), probe->BytesRead);
+  }
+  co_return *probe;
+}
+
+// Logs what a helper cost under the operation it ran for and adds it to the engine's totals
+void Engine::recordUsage(
+  const LogFields &fields, std::string_view helper, const ResourceUsage &usage, ResourceUsage &operation)
+{
+  Log(LogLevel::Info, fields, "{} used {}", helper, usage);
+  usage_.Add(helper, usage);
+  operation += usage;
+}
+
+auto Engine::unlockCommand() -> UnlockCommand
+{
+  if (options_.UnlockCommand) return UnlockCommand{.Launcher = &unlockCommandSpawner_, .SecretOnStdin = true};
+  return UnlockCommand{.Launcher = &managebdeSpawner_, .SecretOnStdin = false};
+}
+
+auto ToString(OperationStatus status) -> std::string_view
+{
+  switch (status) {
+  case OperationStatus::Success:
+    return "success";
+  case OperationStatus::InvalidRequest:
+    return "invalid request";
+  case OperationStatus::NotIndexed:
+    return "not indexed";
+  case OperationStatus::NoMountPoint:
+    return "no mount point";
+  case OperationStatus::SpawnFailed:
+    return "spawn failed";
+  case OperationStatus::DiskPartFailed:
+    return "diskpart failed";
+  case OperationStatus::TimedOut:
+    return "timed out";
+  case OperationStatus::Interrupted:
+    return "interrupted";
+  case OperationStatus::UnlockFailed:
+    return "unlock failed";
+  case OperationStatus::Abandoned:
+    return "abandoned";
+  case OperationStatus::ShutDown:
+    return "shut down";
+  case OperationStatus::InternalError:
+    return "internal error";
+  }
+  return "unknown";
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Accounting.hpp"
+#include "AuditLog.hpp"
+#include "Command.hpp"
+#include "DiskPart.hpp"
+#include "Interrupt.hpp"
+#include "MountJournal.hpp"
+#include "MountPoint.hpp"
+#include "ReadProbe.hpp"
+#include "SessionLock.hpp"
+#include "Spawn.hpp"
+#include "Startup.hpp"
+#include "Unlock.hpp"
+
+namespace Blt {
+
+enum struct OperationStatus {
+  Success = 0,
+  // the request does not describe an operation, or it needs a key source the engine was created without
+  InvalidRequest,
+  // a `<disk id>@<offset>` target that is not in the volume index
+  NotIndexed,
+  NoMountPoint,
+  SpawnFailed,
+  // the conversation ended on DiskPartError, see OperationResult::DiskPart
+  DiskPartFailed,
+  TimedOut,
+  Interrupted,
+  // attached, but the volume did not unlock
+  UnlockFailed,
+  // still running when the teardown deadline passed, the engine let go of it
+  Abandoned,
+  // submitted after Shutdown
+  ShutDown,
+  // an exception escaped the operation or its result could not be stored, the log has the details
+  InternalError,
+};
+
+struct OperationResult
+{
+  OperationStatus Status;
+  DiskPartError DiskPart = DiskPartError::Success;
+  // where a mount attached the volume, `*` resolved to what the pool handed out
+  MountPoint Mount;
+  // a mount with --probe that attached the volume, what reading it back measured
+  std::optional<ProbeResult> Probe;
+  // what the helpers the operation started used (diskpart, the unlock command, bdeunlock, manage-bde), summed over
+  // every target of a request
+  ResourceUsage Usage;
+};
+
+using OperationId = uint64_t;
+using Completion  = std::move_only_function<void(OperationId, const OperationResult &)>;
+
+struct EngineOptions
+{
+  // BLT_UNLOCK_KEYS as a spec, without one mounts prompt through bdeunlock and unlock requests are refused
+  std::optional<std::string> Keys;
+  // replaces manage-bde for keyed unlocks and gets the secret on stdin, like BLT_UNLOCK_COMMAND
+  std::optional<std::string> UnlockCommand;
+  std::size_t UnlockParallelism = 4;
+  // how long a shutdown or an interrupt waits for running sessions before abandoning them
+  std::chrono::milliseconds Grace = std::chrono::seconds(5);
+  // Ctrl-C and SIGTERM interrupt every running operation, only the CLI wants that
+  bool HandleSignals = false;
+  // how the audit log groups the records of concurrent operations into commits
+  AuditPolicy Audit;
+};
+
+/**
+ * The mount/unmount engine as a library, what BitLockerTool.exe runs for a single command.
+ * An engine owns one io_context driven by its own thread, together with everything a run of the CLI used to build
+ * once: the helpers, the mount pool, the mount journal, the session lock and the unlock stage. An orchestrator keeps
+ * one engine and submits operations to it instead of starting an elevated process per operation.
+ * Submit may be called from any thread, the operation itself runs on the engine's thread and so does its completion.
+ * Operations run concurrently, their diskpart sessions queue on the session lock like those of separate processes.
+ * Shutdown (or destruction) interrupts what is still running, waits at most the grace for the teardown and calls the
+ * completion of everything it had to abandon with OperationStatus::Abandoned. Every completion is called exactly once.
+ * Every mount, unmount and unlock of a volume is appended to the audit log (DefaultAuditLogPath), its completion is
+ * called once the record is durable.
+ * The process has to be elevated, diskpart and manage-bde refuse otherwise. Until Shutdown the console's output code
+ * page is UTF-8, the one diskpart answers in.
+ */
+class Engine
+{
+public:
+  // nullptr when the key source can not be opened
+  static auto Create(EngineOptions options) -> std::unique_ptr<Engine>;
+
+  Engine(const Engine &)            = delete;
+  Engine &operator=(const Engine &) = delete;
+  ~Engine();
+
+  /**
+   * `request` is what the command line parses to. After Shutdown the completion is called right away on the calling
+   * thread with OperationStatus::ShutDown and there is no id. The completion must not call Shutdown.
+   */
+  auto Submit(MountInfo request, Completion completion) -> std::optional<OperationId>;
+
+  /**
+   * Submit for completion tokens: a callback, use_awaitable, use_future or deferred. The handler is dispatched on its
+   * associated executor, not called on the engine's thread, and keeps that executor's work alive until then.
+   */
+  template<typename CompletionToken>
+  auto AsyncSubmit(MountInfo request, CompletionToken &&token)
+  {
+    return boost::asio::async_initiate<CompletionToken, void(OperationResult)>(
+      [this](auto handler, MountInfo request) {
+        auto work = boost::asio::make_work_guard(boost::asio::get_associated_executor(handler));
+        Submit(
+          std::move(request),
+          [handler = std::move(handler), work = std::move(work)](OperationId, const OperationResult &result) mutable {
+            boost::asio::dispatch(
+              work.get_executor(), [handler = std::move(handler), result]() mutable { std::move(handler)(result); });
+            work.reset();
+          });
+      },
+      token,
+      std::move(request));
+  }
+
+  // Idempotent, logs the helpers' resource usage once everything is done
+  void Shutdown();
+
+private:
+  Engine(EngineOptions options, std::optional<KeySource> keys);
+
+  void run();
+  void complete(OperationId id, OperationResult result);
+
+  auto perform(MountInfo request) -> boost::asio::awaitable<OperationResult>;
+  // a mount or unmount of several targets, one attach or detach each
+  auto performEach(MountInfo request) -> boost::asio::awaitable<OperationResult>;
+  auto attach(MountInfo info) -> boost::asio::awaitable<OperationResult>;
+  auto detach(MountInfo info) -> boost::asio::awaitable<OperationResult>;
+  // the session's operation and the states it went through end up in `record`, what its helpers used in `usage`,
+  // however the operation ends
+  auto attachVolume(MountInfo info, AuditRecord &record, ResourceUsage &usage)
+    -> boost::asio::awaitable<OperationResult>;
+  auto detachVolume(MountInfo info, AuditRecord &record, ResourceUsage &usage)
+    -> boost::asio::awaitable<OperationResult>;
+  auto indexVolumes(std::chrono::seconds sessionTimeout, ResourceUsage &usage)
+    -> boost::asio::awaitable<OperationResult>;
+  auto watchTargets(MountInfo info) -> boost::asio::awaitable<OperationResult>;
+  // with its own key spec (the unlock action's first argument) instead of the engine's key source
+  auto unlockVolumes(MountInfo info) -> boost::asio::awaitable<OperationResult>;
+  // the session for as long as `sessionTimeout` allows, false when interrupted while waiting
+  auto awaitSession(std::optional<SessionLease> &lease, std::chrono::seconds sessionTimeout)
+    -> boost::asio::awaitable<bool>;
+  // ProbeReads of the volume mounted at `mount`, logged under the mount's operation
+  auto probeVolume(const MountPoint &mount, std::chrono::milliseconds phase, const LogFields &fields)
+    -> boost::asio::awaitable<ProbeResult>;
+  // Appends the records in order, resumes once the last one is durable (or could not be written)
+  auto audit(std::vector<AuditRecord> records) -> boost::asio::awaitable<void>;
+  // Logged, added to the run's summary and to `operation`, the usage the operation returns
+  void recordUsage(
+    const LogFields &fields, std::string_view helper, const ResourceUsage &usage, ResourceUsage &operation);
+  auto unlockCommand() -> UnlockCommand;
+
+  EngineOptions options_;
+
+  SystemExecutable diskpart_{"diskpart.exe", "BLT_DISKPART_PATH"};
+  SystemExecutable bdeunlock_{"bdeunlock.exe"};
+  SystemExecutable managebde_{"manage-bde.exe"};
+  Spawner diskpartSpawner_;
+  Spawner bdeunlockSpawner_;
+  Spawner managebdeSpawner_;
+  // BLT_UNLOCK_COMMAND, only ever launched when one is set
+  Spawner unlockCommandSpawner_;
+
+  MountPool pool_;
+  MountJournal journal_;
+  std::optional<SessionLock> sessions_;
+  std::optional<UnlockStage> unlock_;
+  // without one operations run unaudited, Shutdown stops it once the last record went out
+  std::unique_ptr<AuditLog> audit_;
+  UsageSummary usage_;
+
+  std::atomic<OperationId> nextId_{1};
+  std::mutex mutex_;
+  // guarded by mutex_, what has not completed yet
+  std::map<OperationId, Completion> pending_;
+  bool shuttingDown_ = false;
+  std::once_flag shutdown_;
+  // what the console's output code page was before the engine switched it to UTF-8, Shutdown puts it back
+  unsigned int consoleOutputCodePage_ = 0;
+
+  // declared after the state the operations use: frames the deadline abandoned are destroyed with the io_context and
+  // their cleanup (a pooled target, a ticket on the session board) still finds it
+  boost::asio::io_context ioc_;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_;
+  Interrupt interrupt_;
+  std::thread thread_;
+};
+
+auto ToString(OperationStatus status) -> std::string_view;
+
+}// namespace Blt
\ No newline at end of file
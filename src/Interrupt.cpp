@@ -0,0 +1,90 @@
+#include "Interrupt.hpp"
+
+#include <fmt/chrono.h>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <csignal>
+
+#include "Log.hpp"
+
+namespace asio = boost::asio;
+
+namespace Blt {
+
+Interrupt::Interrupt(asio::io_context &ioc, std::chrono::milliseconds grace)
+  : ioc_(ioc)
+  , signals_(ioc)
+  , broadcast_(ioc, SessionTimer::time_point::max())
+  , deadline_(ioc)
+  , grace_(grace)
+{}
+
+void Interrupt::Listen()
+{
+  // installed here and not by the constructor, an engine inside another process leaves that process's handlers alone
+  signals_.add(SIGINT);
+  signals_.add(SIGTERM);
+#ifdef SIGBREAK
+  signals_.add(SIGBREAK);
+#endif
+  wait();
+}
+
+void Interrupt::Request()
+{
+  if (not Requested()) begin("shutdown");
+}
+
+auto Interrupt::Wait(asio::cancellation_signal *child) -> asio::awaitable<void>
+{
+  if (not Requested()) co_await broadcast_.async_wait(asio::as_tuple(asio::use_awaitable));
+  // woken because a sibling of the `||` finished first, the child is no longer this one's to terminate
+  if (not Requested()) co_return;
+  if (child) child->emit(asio::cancellation_type::terminal);
+}
+
+void Interrupt::Done()
+{
+  if (Requested() and not doneAt_) doneAt_ = Clock::now();
+  signals_.cancel();
+  deadline_.cancel();
+}
+
+auto Interrupt::Teardown() const -> std::chrono::milliseconds
+{
+  if (not requestedAt_) return {};
+  return std::chrono::duration_cast<std::chrono::milliseconds>(doneAt_.value_or(Clock::now()) - *requestedAt_);
+}
+
+void Interrupt::wait()
+{
+  signals_.async_wait([this](const boost::system::error_code &ec, int number) {
+    if (ec) return;
+    if (Requested()) {
+      // absorbed, the deadline of the first one already bounds the teardown
+      Log(LogLevel::Warning, "interrupted again, teardown ends within {} of the first interrupt", grace_);
+    } else {
+      begin(fmt::format("signal {}", number));
+    }
+    wait();
+  });
+}
+
+void Interrupt::begin(std::string_view cause)
+{
+  requestedAt_ = Clock::now();
+  Log(LogLevel::Warning, "interrupted by {}, tearing down", cause);
+  broadcast_.cancel();
+
+  deadline_.expires_after(grace_);
+  deadline_.async_wait([this](const boost::system::error_code &ec) {
+    if (ec) return;
+    doneAt_ = Clock::now();
+    forced_ = true;
+    Log(LogLevel::Error, "teardown did not finish within {}, abandoning what is left", grace_);
+    ioc_.stop();
+  });
+}
+
+}// namespace Blt
\ No newline at end of file
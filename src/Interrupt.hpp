@@ -0,0 +1,69 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/signal_set.hpp>
+
+#include <chrono>
+#include <optional>
+#include <string_view>
+
+#include "SessionClock.hpp"
+
+namespace Blt {
+
+/**
+ * Turns SIGINT/SIGTERM (Ctrl-C and Ctrl-Break on Windows) into teardown of the running diskpart session instead of
+ * leaving the child and its pipes to the OS, where a later run finds VDS still busy with the orphaned session.
+ * Every session races Wait against its child and its conversation. On an interrupt Wait emits a terminal cancellation
+ * on the session's signal, which terminates the child bound to it, and completes, so the `||` cancels the
+ * conversation, its pending read fails and closeStreamsWithError closes both pipes.
+ * Teardown is bounded: whatever still runs `grace` after the interrupt is abandoned by stopping the io_context.
+ */
+class Interrupt
+{
+public:
+  using Clock = SessionClock;
+
+  Interrupt(boost::asio::io_context &ioc, std::chrono::milliseconds grace);
+
+  Interrupt(const Interrupt &)            = delete;
+  Interrupt &operator=(const Interrupt &) = delete;
+
+  // Starts listening, Done has to follow once the action finished or the io_context never runs out of work
+  void Listen();
+
+  // The same teardown without a signal, for an engine shutting down with operations still running
+  void Request();
+
+  // Completes when an interrupt arrives (right away when one already did), `child` is the signal the child is bound to
+  auto Wait(boost::asio::cancellation_signal *child = nullptr) -> boost::asio::awaitable<void>;
+
+  // The action finished, stops listening and the teardown deadline
+  void Done();
+
+  [[nodiscard]] auto Requested() const -> bool { return requestedAt_.has_value(); }
+
+  // From the interrupt to Done, or to the deadline when teardown did not finish in time
+  [[nodiscard]] auto Teardown() const -> std::chrono::milliseconds;
+
+  // Teardown hit the deadline and the io_context was stopped
+  [[nodiscard]] auto Forced() const -> bool { return forced_; }
+
+private:
+  void wait();
+  void begin(std::string_view cause);
+
+  boost::asio::io_context &ioc_;
+  boost::asio::signal_set signals_;
+  // never expires, cancelling it wakes every Wait at once
+  SessionTimer broadcast_;
+  SessionTimer deadline_;
+  std::chrono::milliseconds grace_;
+  std::optional<Clock::time_point> requestedAt_;
+  std::optional<Clock::time_point> doneAt_;
+  bool forced_ = false;
+};
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include "Log.hpp"
+
+#include <fmt/chrono.h>
+
+#include <cstdlib>
+#include <ctime>
+#include <string_view>
+#include <vector>
+
+namespace Blt {
+
+namespace {
+  std::atomic<uint64_t> lastOperation = 0;
+
+  void appendHuman(fmt::memory_buffer &out, const LogRecord &record)
+  {
+    const auto time         = std::chrono::system_clock::to_time_t(record.Time);
+    const auto milliseconds = std::chrono::floor<std::chrono::milliseconds>(record.Time).time_since_epoch() % 1000;
+    fmt::format_to(
+      std::back_inserter(out),
+      "{:%H:%M:%S}.{:03} {:<7}",
+      fmt::localtime(time),
+      milliseconds.count(),
+      ToString(record.Level));
+
+    const auto &fields = record.Fields;
+    if (fields.Operation != 0) fmt::format_to(std::back_inserter(out), " op={}", fields.Operation);
+    if (fields.State >= 0) fmt::format_to(std::back_inserter(out), " state={}", fields.State);
+    if (fields.Disk >= 0) fmt::format_to(std::back_inserter(out), " disk={}", fields.Disk);
+    if (fields.Partition >= 0) fmt::format_to(std::back_inserter(out), " partition={}", fields.Partition);
+
+    fmt::format_to(std::back_inserter(out), " | {}", std::string_view(record.Text.data(), record.Size));
+    if (record.Truncated) out.append(std::string_view("..."));
+    out.push_back('\n');
+  }
+
+  void appendJson(fmt::memory_buffer &out, const LogRecord &record)
+  {
+    fmt::format_to(
+      std::back_inserter(out),
+      R"({{"time":"{:%FT%TZ}","level":"{}")",
+      std::chrono::floor<std::chrono::milliseconds>(record.Time),
+      ToString(record.Level));
+
+    const auto &fields = record.Fields;
+    if (fields.Operation != 0) fmt::format_to(std::back_inserter(out), R"(,"op":{})", fields.Operation);
+    if (fields.State >= 0) fmt::format_to(std::back_inserter(out), R"(,"state":{})", fields.State);
+    if (fields.Disk >= 0) fmt::format_to(std::back_inserter(out), R"(,"disk":{})", fields.Disk);
+    if (fields.Partition >= 0) fmt::format_to(std::back_inserter(out), R"(,"partition":{})", fields.Partition);
+    if (record.Truncated) out.append(std::string_view(R"(,"truncated":true)"));
+
+    out.append(std::string_view(R"(,"msg":)"));
+    AppendJsonString(out, std::string_view(record.Text.data(), record.Size));
+    out.append(std::string_view("}\n"));
+  }
+}// namespace
+
+auto LogOptionsFromEnvironment() -> LogOptions
+{
+  auto options = LogOptions();
+  if (const auto *format = std::getenv("BLT_LOG_FORMAT"); format and std::string_view(format) == "json")
+    options.Format = LogFormat::Json;
+
+  if (const auto *level = std::getenv("BLT_LOG_LEVEL")) {
+    const auto name = std::string_view(level);
+    if (name == "debug") options.Threshold = LogLevel::Debug;
+    if (name == "warning") options.Threshold = LogLevel::Warning;
+    if (name == "error") options.Threshold = LogLevel::Error;
+  }
+  return options;
+}
+
+auto LogSink::Instance() -> LogSink &
+{
+  static auto sink = LogSink();
+  return sink;
+}
+
+LogSink::~LogSink() { Stop(); }
+
+void LogSink::Start(LogOptions options)
+{
+  if (running_.load()) return;
+
+  options_ = options;
+  threshold_.store(options.Threshold);
+  slots_ = std::make_unique<Slot[]>(Capacity);
+  for (std::size_t index = 0; index < Capacity; ++index)
+    slots_[index].Sequence.store(index, std::memory_order_relaxed);
+  head_.store(0);
+  pending_.store(0);
+  tail_ = 0;
+
+  stopping_.store(false);
+  writer_ = std::thread([this] { writerLoop(); });
+  running_.store(true);
+}
+
+void LogSink::Stop()
+{
+  if (not running_.exchange(false)) return;
+
+  stopping_.store(true);
+  pending_.fetch_add(1);
+  pending_.notify_one();
+  writer_.join();
+}
+
+void LogSink::Push(const LogRecord &record) noexcept
+{
+  if (not running_.load(std::memory_order_acquire)) {
+    const auto *single = &record;
+    auto lock          = std::scoped_lock(syncWrite_);
+    write(&single, 1);
+    return;
+  }
+
+  if (not tryPush(record)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // only the push that finds the writer idle pays for the wake up
+  if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) pending_.notify_one();
+}
+
+// bounded multi-producer ring after Vyukov: a slot is free for position p when its sequence is p, readable at p + 1
+auto LogSink::tryPush(const LogRecord &record) noexcept -> bool
+{
+  auto position = head_.load(std::memory_order_relaxed);
+  while (true) {
+    auto &slot          = slots_[position % Capacity];
+    const auto sequence = slot.Sequence.load(std::memory_order_acquire);
+    const auto distance = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+    if (distance < 0) return false;
+    if (distance > 0) {
+      position = head_.load(std::memory_order_relaxed);
+      continue;
+    }
+    if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+      slot.Record = record;
+      slot.Sequence.store(position + 1, std::memory_order_release);
+      return true;
+    }
+  }
+}
+
+void LogSink::writerLoop()
+{
+  auto batch = std::vector<const LogRecord *>();
+  batch.reserve(Capacity + 1);
+  while (true) {
+    pending_.wait(0, std::memory_order_acquire);
+
+    // a batch is everything published so far, slots are only handed back once the batch is written
+    const auto first = tail_;
+    while (batch.size() < Capacity) {
+      auto &slot = slots_[tail_ % Capacity];
+      if (slot.Sequence.load(std::memory_order_acquire) != tail_ + 1) break;
+      batch.push_back(&slot.Record);
+      ++tail_;
+    }
+
+    if (const auto dropped = dropped_.exchange(0, std::memory_order_relaxed); dropped != 0) {
+      auto notice = LogRecord{.Time = std::chrono::system_clock::now(), .Level = LogLevel::Warning};
+      auto result = fmt::format_to_n(
+        notice.Text.data(), notice.Text.size(), "dropped {} log records, the queue was full", dropped);
+      notice.Size = static_cast<uint16_t>(result.size);
+      batch.push_back(&notice);
+      write(batch.data(), batch.size());
+      batch.pop_back();
+    } else if (not batch.empty()) {
+      write(batch.data(), batch.size());
+    }
+
+    for (auto position = first; position != tail_; ++position)
+      slots_[position % Capacity].Sequence.store(position + Capacity, std::memory_order_release);
+    pending_.fetch_sub(static_cast<int64_t>(batch.size()), std::memory_order_acq_rel);
+
+    // Stop bumped pending_ without publishing a record, the loop ends once that is the only count left
+    if (stopping_.load() and batch.empty() and pending_.load() <= 1) break;
+    batch.clear();
+  }
+}
+
+void LogSink::write(const LogRecord *const *records, std::size_t count)
+{
+  auto out = fmt::memory_buffer();
+  for (std::size_t index = 0; index < count; ++index) {
+    if (options_.Format == LogFormat::Json) {
+      appendJson(out, *records[index]);
+    } else {
+      appendHuman(out, *records[index]);
+    }
+  }
+  std::fwrite(out.data(), 1, out.size(), options_.Output);
+  std::fflush(options_.Output);
+}
+
+void AppendJsonString(fmt::memory_buffer &out, std::string_view text)
+{
+  out.push_back('"');
+  for (const char character : text) {
+    switch (character) {
+    case '"':
+      out.append(std::string_view("\\\""));
+      break;
+    case '\\':
+      out.append(std::string_view("\\\\"));
+      break;
+    case '\n':
+      out.append(std::string_view("\\n"));
+      break;
+    case '\r':
+      out.append(std::string_view("\\r"));
+      break;
+    case '\t':
+      out.append(std::string_view("\\t"));
+      break;
+    default:
+      if (static_cast<unsigned char>(character) < 0x20) {
+        fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned char>(character));
+      } else {
+        out.push_back(character);
+      }
+    }
+  }
+  out.push_back('"');
+}
+
+auto NextLogOperation() noexcept -> uint64_t { return lastOperation.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+auto ToString(LogLevel level) -> std::string_view
+{
+  switch (level) {
+  case LogLevel::Debug:
+    return "debug";
+  case LogLevel::Info:
+    return "info";
+  case LogLevel::Warning:
+    return "warning";
+  case LogLevel::Error:
+    return "error";
+  }
+  return "unknown";
+}
+
+}// namespace Blt
\ No newline at end of file
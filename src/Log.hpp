@@ -0,0 +1,150 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace Blt {
+
+enum struct LogLevel : uint8_t {
+  Debug,
+  Info,
+  Warning,
+  Error,
+};
+
+enum struct LogFormat : uint8_t {
+  Human,
+  Json,
+};
+
+// What a record is about, -1 and 0 mean "not known here" and are left out of the output
+struct LogFields
+{
+  uint64_t Operation = 0;
+  int State          = -1;
+  int Disk           = -1;
+  int Partition      = -1;
+};
+
+/**
+ * One formatted message, fixed size so queueing it never allocates.
+ * Longer messages are cut at Text's size, which is enough for every message but raw diskpart output.
+ */
+struct LogRecord
+{
+  std::chrono::system_clock::time_point Time;
+  LogFields Fields;
+  LogLevel Level;
+  bool Truncated;
+  uint16_t Size;
+  std::array<char, 440> Text;
+};
+
+struct LogOptions
+{
+  LogFormat Format   = LogFormat::Human;
+  LogLevel Threshold = LogLevel::Info;
+  std::FILE *Output  = stdout;
+};
+
+// BLT_LOG_FORMAT=human|json and BLT_LOG_LEVEL=debug|info|warning|error, anything else keeps the default
+auto LogOptionsFromEnvironment() -> LogOptions;
+
+/**
+ * Process wide log sink. Producers format into a LogRecord on their own thread and hand it to a bounded lock-free
+ * ring, a background thread turns batches of records into text and writes each batch with a single fwrite.
+ * A producer never waits for the console: when the ring is full the record is dropped and counted, the writer
+ * reports the count with its next batch.
+ * Before Start and after Stop records are written synchronously, so tools that never start the sink still log.
+ */
+class LogSink
+{
+public:
+  static constexpr std::size_t Capacity = 1024;
+
+  static auto Instance() -> LogSink &;
+
+  ~LogSink();
+
+  LogSink(const LogSink &)            = delete;
+  LogSink &operator=(const LogSink &) = delete;
+
+  void Start(LogOptions options);
+
+  // Writes everything still queued and joins the writer
+  void Stop();
+
+  [[nodiscard]] auto Enabled(LogLevel level) const noexcept -> bool
+  {
+    return level >= threshold_.load(std::memory_order_relaxed);
+  }
+
+  void Push(const LogRecord &record) noexcept;
+
+private:
+  struct Slot
+  {
+    std::atomic<std::size_t> Sequence;
+    LogRecord Record;
+  };
+
+  LogSink() = default;
+
+  auto tryPush(const LogRecord &record) noexcept -> bool;
+  void writerLoop();
+  void write(const LogRecord *const *records, std::size_t count);
+
+  LogOptions options_;
+  std::atomic<LogLevel> threshold_ = LogLevel::Info;
+  std::atomic<bool> running_       = false;
+  std::atomic<bool> stopping_      = false;
+  std::unique_ptr<Slot[]> slots_;
+  std::thread writer_;
+  std::mutex syncWrite_;
+
+  // producers and the writer touch different ends of the ring, keep them off each other's cache line
+  alignas(64) std::atomic<std::size_t> head_ = 0;
+  alignas(64) std::atomic<int64_t> pending_  = 0;
+  std::atomic<uint64_t> dropped_             = 0;
+  alignas(64) std::size_t tail_              = 0;
+};
+
+// Distinct per diskpart session or other unit of work, lets interleaved records be told apart
+auto NextLogOperation() noexcept -> uint64_t;
+
+auto ToString(LogLevel level) -> std::string_view;
+
+// `text` as a quoted JSON string, control characters escaped
+void AppendJsonString(fmt::memory_buffer &out, std::string_view text);
+
+template<typename... Args>
+void Log(LogLevel level, const LogFields &fields, fmt::format_string<Args...> format, Args &&...args)
+{
+  auto &sink = LogSink::Instance();
+  if (not sink.Enabled(level)) return;
+
+  auto record      = LogRecord{.Time = std::chrono::system_clock::now(), .Fields = fields, .Level = level};
+  auto result      = fmt::format_to_n(record.Text.data(), record.Text.size(), format, std::forward<Args>(args)...);
+  record.Size      = static_cast<uint16_t>(std::min(result.size, record.Text.size()));
+  record.Truncated = result.size > record.Text.size();
+  sink.Push(record);
+}
+
+template<typename... Args>
+void Log(LogLevel level, fmt::format_string<Args...> format, Args &&...args)
+{
+  Log(level, LogFields{}, format, std::forward<Args>(args)...);
+}
+
+}// namespace Blt
\ No newline at end of file
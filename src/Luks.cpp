@@ -0,0 +1,271 @@
+#include "Luks.hpp"
+
+#ifdef __linux__
+#include <fmt/format.h>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/asio/writable_pipe.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <exception>
+#include <system_error>
+#include <utility>
+
+#include <unistd.h>
+
+#include "Common.hpp"
+#include "Log.hpp"
+
+namespace Blt {
+
+namespace asio = boost::asio;
+
+namespace {
+  auto mapperPath(std::string_view device) -> std::string
+  {
+    return fmt::format("/dev/mapper/{}", LuksMapperName(device));
+  }
+}// namespace
+
+LuksBackend::LuksBackend(LuksCommands commands, KeySource keys, MountPool &pool, std::filesystem::path sysBlock)
+  : commands_(commands)
+  , keys_(std::move(keys))
+  , pool_(pool)
+  , sysBlock_(std::move(sysBlock))
+{}
+
+auto LuksBackend::Attach(LuksTarget target) -> asio::awaitable<LuksResult>
+{
+  auto result = LuksResult{.Error = LuksError::Success, .Device = {}, .Mount = target.Mount, .Usage = {}};
+  if (auto device = FindSysfsDevice(target.Location, sysBlock_)) {
+    result.Device = std::move(*device);
+  } else {
+    Log(
+      LogLevel::Error,
+      "no block device is disk #{} partition #{} with the given capacities",
+      target.Location.DiskNumber,
+      target.Location.PartitionNumber);
+    result.Error = LuksError::NoDevice;
+    co_return result;
+  }
+
+  if (result.Mount.Letter != 0) {
+    Log(LogLevel::Error, "{}: drive letters do not exist here, give a folder or *", result.Device);
+    result.Error = LuksError::NoMountPoint;
+    co_return result;
+  }
+  if (result.Mount.Automatic) {
+    auto acquired = pool_.Acquire();
+    if (not acquired) {
+      Log(LogLevel::Error, "{}: no free mount folder left", result.Device);
+      result.Error = LuksError::NoMountPoint;
+      co_return result;
+    }
+    result.Mount = std::move(*acquired);
+  }
+  // a pooled folder goes back unless the volume ended up mounted on it
+  auto release = target.Mount.Automatic;
+  blt_defer {
+    if (release) pool_.Release(result.Mount);
+  };
+
+  auto key = co_await lookupKey(target, result.Device);
+  if (not key) {
+    Log(LogLevel::Warning, "no key for {}", result.Device);
+    result.Error = LuksError::NoKey;
+    co_return result;
+  }
+
+  const auto device = fmt::format("/dev/{}", result.Device);
+  const auto name   = LuksMapperName(result.Device);
+  auto open         = std::vector<std::string>{"open", "--type", "luks", "--key-file"};
+  auto input        = std::string_view();
+  switch (key->Kind) {
+  case UnlockKeyKind::Password: {
+    open.emplace_back("-");
+    input = key->Value.Reveal();
+    break;
+  }
+  case UnlockKeyKind::RecoveryKey: {
+    open.emplace_back(key->Value.Reveal());
+    break;
+  }
+  case UnlockKeyKind::RecoveryPassword: {
+    Log(LogLevel::Error, "{}: a recovery password only unlocks BitLocker volumes", result.Device);
+    result.Error = LuksError::UnsupportedKey;
+    co_return result;
+  }
+  }
+  open.push_back(device);
+  open.push_back(name);
+
+  Log(LogLevel::Info, "opening {} as {} with {} {}", device, name, ToString(key->Kind), key->Value);
+  if (const auto exitCode = co_await run(commands_.Cryptsetup, open, input, result.Usage); exitCode != 0) {
+    Log(LogLevel::Error, "{}: cryptsetup open exited with {}", device, exitCode);
+    result.Error = exitCode < 0 ? LuksError::SpawnFailed : LuksError::OpenFailed;
+    co_return result;
+  }
+
+  auto ec = std::error_code();
+  std::filesystem::create_directories(std::filesystem::path(result.Mount.Folder), ec);
+  const auto mount = std::array{mapperPath(result.Device), result.Mount.Folder};
+  if (const auto exitCode = co_await run(commands_.Mount, mount, {}, result.Usage); exitCode != 0) {
+    Log(LogLevel::Error, "{}: mount exited with {}, closing {} again", device, exitCode, name);
+    const auto close = std::array{std::string("close"), name};
+    co_await run(commands_.Cryptsetup, close, {}, result.Usage);
+    result.Error = exitCode < 0 ? LuksError::SpawnFailed : LuksError::MountFailed;
+    co_return result;
+  }
+
+  release = false;
+  Log(LogLevel::Info, "{} attached at {}", device, result.Mount);
+  co_return result;
+}
+
+auto LuksBackend::AttachAll(std::vector<LuksTarget> targets, std::size_t parallelism)
+  -> asio::awaitable<std::vector<LuksResult>>
+{
+  auto results = std::vector<LuksResult>(targets.size());
+  auto next    = std::size_t(0);
+  auto worker  = [&]() -> asio::awaitable<void> {
+    while (next < targets.size()) {
+      const auto index = next++;
+      results[index]   = co_await Attach(std::move(targets[index]));
+    }
+  };
+
+  auto executor = co_await asio::this_coro::executor;
+  auto workers  = std::vector<decltype(asio::co_spawn(executor, worker(), asio::deferred))>();
+  for (std::size_t count = 0; count < std::min(std::max<std::size_t>(parallelism, 1), targets.size()); ++count)
+    workers.push_back(asio::co_spawn(executor, worker(), asio::deferred));
+  if (workers.empty()) co_return results;
+
+  auto [order, exceptions] = co_await asio::experimental::make_parallel_group(std::move(workers))
+                               .async_wait(asio::experimental::wait_for_all(), asio::use_awaitable);
+  for (const auto &exception : exceptions) {
+    if (exception) std::rethrow_exception(exception);
+  }
+  co_return results;
+}
+
+auto LuksBackend::Detach(LuksTarget target) -> asio::awaitable<LuksResult>
+{
+  auto result = LuksResult{.Error = LuksError::Success, .Device = {}, .Mount = target.Mount, .Usage = {}};
+  if (not result.Mount.IsFolder()) {
+    Log(LogLevel::Error, "a LUKS volume is detached from the folder it is mounted at");
+    result.Error = LuksError::NoMountPoint;
+    co_return result;
+  }
+  if (auto device = FindSysfsDevice(target.Location, sysBlock_)) {
+    result.Device = std::move(*device);
+  } else {
+    result.Error = LuksError::NoDevice;
+    co_return result;
+  }
+
+  const auto umount = std::array{result.Mount.Folder};
+  if (const auto exitCode = co_await run(commands_.Umount, umount, {}, result.Usage); exitCode != 0) {
+    Log(LogLevel::Error, "{}: umount exited with {}", result.Mount, exitCode);
+    result.Error = exitCode < 0 ? LuksError::SpawnFailed : LuksError::UnmountFailed;
+    co_return result;
+  }
+
+  const auto close = std::array{std::string("close"), LuksMapperName(result.Device)};
+  if (const auto exitCode = co_await run(commands_.Cryptsetup, close, {}, result.Usage); exitCode != 0) {
+    Log(LogLevel::Error, "{}: cryptsetup close exited with {}", result.Device, exitCode);
+    result.Error = exitCode < 0 ? LuksError::SpawnFailed : LuksError::CloseFailed;
+    co_return result;
+  }
+  // a pooled folder can be handed out again
+  pool_.Release(result.Mount);
+  Log(LogLevel::Info, "/dev/{} detached from {}", result.Device, result.Mount);
+  co_return result;
+}
+
+auto LuksBackend::lookupKey(const LuksTarget &target, std::string_view device)
+  -> asio::awaitable<std::optional<UnlockKey>>
+{
+  if (target.Volume) {
+    if (auto key = co_await keys_.Lookup(fmt::format("{}@{}", target.Volume->DiskId, target.Volume->PartitionOffset)))
+      co_return std::move(key);
+  }
+  if (target.Mount.IsFolder()) {
+    if (auto key = co_await keys_.Lookup(target.Mount.Folder)) co_return std::move(key);
+  }
+  co_return co_await keys_.Lookup(fmt::format("/dev/{}", device));
+}
+
+auto LuksBackend::run(
+  Spawner &spawner, std::span<const std::string> arguments, std::string_view input, ResourceUsage &usage)
+  -> asio::awaitable<int>
+{
+  auto executor   = co_await asio::this_coro::executor;
+  auto in         = asio::writable_pipe(executor);
+  auto accounting = ChildAccounting();
+  auto ec         = boost::system::error_code();
+  auto process =
+    spawner.Launch(executor, arguments, SpawnStdio{.In = input.empty() ? nullptr : &in}, &accounting, ec);
+  if (ec) {
+    Log(LogLevel::Error, "unable to start {}: {}", spawner.Executable().string(), ec.message());
+    co_return -1;
+  }
+
+  // cryptsetup reads a key file of `-` up to EOF, a newline would become part of the passphrase. A helper that exits
+  // first (a device that is not LUKS, a mapping that is already open) fails the write with EPIPE, SIGPIPE is ignored
+  auto writeError = boost::system::error_code();
+  if (not input.empty()) {
+    auto [error, written] = co_await asio::async_write(in, asio::buffer(input), asio::as_tuple(asio::use_awaitable));
+    writeError            = error;
+    if (not error and written != input.size()) writeError = asio::error::broken_pipe;
+    in.close();
+  }
+
+  auto [waitError, exitCode] = co_await process.async_wait(asio::as_tuple(asio::use_awaitable));
+  usage += accounting.Collect();
+  if (waitError) co_return -1;
+  if (writeError) {
+    Log(
+      LogLevel::Error,
+      "{} exited with {} before it read its input: {}",
+      spawner.Executable().string(),
+      exitCode,
+      writeError.message());
+    co_return std::max(exitCode, 1);
+  }
+  co_return exitCode;
+}
+
+auto LuksMapperName(std::string_view device) -> std::string
+{
+  return fmt::format("blt-{}", device);
+}
+
+auto FindExecutable(std::string_view name, const char *overrideVariable) -> std::filesystem::path
+{
+  if (overrideVariable) {
+    if (const auto *standIn = std::getenv(overrideVariable); standIn and *standIn) return standIn;
+  }
+
+  const auto *path = std::getenv("PATH");
+  auto directories = fmt::format("{}:/usr/sbin:/sbin", path ? path : "");
+  for (std::size_t begin = 0; begin <= directories.size();) {
+    const auto end       = std::min(directories.find(':', begin), directories.size());
+    const auto directory = std::string_view(directories).substr(begin, end - begin);
+    begin                = end + 1;
+    if (directory.empty()) continue;
+
+    auto candidate = std::filesystem::path(directory) / name;
+    if (::access(candidate.c_str(), X_OK) == 0) return candidate;
+  }
+  // posix_spawn reports it as missing
+  return std::filesystem::path(name);
+}
+
+}// namespace Blt
+#endif
\ No newline at end of file
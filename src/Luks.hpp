@@ -0,0 +1,115 @@
+#pragma once
+
+#ifdef __linux__
+#include <boost/asio/awaitable.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Accounting.hpp"
+#include "MountPoint.hpp"
+#include "Spawn.hpp"
+#include "Unlock.hpp"
+#include "VolumeIndex.hpp"
+
+namespace Blt {
+
+// One LUKS volume to attach or detach, located the way diskpart locates a partition
+struct LuksTarget
+{
+  VolumeLocation Location;
+  // set when the target was given by identity, its key is looked up by `<disk id>@<offset>` first
+  std::optional<VolumeKey> Volume;
+  MountPoint Mount;
+};
+
+enum struct LuksError {
+  Success = 0,
+  NoDevice,
+  NoMountPoint,
+  NoKey,
+  UnsupportedKey,
+  SpawnFailed,
+  OpenFailed,
+  MountFailed,
+  UnmountFailed,
+  CloseFailed,
+};
+
+struct LuksResult
+{
+  LuksError Error;
+  // kernel name of the block device, empty when none matched
+  std::string Device;
+  MountPoint Mount;
+  ResourceUsage Usage;
+};
+
+/**
+ * The helpers an attach runs, each one replaceable by a stand-in through its Spawner's resolver.
+ * Cryptsetup is started as `open --type luks --key-file <file|-> <device> <name>` and `close <name>`, Mount as
+ * `<device> <folder>` and Umount as `<folder>`, which is what cryptsetup, mount and umount take.
+ */
+struct LuksCommands
+{
+  Spawner &Cryptsetup;
+  Spawner &Mount;
+  Spawner &Umount;
+};
+
+/**
+ * Attach and detach of LUKS volumes, the Linux counterpart of the diskpart session.
+ * The block device is matched in sysfs by disk and partition number and both capacities, opened through cryptsetup
+ * as /dev/mapper/blt-<kernel name> and the mapper device is mounted at a folder. There are no drive letters here,
+ * `*` takes a folder from the MountPool.
+ * Keys come from the same KeySource as BitLocker unlocks, looked up by volume identity, then mount point, then
+ * /dev/<kernel name>. A password is written to cryptsetup's stdin without a newline, a recovery key is a key file
+ * path passed as --key-file. Recovery passwords only exist for BitLocker and are refused.
+ */
+class LuksBackend
+{
+public:
+  LuksBackend(
+    LuksCommands commands, KeySource keys, MountPool &pool, std::filesystem::path sysBlock = "/sys/block");
+
+  auto Attach(LuksTarget target) -> boost::asio::awaitable<LuksResult>;
+
+  /**
+   * Every target is opened and mounted on its own, so one slow key derivation (LUKS2 argon2 takes a second or more
+   * by design) does not hold up the others. At most `parallelism` attaches run at once, workers pull targets from a
+   * shared cursor like UnlockStage does.
+   */
+  auto AttachAll(std::vector<LuksTarget> targets, std::size_t parallelism)
+    -> boost::asio::awaitable<std::vector<LuksResult>>;
+
+  auto Detach(LuksTarget target) -> boost::asio::awaitable<LuksResult>;
+
+private:
+  auto lookupKey(const LuksTarget &target, std::string_view device) -> boost::asio::awaitable<std::optional<UnlockKey>>;
+
+  // The helper's exit code, -1 when it could not be started or waited for, never 0 when it did not take all of `input`
+  auto run(Spawner &spawner, std::span<const std::string> arguments, std::string_view input, ResourceUsage &usage)
+    -> boost::asio::awaitable<int>;
+
+  LuksCommands commands_;
+  KeySource keys_;
+  MountPool &pool_;
+  std::filesystem::path sysBlock_;
+};
+
+// `blt-<kernel name>`, the device-mapper name a volume is opened as
+auto LuksMapperName(std::string_view device) -> std::string;
+
+/**
+ * Absolute path of a helper: the value of `overrideVariable` when it is set, which is how stand-ins replace the real
+ * tools, otherwise the first match in PATH and then /usr/sbin and /sbin. posix_spawn does not search PATH itself.
+ */
+auto FindExecutable(std::string_view name, const char *overrideVariable = nullptr) -> std::filesystem::path;
+
+}// namespace Blt
+#endif
\ No newline at end of file
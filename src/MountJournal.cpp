@@ -0,0 +1,349 @@
+#include "MountJournal.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Common.hpp"
+#include "Log.hpp"
+
+namespace Blt {
+
+namespace {
+  constexpr auto journalHeader = std::string_view("# BitLockerTool mount journal v1");
+  constexpr auto hashDigits    = std::size_t{16};
+
+  auto hashLine(std::string_view payload) -> uint64_t
+  {
+    // FNV-1a, a torn or hand edited line only has to be told apart from an intact one
+    auto hash = uint64_t{0xcbf29ce484222325};
+    for (auto byte : payload) {
+      hash ^= static_cast<unsigned char>(byte);
+      hash *= 0x100000001b3;
+    }
+    return hash;
+  }
+
+  // "X:" with an upper case letter or the folder, two spellings of the same target are one key
+  auto mountKey(const MountPoint &mount) -> std::string
+  {
+    if (mount.Letter == 0) return mount.Folder;
+    const auto upper = mount.Letter >= 'a' ? static_cast<char>(mount.Letter - 'a' + 'A') : mount.Letter;
+    return fmt::format("{}:", upper);
+  }
+
+  auto formatRecord(const MountRecord &record) -> std::string
+  {
+    return fmt::format(
+      "+ {} {} {} {} {} {} {} {}",
+      record.DiskNumber,
+      record.DiskCapacity.Count(),
+      record.PartitionNumber,
+      record.PartitionCapacity.Count(),
+      record.Volume ? record.Volume->DiskId : "-",
+      record.Volume ? record.Volume->PartitionOffset : 0,
+      record.VolumeName.empty() ? "-" : record.VolumeName,
+      mountKey(record.Mount));
+  }
+
+  auto formatLine(std::string_view payload) -> std::string
+  {
+    return fmt::format("{:016x} {}\n", hashLine(payload), payload);
+  }
+
+  auto parseRecord(std::string_view payload) -> std::optional<MountRecord>
+  {
+    auto stream = std::istringstream(std::string(payload.substr(2)));
+    auto record = MountRecord();
+    auto diskId = std::string();
+    uint64_t diskCapacity;
+    uint64_t partitionCapacity;
+    uint64_t partitionOffset;
+    if (not(stream >> record.DiskNumber >> diskCapacity >> record.PartitionNumber >> partitionCapacity >> diskId
+            >> partitionOffset >> record.VolumeName))
+      return std::nullopt;
+    stream.get();
+
+    // the mount point is the rest of the line, a folder may contain blanks
+    auto mount = std::string();
+    std::getline(stream, mount);
+    auto parsed = mount.size() == 2 and mount[1] == ':' ? ParseMountPoint(mount.substr(0, 1), false)
+                                                        : ParseMountPoint(mount, false);
+    if (not parsed) return std::nullopt;
+
+    record.DiskCapacity      = CapacityBytes(diskCapacity);
+    record.PartitionCapacity = CapacityBytes(partitionCapacity);
+    if (diskId != "-") record.Volume = VolumeKey{.DiskId = std::move(diskId), .PartitionOffset = partitionOffset};
+    if (record.VolumeName == "-") record.VolumeName.clear();
+    record.Mount = std::move(*parsed);
+    return record;
+  }
+
+  // Replays the lines after the header into `records`, returns how many bytes of `content` are intact
+  auto replay(std::string_view content, std::vector<MountRecord> &records) -> std::size_t
+  {
+    auto intact = journalHeader.size() + 1;
+    for (auto rest = content.substr(std::min(intact, content.size())); not rest.empty();) {
+      const auto end = rest.find('\n');
+      if (end == std::string_view::npos) break;
+      const auto line = rest.substr(0, end);
+      if (line.size() < hashDigits + 3 or line[hashDigits] != ' ') break;
+
+      auto hash          = uint64_t{0};
+      auto [_, error]    = std::from_chars(line.data(), line.data() + hashDigits, hash, 16);
+      const auto payload = line.substr(hashDigits + 1);
+      if (error != std::errc() or hash != hashLine(payload)) break;
+
+      if (payload.starts_with("+ ")) {
+        auto record = parseRecord(payload);
+        if (not record) break;
+        std::erase_if(
+          records, [&record](const MountRecord &entry) { return mountKey(entry.Mount) == mountKey(record->Mount); });
+        records.push_back(std::move(*record));
+      } else if (payload.starts_with("- ")) {
+        const auto key = payload.substr(2);
+        std::erase_if(records, [key](const MountRecord &entry) { return mountKey(entry.Mount) == key; });
+      } else {
+        break;
+      }
+      intact += end + 1;
+      rest.remove_prefix(end + 1);
+    }
+    return std::min(intact, content.size());
+  }
+
+  auto readContent(const std::filesystem::path &path) -> std::optional<std::string>
+  {
+    auto file = std::ifstream(path, std::ios::binary);
+    if (not file) return std::nullopt;
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+#ifdef _WIN32
+  using File = HANDLE;
+
+  // appending opens with FILE_APPEND_DATA only, every write lands at the end whatever the file pointer says
+  auto openFile(const std::filesystem::path &path, bool truncate) -> File
+  {
+    return CreateFileW(
+      path.c_str(),
+      truncate ? GENERIC_WRITE : FILE_APPEND_DATA | SYNCHRONIZE,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      nullptr,
+      truncate ? CREATE_ALWAYS : OPEN_ALWAYS,
+      FILE_ATTRIBUTE_NORMAL,
+      nullptr);
+  }
+
+  auto isOpen(File file) -> bool { return file != INVALID_HANDLE_VALUE; }
+
+  void closeFile(File file) { CloseHandle(file); }
+
+  auto isEmpty(File file) -> bool
+  {
+    auto size = LARGE_INTEGER{};
+    return GetFileSizeEx(file, &size) and size.QuadPart == 0;
+  }
+
+  auto writeAll(File file, std::string_view bytes) -> bool
+  {
+    while (not bytes.empty()) {
+      auto written = DWORD{0};
+      if (not WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr)) return false;
+      bytes.remove_prefix(written);
+    }
+    return true;
+  }
+
+  auto syncData(File file) -> bool { return FlushFileBuffers(file); }
+
+  // NTFS journals the directory entry, flushing the file is enough for a new one to survive
+  auto syncDirectory(const std::filesystem::path &) -> bool { return true; }
+
+  auto replaceFile(const std::filesystem::path &from, const std::filesystem::path &to) -> bool
+  {
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+  }
+#else
+  using File = int;
+
+  auto openFile(const std::filesystem::path &path, bool truncate) -> File
+  {
+    return ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : O_APPEND), 0640);
+  }
+
+  auto isOpen(File file) -> bool { return file >= 0; }
+
+  void closeFile(File file) { ::close(file); }
+
+  auto isEmpty(File file) -> bool
+  {
+    struct stat status;
+    return ::fstat(file, &status) == 0 and status.st_size == 0;
+  }
+
+  auto writeAll(File file, std::string_view bytes) -> bool
+  {
+    while (not bytes.empty()) {
+      const auto written = ::write(file, bytes.data(), bytes.size());
+      if (written < 0 and errno == EINTR) continue;
+      if (written < 0) return false;
+      bytes.remove_prefix(static_cast<std::size_t>(written));
+    }
+    return true;
+  }
+
+  auto syncData(File file) -> bool { return ::fdatasync(file) == 0; }
+
+  // a created or renamed file is only durable once the directory entry pointing at it is
+  auto syncDirectory(const std::filesystem::path &path) -> bool
+  {
+    const auto parent    = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+    const auto directory = ::open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory < 0) return false;
+    const auto synced = ::fsync(directory) == 0;
+    ::close(directory);
+    return synced;
+  }
+
+  auto replaceFile(const std::filesystem::path &from, const std::filesystem::path &to) -> bool
+  {
+    return ::rename(from.c_str(), to.c_str()) == 0 and syncDirectory(to);
+  }
+#endif
+}// namespace
+
+MountJournal::MountJournal(std::filesystem::path path)
+  : path_(std::move(path))
+{}
+
+auto MountJournal::Open(std::filesystem::path path) -> MountJournal
+{
+  auto journal = MountJournal(std::move(path));
+
+  // a compaction that did not get to its rename, the journal itself is still whole
+  auto staging = journal.path_;
+  staging += ".tmp";
+  auto ec = std::error_code();
+  std::filesystem::remove(staging, ec);
+
+  const auto content = readContent(journal.path_);
+  if (not content or not content->starts_with(journalHeader)) return journal;
+
+  const auto intact = replay(*content, journal.records_);
+  if (intact < content->size()) {
+    Log(
+      LogLevel::Warning,
+      "mount journal has {} bytes of an interrupted write, dropping them",
+      content->size() - intact);
+    std::filesystem::resize_file(journal.path_, intact, ec);
+  }
+  return journal;
+}
+
+auto MountJournal::Find(const MountPoint &mount) const -> const MountRecord *
+{
+  const auto key   = mountKey(mount);
+  const auto entry = std::ranges::find_if(records_, [&key](const MountRecord &record) {
+    return mountKey(record.Mount) == key;
+  });
+  return entry == records_.end() ? nullptr : &*entry;
+}
+
+auto MountJournal::Append(MountRecord record) -> bool
+{
+  if (not appendLine(formatRecord(record))) return false;
+  const auto key = mountKey(record.Mount);
+  std::erase_if(records_, [&key](const MountRecord &entry) { return mountKey(entry.Mount) == key; });
+  records_.push_back(std::move(record));
+  return true;
+}
+
+auto MountJournal::Remove(const MountPoint &mount) -> bool
+{
+  const auto key = mountKey(mount);
+  if (not appendLine(fmt::format("- {}", key))) return false;
+  std::erase_if(records_, [&key](const MountRecord &entry) { return mountKey(entry.Mount) == key; });
+
+  // the removal is already durable, a failed compaction only leaves a longer journal for the next run
+  if (not compact()) Log(LogLevel::Warning, "unable to compact the mount journal {}", path_.string());
+  return true;
+}
+
+auto MountJournal::appendLine(std::string_view payload) -> bool
+{
+  auto ec = std::error_code();
+  if (path_.has_parent_path()) std::filesystem::create_directories(path_.parent_path(), ec);
+
+  const auto file = openFile(path_, false);
+  if (not isOpen(file)) return false;
+  const auto fresh = isEmpty(file);
+  auto bytes       = fresh ? fmt::format("{}\n", journalHeader) : std::string();
+  bytes += formatLine(payload);
+  const auto written = writeAll(file, bytes) and syncData(file);
+  closeFile(file);
+  return written and (not fresh or syncDirectory(path_));
+}
+
+auto MountJournal::compact() -> bool
+{
+  // another process may have appended since Open, replaying the file as it is now keeps what it attached. A torn
+  // line is left for the next Open to cut, the rewrite would have to drop it
+  const auto content = readContent(path_);
+  if (not content or not content->starts_with(journalHeader)) return false;
+  auto current = std::vector<MountRecord>();
+  if (replay(*content, current) != content->size()) return false;
+  records_ = std::move(current);
+
+  auto bytes = fmt::format("{}\n", journalHeader);
+  for (const auto &record : records_) bytes += formatLine(formatRecord(record));
+
+  auto staging = path_;
+  staging += ".tmp";
+  const auto file = openFile(staging, true);
+  if (not isOpen(file)) return false;
+  const auto written = writeAll(file, bytes) and syncData(file);
+  closeFile(file);
+  return written and replaceFile(staging, path_);
+}
+
+auto DefaultMountJournalPath() -> std::filesystem::path
+{
+  return DefaultVolumeIndexPath().replace_filename("mounts.journal");
+}
+
+auto MountedVolumeName([[maybe_unused]] const MountPoint &mount) -> std::string
+{
+#ifdef _WIN32
+  auto root = std::wstring{static_cast<wchar_t>(mount.Letter), L':'};
+  if (mount.Letter == 0)
+    root = std::filesystem::path(std::u8string(mount.Folder.begin(), mount.Folder.end())).wstring();
+  if (not root.ends_with(L'\\')) root += L'\\';
+
+  std::array<wchar_t, 64> name;
+  if (not GetVolumeNameForVolumeMountPointW(root.c_str(), name.data(), static_cast<DWORD>(name.size()))) return {};
+  // `\\?\Volume{GUID}\` is plain ASCII
+  auto volumeName = std::string();
+  for (auto character = name.data(); *character != L'\0'; ++character) volumeName += static_cast<char>(*character);
+  return volumeName;
+#else
+  return {};
+#endif
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MountPoint.hpp"
+#include "Unit.hpp"
+#include "VolumeIndex.hpp"
+
+namespace Blt {
+
+// What a successful mount resolved its target to, enough to undo it without walking the list tables again
+struct MountRecord
+{
+  int DiskNumber;
+  CapacityBytes DiskCapacity;
+  int PartitionNumber;
+  CapacityBytes PartitionCapacity;
+  // set when the target was given by identity
+  std::optional<VolumeKey> Volume;
+  // `\\?\Volume{GUID}\` the mount point led to right after the assign, empty when it could not be read
+  std::string VolumeName;
+  MountPoint Mount;
+};
+
+/**
+ * Append-only log of the volumes this tool attached, so unmount can skip the list-disk/list-partition validation for
+ * a target the same tool already validated.
+ * A mount appends one line, an unmount appends a removal and then compacts the file down to the volumes that are
+ * still attached (written to a sibling and renamed over it like the volume index).
+ * Every line carries a hash of its content. Opening replays the lines and cuts the file at the first one that is
+ * incomplete or does not hash, which is what a crash in the middle of an append leaves behind.
+ * An append is synced to disk before it returns, a compaction syncs the sibling before the rename and the directory
+ * after it. Append and Remove are called with the session lock held: the compaction replays the file again first,
+ * so it keeps what other processes appended since Open.
+ */
+class MountJournal
+{
+public:
+  static auto Open(std::filesystem::path path) -> MountJournal;
+
+  [[nodiscard]] auto Find(const MountPoint &mount) const -> const MountRecord *;
+
+  auto Append(MountRecord record) -> bool;
+
+  // After a clean unmount, false when the removal could not be written
+  auto Remove(const MountPoint &mount) -> bool;
+
+  [[nodiscard]] auto Size() const -> std::size_t { return records_.size(); }
+
+private:
+  explicit MountJournal(std::filesystem::path path);
+
+  auto appendLine(std::string_view payload) -> bool;
+  auto compact() -> bool;
+
+  std::filesystem::path path_;
+  std::vector<MountRecord> records_;
+};
+
+// mounts.journal next to the volume index
+auto DefaultMountJournalPath() -> std::filesystem::path;
+
+/**
+ * The `\\?\Volume{GUID}\` name of the volume attached at `mount` right now, empty when nothing is or the platform
+ * has no such name. Reading it is one call, no diskpart session.
+ */
+auto MountedVolumeName(const MountPoint &mount) -> std::string;
+
+}// namespace Blt
\ No newline at end of file
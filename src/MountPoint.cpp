@@ -0,0 +1,170 @@
+#include "MountPoint.hpp"
+
+#include <bit>
+#include <charconv>
+#include <cstdlib>
+#include <system_error>
+
+#include "Common.hpp"
+
+namespace Blt {
+
+namespace {
+  constexpr auto folderPrefix = std::string_view("volume-");
+  // C to Z, A and B are never handed out
+  constexpr auto usableLetters = ((uint32_t{1} << 26) - 1) & ~uint32_t{0b11};
+
+  auto isLetter(char letter) -> bool { return (letter >= 'a' and letter <= 'z') or (letter >= 'A' and letter <= 'Z'); }
+
+  auto letterBit(char letter) -> uint32_t
+  {
+    const auto upper = letter >= 'a' ? static_cast<char>(letter - 'a' + 'A') : letter;
+    return uint32_t{1} << (upper - 'A');
+  }
+
+  auto toUtf8(const std::filesystem::path &path) -> std::string
+  {
+    const auto utf8 = path.u8string();
+    return std::string(utf8.begin(), utf8.end());
+  }
+
+  auto fromUtf8(std::string_view utf8) -> std::filesystem::path
+  {
+    return std::filesystem::path(std::u8string(utf8.begin(), utf8.end()));
+  }
+}// namespace
+
+auto ParseMountPoint(std::string_view argument, bool automatic) -> std::optional<MountPoint>
+{
+  if (argument == "*") {
+    if (not automatic) return std::nullopt;
+    return MountPoint{.Letter = 0, .Folder = {}, .Automatic = true};
+  }
+  if (argument.size() == 1) {
+    if (not isLetter(argument[0])) return std::nullopt;
+    return MountPoint{.Letter = argument[0], .Folder = {}, .Automatic = false};
+  }
+  // the path goes into a quoted diskpart argument, which has no escape for a quote
+  if (argument.find('"') != std::string_view::npos or not fromUtf8(argument).is_absolute()) return std::nullopt;
+  return MountPoint{.Letter = 0, .Folder = std::string(argument), .Automatic = false};
+}
+
+MountPool::MountPool(LetterSource freeLetters, std::filesystem::path folderRoot)
+  : freeLetters_(freeLetters)
+  , letters_(freeLetters() & usableLetters)
+  , folderRoot_(std::move(folderRoot))
+{
+  for (auto &word : folders_) word.store(~uint64_t{0}, std::memory_order_relaxed);
+}
+
+auto MountPool::Acquire() -> std::optional<MountPoint>
+{
+  auto state = letters_.load(std::memory_order_relaxed);
+  auto asked = false;
+  while (true) {
+    const auto free = static_cast<uint32_t>(state);
+    if (free == 0) {
+      // once per Acquire, a letter source with nothing free sends the mount to the folders
+      if (asked) break;
+      asked           = true;
+      const auto held = static_cast<uint32_t>(state >> 32);
+      const auto more = freeLetters_() & usableLetters & ~held;
+      if (more == 0) break;
+      if (letters_.compare_exchange_strong(state, state | more, std::memory_order_acq_rel)) {
+        state |= more;
+      } else {
+        // lost to another Acquire or Release, whatever they left is looked at again
+        asked = false;
+      }
+      continue;
+    }
+    const auto index = std::countr_zero(free);
+    const auto bit   = uint64_t{1} << index;
+    if (letters_.compare_exchange_weak(state, (state & ~bit) | (bit << 32), std::memory_order_acq_rel))
+      return MountPoint{.Letter = static_cast<char>('A' + index), .Folder = {}, .Automatic = false};
+  }
+  return acquireFolder();
+}
+
+auto MountPool::acquireFolder() -> std::optional<MountPoint>
+{
+  for (std::size_t word = 0; word < folders_.size(); ++word) {
+    auto free = folders_[word].load(std::memory_order_relaxed);
+    while (free != 0) {
+      const auto bit = std::countr_zero(free);
+      if (not folders_[word].compare_exchange_weak(free, free & ~(uint64_t{1} << bit), std::memory_order_acq_rel))
+        continue;
+
+      // the slot is ours now, a folder that is in use or not a directory is left out of the pool for good
+      const auto path = folderPath(word * slotsPerWord + static_cast<std::size_t>(bit));
+      auto ec         = std::error_code();
+      std::filesystem::create_directories(path, ec);
+      if (not ec and std::filesystem::is_directory(path, ec) and std::filesystem::is_empty(path, ec))
+        return MountPoint{.Letter = 0, .Folder = toUtf8(path), .Automatic = false};
+      free = folders_[word].load(std::memory_order_relaxed);
+    }
+  }
+  return std::nullopt;
+}
+
+void MountPool::Release(const MountPoint &point)
+{
+  if (point.Letter != 0) {
+    const auto bit = isLetter(point.Letter) ? uint64_t{letterBit(point.Letter) & usableLetters} : 0;
+    if (bit == 0) return;
+    auto state = letters_.load(std::memory_order_relaxed);
+    while (not letters_.compare_exchange_weak(state, (state & ~(bit << 32)) | bit, std::memory_order_acq_rel)) {}
+    return;
+  }
+
+  // only folders this pool handed out, `<root>/volume-<slot>`
+  const auto path = fromUtf8(point.Folder);
+  if (path.parent_path() != folderRoot_) return;
+  const auto name = toUtf8(path.filename());
+  if (not name.starts_with(folderPrefix)) return;
+  auto slot    = std::size_t{0};
+  auto [_, ec] = std::from_chars(name.data() + folderPrefix.size(), name.data() + name.size(), slot, 10);
+  if (ec != std::errc() or slot >= FolderSlots) return;
+  folders_[slot / slotsPerWord].fetch_or(uint64_t{1} << (slot % slotsPerWord), std::memory_order_acq_rel);
+}
+
+auto MountPool::Reserve(const MountPoint &point) -> bool
+{
+  if (not isLetter(point.Letter)) return false;
+  const auto bit = uint64_t{letterBit(point.Letter)};
+  auto state     = letters_.load(std::memory_order_relaxed);
+  while ((state & bit) != 0) {
+    if (letters_.compare_exchange_weak(state, (state & ~bit) | (bit << 32), std::memory_order_acq_rel)) return true;
+  }
+  return false;
+}
+
+auto MountPool::folderPath(std::size_t slot) const -> std::filesystem::path
+{
+  return folderRoot_ / fmt::format("{}{}", folderPrefix, slot);
+}
+
+auto FreeDriveLetters() -> uint32_t
+{
+#ifdef _WIN32
+  constexpr auto allLetters = (uint32_t{1} << 26) - 1;
+  constexpr auto floppies   = uint32_t{0b11};
+  return ~static_cast<uint32_t>(GetLogicalDrives()) & allLetters & ~floppies;
+#else
+  return 0;
+#endif
+}
+
+auto DefaultMountRoot() -> std::filesystem::path
+{
+  if (const auto *root = std::getenv("BLT_MOUNT_ROOT"); root and *root) return fromUtf8(root);
+#ifdef _WIN32
+  if (const auto *programData = std::getenv("ProgramData"))
+    return std::filesystem::path(programData) / "BitLockerTool" / "mounts";
+  return "mounts";
+#else
+  return "/run/bitlockertool/mounts";
+#endif
+}
+
+}// namespace Blt
\ No newline at end of file
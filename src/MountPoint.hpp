@@ -0,0 +1,100 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace Blt {
+
+/**
+ * Where a volume is attached: a drive letter, a folder mount point (`assign mount=`, a bind mount target on Linux) or,
+ * with `Automatic`, whatever the MountPool has free when the mount starts.
+ */
+struct MountPoint
+{
+  char Letter = 0;
+  // absolute UTF-8 path, only used when there is no letter. diskpart needs an empty folder on an NTFS volume
+  std::string Folder;
+  bool Automatic = false;
+
+  [[nodiscard]] auto IsFolder() const -> bool { return Letter == 0 and not Folder.empty(); }
+};
+
+// `X`, `*` or an absolute folder path as given on the command line, `*` only when `automatic` is allowed
+auto ParseMountPoint(std::string_view argument, bool automatic) -> std::optional<MountPoint>;
+
+/**
+ * Free drive letters and numbered folders under a root, handed out to concurrent mounts without a lock.
+ * Each set is a bitmap of free slots: Acquire takes the lowest set bit with one compare-exchange (retried only when
+ * another mount raced for the same word) and Release sets it again, so both are O(1) in the number of mounts.
+ * Letters are preferred, folders are used once every letter is taken.
+ * Letters live in one word, the free ones in the low half and the ones handed out or reserved in the high half. When
+ * Acquire finds none free it asks the letter source again and takes what is free there and not held by the pool, which
+ * is how letters other processes gave up come back.
+ * A letter another process takes makes the assign fail, such a letter is not released so the next mount does not
+ * collide with it again. A folder slot that is not an empty directory is skipped and stays out of the pool.
+ */
+class MountPool
+{
+public:
+  static constexpr std::size_t FolderSlots = 256;
+
+  // bit n set when 'A' + n may be used, FreeDriveLetters
+  using LetterSource = uint32_t (*)();
+
+  // `freeLetters` is asked once now and again whenever Acquire runs out of letters
+  MountPool(LetterSource freeLetters, std::filesystem::path folderRoot);
+
+  MountPool(const MountPool &)            = delete;
+  MountPool &operator=(const MountPool &) = delete;
+
+  [[nodiscard]] auto Acquire() -> std::optional<MountPoint>;
+
+  // After a failed attach of what Acquire or Reserve handed out, or once the volume was detached from it
+  void Release(const MountPoint &point);
+
+  /**
+   * Takes a letter that was given explicitly out of the pool, so `*` mounts never pick it. True when the letter was
+   * free and is held now, only then does the caller Release it again when the volume does not end up attached there.
+   */
+  [[nodiscard]] auto Reserve(const MountPoint &point) -> bool;
+
+private:
+  static constexpr std::size_t slotsPerWord = 64;
+
+  auto acquireFolder() -> std::optional<MountPoint>;
+  auto folderPath(std::size_t slot) const -> std::filesystem::path;
+
+  LetterSource freeLetters_;
+  // free letters in the low 32 bits, held ones in the high 32 bits
+  std::atomic<uint64_t> letters_;
+  std::array<std::atomic<uint64_t>, FolderSlots / slotsPerWord> folders_;
+  std::filesystem::path folderRoot_;
+};
+
+// Letters no volume uses right now, leaving out A and B which Windows keeps for floppy drives. None elsewhere
+auto FreeDriveLetters() -> uint32_t;
+
+// BLT_MOUNT_ROOT, %ProgramData%\BitLockerTool\mounts on Windows, /run/bitlockertool/mounts elsewhere
+auto DefaultMountRoot() -> std::filesystem::path;
+
+}// namespace Blt
+
+// `X:` for a letter and the folder otherwise, the form manage-bde and bdeunlock take a volume in
+template<>
+struct fmt::formatter<Blt::MountPoint> : fmt::formatter<std::string_view>
+{
+  auto format(const Blt::MountPoint &point, fmt::format_context &context) const
+  {
+    if (point.Letter != 0) return fmt::format_to(context.out(), "{}:", point.Letter);
+    if (point.Automatic) return fmt::format_to(context.out(), "*");
+    return fmt::format_to(context.out(), "{}", point.Folder);
+  }
+};
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Blt {
+
+/**
+ * Aho-Corasick automaton over a fixed set of literal byte patterns, built entirely at compile time.
+ *
+ * Scan() visits every byte of the input once and reports every occurrence of every pattern, so the cost of
+ * recognising a response does not depend on how many patterns (or languages) are loaded.
+ * Children are kept as sibling lists instead of a full 256-wide transition table to keep the tables small enough for
+ * constant evaluation.
+ */
+template<std::size_t TPatternCount, std::size_t TNodeCount>
+class MultiPattern
+{
+public:
+  static_assert(TNodeCount < 0xFFFF, "too many pattern bytes for 16-bit node indices");
+
+  constexpr explicit MultiPattern(const std::array<std::u8string_view, TPatternCount> &patterns)
+  {
+    for (std::size_t index = 0; index < patterns.size(); ++index) insert(patterns[index], index);
+    link();
+  }
+
+  // onMatch(patternIndex, matchBegin, matchEnd) is called in order of matchEnd
+  template<typename TOnMatch>
+  constexpr void Scan(std::u8string_view text, TOnMatch &&onMatch) const
+  {
+    uint16_t state = 0;
+    for (std::size_t position = 0; position < text.size(); ++position) {
+      const auto byte = text[position];
+      auto next       = child(state, byte);
+      while (next == None and state != 0) {
+        state = nodes_[state].Fail;
+        next  = child(state, byte);
+      }
+      state = next == None ? uint16_t(0) : next;
+
+      for (auto match = nodes_[state].Output != None ? state : nodes_[state].DictLink; match != 0;
+           match      = nodes_[match].DictLink) {
+        const auto length = nodes_[match].Depth;
+        onMatch(static_cast<std::size_t>(nodes_[match].Output), position + 1 - length, position + 1);
+      }
+    }
+  }
+
+private:
+  static constexpr uint16_t None = 0xFFFF;
+
+  struct Node
+  {
+    char8_t Byte         = 0;
+    uint16_t FirstChild  = None;
+    uint16_t NextSibling = None;
+    uint16_t Fail        = 0;
+    // nearest node on the fail chain that ends a pattern, the root (0) never does
+    uint16_t DictLink = 0;
+    uint16_t Output   = None;
+    uint16_t Depth    = 0;
+  };
+
+  [[nodiscard]] constexpr auto child(uint16_t node, char8_t byte) const -> uint16_t
+  {
+    for (auto current = nodes_[node].FirstChild; current != None; current = nodes_[current].NextSibling)
+      if (nodes_[current].Byte == byte) return current;
+    return None;
+  }
+
+  constexpr void insert(std::u8string_view pattern, std::size_t index)
+  {
+    uint16_t node = 0;
+    for (const auto byte : pattern) {
+      auto next = child(node, byte);
+      if (next == None) {
+        next                     = size_++;
+        nodes_[next].Byte        = byte;
+        nodes_[next].Depth       = static_cast<uint16_t>(nodes_[node].Depth + 1);
+        nodes_[next].NextSibling = nodes_[node].FirstChild;
+        nodes_[node].FirstChild  = next;
+      }
+      node = next;
+    }
+    if (nodes_[node].Output == None) nodes_[node].Output = static_cast<uint16_t>(index);
+  }
+
+  // breadth first, a node's fail link always points to a shallower node that is already linked
+  constexpr void link()
+  {
+    std::array<uint16_t, TNodeCount> queue{};
+    std::size_t head = 0;
+    std::size_t tail = 0;
+
+    for (auto current = nodes_[0].FirstChild; current != None; current = nodes_[current].NextSibling)
+      queue[tail++] = current;
+
+    while (head < tail) {
+      const auto node = queue[head++];
+      for (auto current = nodes_[node].FirstChild; current != None; current = nodes_[current].NextSibling) {
+        auto fail = nodes_[node].Fail;
+        auto next = child(fail, nodes_[current].Byte);
+        while (next == None and fail != 0) {
+          fail = nodes_[fail].Fail;
+          next = child(fail, nodes_[current].Byte);
+        }
+        nodes_[current].Fail     = next == None ? uint16_t(0) : next;
+        const auto &failNode     = nodes_[nodes_[current].Fail];
+        nodes_[current].DictLink = failNode.Output != None ? nodes_[current].Fail : failNode.DictLink;
+        queue[tail++]            = current;
+      }
+    }
+  }
+
+  std::array<Node, TNodeCount> nodes_{};
+  uint16_t size_ = 1;
+};
+
+// Upper bound on the automaton size for a pattern table, one node per pattern byte plus the root
+template<std::size_t TPatternCount>
+constexpr auto MultiPatternNodeCount(const std::array<std::u8string_view, TPatternCount> &patterns) -> std::size_t
+{
+  std::size_t count = 1;
+  for (const auto pattern : patterns) count += pattern.size();
+  return count;
+}
+
+}// namespace Blt
@@ -0,0 +1,323 @@
+#include "ReadProbe.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <boost/asio/random_access_file.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <random>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+#include "Common.hpp"
+#include "Log.hpp"
+#include "MountJournal.hpp"
+
+#ifdef _WIN32
+#include <winioctl.h>
+#endif
+
+namespace asio = boost::asio;
+
+namespace Blt {
+
+namespace {
+#ifdef BOOST_ASIO_HAS_FILE
+  // direct reads need their buffer, offset and length aligned to the logical sector, 4 KiB covers every common one
+  constexpr auto alignment = std::size_t{4096};
+
+  struct AlignedDelete
+  {
+    void operator()(std::byte *block) const { ::operator delete[](block, std::align_val_t{alignment}); }
+  };
+  using AlignedBlock = std::unique_ptr<std::byte[], AlignedDelete>;
+
+  auto alignedBlock(std::size_t size) -> AlignedBlock
+  {
+    return AlignedBlock(static_cast<std::byte *>(::operator new[](size, std::align_val_t{alignment})));
+  }
+
+  auto alignUp(std::size_t size) -> std::size_t
+  {
+    return std::max(alignment, (size + alignment - 1) / alignment * alignment);
+  }
+
+  // Nearest rank of `fraction` in values sorted ascending
+  template<typename Value>
+  auto percentile(const std::vector<Value> &sorted, double fraction) -> Value
+  {
+    if (sorted.empty()) return Value{};
+    return sorted[static_cast<std::size_t>(fraction * static_cast<double>(sorted.size() - 1))];
+  }
+
+  // What completed in each window of a phase
+  struct Phase
+  {
+    std::vector<uint64_t> Bytes;
+    std::vector<uint64_t> Reads;
+    std::chrono::duration<double> Elapsed{0};
+    bool Failed = false;
+  };
+
+  // `perWindow` are amounts that completed per window, `scale` turns one into the rate's unit
+  auto rateOf(const std::vector<uint64_t> &perWindow, double scale, const Phase &phase, const ProbeOptions &options)
+    -> ProbeRate
+  {
+    const auto window = std::chrono::duration<double>(options.Phase).count() / static_cast<double>(perWindow.size());
+    auto rates        = std::vector<double>();
+    auto total        = 0.0;
+    for (const auto amount : perWindow) {
+      rates.push_back(static_cast<double>(amount) * scale / window);
+      total += static_cast<double>(amount) * scale;
+    }
+    std::ranges::sort(rates);
+    return ProbeRate{
+      .Mean   = phase.Elapsed.count() > 0 ? total / phase.Elapsed.count() : 0,
+      .Median = percentile(rates, 0.5),
+      .Low    = percentile(rates, 0.1),
+    };
+  }
+
+  using File = asio::random_access_file::native_handle_type;
+
+  struct Opened
+  {
+    File Handle;
+    uint64_t Size;
+  };
+
+#ifdef _WIN32
+  auto openDirect(const std::filesystem::path &path) -> std::optional<Opened>
+  {
+    const auto handle = CreateFileW(
+      path.c_str(),
+      GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_WRITE,
+      nullptr,
+      OPEN_EXISTING,
+      FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
+      nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+      Log(LogLevel::Warning, "unable to open {} for unbuffered reads: error {}", path.string(), GetLastError());
+      return std::nullopt;
+    }
+
+    // a volume has a length, a file has a size
+    auto length   = GET_LENGTH_INFORMATION{};
+    auto returned = DWORD{0};
+    auto size     = LARGE_INTEGER{};
+    if (DeviceIoControl(handle, IOCTL_DISK_GET_LENGTH_INFO, nullptr, 0, &length, sizeof(length), &returned, nullptr)) {
+      size = length.Length;
+    } else if (not GetFileSizeEx(handle, &size)) {
+      size.QuadPart = 0;
+    }
+    return Opened{.Handle = handle, .Size = static_cast<uint64_t>(size.QuadPart)};
+  }
+
+  void closeDirect(File handle) { CloseHandle(handle); }
+#else
+  auto openDirect(const std::filesystem::path &path) -> std::optional<Opened>
+  {
+    const auto handle = ::open(path.c_str(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+    if (handle < 0) {
+      Log(LogLevel::Warning, "unable to open {} for direct reads: {}", path.string(), std::strerror(errno));
+      return std::nullopt;
+    }
+
+    struct stat status;
+    auto size = uint64_t{0};
+    // a block device has a size of 0, its length comes from the driver
+    if (::fstat(handle, &status) == 0 and not S_ISBLK(status.st_mode)) {
+      size = static_cast<uint64_t>(status.st_size);
+    } else if (::ioctl(handle, BLKGETSIZE64, &size) != 0) {
+      size = 0;
+    }
+    return Opened{.Handle = handle, .Size = size};
+  }
+
+  void closeDirect(File handle) { ::close(handle); }
+#endif
+
+  /**
+   * `depth` readers of `block` bytes each at the offsets `next` hands out, until the phase is over or a read fails.
+   * Readers only run on the executor's thread, `next` and the counters are shared without a lock like UnlockStage's
+   * cursor.
+   */
+  template<typename NextOffset>
+  auto readPhase(
+    asio::random_access_file &file,
+    std::size_t block,
+    std::size_t depth,
+    const ProbeOptions &options,
+    NextOffset next,
+    std::vector<std::chrono::microseconds> *latencies) -> asio::awaitable<Phase>
+  {
+    auto phase = Phase();
+    phase.Bytes.resize(options.Windows);
+    phase.Reads.resize(options.Windows);
+    const auto start    = std::chrono::steady_clock::now();
+    const auto deadline = start + options.Phase;
+    auto worker         = [&]() -> asio::awaitable<void> {
+      auto buffer = alignedBlock(block);
+      while (not phase.Failed and std::chrono::steady_clock::now() < deadline) {
+        const auto offset    = next();
+        const auto submitted = std::chrono::steady_clock::now();
+        auto [error, read]   = co_await file.async_read_some_at(
+          offset, asio::buffer(buffer.get(), block), asio::as_tuple(asio::use_awaitable));
+        const auto completed = std::chrono::steady_clock::now();
+        if (error or read == 0) {
+          if (not std::exchange(phase.Failed, true))
+            Log(LogLevel::Warning, "probe read of {} bytes at {} failed: {}", block, offset, error.message());
+          co_return;
+        }
+
+        // a read still in flight when the phase ends counts towards the last window
+        const auto elapsed = std::chrono::duration<double>(completed - start) / options.Phase;
+        const auto window =
+          std::min(options.Windows - 1, static_cast<std::size_t>(elapsed * static_cast<double>(options.Windows)));
+        phase.Bytes[window] += read;
+        ++phase.Reads[window];
+        if (latencies)
+          latencies->push_back(std::chrono::duration_cast<std::chrono::microseconds>(completed - submitted));
+      }
+    };
+
+    auto executor = co_await asio::this_coro::executor;
+    auto workers  = std::vector<decltype(asio::co_spawn(executor, worker(), asio::deferred))>();
+    for (std::size_t count = 0; count < std::max<std::size_t>(depth, 1); ++count)
+      workers.push_back(asio::co_spawn(executor, worker(), asio::deferred));
+    auto [order, exceptions] = co_await asio::experimental::make_parallel_group(std::move(workers))
+                                 .async_wait(asio::experimental::wait_for_all(), asio::use_awaitable);
+    for (const auto &exception : exceptions) {
+      if (exception) std::rethrow_exception(exception);
+    }
+    phase.Elapsed = std::chrono::steady_clock::now() - start;
+    co_return phase;
+  }
+#endif
+}// namespace
+
+auto ProbeReads(std::filesystem::path path, [[maybe_unused]] ProbeOptions options) -> asio::awaitable<ProbeResult>
+{
+#ifndef BOOST_ASIO_HAS_FILE
+  Log(LogLevel::Warning, "not probing {}, this build has no asynchronous file reads", path.string());
+  co_return ProbeResult{.Error = ProbeError::Unsupported};
+#else
+  options.Windows         = std::max<std::size_t>(options.Windows, 1);
+  options.SequentialBlock = alignUp(options.SequentialBlock);
+  options.RandomBlock     = alignUp(options.RandomBlock);
+
+  auto opened = openDirect(path);
+  if (not opened) co_return ProbeResult{.Error = ProbeError::OpenFailed};
+  auto file  = asio::random_access_file(co_await asio::this_coro::executor);
+  auto error = boost::system::error_code();
+  if (file.assign(opened->Handle, error); error) {
+    Log(LogLevel::Warning, "unable to read {} asynchronously: {}", path.string(), error.message());
+    closeDirect(opened->Handle);
+    co_return ProbeResult{.Error = ProbeError::OpenFailed};
+  }
+
+  // whole sequential blocks only, the tail of an image that is not a multiple of them is never read. The random reads
+  // pick among the whole random blocks of that span, there has to be one
+  const auto span = opened->Size / options.SequentialBlock * options.SequentialBlock;
+  if (span == 0 or span < options.RandomBlock) {
+    Log(LogLevel::Warning, "{} holds {} bytes, less than one probe read", path.string(), opened->Size);
+    co_return ProbeResult{.Error = ProbeError::TooSmall};
+  }
+
+  auto result             = ProbeResult();
+  auto cursor             = uint64_t{0};
+  const auto nextSequence = [&] {
+    const auto offset = cursor;
+    cursor            = cursor + options.SequentialBlock < span ? cursor + options.SequentialBlock : 0;
+    return offset;
+  };
+  const auto sequential =
+    co_await readPhase(file, options.SequentialBlock, options.SequentialDepth, options, nextSequence, nullptr);
+  result.SequentialMBps = rateOf(sequential.Bytes, 1e-6, sequential, options);
+  for (const auto bytes : sequential.Bytes) result.BytesRead += bytes;
+  if (sequential.Failed) {
+    result.Error = ProbeError::ReadFailed;
+    co_return result;
+  }
+
+  auto generator        = std::minstd_rand(std::random_device()());
+  auto blocks           = std::uniform_int_distribution<uint64_t>(0, span / options.RandomBlock - 1);
+  auto latencies        = std::vector<std::chrono::microseconds>();
+  const auto nextRandom = [&] { return blocks(generator) * options.RandomBlock; };
+  const auto random =
+    co_await readPhase(file, options.RandomBlock, options.RandomDepth, options, nextRandom, &latencies);
+  result.RandomIops = rateOf(random.Reads, 1, random, options);
+  for (const auto bytes : random.Bytes) result.BytesRead += bytes;
+  std::ranges::sort(latencies);
+  result.RandomP50 = percentile(latencies, 0.5);
+  result.RandomP99 = percentile(latencies, 0.99);
+  if (random.Failed) result.Error = ProbeError::ReadFailed;
+  co_return result;
+#endif
+}
+
+auto ProbePath(const MountPoint &mount) -> std::optional<std::filesystem::path>
+{
+#ifdef _WIN32
+  auto name = MountedVolumeName(mount);
+  if (name.empty()) return std::nullopt;
+  // `\\?\Volume{GUID}\` is the volume's root folder, without the backslash it is the volume
+  if (name.ends_with('\\')) name.pop_back();
+  return std::filesystem::path(name);
+#else
+  if (not mount.IsFolder()) return std::nullopt;
+  auto folder = std::filesystem::path(mount.Folder).lexically_normal();
+  if (not folder.has_filename()) folder = folder.parent_path();
+
+  struct stat mounted;
+  struct stat parent;
+  if (::stat(folder.c_str(), &mounted) != 0 or ::stat(folder.parent_path().c_str(), &parent) != 0) return std::nullopt;
+  if (mounted.st_dev == parent.st_dev) return std::nullopt;
+
+  auto ec           = std::error_code();
+  const auto device = std::filesystem::read_symlink(
+    fmt::format("/sys/dev/block/{}:{}", major(mounted.st_dev), minor(mounted.st_dev)), ec);
+  if (ec) return std::nullopt;
+  return std::filesystem::path("/dev") / device.filename();
+#endif
+}
+
+auto ToString(ProbeError error) -> std::string_view
+{
+  switch (error) {
+  case ProbeError::Success:
+    return "success";
+  case ProbeError::OpenFailed:
+    return "open failed";
+  case ProbeError::TooSmall:
+    return "too small";
+  case ProbeError::ReadFailed:
+    return "read failed";
+  case ProbeError::Unsupported:
+    return "unsupported";
+  case ProbeError::Interrupted:
+    return "interrupted";
+  }
+  return "unknown";
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <fmt/format.h>
+#include <boost/asio/awaitable.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "MountPoint.hpp"
+
+namespace Blt {
+
+enum struct ProbeError {
+  Success = 0,
+  // not there, or it refused direct reads (a tmpfs file, a device without the rights to read it)
+  OpenFailed,
+  // shorter than one sequential or one random read
+  TooSmall,
+  ReadFailed,
+  // asio has no asynchronous file I/O in this build, io_uring is off on Linux
+  Unsupported,
+  // an interrupt came before it was over, what ran until then is not reported
+  Interrupted,
+};
+
+struct ProbeOptions
+{
+  // how long the sequential and then the random phase read
+  std::chrono::milliseconds Phase = std::chrono::milliseconds(500);
+  std::size_t SequentialBlock = 1024 * 1024;
+  std::size_t SequentialDepth = 4;
+  std::size_t RandomBlock     = 4096;
+  std::size_t RandomDepth     = 32;
+  // each phase is cut into this many windows, a stall the average hides shows up in the slowest of them
+  std::size_t Windows = 10;
+};
+
+// What a phase sustained, per second
+struct ProbeRate
+{
+  double Mean   = 0;
+  double Median = 0;
+  // the 10th percentile window
+  double Low = 0;
+};
+
+struct ProbeResult
+{
+  ProbeError Error = ProbeError::Success;
+  // MB are 10^6 bytes, like every disk vendor counts them
+  ProbeRate SequentialMBps;
+  ProbeRate RandomIops;
+  // from submitting a random read to its completion
+  std::chrono::microseconds RandomP50{0};
+  std::chrono::microseconds RandomP99{0};
+  uint64_t BytesRead = 0;
+};
+
+/**
+ * Short read benchmark of a mounted volume's device (or of any file, like a loop image): SequentialDepth readers
+ * stream SequentialBlock reads from the start, then RandomDepth readers issue RandomBlock reads at random aligned
+ * offsets, each phase for as long as Phase. Everything bypasses the cache, O_DIRECT reads through io_uring on Linux and
+ * unbuffered overlapped reads on Windows, both through asio's random_access_file on the calling executor. Reads are
+ * 4 KiB aligned in memory, offset and length, which covers 512 and 4096 byte sectors.
+ * Only ever reads. A read that fails ends the probe with ReadFailed and what was measured until then.
+ */
+auto ProbeReads(std::filesystem::path path, ProbeOptions options = {}) -> boost::asio::awaitable<ProbeResult>;
+
+/**
+ * The device behind a mounted volume: its `\\?\Volume{GUID}` on Windows, on Linux the /dev node of the filesystem
+ * mounted at the folder (dm-N for an opened LUKS volume, loopN for a mounted image). nullopt when nothing is mounted
+ * there, a folder that is not a mount point would probe the disk it is on instead.
+ */
+auto ProbePath(const MountPoint &mount) -> std::optional<std::filesystem::path>;
+
+auto ToString(ProbeError error) -> std::string_view;
+
+}// namespace Blt
+
+template<>
+struct fmt::formatter<Blt::ProbeResult> : fmt::formatter<std::string_view>
+{
+  auto format(const Blt::ProbeResult &probe, fmt::format_context &context) const
+  {
+    return fmt::format_to(
+      context.out(),
+      "sequential {:.1f} MB/s (median {:.1f}, low {:.1f}), random {:.0f} IOPS (median {:.0f}, low {:.0f}), "
+      "p50 {}us p99 {}us",
+      probe.SequentialMBps.Mean,
+      probe.SequentialMBps.Median,
+      probe.SequentialMBps.Low,
+      probe.RandomIops.Mean,
+      probe.RandomIops.Median,
+      probe.RandomIops.Low,
+      probe.RandomP50.count(),
+      probe.RandomP99.count());
+  }
+};
\ No newline at end of file
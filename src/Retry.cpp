@@ -0,0 +1,31 @@
+#include "Retry.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Blt {
+
+StepRetry::StepRetry()
+#ifdef BLT_VIRTUAL_TIME
+  // the same jitter every run, a scenario under virtual time takes the same route each time
+  : random_()
+#else
+  : random_(std::random_device{}())
+#endif
+{}
+
+auto StepRetry::Next(DiskPartState state, DiskPartError error) -> std::optional<std::chrono::milliseconds>
+{
+  if (ClassifyError(error) != ErrorClass::Transient or RetryEntryState(state) == state) return std::nullopt;
+
+  const auto policy = RetryPolicyFor(state);
+  auto &attempt     = attempts_[static_cast<std::size_t>(state)];
+  if (attempt >= policy.MaxAttempts) return std::nullopt;
+
+  const auto exponent = std::min(attempt++, 16);
+  const auto ceiling  = std::min(policy.BaseDelay * (int64_t(1) << exponent), policy.MaxDelay);
+  auto jitter         = std::uniform_int_distribution<int64_t>(ceiling.count() / 2, ceiling.count());
+  return std::chrono::milliseconds(jitter(random_));
+}
+
+}// namespace Blt
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <random>
+
+#include "DiskPart.hpp"
+
+namespace Blt {
+
+enum struct ErrorClass {
+  Transient,
+  Permanent,
+};
+
+struct RetryPolicy
+{
+  int MaxAttempts;
+  std::chrono::milliseconds BaseDelay;
+  std::chrono::milliseconds MaxDelay;
+};
+
+// Only VDS contention goes away by itself, everything else means the session or the target is wrong
+constexpr auto ClassifyError(DiskPartError error) -> ErrorClass
+{
+  switch (error) {
+  case DiskPartError::ServiceBusy:
+    return ErrorClass::Transient;
+  default:
+    return ErrorClass::Permanent;
+  }
+}
+
+constexpr auto RetryPolicyFor(DiskPartState state) -> RetryPolicy
+{
+  using namespace std::chrono_literals;
+  switch (state) {
+  case DiskPartState::ReadListDisk:
+  case DiskPartState::ReadListPartition:
+    return {.MaxAttempts = 3, .BaseDelay = 500ms, .MaxDelay = 4s};
+  case DiskPartState::ReadSelectDisk:
+  case DiskPartState::ReadSelectPartition:
+  case DiskPartState::ReadAssignLetter:
+  case DiskPartState::ReadRemoveLetter:
+  case DiskPartState::ReadDetailDisk:
+  case DiskPartState::ReadDetailPartition:
+  case DiskPartState::ReadSelectVolume:
+    return {.MaxAttempts = 5, .BaseDelay = 250ms, .MaxDelay = 8s};
+  default:
+    // StartUp has no command to re-issue, a failed write means the pipe is gone
+    return {.MaxAttempts = 0, .BaseDelay = 0ms, .MaxDelay = 0ms};
+  }
+}
+
+// The command state whose response was read in `state`, re-issuing it produces a fresh response
+constexpr auto RetryEntryState(DiskPartState state) -> DiskPartState
+{
+  switch (state) {
+  case DiskPartState::ReadListDisk:
+    return DiskPartState::ListDisk;
+  case DiskPartState::ReadSelectDisk:
+    return DiskPartState::SelectDisk;
+  case DiskPartState::ReadListPartition:
+    return DiskPartState::ListPartition;
+  case DiskPartState::ReadSelectPartition:
+    return DiskPartState::SelectPartition;
+  case DiskPartState::ReadAssignLetter:
+    return DiskPartState::AssignLetter;
+  case DiskPartState::ReadRemoveLetter:
+    return DiskPartState::RemoveLetter;
+  case DiskPartState::ReadDetailDisk:
+    return DiskPartState::DetailDisk;
+  case DiskPartState::ReadDetailPartition:
+    return DiskPartState::DetailPartition;
+  case DiskPartState::ReadSelectVolume:
+    return DiskPartState::SelectVolume;
+  default:
+    return state;
+  }
+}
+
+/**
+ * Per-session retry bookkeeping, every state has its own attempt budget for the lifetime of the session.
+ * Delays grow exponentially from the policy's BaseDelay and are jittered into [delay/2, delay] so concurrent
+ * sessions waiting on the same VDS instance don't re-issue in lock step.
+ */
+class StepRetry
+{
+public:
+  StepRetry();
+
+  // Delay before re-issuing the command of `state`, or nothing when the error is permanent or the budget is spent
+  [[nodiscard]] auto Next(DiskPartState state, DiskPartError error) -> std::optional<std::chrono::milliseconds>;
+
+private:
+  static constexpr auto StateCount = static_cast<std::size_t>(DiskPartState::Exit) + 1;
+
+  std::array<int, StateCount> attempts_{};
+  std::minstd_rand random_;
+};
+
+}// namespace Blt
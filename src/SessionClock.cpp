@@ -0,0 +1,59 @@
+#include "SessionClock.hpp"
+
+#include <atomic>
+#include <limits>
+
+namespace Blt {
+
+namespace {
+  // ticks since the virtual epoch
+  std::atomic<VirtualClock::rep> virtualNow = 0;
+  // the earliest deadline asio asked about since the clock last moved, max when it asked about none
+  std::atomic<VirtualClock::rep> earliestDeadline = std::numeric_limits<VirtualClock::rep>::max();
+
+  void noteDeadline(VirtualClock::time_point expiry)
+  {
+    auto earliest = earliestDeadline.load(std::memory_order_relaxed);
+    while (expiry.time_since_epoch().count() < earliest
+           and not earliestDeadline.compare_exchange_weak(
+             earliest, expiry.time_since_epoch().count(), std::memory_order_relaxed)) {}
+  }
+}// namespace
+
+auto VirtualClock::now() noexcept -> time_point
+{
+  return time_point(duration(virtualNow.load(std::memory_order_acquire)));
+}
+
+auto VirtualWaitTraits::to_wait_duration(const VirtualClock::duration &untilExpiry) -> VirtualClock::duration
+{
+  // asio hands over the remainder already saturated, now + remainder does not overflow
+  noteDeadline(VirtualClock::now() + untilExpiry);
+  return VirtualClock::duration::zero();
+}
+
+auto VirtualWaitTraits::to_wait_duration(const VirtualClock::time_point &expiry) -> VirtualClock::duration
+{
+  noteDeadline(expiry);
+  return VirtualClock::duration::zero();
+}
+
+auto RunVirtualTime(boost::asio::io_context &ioc, std::chrono::steady_clock::duration settle)
+  -> VirtualClock::duration
+{
+  const auto started = VirtualClock::now();
+  while (not ioc.stopped()) {
+    if (ioc.poll() != 0) continue;
+    if (ioc.stopped()) break;
+    // a pipe or process completion may still be on its way through the kernel, time only moves once all is quiet
+    if (ioc.run_one_for(settle) != 0) continue;
+    if (ioc.stopped()) break;
+
+    const auto deadline = earliestDeadline.exchange(std::numeric_limits<VirtualClock::rep>::max());
+    if (deadline == std::numeric_limits<VirtualClock::rep>::max()) continue;
+    if (deadline > virtualNow.load(std::memory_order_relaxed)) virtualNow.store(deadline, std::memory_order_release);
+  }
+  return VirtualClock::now() - started;
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <cstdint>
+
+namespace Blt {
+
+/**
+ * A steady clock that only moves when RunVirtualTime moves it, so session deadlines, retry delays and the teardown
+ * grace elapse as fast as the io_context runs out of other work.
+ * There is one virtual clock per process, it starts at its epoch.
+ */
+struct VirtualClock
+{
+  using duration                  = std::chrono::steady_clock::duration;
+  using rep                       = duration::rep;
+  using period                    = duration::period;
+  using time_point                = std::chrono::time_point<VirtualClock>;
+  static constexpr bool is_steady = true;
+
+  static auto now() noexcept -> time_point;
+};
+
+/**
+ * asio asks how long its reactor may sleep until the earliest timer expires. Virtual deadlines never pass on their
+ * own, so the answer is always zero, and the deadline is remembered for RunVirtualTime to jump to.
+ */
+struct VirtualWaitTraits
+{
+  static auto to_wait_duration(const VirtualClock::duration &untilExpiry) -> VirtualClock::duration;
+  static auto to_wait_duration(const VirtualClock::time_point &expiry) -> VirtualClock::duration;
+};
+
+using VirtualTimer = boost::asio::basic_waitable_timer<VirtualClock, VirtualWaitTraits>;
+
+// What the engine measures its session deadlines with, BLT_VIRTUAL_TIME switches every one of them at compile time
+#ifdef BLT_VIRTUAL_TIME
+using SessionClock = VirtualClock;
+using SessionTimer = VirtualTimer;
+#else
+using SessionClock = std::chrono::steady_clock;
+using SessionTimer = boost::asio::steady_timer;
+#endif
+
+/**
+ * Runs `ioc` until it is out of work or stopped. Whenever nothing is ready and `settle` of real time brought no
+ * completion either, the virtual clock jumps to the earliest pending virtual deadline.
+ * A timer that never expires (time_point::max()) is never jumped to, a run whose only work is such a timer or I/O
+ * that never completes does not return, just like io_context::run.
+ * Returns the virtual time that passed. Only one thread may run virtual time at once.
+ */
+auto RunVirtualTime(
+  boost::asio::io_context &ioc, std::chrono::steady_clock::duration settle = std::chrono::milliseconds(1))
+  -> VirtualClock::duration;
+
+}// namespace Blt
\ No newline at end of file
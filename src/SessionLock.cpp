@@ -0,0 +1,428 @@
+#include "SessionLock.hpp"
+
+#include <fmt/chrono.h>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Common.hpp"
+#include "Log.hpp"
+#include "SessionClock.hpp"
+#include "VolumeIndex.hpp"
+
+namespace asio = boost::asio;
+
+namespace Blt {
+
+namespace Detail {
+  struct SessionSlot
+  {
+    // 0 when the slot is free
+    uint64_t Ticket;
+    // identifies the process together with the pid, a reused pid starts at another time
+    uint64_t ProcessStart;
+    // wall clock milliseconds, the board is shared between processes
+    int64_t QueuedAt;
+    // 0 while waiting
+    int64_t HeldSince;
+    // wall clock milliseconds after which a holder that is still alive counts as hung, 0 while waiting
+    int64_t Deadline;
+    uint32_t Pid;
+    uint32_t Reserved;
+  };
+
+  struct SessionBoard
+  {
+    static constexpr uint32_t CurrentMagic   = 0x53544c42;// "BLTS"
+    static constexpr uint32_t CurrentVersion = 2;
+
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t NextTicket;
+    // running average of how long a session was held, 0 until the first one was released
+    int64_t AverageHold;
+    uint64_t Sessions;
+    std::array<SessionSlot, 64> Slots;
+  };
+}// namespace Detail
+
+namespace {
+  using Detail::SessionBoard;
+  using Detail::SessionSlot;
+
+  auto wallClock() -> int64_t
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+  }
+
+  auto currentPid() -> uint32_t
+  {
+#ifdef _WIN32
+    return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+    return static_cast<uint32_t>(::getpid());
+#endif
+  }
+
+  // Start time of a running process in the platform's own unit, nullopt when there is no such process
+  auto processStart(uint32_t pid) -> std::optional<uint64_t>
+  {
+#ifdef _WIN32
+    auto process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (not process) return std::nullopt;
+    blt_defer {
+      CloseHandle(process);
+    };
+    DWORD exitCode;
+    if (not GetExitCodeProcess(process, &exitCode) or exitCode != STILL_ACTIVE) return std::nullopt;
+    FILETIME creation, exit, kernel, user;
+    if (not GetProcessTimes(process, &creation, &exit, &kernel, &user)) return std::nullopt;
+    return (uint64_t{creation.dwHighDateTime} << 32) | creation.dwLowDateTime;
+#else
+    // field 22 of /proc/<pid>/stat, counted after the command name which may itself contain blanks and parentheses
+    auto stat = std::ifstream(fmt::format("/proc/{}/stat", pid));
+    auto line = std::string();
+    if (not std::getline(stat, line)) return std::nullopt;
+    const auto end = line.rfind(')');
+    if (end == std::string::npos) return std::nullopt;
+
+    auto field = std::size_t{2};
+    auto begin = end + 1;
+    while (begin < line.size()) {
+      begin = line.find_first_not_of(' ', begin);
+      if (begin == std::string::npos) break;
+      const auto next = std::min(line.find(' ', begin), line.size());
+      if (++field == 22) return std::strtoull(line.substr(begin, next - begin).c_str(), nullptr, 10);
+      begin = next;
+    }
+    return std::nullopt;
+#endif
+  }
+
+  auto findSlot(SessionBoard &board, uint64_t ticket) -> SessionSlot *
+  {
+    const auto slot = std::ranges::find(board.Slots, ticket, &SessionSlot::Ticket);
+    return slot == board.Slots.end() ? nullptr : &*slot;
+  }
+
+  // Drops the slots of processes that are gone and of holders past their own deadline
+  void reap(SessionBoard &board, int64_t now)
+  {
+    for (auto &slot : board.Slots) {
+      if (slot.Ticket == 0) continue;
+      if (processStart(slot.Pid) != slot.ProcessStart) {
+        Log(
+          LogLevel::Warning,
+          "process {} left ticket {} on the session board {}, dropping it",
+          slot.Pid,
+          slot.Ticket,
+          slot.HeldSince ? "while holding the session" : "while waiting");
+        slot = SessionSlot{};
+      } else if (slot.HeldSince != 0 and now > slot.Deadline) {
+        Log(
+          LogLevel::Warning,
+          "process {} has held the diskpart session for {}, evicting it as hung",
+          slot.Pid,
+          std::chrono::milliseconds(now - slot.HeldSince));
+        slot = SessionSlot{};
+      }
+    }
+  }
+
+  // the OS lock on the file, held while the board is read or written
+  class BoardGuard
+  {
+  public:
+#ifdef _WIN32
+    explicit BoardGuard(HANDLE file)
+      : file_(file)
+    {
+      // a range past the board, locked ranges are enforced against reads and writes but the view never touches it
+      auto overlapped       = OVERLAPPED{};
+      overlapped.OffsetHigh = 1;
+      locked_               = LockFileEx(file_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped);
+    }
+    ~BoardGuard()
+    {
+      if (not locked_) return;
+      auto overlapped       = OVERLAPPED{};
+      overlapped.OffsetHigh = 1;
+      UnlockFileEx(file_, 0, 1, 0, &overlapped);
+    }
+#else
+    explicit BoardGuard(int file)
+      : file_(file)
+    {
+      do {
+        locked_ = ::flock(file_, LOCK_EX) == 0;
+      } while (not locked_ and errno == EINTR);
+    }
+    ~BoardGuard()
+    {
+      if (locked_) ::flock(file_, LOCK_UN);
+    }
+#endif
+
+    BoardGuard(const BoardGuard &)            = delete;
+    BoardGuard &operator=(const BoardGuard &) = delete;
+
+    explicit operator bool() const { return locked_; }
+
+  private:
+#ifdef _WIN32
+    HANDLE file_;
+    BOOL locked_;
+#else
+    int file_;
+    bool locked_;
+#endif
+  };
+}// namespace
+
+SessionLease::SessionLease(SessionLock &lock, uint64_t ticket, std::chrono::milliseconds waited)
+  : lock_(&lock)
+  , ticket_(ticket)
+  , waited_(waited)
+{}
+
+SessionLease::SessionLease(SessionLease &&other) noexcept
+  : lock_(std::exchange(other.lock_, nullptr))
+  , ticket_(other.ticket_)
+  , waited_(other.waited_)
+{}
+
+SessionLease &SessionLease::operator=(SessionLease &&other) noexcept
+{
+  if (this != &other) {
+    if (lock_) lock_->release(ticket_, true);
+    lock_   = std::exchange(other.lock_, nullptr);
+    ticket_ = other.ticket_;
+    waited_ = other.waited_;
+  }
+  return *this;
+}
+
+SessionLease::~SessionLease()
+{
+  if (lock_) lock_->release(ticket_, true);
+}
+
+auto SessionLock::Open(const std::filesystem::path &path, SessionLockOptions options) -> std::optional<SessionLock>
+{
+  auto ec = std::error_code();
+  if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+
+#ifdef _WIN32
+  auto file = CreateFileW(
+    path.c_str(),
+    GENERIC_READ | GENERIC_WRITE,
+    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+    nullptr,
+    OPEN_ALWAYS,
+    FILE_ATTRIBUTE_NORMAL,
+    nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    Log(LogLevel::Warning, "unable to open session lock {}: {}", path.string(), GetLastError());
+    return std::nullopt;
+  }
+  // the mapping grows the file to the board's size, the view keeps the mapping alive on its own
+  auto mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, 0, sizeof(SessionBoard), nullptr);
+  auto *view   = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SessionBoard)) : nullptr;
+  if (mapping) CloseHandle(mapping);
+  if (not view) {
+    Log(LogLevel::Warning, "unable to map session lock {}: {}", path.string(), GetLastError());
+    CloseHandle(file);
+    return std::nullopt;
+  }
+#else
+  auto file = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+  if (file < 0) {
+    Log(LogLevel::Warning, "unable to open session lock {}: {}", path.string(), std::strerror(errno));
+    return std::nullopt;
+  }
+  {
+    // grown under the lock, a second process must not map a file that is still shorter than the board
+    auto guard = BoardGuard(file);
+    struct stat status;
+    if (::fstat(file, &status) == 0 and static_cast<std::size_t>(status.st_size) < sizeof(SessionBoard))
+      static_cast<void>(::ftruncate(file, sizeof(SessionBoard)));
+  }
+  auto *view = ::mmap(nullptr, sizeof(SessionBoard), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  if (view == MAP_FAILED) {
+    Log(LogLevel::Warning, "unable to map session lock {}: {}", path.string(), std::strerror(errno));
+    ::close(file);
+    return std::nullopt;
+  }
+#endif
+
+  auto lock  = SessionLock(file, static_cast<SessionBoard *>(view), options);
+  auto guard = BoardGuard(file);
+  if (not guard) return std::nullopt;
+  // a new file is all zeros, a board of another layout is started over
+  if (lock.board_->Magic != SessionBoard::CurrentMagic or lock.board_->Version != SessionBoard::CurrentVersion) {
+    *lock.board_            = SessionBoard{};
+    lock.board_->Magic      = SessionBoard::CurrentMagic;
+    lock.board_->Version    = SessionBoard::CurrentVersion;
+    lock.board_->NextTicket = 1;
+  }
+  return std::optional<SessionLock>(std::move(lock));
+}
+
+SessionLock::SessionLock(NativeFile file, Detail::SessionBoard *board, SessionLockOptions options)
+  : file_(file)
+  , board_(board)
+  , options_(options)
+{}
+
+SessionLock::SessionLock(SessionLock &&other) noexcept
+  : file_(other.file_)
+  , board_(std::exchange(other.board_, nullptr))
+  , options_(other.options_)
+{}
+
+SessionLock::~SessionLock()
+{
+  if (not board_) return;
+#ifdef _WIN32
+  UnmapViewOfFile(board_);
+  CloseHandle(file_);
+#else
+  ::munmap(board_, sizeof(SessionBoard));
+  ::close(file_);
+#endif
+}
+
+auto SessionLock::Acquire(std::chrono::milliseconds hold) -> asio::awaitable<std::optional<SessionLease>>
+{
+  const auto pid    = currentPid();
+  const auto start  = processStart(pid);
+  const auto queued = SessionClock::now();
+  auto ticket       = uint64_t{0};
+  {
+    auto guard = BoardGuard(file_);
+    if (not guard or not start) co_return std::nullopt;
+    reap(*board_, wallClock());
+    auto *slot = findSlot(*board_, 0);
+    if (not slot) {
+      Log(LogLevel::Warning, "the session board is full, running without waiting for the other sessions");
+      co_return std::nullopt;
+    }
+    ticket = board_->NextTicket++;
+    *slot  = SessionSlot{
+       .Ticket       = ticket,
+       .ProcessStart = *start,
+       .QueuedAt     = wallClock(),
+       .HeldSince    = 0,
+       .Deadline     = 0,
+       .Pid          = pid,
+       .Reserved     = 0};
+  }
+  // cleared once the session is handed over, until then leaving the loop by any way gives the ticket back
+  auto withdraw = true;
+  blt_defer {
+    if (withdraw) release(ticket, false);
+  };
+
+  // on the session clock like every other wait of a session, virtual time skips the polls
+  auto timer        = SessionTimer(co_await asio::this_coro::executor);
+  auto lastAhead    = std::numeric_limits<std::size_t>::max();
+  auto lastReported = SessionClock::time_point();
+  for (;;) {
+    auto ahead    = std::size_t{0};
+    auto estimate = std::optional<std::chrono::milliseconds>();
+    {
+      auto guard = BoardGuard(file_);
+      if (not guard) co_return std::nullopt;
+      const auto now = wallClock();
+      reap(*board_, now);
+      auto *slot = findSlot(*board_, ticket);
+      if (not slot) co_return std::nullopt;
+
+      auto heldFor = int64_t{0};
+      for (const auto &other : board_->Slots) {
+        if (other.Ticket == 0 or other.Ticket >= ticket) continue;
+        ++ahead;
+        if (other.HeldSince != 0) heldFor = now - other.HeldSince;
+      }
+      if (ahead == 0) {
+        slot->HeldSince = now;
+        slot->Deadline  = now + (hold + options_.Grace).count();
+        withdraw        = false;
+      } else if (board_->AverageHold > 0) {
+        // what is left of the running session and a full average for everyone behind it
+        const auto average = board_->AverageHold;
+        estimate           = std::chrono::milliseconds(
+          std::max<int64_t>(average - heldFor, 0) + average * static_cast<int64_t>(ahead - 1));
+      }
+    }
+
+    const auto now = SessionClock::now();
+    if (not withdraw) {
+      const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(now - queued);
+      if (lastAhead != std::numeric_limits<std::size_t>::max())
+        Log(LogLevel::Info, "diskpart session is ours after waiting {}", waited);
+      co_return SessionLease(*this, ticket, waited);
+    }
+    if (ahead != lastAhead or now - lastReported >= options_.Report) {
+      if (estimate) {
+        Log(LogLevel::Info, "waiting for the diskpart session, {} ahead in the queue, about {} left", ahead, *estimate);
+      } else {
+        Log(LogLevel::Info, "waiting for the diskpart session, {} ahead in the queue", ahead);
+      }
+      lastAhead    = ahead;
+      lastReported = now;
+    }
+
+    timer.expires_after(options_.Poll);
+    if (auto [ec] = co_await timer.async_wait(asio::as_tuple(asio::use_awaitable)); ec) co_return std::nullopt;
+  }
+}
+
+void SessionLock::release(uint64_t ticket, bool held)
+{
+  auto guard = BoardGuard(file_);
+  if (not guard) return;
+  auto *slot = findSlot(*board_, ticket);
+  // evicted as hung in the meantime, whoever did it already logged it
+  if (not slot) return;
+
+  if (held and slot->HeldSince != 0) {
+    const auto hold     = wallClock() - slot->HeldSince;
+    board_->AverageHold = board_->Sessions == 0 ? hold : (board_->AverageHold * 3 + hold) / 4;
+    ++board_->Sessions;
+  }
+  *slot = SessionSlot{};
+}
+
+auto DefaultSessionLockPath() -> std::filesystem::path
+{
+  if (const auto *path = std::getenv("BLT_SESSION_LOCK"); path and *path) return path;
+#ifdef _WIN32
+  // machine wide, two administrators share one VDS
+  if (const auto *programData = std::getenv("ProgramData"))
+    return std::filesystem::path(programData) / "BitLockerTool" / "session.lock";
+#endif
+  return DefaultVolumeIndexPath().replace_filename("session.lock");
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+namespace Blt {
+
+namespace Detail {
+  struct SessionBoard;
+}
+
+class SessionLock;
+
+// The session while it is held, released when it goes out of scope
+class SessionLease
+{
+public:
+  SessionLease(SessionLease &&other) noexcept;
+  SessionLease &operator=(SessionLease &&other) noexcept;
+  ~SessionLease();
+
+  [[nodiscard]] auto Ticket() const -> uint64_t { return ticket_; }
+
+  // Time spent in the queue before the session was handed over
+  [[nodiscard]] auto Waited() const -> std::chrono::milliseconds { return waited_; }
+
+private:
+  friend class SessionLock;
+  SessionLease(SessionLock &lock, uint64_t ticket, std::chrono::milliseconds waited);
+
+  SessionLock *lock_;
+  uint64_t ticket_;
+  std::chrono::milliseconds waited_;
+};
+
+struct SessionLockOptions
+{
+  // how often a waiter looks at the board, there is no cross-process wakeup
+  std::chrono::milliseconds Poll = std::chrono::milliseconds(100);
+  // how long a holder may overrun the hold it announced (tearing diskpart down, the journal) before it is evicted
+  std::chrono::milliseconds Grace = std::chrono::seconds(120);
+  // how often an unchanged queue position is logged again
+  std::chrono::milliseconds Report = std::chrono::seconds(5);
+};
+
+/**
+ * FIFO hand-over of the diskpart session between BitLockerTool processes. VDS serializes its callers anyway, two
+ * sessions at once only means the second one sits in its 100s timeout instead of waiting its turn.
+ * The ticket board lives in the lock file, mapped into every process. It is only read or written while the process
+ * holds an OS lock on the file (flock, LockFileEx), which is held for a board update and never across a session.
+ * A waiter draws the next ticket and the session belongs to the lowest ticket on the board, so callers are served in
+ * arrival order. Waiters log their position and an estimate from the average hold time of earlier sessions.
+ * Every slot records the pid and the start time of its process. A slot whose process is gone (crashed, killed, pid
+ * reused) is dropped by whoever looks at the board next. A holder records its own deadline, the hold it announced plus
+ * the grace, and is only evicted as hung with a warning once that has passed, however long its session timeout is.
+ */
+class SessionLock
+{
+public:
+  // nullopt when the lock file cannot be created or mapped, callers then run unserialized as before
+  static auto Open(const std::filesystem::path &path, SessionLockOptions options = {}) -> std::optional<SessionLock>;
+
+  SessionLock(SessionLock &&other) noexcept;
+  SessionLock &operator=(SessionLock &&) = delete;
+  ~SessionLock();
+
+  /**
+   * Queues for the session and completes once it is this process's turn, to hold it for at most `hold` (the session
+   * timeout). Cancelling it (an interrupt winning a `||`) takes the ticket back off the board, nullopt is returned then
+   * and when the board is full.
+   */
+  auto Acquire(std::chrono::milliseconds hold) -> boost::asio::awaitable<std::optional<SessionLease>>;
+
+private:
+  friend class SessionLease;
+#ifdef _WIN32
+  using NativeFile = void *;
+#else
+  using NativeFile = int;
+#endif
+
+  SessionLock(NativeFile file, Detail::SessionBoard *board, SessionLockOptions options);
+
+  void release(uint64_t ticket, bool held);
+
+  NativeFile file_;
+  Detail::SessionBoard *board_;
+  SessionLockOptions options_;
+};
+
+// session.lock under ProgramData on Windows, next to the volume index elsewhere, BLT_SESSION_LOCK overrides both
+auto DefaultSessionLockPath() -> std::filesystem::path;
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,336 @@
+#include "Spawn.hpp"
+
+#include <atomic>
+#include <utility>
+
+#ifdef _WIN32
+#include <array>
+#include <cstddef>
+#include <cwchar>
+#include <string>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+namespace Blt {
+
+namespace asio = boost::asio;
+namespace proc = boost::process::v2;
+
+namespace {
+  auto lastError() -> boost::system::error_code
+  {
+#ifdef _WIN32
+    return boost::system::error_code(static_cast<int>(GetLastError()), boost::system::system_category());
+#else
+    return boost::system::error_code(errno, boost::system::system_category());
+#endif
+  }
+
+#ifdef _WIN32
+  auto widen(std::string_view text) -> std::wstring
+  {
+    auto wide = std::wstring(text.size(), L'\0');
+    wide.resize(static_cast<std::size_t>(MultiByteToWideChar(
+      CP_UTF8, 0, text.data(), static_cast<int>(text.size()), wide.data(), static_cast<int>(wide.size()))));
+    return wide;
+  }
+
+  // CommandLineToArgvW rules, which is how the C runtime of the child splits it again
+  void appendQuoted(std::wstring &commandLine, std::wstring_view argument)
+  {
+    if (not argument.empty() and argument.find_first_of(L" \t\"") == std::wstring_view::npos) {
+      commandLine.append(argument);
+      return;
+    }
+
+    commandLine.push_back(L'"');
+    std::size_t backslashes = 0;
+    for (const auto character : argument) {
+      if (character == L'\\') {
+        ++backslashes;
+        continue;
+      }
+      commandLine.append(character == L'"' ? backslashes * 2 + 1 : backslashes, L'\\');
+      commandLine.push_back(character);
+      backslashes = 0;
+    }
+    commandLine.append(backslashes * 2, L'\\');
+    commandLine.push_back(L'"');
+  }
+#endif
+}// namespace
+
+Spawner::Spawner(Resolver resolve)
+  : resolve_(std::move(resolve))
+{}
+
+Spawner::~Spawner()
+{
+  if (prepared_) closePipes(*prepared_);
+}
+
+auto Spawner::Executable() -> const std::filesystem::path &
+{
+  std::call_once(resolved_, [this] { resolve(); });
+  return executable_;
+}
+
+void Spawner::Prepare(bool pipes)
+{
+  std::call_once(resolved_, [this] { resolve(); });
+  if (not pipes) return;
+
+  auto lock = std::scoped_lock(preparedLock_);
+  if (prepared_) return;
+  if (auto next = PipeSet(); openPipes(next)) prepared_ = next;
+}
+
+auto Spawner::Launch(
+  asio::any_io_executor executor,
+  std::span<const std::string> arguments,
+  SpawnStdio stdio,
+  ChildAccounting *accounting,
+  boost::system::error_code &ec) -> proc::process
+{
+  std::call_once(resolved_, [this] { resolve(); });
+
+  const auto redirected = stdio.In or stdio.Out;
+  auto pipes            = PipeSet();
+  if (redirected) {
+    auto lock     = std::unique_lock(preparedLock_);
+    auto prepared = std::exchange(prepared_, std::nullopt);
+    lock.unlock();
+
+    if (prepared) {
+      pipes = *prepared;
+    } else if (not openPipes(pipes)) {
+      ec = lastError();
+      return proc::process(executor);
+    }
+  }
+
+#ifdef _WIN32
+  auto commandLine = std::wstring();
+  appendQuoted(commandLine, executable_.native());
+  for (const auto &argument : arguments) {
+    commandLine.push_back(L' ');
+    appendQuoted(commandLine, widen(argument));
+  }
+
+  auto startup            = STARTUPINFOEXW{};
+  startup.StartupInfo.cb  = sizeof(startup);
+  auto inherited          = std::array<HANDLE, 2>();
+  std::size_t inheritable = 0;
+  if (redirected) {
+    startup.StartupInfo.dwFlags    = STARTF_USESTDHANDLES;
+    startup.StartupInfo.hStdInput  = stdio.In ? pipes.ChildIn : nullptr;
+    startup.StartupInfo.hStdOutput = stdio.Out ? pipes.ChildOut : nullptr;
+    startup.StartupInfo.hStdError  = nullptr;
+    if (stdio.In) inherited[inheritable++] = pipes.ChildIn;
+    if (stdio.Out) inherited[inheritable++] = pipes.ChildOut;
+  }
+
+  // only the child's own pipe ends are inherited, they are inheritable for no longer than this call
+  auto attributes = std::vector<std::byte>();
+  if (inheritable != 0) {
+    SIZE_T size = 0;
+    InitializeProcThreadAttributeList(nullptr, 1, 0, &size);
+    attributes.resize(size);
+    startup.lpAttributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributes.data());
+    InitializeProcThreadAttributeList(startup.lpAttributeList, 1, 0, &size);
+    UpdateProcThreadAttribute(
+      startup.lpAttributeList,
+      0,
+      PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
+      inherited.data(),
+      inheritable * sizeof(HANDLE),
+      nullptr,
+      nullptr);
+    for (std::size_t index = 0; index < inheritable; ++index)
+      SetHandleInformation(inherited[index], HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT);
+  }
+
+  auto information = PROCESS_INFORMATION{};
+  const auto flags = EXTENDED_STARTUPINFO_PRESENT | CREATE_UNICODE_ENVIRONMENT | CREATE_SUSPENDED
+                     | (stdio.Out ? 0 : CREATE_NO_WINDOW);
+  const auto created = CreateProcessW(
+    executable_.c_str(),
+    commandLine.data(),
+    nullptr,
+    nullptr,
+    inheritable != 0,
+    flags,
+    environment_.data(),
+    nullptr,
+    &startup.StartupInfo,
+    &information);
+  const auto error = GetLastError();
+  if (startup.lpAttributeList) DeleteProcThreadAttributeList(startup.lpAttributeList);
+  // manage-bde takes recovery passwords as arguments, this copy of them does not outlive the launch
+  SecureZeroMemory(commandLine.data(), commandLine.size() * sizeof(wchar_t));
+
+  // the child has its own copies now, or never started
+  if (pipes.ChildIn) CloseHandle(std::exchange(pipes.ChildIn, nullptr));
+  if (pipes.ChildOut) CloseHandle(std::exchange(pipes.ChildOut, nullptr));
+  if (not stdio.In and pipes.ParentIn) CloseHandle(std::exchange(pipes.ParentIn, nullptr));
+  if (not stdio.Out and pipes.ParentOut) CloseHandle(std::exchange(pipes.ParentOut, nullptr));
+  if (not created) {
+    closePipes(pipes);
+    ec = boost::system::error_code(static_cast<int>(error), boost::system::system_category());
+    return proc::process(executor);
+  }
+
+  if (accounting) accounting->Attach(information.hProcess);
+  ResumeThread(information.hThread);
+  CloseHandle(information.hThread);
+
+  if (stdio.In) stdio.In->assign(pipes.ParentIn, ec);
+  if (stdio.Out and not ec) stdio.Out->assign(pipes.ParentOut, ec);
+  if (redirected) Prepare(true);
+  return proc::process(executor, information.dwProcessId, information.hProcess);
+#else
+  auto argv = std::vector<char *>();
+  argv.reserve(arguments.size() + 2);
+  argv.push_back(const_cast<char *>(executable_.c_str()));
+  for (const auto &argument : arguments) argv.push_back(const_cast<char *>(argument.c_str()));
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (stdio.In) {
+    posix_spawn_file_actions_adddup2(&actions, pipes.ChildIn, STDIN_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  }
+  if (stdio.Out) {
+    posix_spawn_file_actions_adddup2(&actions, pipes.ChildOut, STDOUT_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  }
+
+  posix_spawnattr_t attributes;
+  posix_spawnattr_init(&attributes);
+#ifdef POSIX_SPAWN_USEVFORK
+  // implied by current glibc, older ones fork without it
+  posix_spawnattr_setflags(&attributes, POSIX_SPAWN_USEVFORK);
+#endif
+
+  pid_t pid         = -1;
+  const auto result = posix_spawn(
+    &pid, executable_.c_str(), &actions, &attributes, argv.data(), environmentPointers_.data());
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attributes);
+
+  // every descriptor is close-on-exec, dup2 only clears that on the child's 0 and 1
+  if (pipes.ChildIn >= 0) ::close(std::exchange(pipes.ChildIn, -1));
+  if (pipes.ChildOut >= 0) ::close(std::exchange(pipes.ChildOut, -1));
+  if (not stdio.In and pipes.ParentIn >= 0) ::close(std::exchange(pipes.ParentIn, -1));
+  if (not stdio.Out and pipes.ParentOut >= 0) ::close(std::exchange(pipes.ParentOut, -1));
+  if (result != 0) {
+    closePipes(pipes);
+    ec = boost::system::error_code(result, boost::system::system_category());
+    return proc::process(executor);
+  }
+
+  if (accounting) accounting->Attach(pid);
+  if (stdio.In) stdio.In->assign(pipes.ParentIn, ec);
+  if (stdio.Out and not ec) stdio.Out->assign(pipes.ParentOut, ec);
+  if (redirected) Prepare(true);
+  return proc::process(executor, pid);
+#endif
+}
+
+void Spawner::resolve()
+{
+  executable_ = resolve_();
+
+#ifdef _WIN32
+  // a block of NUL terminated entries ending in an empty one
+  if (auto *block = GetEnvironmentStringsW()) {
+    auto *end = block;
+    while (*end) end += std::wcslen(end) + 1;
+    environment_.assign(block, end + 1);
+    FreeEnvironmentStringsW(block);
+  }
+#else
+  for (auto **entry = environ; entry and *entry; ++entry) environment_.emplace_back(*entry);
+  for (auto &entry : environment_) environmentPointers_.push_back(entry.data());
+  environmentPointers_.push_back(nullptr);
+#endif
+}
+
+#ifdef _WIN32
+auto Spawner::openPipes(PipeSet &pipes) -> bool
+{
+  static auto serial = std::atomic<uint32_t>(0);
+
+  // asio needs overlapped handles on its side, the child gets ordinary synchronous ones
+  const auto open = [](DWORD direction, DWORD childAccess, HANDLE &parent, HANDLE &child) {
+    const auto name = L"\\\\.\\pipe\\BitLockerTool-" + std::to_wstring(GetCurrentProcessId()) + L"-"
+                      + std::to_wstring(serial.fetch_add(1, std::memory_order_relaxed));
+    parent = CreateNamedPipeW(
+      name.c_str(),
+      direction | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+      PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+      1,
+      4096,
+      4096,
+      0,
+      nullptr);
+    if (parent == INVALID_HANDLE_VALUE) {
+      parent = nullptr;
+      return false;
+    }
+    child = CreateFileW(name.c_str(), childAccess, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (child == INVALID_HANDLE_VALUE) {
+      child = nullptr;
+      return false;
+    }
+    return true;
+  };
+
+  if (
+    open(PIPE_ACCESS_OUTBOUND, GENERIC_READ, pipes.ParentIn, pipes.ChildIn)
+    and open(PIPE_ACCESS_INBOUND, GENERIC_WRITE, pipes.ParentOut, pipes.ChildOut))
+    return true;
+
+  closePipes(pipes);
+  return false;
+}
+
+void Spawner::closePipes(PipeSet &pipes)
+{
+  for (auto *handle : {&pipes.ParentIn, &pipes.ChildIn, &pipes.ParentOut, &pipes.ChildOut}) {
+    if (*handle) CloseHandle(std::exchange(*handle, nullptr));
+  }
+}
+#else
+auto Spawner::openPipes(PipeSet &pipes) -> bool
+{
+  int in[2];
+  int out[2];
+  if (::pipe2(in, O_CLOEXEC) != 0) return false;
+  if (::pipe2(out, O_CLOEXEC) != 0) {
+    ::close(in[0]);
+    ::close(in[1]);
+    return false;
+  }
+  pipes = PipeSet{.ParentIn = in[1], .ChildIn = in[0], .ParentOut = out[0], .ChildOut = out[1]};
+  return true;
+}
+
+void Spawner::closePipes(PipeSet &pipes)
+{
+  for (auto *descriptor : {&pipes.ParentIn, &pipes.ChildIn, &pipes.ParentOut, &pipes.ChildOut}) {
+    if (*descriptor >= 0) ::close(std::exchange(*descriptor, -1));
+  }
+}
+#endif
+
+}// namespace Blt
\ No newline at end of file
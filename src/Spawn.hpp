@@ -0,0 +1,99 @@
+#pragma once
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/readable_pipe.hpp>
+#include <boost/asio/writable_pipe.hpp>
+#include <boost/process/v2/process.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Accounting.hpp"
+
+namespace Blt {
+
+// The parent's ends of a child's stdin and stdout, either may be left out
+struct SpawnStdio
+{
+  boost::asio::writable_pipe *In  = nullptr;
+  boost::asio::readable_pipe *Out = nullptr;
+};
+
+/**
+ * Starts one helper executable through the cheapest path the platform has: posix_spawn on Linux, which glibc runs
+ * through clone(CLONE_VM | CLONE_VFORK) without copying the page tables, and CreateProcessW on Windows without the
+ * shell, COM or an elevation round trip (the tool's manifest already requires an elevated token).
+ * The executable path and the environment are resolved once, on first use, and a set of pipes is kept open ahead
+ * of the next launch so creating them is off the path to the child's first output.
+ * Children without a redirected stdout get no console of their own on Windows and /dev/null on Linux, their output
+ * never mixes with the log. stderr is inherited on Linux and not connected on Windows.
+ */
+class Spawner
+{
+public:
+  using Resolver = std::function<std::filesystem::path()>;
+
+  explicit Spawner(Resolver resolve);
+  ~Spawner();
+
+  Spawner(const Spawner &)            = delete;
+  Spawner &operator=(const Spawner &) = delete;
+
+  // Resolves now instead of on the first Launch and, with `pipes`, opens the pipes for it, safe from any thread
+  void Prepare(bool pipes);
+
+  /**
+   * With `accounting` the child is attached before it runs its first instruction on Windows (it starts suspended).
+   * The returned process owns the child like one boost::process started, async_execute and async_wait work on it.
+   */
+  auto Launch(
+    boost::asio::any_io_executor executor,
+    std::span<const std::string> arguments,
+    SpawnStdio stdio,
+    ChildAccounting *accounting,
+    boost::system::error_code &ec) -> boost::process::v2::process;
+
+  [[nodiscard]] auto Executable() -> const std::filesystem::path &;
+
+private:
+  // child ends are inheritable, parent ends are not
+  struct PipeSet
+  {
+#ifdef _WIN32
+    HANDLE ParentIn  = nullptr;
+    HANDLE ChildIn   = nullptr;
+    HANDLE ParentOut = nullptr;
+    HANDLE ChildOut  = nullptr;
+#else
+    int ParentIn  = -1;
+    int ChildIn   = -1;
+    int ParentOut = -1;
+    int ChildOut  = -1;
+#endif
+  };
+
+  void resolve();
+  auto openPipes(PipeSet &pipes) -> bool;
+  static void closePipes(PipeSet &pipes);
+
+  Resolver resolve_;
+  std::once_flag resolved_;
+  std::filesystem::path executable_;
+#ifdef _WIN32
+  std::wstring environment_;
+#else
+  std::vector<std::string> environment_;
+  std::vector<char *> environmentPointers_;
+#endif
+
+  std::mutex preparedLock_;
+  std::optional<PipeSet> prepared_;
+};
+
+}// namespace Blt
\ No newline at end of file
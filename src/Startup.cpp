@@ -0,0 +1,68 @@
+#include "Startup.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+
+#include "Log.hpp"
+
+namespace Blt {
+
+auto SystemExecutable::Path() -> std::string_view
+{
+  std::call_once(resolved_, [this] { resolve(); });
+  return std::string_view(path_.data(), size_);
+}
+
+void SystemExecutable::resolve()
+{
+  if (overrideVariable_) {
+    const auto length = GetEnvironmentVariableA(overrideVariable_, path_.data(), static_cast<DWORD>(path_.size()));
+    if (length != 0 and length < path_.size()) {
+      size_ = length;
+      return;
+    }
+  }
+
+  // GetSystemDirectoryW needs neither COM nor the shell, unlike SHGetKnownFolderPath
+  std::array<wchar_t, MAX_PATH> buffer;
+  auto size = static_cast<std::size_t>(GetSystemDirectoryW(buffer.data(), static_cast<UINT>(buffer.size())));
+  assert(size != 0 and size + 1 + name_.size() < buffer.size());
+  buffer[size++] = L'\\';
+  std::copy(name_.cbegin(), name_.cend(), buffer.data() + size);
+  size += name_.size();
+
+  auto written = WideCharToMultiByte(
+    CP_UTF8,
+    0,
+    buffer.data(),
+    static_cast<int>(size),
+    path_.data(),
+    static_cast<int>(path_.size() - 1),
+    nullptr,
+    nullptr);
+  assert(written);
+  path_[static_cast<std::size_t>(written)] = '\0';
+  size_                                    = static_cast<std::size_t>(written);
+}
+
+void MarkFirstCommandWritten(const LogFields &fields)
+{
+  static const auto enabled = std::getenv("BLT_STARTUP_TRACE") != nullptr;
+  static std::atomic_flag reported;
+  if (not enabled or reported.test_and_set()) return;
+
+  FILETIME now;
+  GetSystemTimePreciseAsFileTime(&now);
+  FILETIME creation, exit, kernel, user;
+  if (not GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return;
+
+  const auto ticks = [](const FILETIME &time) {
+    return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+  };
+  // FILETIME counts 100ns intervals
+  Log(LogLevel::Info, fields, "time-to-first-command: {}us", (ticks(now) - ticks(creation)) / 10);
+}
+
+}// namespace Blt
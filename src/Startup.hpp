@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Common.hpp"
+#include "Log.hpp"
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <string_view>
+
+namespace Blt {
+
+/**
+ * Absolute UTF-8 path of an executable in the system directory, resolved on first use so an action only pays for the
+ * helpers it actually launches.
+ * When `overrideVariable` names a set environment variable its value is used instead, which lets stand-ins replace
+ * the real tools.
+ */
+class SystemExecutable
+{
+public:
+  explicit SystemExecutable(std::string_view name, const char *overrideVariable = nullptr)
+    : name_(name)
+    , overrideVariable_(overrideVariable)
+  {}
+
+  SystemExecutable(const SystemExecutable &)            = delete;
+  SystemExecutable &operator=(const SystemExecutable &) = delete;
+
+  // NUL terminated, safe to call from several threads
+  [[nodiscard]] auto Path() -> std::string_view;
+
+private:
+  void resolve();
+
+  std::string_view name_;
+  const char *overrideVariable_;
+  std::once_flag resolved_;
+  std::array<char, MAX_PATH> path_{};
+  std::size_t size_ = 0;
+};
+
+// Logs the time from process creation to the first command written to diskpart once, when BLT_STARTUP_TRACE is set,
+// under the fields of the session that wrote it
+void MarkFirstCommandWritten(const LogFields &fields);
+
+}// namespace Blt
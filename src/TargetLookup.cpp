@@ -0,0 +1,218 @@
+#include "TargetLookup.hpp"
+
+#include <fmt/format.h>
+#include <fmt/chrono.h>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <chrono>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/windows/overlapped_ptr.hpp>
+#include <boost/asio/windows/random_access_handle.hpp>
+
+#include <array>
+#include <cstddef>
+
+#include <winioctl.h>
+#endif
+
+namespace asio = boost::asio;
+
+namespace Blt {
+
+namespace {
+#ifdef _WIN32
+  // DeviceIoControl on an overlapped handle completing through the io_context, cancelling it is CancelIoEx
+  template<typename CompletionToken>
+  auto asyncIoControl(
+    asio::windows::random_access_handle &device,
+    DWORD code,
+    void *output,
+    DWORD outputSize,
+    CompletionToken &&token)
+  {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code, std::size_t)>(
+      [&device, code, output, outputSize](auto handler) {
+        if (auto slot = asio::get_associated_cancellation_slot(handler); slot.is_connected()) {
+          slot.assign([&device](asio::cancellation_type) {
+            auto ignored = boost::system::error_code();
+            device.cancel(ignored);
+          });
+        }
+        auto overlapped = asio::windows::overlapped_ptr(device.get_executor(), std::move(handler));
+        DWORD returned  = 0;
+        if (
+          not DeviceIoControl(device.native_handle(), code, nullptr, 0, output, outputSize, &returned, overlapped.get())
+          and GetLastError() != ERROR_IO_PENDING) {
+          overlapped.complete(
+            boost::system::error_code(static_cast<int>(GetLastError()), asio::error::get_system_category()), 0);
+        } else {
+          // completions are queued to the port even when the call finished right away
+          overlapped.release();
+        }
+      },
+      token);
+  }
+#endif
+
+  auto listedAt(const VolumeLocation &location, DiskPartState state) -> CapacityBytes
+  {
+    return state == DiskPartState::ReadListDisk ? location.DiskCapacity : location.PartitionCapacity;
+  }
+}// namespace
+
+#ifdef _WIN32
+auto QueryTargetLocation(int diskNumber, int partitionNumber) -> asio::awaitable<std::optional<VolumeLocation>>
+{
+  const auto path = L"\\\\.\\PhysicalDrive" + std::to_wstring(diskNumber);
+  auto handle     = CreateFileW(
+    path.c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ | FILE_SHARE_WRITE,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_FLAG_OVERLAPPED,
+    nullptr);
+  if (handle == INVALID_HANDLE_VALUE) co_return std::nullopt;
+  auto device = asio::windows::random_access_handle(co_await asio::this_coro::executor, handle);
+
+  auto length = GET_LENGTH_INFORMATION{};
+  if (auto [ec, _] = co_await asyncIoControl(
+        device, IOCTL_DISK_GET_LENGTH_INFO, &length, sizeof(length), asio::as_tuple(asio::use_awaitable));
+      ec)
+    co_return std::nullopt;
+
+  // room for 128 entries, the size of a default GPT partition array
+  alignas(DRIVE_LAYOUT_INFORMATION_EX)
+    std::array<std::byte, sizeof(DRIVE_LAYOUT_INFORMATION_EX) + 127 * sizeof(PARTITION_INFORMATION_EX)> storage;
+  if (auto [ec, _] = co_await asyncIoControl(
+        device,
+        IOCTL_DISK_GET_DRIVE_LAYOUT_EX,
+        storage.data(),
+        static_cast<DWORD>(storage.size()),
+        asio::as_tuple(asio::use_awaitable));
+      ec)
+    co_return std::nullopt;
+  const auto *layout = reinterpret_cast<const DRIVE_LAYOUT_INFORMATION_EX *>(storage.data());
+
+  for (DWORD entry = 0; entry < layout->PartitionCount; ++entry) {
+    const auto &partition = layout->PartitionEntry[entry];
+    if (partition.PartitionNumber != static_cast<DWORD>(partitionNumber)) continue;
+    co_return VolumeLocation{
+      .DiskNumber        = diskNumber,
+      .DiskCapacity      = CapacityBytes(static_cast<uint64_t>(length.Length.QuadPart)),
+      .PartitionNumber   = partitionNumber,
+      .PartitionCapacity = CapacityBytes(static_cast<uint64_t>(partition.PartitionLength.QuadPart)),
+    };
+  }
+  co_return std::nullopt;
+}
+#elif defined(__linux__)
+auto QueryTargetLocation(int diskNumber, int partitionNumber) -> asio::awaitable<std::optional<VolumeLocation>>
+{
+  // a handful of small sysfs reads, nothing to wait on
+  co_return FindSysfsLocation(diskNumber, partitionNumber);
+}
+#else
+auto QueryTargetLocation(int, int) -> asio::awaitable<std::optional<VolumeLocation>>
+{
+  co_return std::nullopt;
+}
+#endif
+
+TargetHedge::TargetHedge(
+  int diskNumber, CapacityBytes diskCapacity, int partitionNumber, CapacityBytes partitionCapacity)
+  : diskNumber_(diskNumber)
+  , diskCapacity_(diskCapacity)
+  , partitionNumber_(partitionNumber)
+  , partitionCapacity_(partitionCapacity)
+{}
+
+auto TargetHedge::Run(LogFields fields) -> asio::awaitable<void>
+{
+  if (cancelled_) co_return;
+
+  const auto started         = std::chrono::steady_clock::now();
+  auto [exception, location] = co_await asio::co_spawn(
+    co_await asio::this_coro::executor,
+    QueryTargetLocation(diskNumber_, partitionNumber_),
+    asio::bind_cancellation_slot(cancel_.slot(), asio::as_tuple(asio::use_awaitable)));
+  const auto took =
+    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+  if (cancelled_) {
+    Log(LogLevel::Debug, fields, "direct lookup cancelled after {}, the list tables answered first", took);
+    co_return;
+  }
+  if (exception) {
+    Log(LogLevel::Warning, fields, "direct lookup failed after {}", took);
+    co_return;
+  }
+
+  answered_  = true;
+  direct_    = location;
+  confirmed_ = direct_ and MatchesListedCapacity(diskCapacity_, direct_->DiskCapacity)
+               and MatchesListedCapacity(partitionCapacity_, direct_->PartitionCapacity);
+  Log(
+    LogLevel::Info,
+    fields,
+    "direct lookup {} disk #{} partition #{} in {}",
+    confirmed_ ? "confirmed" : "could not confirm",
+    diskNumber_,
+    partitionNumber_,
+    took);
+  logDifference(fields, DiskPartState::ReadListDisk);
+  logDifference(fields, DiskPartState::ReadListPartition);
+}
+
+void TargetHedge::Compare(const LogFields &fields, DiskPartState state, DiskPartError error)
+{
+  // only a definite answer counts, a busy service or a broken pipe says nothing about the target
+  auto &tables = state == DiskPartState::ReadListDisk ? tablesDisk_ : tablesPartition_;
+  if (error == DiskPartError::Success) {
+    tables = true;
+  } else if (error == DiskPartError::MismatchDisk or error == DiskPartError::MismatchPartition) {
+    tables = false;
+  } else {
+    return;
+  }
+  logDifference(fields, state);
+
+  // the tables validated the whole target before the OS answered
+  if (state == DiskPartState::ReadListPartition and error == DiskPartError::Success and not answered_) Cancel();
+}
+
+void TargetHedge::Cancel()
+{
+  if (std::exchange(cancelled_, true) or answered_) return;
+  cancel_.emit(asio::cancellation_type::terminal);
+}
+
+void TargetHedge::logDifference(const LogFields &fields, DiskPartState state)
+{
+  const auto &tables = state == DiskPartState::ReadListDisk ? tablesDisk_ : tablesPartition_;
+  if (not answered_ or not tables) return;
+
+  const auto disk     = state == DiskPartState::ReadListDisk;
+  const auto given    = disk ? diskCapacity_ : partitionCapacity_;
+  const auto directly = direct_ and MatchesListedCapacity(given, listedAt(*direct_, state));
+  if (directly == *tables) return;
+
+  Log(
+    LogLevel::Warning,
+    fields,
+    "`list {}` {} #{} of {} bytes, the OS reports {}",
+    disk ? "disk" : "partition",
+    *tables ? "lists" : "does not list",
+    disk ? diskNumber_ : partitionNumber_,
+    given.Count(),
+    direct_ ? fmt::format("{} bytes", listedAt(*direct_, state).Count()) : std::string("no such device"));
+}
+
+}// namespace Blt
\ No newline at end of file
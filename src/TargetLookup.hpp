@@ -0,0 +1,68 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+
+#include <optional>
+
+#include "DiskPart.hpp"
+#include "Log.hpp"
+#include "Unit.hpp"
+#include "VolumeIndex.hpp"
+
+namespace Blt {
+
+/**
+ * Disk `diskNumber` and its partition `partitionNumber` with their exact capacities, read straight from the OS instead
+ * of waiting for VDS: IOCTL_DISK_GET_LENGTH_INFO and IOCTL_DISK_GET_DRIVE_LAYOUT_EX issued overlapped on
+ * \\.\PhysicalDrive<n> on Windows, sysfs on Linux. Cancelling the coroutine cancels an outstanding ioctl.
+ * nullopt when the disk can not be opened or has no such partition.
+ */
+auto QueryTargetLocation(int diskNumber, int partitionNumber) -> boost::asio::awaitable<std::optional<VolumeLocation>>;
+
+/**
+ * Races the direct lookup against the list tables of one diskpart conversation.
+ * Run queries the OS while diskpart is still starting up. Once the answer matches the target, Confirmed turns true
+ * and the protocol goes straight to `select`, skipping `list disk` and `list partition`. Whatever the tables
+ * answered meanwhile is reported through Compare, which logs where the two sources disagree. If the tables validate
+ * the target first, the direct query is cancelled through its cancellation_signal.
+ */
+class TargetHedge
+{
+public:
+  TargetHedge(int diskNumber, CapacityBytes diskCapacity, int partitionNumber, CapacityBytes partitionCapacity);
+
+  TargetHedge(const TargetHedge &)            = delete;
+  TargetHedge &operator=(const TargetHedge &) = delete;
+
+  // Returns once the direct query answered or was cancelled
+  auto Run(LogFields fields) -> boost::asio::awaitable<void>;
+
+  [[nodiscard]] auto Confirmed() const -> bool { return confirmed_; }
+
+  // What `list disk` (ReadListDisk) or `list partition` (ReadListPartition) answered about the target
+  void Compare(const LogFields &fields, DiskPartState state, DiskPartError error);
+
+  // The conversation no longer needs the direct answer
+  void Cancel();
+
+private:
+  // once both sources answered for `state`'s half of the target
+  void logDifference(const LogFields &fields, DiskPartState state);
+
+  int diskNumber_;
+  CapacityBytes diskCapacity_;
+  int partitionNumber_;
+  CapacityBytes partitionCapacity_;
+
+  boost::asio::cancellation_signal cancel_;
+  bool cancelled_ = false;
+  bool answered_  = false;
+  bool confirmed_ = false;
+  std::optional<VolumeLocation> direct_;
+  // what the list tables said, nullopt until they answered
+  std::optional<bool> tablesDisk_;
+  std::optional<bool> tablesPartition_;
+};
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include "Unlock.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/writable_pipe.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <utility>
+
+#include "Common.hpp"
+#include "Log.hpp"
+
+namespace Blt {
+
+namespace asio = boost::asio;
+
+namespace {
+  auto parseKind(std::string_view kind) -> std::optional<UnlockKeyKind>
+  {
+    if (kind == "password") return UnlockKeyKind::Password;
+    if (kind == "recovery-password") return UnlockKeyKind::RecoveryPassword;
+    if (kind == "recovery-key") return UnlockKeyKind::RecoveryKey;
+    return std::nullopt;
+  }
+
+  auto trim(std::string_view text) -> std::string_view
+  {
+    const auto begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) return {};
+    return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+  }
+
+  // "<kind> <secret>", the secret is the rest of the line so passwords may contain blanks
+  auto parseKey(std::string_view line) -> std::optional<UnlockKey>
+  {
+    line            = trim(line);
+    const auto kind = parseKind(line.substr(0, line.find_first_of(" \t")));
+    if (not kind or line.find_first_of(" \t") == std::string_view::npos) return std::nullopt;
+
+    const auto secret = trim(line.substr(line.find_first_of(" \t")));
+    if (secret.empty()) return std::nullopt;
+    return UnlockKey{.Kind = *kind, .Value = Secret(std::string(secret))};
+  }
+}// namespace
+
+void WipeString(std::string &value) noexcept
+{
+  // growing to the capacity never reallocates, it makes the bytes past size() reachable
+  value.resize(value.capacity());
+  auto *bytes = static_cast<volatile char *>(value.data());
+  for (std::size_t index = 0; index < value.size(); ++index) bytes[index] = '\0';
+  value.clear();
+}
+
+Secret::~Secret() { WipeString(value_); }
+
+Secret::Secret(Secret &&other) noexcept
+  : value_(std::move(other.value_))
+{
+  WipeString(other.value_);
+}
+
+Secret &Secret::operator=(Secret &&other) noexcept
+{
+  if (this != &other) {
+    WipeString(value_);
+    value_ = std::move(other.value_);
+    WipeString(other.value_);
+  }
+  return *this;
+}
+
+auto KeySource::Open(std::string_view spec) -> std::optional<KeySource>
+{
+  auto source = KeySource();
+  if (spec.starts_with("agent:")) {
+    source.agent_ = spec.substr(6);
+    return source;
+  }
+
+  auto file = std::ifstream(std::filesystem::path(spec));
+  if (not file) return std::nullopt;
+
+  auto line = std::string();
+  blt_defer {
+    WipeString(line);
+  };
+  for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+    auto view = trim(line);
+    if (view.empty() or view.starts_with('#')) continue;
+
+    const auto volumeEnd = view.find_first_of(" \t");
+    auto key             = volumeEnd == std::string_view::npos ? std::nullopt : parseKey(view.substr(volumeEnd));
+    if (not key) {
+      // the line holds key material, only its position is safe to report
+      Log(LogLevel::Error, "{}:{}: expected <volume> <kind> <secret>", spec, lineNumber);
+      continue;
+    }
+    source.entries_.push_back(
+      FileEntry{.Volume = std::string(view.substr(0, volumeEnd)), .Kind = key->Kind, .Value = std::move(key->Value)});
+  }
+  return source;
+}
+
+auto KeySource::Lookup(std::string_view volume) -> asio::awaitable<std::optional<UnlockKey>>
+{
+  if (agent_.empty()) {
+    const auto entry = std::ranges::find(entries_, volume, &FileEntry::Volume);
+    if (entry == entries_.end()) co_return std::nullopt;
+    co_return UnlockKey{.Kind = entry->Kind, .Value = Secret(std::string(entry->Value.Reveal()))};
+  }
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+  auto agent = asio::local::stream_protocol::socket(co_await asio::this_coro::executor);
+  if (auto [ec] = co_await agent.async_connect(
+        asio::local::stream_protocol::endpoint(agent_.string()), asio::as_tuple(asio::use_awaitable));
+      ec) {
+    Log(LogLevel::Error, "key agent {}: {}", agent_.string(), ec.message());
+    co_return std::nullopt;
+  }
+
+  const auto request = fmt::format("GET {}\n", volume);
+  if (auto [ec, size] =
+        co_await asio::async_write(agent, asio::buffer(request), asio::as_tuple(asio::use_awaitable));
+      ec) {
+    Log(LogLevel::Error, "key agent {}: {}", agent_.string(), ec.message());
+    co_return std::nullopt;
+  }
+
+  auto reply = std::string();
+  blt_defer {
+    WipeString(reply);
+  };
+  auto [ec, size] = co_await asio::async_read_until(
+    agent, asio::dynamic_buffer(reply, 4096), '\n', asio::as_tuple(asio::use_awaitable));
+  if (ec) {
+    Log(LogLevel::Error, "key agent {}: {}", agent_.string(), ec.message());
+    co_return std::nullopt;
+  }
+  co_return parseKey(std::string_view(reply).substr(0, size - 1));
+#else
+  Log(LogLevel::Error, "key agents need local socket support");
+  co_return std::nullopt;
+#endif
+}
+
+UnlockStage::UnlockStage(KeySource keys, UnlockCommand command, std::size_t parallelism)
+  : keys_(std::move(keys))
+  , command_(std::move(command))
+  , parallelism_(std::max<std::size_t>(parallelism, 1))
+{}
+
+auto UnlockStage::Run(std::vector<std::string> volumes) -> asio::awaitable<std::vector<UnlockResult>>
+{
+  auto results = std::vector<UnlockResult>(volumes.size());
+  auto next    = std::size_t(0);
+  auto worker  = [&]() -> asio::awaitable<void> {
+    while (next < volumes.size()) {
+      const auto index = next++;
+      results[index]   = co_await unlockOne(volumes[index]);
+    }
+  };
+
+  auto executor = co_await asio::this_coro::executor;
+  auto workers  = std::vector<decltype(asio::co_spawn(executor, worker(), asio::deferred))>();
+  for (std::size_t count = 0; count < std::min(parallelism_, volumes.size()); ++count)
+    workers.push_back(asio::co_spawn(executor, worker(), asio::deferred));
+  if (workers.empty()) co_return results;
+
+  auto [order, exceptions] = co_await asio::experimental::make_parallel_group(std::move(workers))
+                               .async_wait(asio::experimental::wait_for_all(), asio::use_awaitable);
+  for (const auto &exception : exceptions) {
+    if (exception) std::rethrow_exception(exception);
+  }
+  co_return results;
+}
+
+auto UnlockStage::unlockOne(const std::string &volume) -> asio::awaitable<UnlockResult>
+{
+  auto key = co_await keys_.Lookup(volume);
+  if (not key) {
+    Log(LogLevel::Warning, "no key for {}", volume);
+    co_return UnlockResult{.Volume = volume, .Error = UnlockError::NoKey, .ExitCode = -1};
+  }
+
+  auto arguments = std::vector<std::string>();
+  blt_defer {
+    for (auto &argument : arguments) WipeString(argument);
+  };
+  if (command_.SecretOnStdin) {
+    arguments.push_back(volume);
+  } else {
+    switch (key->Kind) {
+    case UnlockKeyKind::RecoveryPassword: {
+      arguments = {"-unlock", volume, "-RecoveryPassword", std::string(key->Value.Reveal())};
+      break;
+    }
+    case UnlockKeyKind::RecoveryKey: {
+      arguments = {"-unlock", volume, "-RecoveryKey", std::string(key->Value.Reveal())};
+      break;
+    }
+    case UnlockKeyKind::Password: {
+      Log(LogLevel::Error, "{}: manage-bde only takes a password from a console, configure a stand-in command", volume);
+      co_return UnlockResult{.Volume = volume, .Error = UnlockError::UnsupportedKey, .ExitCode = -1};
+    }
+    }
+  }
+  Log(LogLevel::Info, "unlocking {} with {} {}", volume, ToString(key->Kind), key->Value);
+
+  auto executor   = co_await asio::this_coro::executor;
+  auto secretIn   = asio::writable_pipe(executor);
+  auto ec         = boost::system::error_code();
+  auto accounting = ChildAccounting();
+  auto process    = command_.Launcher->Launch(executor, arguments, SpawnStdio{.In = &secretIn}, &accounting, ec);
+  for (auto &argument : arguments) WipeString(argument);
+  if (ec) {
+    Log(LogLevel::Error, "{}: unable to start {}: {}", volume, command_.Launcher->Executable().string(), ec.message());
+    co_return UnlockResult{.Volume = volume, .Error = UnlockError::SpawnFailed, .ExitCode = -1};
+  }
+
+  // wiped however the unlock ends
+  auto payload = std::string();
+  blt_defer {
+    WipeString(payload);
+  };
+  auto writeError = boost::system::error_code();
+  if (command_.SecretOnStdin) {
+    payload = fmt::format("{}\n{}\n", ToString(key->Kind), key->Value.Reveal());
+    auto [error, written] =
+      co_await asio::async_write(secretIn, asio::buffer(payload), asio::as_tuple(asio::use_awaitable));
+    writeError = error;
+    if (not error and written != payload.size()) writeError = asio::error::broken_pipe;
+    WipeString(payload);
+  }
+  secretIn.close();
+
+  // a command that exited before it read the secret is reaped all the same, its exit code says why it did
+  auto [waitError, exitCode] = co_await process.async_wait(asio::as_tuple(asio::use_awaitable));
+  if (writeError) {
+    Log(
+      LogLevel::Error,
+      "{}: unable to hand the secret to the unlock command: {}, it exited with {}",
+      volume,
+      writeError.message(),
+      exitCode);
+    co_return UnlockResult{
+      .Volume = volume, .Error = UnlockError::Failed, .ExitCode = exitCode, .Usage = accounting.Collect()};
+  }
+  if (waitError or exitCode != 0) {
+    Log(LogLevel::Error, "{}: unlock command exited with {}", volume, exitCode);
+    co_return UnlockResult{
+      .Volume = volume, .Error = UnlockError::Failed, .ExitCode = exitCode, .Usage = accounting.Collect()};
+  }
+  Log(LogLevel::Info, "{} unlocked", volume);
+  co_return UnlockResult{.Volume = volume, .Error = UnlockError::Success, .ExitCode = 0, .Usage = accounting.Collect()};
+}
+
+auto ToString(UnlockKeyKind kind) -> std::string_view
+{
+  switch (kind) {
+  case UnlockKeyKind::Password:
+    return "password";
+  case UnlockKeyKind::RecoveryPassword:
+    return "recovery-password";
+  case UnlockKeyKind::RecoveryKey:
+    return "recovery-key";
+  }
+  return "unknown";
+}
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Accounting.hpp"
+#include "Spawn.hpp"
+
+namespace Blt {
+
+/**
+ * Key material that is wiped when it goes away and can't be printed: formatting a Secret always yields
+ * "<redacted>", Reveal() is the only way to the bytes.
+ */
+class Secret
+{
+public:
+  Secret() = default;
+  explicit Secret(std::string value)
+    : value_(std::move(value))
+  {}
+  ~Secret();
+
+  Secret(Secret &&other) noexcept;
+  Secret &operator=(Secret &&other) noexcept;
+  Secret(const Secret &)            = delete;
+  Secret &operator=(const Secret &) = delete;
+
+  [[nodiscard]] auto Reveal() const noexcept -> std::string_view { return value_; }
+
+private:
+  std::string value_;
+};
+
+// Zeroes the whole allocation, not just size(), then empties the string
+void WipeString(std::string &value) noexcept;
+
+enum struct UnlockKeyKind {
+  Password,
+  RecoveryPassword,
+  RecoveryKey,
+};
+
+struct UnlockKey
+{
+  UnlockKeyKind Kind;
+  Secret Value;
+};
+
+/**
+ * Where unlock keys come from, picked by the spec:
+ *   agent:<socket path>   one "GET <volume>\n" per lookup, answered with "<kind> <secret>\n" or "NONE\n"
+ *   <file>                lines of "<volume> <kind> <secret>", lines starting with '#' are comments
+ * <kind> is password, recovery-password or recovery-key (a .BEK path), <volume> is what manage-bde takes, e.g. X:
+ */
+class KeySource
+{
+public:
+  static auto Open(std::string_view spec) -> std::optional<KeySource>;
+
+  auto Lookup(std::string_view volume) -> boost::asio::awaitable<std::optional<UnlockKey>>;
+
+private:
+  struct FileEntry
+  {
+    std::string Volume;
+    UnlockKeyKind Kind;
+    Secret Value;
+  };
+
+  std::filesystem::path agent_;
+  std::vector<FileEntry> entries_;
+};
+
+/**
+ * The program that unlocks one volume, started through its Spawner like every other helper.
+ * manage-bde takes recovery passwords and recovery keys as arguments and can't take a password without a console.
+ * A stand-in is started as `<executable> <volume>` and reads "<kind>\n<secret>\n" from stdin, so it sees every kind
+ * and the secret never shows up in a command line.
+ */
+struct UnlockCommand
+{
+  // outlives the stage, shared with whatever else launches the same executable
+  Spawner *Launcher;
+  bool SecretOnStdin;
+};
+
+enum struct UnlockError {
+  Success = 0,
+  NoKey,
+  UnsupportedKey,
+  SpawnFailed,
+  Failed,
+};
+
+struct UnlockResult
+{
+  std::string Volume;
+  UnlockError Error;
+  int ExitCode;
+  ResourceUsage Usage;
+};
+
+/**
+ * Unlocks many volumes with at most `parallelism` unlock commands running at once.
+ * Workers pull volumes from a shared cursor, which relies on the io_context running on a single thread.
+ */
+class UnlockStage
+{
+public:
+  UnlockStage(KeySource keys, UnlockCommand command, std::size_t parallelism);
+
+  auto Run(std::vector<std::string> volumes) -> boost::asio::awaitable<std::vector<UnlockResult>>;
+
+private:
+  auto unlockOne(const std::string &volume) -> boost::asio::awaitable<UnlockResult>;
+
+  KeySource keys_;
+  UnlockCommand command_;
+  std::size_t parallelism_;
+};
+
+auto ToString(UnlockKeyKind kind) -> std::string_view;
+
+}// namespace Blt
+
+template<>
+struct fmt::formatter<Blt::Secret> : fmt::formatter<std::string_view>
+{
+  auto format(const Blt::Secret &, fmt::format_context &context) const
+  {
+    return fmt::formatter<std::string_view>::format("<redacted>", context);
+  }
+};
\ No newline at end of file
@@ -0,0 +1,326 @@
+#include "VolumeIndex.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include "Common.hpp"
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Blt {
+
+namespace {
+  constexpr auto indexHeader = std::string_view("# BitLockerTool volume index v1");
+
+#ifdef __linux__
+  constexpr uint64_t sysfsSectorBytes = 512;
+
+  auto readAttribute(const std::filesystem::path &path) -> std::string
+  {
+    auto file  = std::ifstream(path);
+    auto value = std::string();
+    std::getline(file, value);
+    while (not value.empty() and std::isspace(static_cast<unsigned char>(value.back()))) value.pop_back();
+    return value;
+  }
+
+  auto readNumber(const std::filesystem::path &path) -> std::optional<uint64_t>
+  {
+    auto file = std::ifstream(path);
+    uint64_t value;
+    if (file >> value) return value;
+    return std::nullopt;
+  }
+
+  // The index is whitespace separated, serials and backing file paths may contain blanks
+  auto sysfsDiskId(const std::filesystem::path &disk) -> std::string
+  {
+    for (const auto *attribute : {"wwid", "device/wwid", "serial", "device/serial", "loop/backing_file"}) {
+      auto id = readAttribute(disk / attribute);
+      if (id.empty()) continue;
+      std::ranges::replace_if(id, [](unsigned char c) { return std::isspace(c); }, '_');
+      return NormalizeDiskId(id);
+    }
+    return {};
+  }
+
+  // RAM disks and device-mapper targets never carry a partition table, detached loop devices have no size
+  auto isSysfsDisk(const std::filesystem::path &disk) -> bool
+  {
+    const auto name = disk.filename().string();
+    for (const auto *prefix : {"ram", "zram", "dm-"}) {
+      if (name.starts_with(prefix)) return false;
+    }
+    return readNumber(disk / "size").value_or(0) > 0;
+  }
+
+  // In name order, the order disk numbers are handed out in
+  auto sysfsDisks(const std::filesystem::path &sysBlock) -> std::vector<std::filesystem::path>
+  {
+    auto ec    = std::error_code();
+    auto disks = std::vector<std::filesystem::path>();
+    for (const auto &entry : std::filesystem::directory_iterator(sysBlock, ec)) {
+      if (isSysfsDisk(entry.path())) disks.push_back(entry.path());
+    }
+    std::ranges::sort(disks);
+    return disks;
+  }
+
+  auto sameCapacity(CapacityBytes given, std::optional<uint64_t> sectors) -> bool
+  {
+    return sectors and MatchesListedCapacity(given, CapacityBytes(*sectors * sysfsSectorBytes));
+  }
+#endif
+
+#ifdef _WIN32
+  // `bytes` on the disk under `path` before it returns, true only if all of them made it
+  auto writeDurably(const std::filesystem::path &path, std::string_view bytes) -> bool
+  {
+    const auto file =
+      CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    auto written = true;
+    while (written and not bytes.empty()) {
+      auto chunk = DWORD{0};
+      written    = WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &chunk, nullptr);
+      bytes.remove_prefix(chunk);
+    }
+    written = written and FlushFileBuffers(file);
+    CloseHandle(file);
+    return written;
+  }
+
+  // NTFS journals the rename itself, write-through returns once it is on the disk
+  auto replaceFile(const std::filesystem::path &from, const std::filesystem::path &to) -> bool
+  {
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+  }
+#else
+  auto writeDurably(const std::filesystem::path &path, std::string_view bytes) -> bool
+  {
+    const auto file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file < 0) return false;
+    auto written = true;
+    while (written and not bytes.empty()) {
+      const auto chunk = ::write(file, bytes.data(), bytes.size());
+      if (chunk < 0 and errno == EINTR) continue;
+      written = chunk >= 0;
+      if (written) bytes.remove_prefix(static_cast<std::size_t>(chunk));
+    }
+    written = written and ::fdatasync(file) == 0;
+    ::close(file);
+    return written;
+  }
+
+  // the rename is only durable once the directory holding both names is
+  auto replaceFile(const std::filesystem::path &from, const std::filesystem::path &to) -> bool
+  {
+    if (::rename(from.c_str(), to.c_str()) != 0) return false;
+    const auto parent    = to.has_parent_path() ? to.parent_path() : std::filesystem::path(".");
+    const auto directory = ::open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory < 0) return false;
+    const auto synced = ::fsync(directory) == 0;
+    ::close(directory);
+    return synced;
+  }
+#endif
+}// namespace
+
+auto MatchesListedCapacity(CapacityBytes given, CapacityBytes actual) -> bool
+{
+  for (const uint64_t unit : {uint64_t{1} << 30, uint64_t{1} << 20, uint64_t{1} << 10}) {
+    if (given.Count() % unit != 0) continue;
+    return given.Count() == (actual.Count() + unit / 2) / unit * unit;
+  }
+  return given == actual;
+}
+
+auto VolumeKeyHash::operator()(const VolumeKey &key) const noexcept -> std::size_t
+{
+  return std::hash<std::string>{}(key.DiskId) ^ (std::hash<uint64_t>{}(key.PartitionOffset) << 1);
+}
+
+auto NormalizeDiskId(std::string_view diskId) -> std::string
+{
+  if (diskId.starts_with('{') and diskId.ends_with('}')) diskId = diskId.substr(1, diskId.size() - 2);
+
+  auto normalized = std::string(diskId);
+  std::ranges::transform(normalized, normalized.begin(), [](unsigned char c) { return std::toupper(c); });
+  return normalized;
+}
+
+void VolumeIndex::Insert(VolumeKey key, VolumeLocation location)
+{
+  entries_.insert_or_assign(std::move(key), location);
+}
+
+auto VolumeIndex::Resolve(const VolumeKey &key) const -> std::optional<VolumeLocation>
+{
+  if (auto entry = entries_.find(key); entry != entries_.end()) return entry->second;
+  return std::nullopt;
+}
+
+auto VolumeIndex::Size() const -> std::size_t { return entries_.size(); }
+
+auto VolumeIndex::Save(const std::filesystem::path &path) const -> bool
+{
+  auto ec = std::error_code();
+  if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+
+  auto content = std::ostringstream();
+  content << indexHeader << '\n';
+  for (const auto &[key, location] : entries_) {
+    content << key.DiskId << ' ' << key.PartitionOffset << ' ' << location.DiskNumber << ' '
+            << location.DiskCapacity.Count() << ' ' << location.PartitionNumber << ' '
+            << location.PartitionCapacity.Count() << '\n';
+  }
+
+  // the staging file is on the disk before the rename, a power loss leaves the old index or the new one, never a torn
+  // one in its place
+  auto staging = path;
+  staging += ".tmp";
+  if (not writeDurably(staging, content.view())) {
+    std::filesystem::remove(staging, ec);
+    return false;
+  }
+  return replaceFile(staging, path);
+}
+
+auto VolumeIndex::Load(const std::filesystem::path &path) -> std::optional<VolumeIndex>
+{
+  auto file = std::ifstream(path);
+  if (not file) return std::nullopt;
+
+  auto header = std::string();
+  if (not std::getline(file, header) or header != indexHeader) return std::nullopt;
+
+  auto index    = VolumeIndex();
+  auto key      = VolumeKey();
+  auto location = VolumeLocation();
+  uint64_t diskCapacity;
+  uint64_t partitionCapacity;
+  while (file >> key.DiskId >> key.PartitionOffset >> location.DiskNumber >> diskCapacity >> location.PartitionNumber
+         >> partitionCapacity) {
+    location.DiskCapacity      = CapacityBytes(diskCapacity);
+    location.PartitionCapacity = CapacityBytes(partitionCapacity);
+    index.Insert(key, location);
+  }
+  if (not file.eof()) return std::nullopt;
+  return index;
+}
+
+auto DefaultVolumeIndexPath() -> std::filesystem::path
+{
+#ifdef _WIN32
+  if (const auto *localAppData = std::getenv("LOCALAPPDATA"))
+    return std::filesystem::path(localAppData) / "BitLockerTool" / "volumes.idx";
+  return "volumes.idx";
+#else
+  if (const auto *stateHome = std::getenv("XDG_STATE_HOME"); stateHome and *stateHome)
+    return std::filesystem::path(stateHome) / "bitlockertool" / "volumes.idx";
+  if (const auto *home = std::getenv("HOME"))
+    return std::filesystem::path(home) / ".local" / "state" / "bitlockertool" / "volumes.idx";
+  return "volumes.idx";
+#endif
+}
+
+#ifdef __linux__
+auto BuildVolumeIndexFromSysfs(const std::filesystem::path &sysBlock, std::string_view device) -> VolumeIndex
+{
+  auto ec          = std::error_code();
+  const auto disks = sysfsDisks(sysBlock);
+
+  auto index = VolumeIndex();
+  for (int diskNumber = 0; diskNumber < static_cast<int>(disks.size()); ++diskNumber) {
+    const auto &disk = disks[static_cast<std::size_t>(diskNumber)];
+    if (not device.empty() and disk.filename() != device and not std::filesystem::exists(disk / device, ec)) continue;
+
+    const auto diskId = sysfsDiskId(disk);
+    if (diskId.empty()) continue;
+    const auto diskSectors = readNumber(disk / "size");
+
+    for (const auto &entry : std::filesystem::directory_iterator(disk, ec)) {
+      const auto partitionNumber = readNumber(entry.path() / "partition");
+      const auto start           = readNumber(entry.path() / "start");
+      const auto sectors         = readNumber(entry.path() / "size");
+      if (not partitionNumber or not start or not sectors) continue;
+
+      index.Insert(
+        VolumeKey{.DiskId = diskId, .PartitionOffset = *start * sysfsSectorBytes},
+        VolumeLocation{
+          .DiskNumber        = diskNumber,
+          .DiskCapacity      = CapacityBytes(diskSectors.value_or(0) * sysfsSectorBytes),
+          .PartitionNumber   = static_cast<int>(*partitionNumber),
+          .PartitionCapacity = CapacityBytes(*sectors * sysfsSectorBytes),
+        });
+    }
+  }
+  return index;
+}
+
+auto FindSysfsDevice(const VolumeLocation &location, const std::filesystem::path &sysBlock)
+  -> std::optional<std::string>
+{
+  const auto disks = sysfsDisks(sysBlock);
+  if (location.DiskNumber < 0 or location.DiskNumber >= static_cast<int>(disks.size())) return std::nullopt;
+  const auto &disk = disks[static_cast<std::size_t>(location.DiskNumber)];
+  if (not sameCapacity(location.DiskCapacity, readNumber(disk / "size"))) return std::nullopt;
+
+  if (location.PartitionNumber == 0) {
+    if (not sameCapacity(location.PartitionCapacity, readNumber(disk / "size"))) return std::nullopt;
+    return disk.filename().string();
+  }
+
+  auto ec = std::error_code();
+  for (const auto &entry : std::filesystem::directory_iterator(disk, ec)) {
+    const auto partitionNumber = readNumber(entry.path() / "partition");
+    if (partitionNumber != static_cast<uint64_t>(location.PartitionNumber)) continue;
+    if (not sameCapacity(location.PartitionCapacity, readNumber(entry.path() / "size"))) return std::nullopt;
+    return entry.path().filename().string();
+  }
+  return std::nullopt;
+}
+
+auto FindSysfsLocation(int diskNumber, int partitionNumber, const std::filesystem::path &sysBlock)
+  -> std::optional<VolumeLocation>
+{
+  const auto disks = sysfsDisks(sysBlock);
+  if (diskNumber < 0 or diskNumber >= static_cast<int>(disks.size())) return std::nullopt;
+  const auto &disk       = disks[static_cast<std::size_t>(diskNumber)];
+  const auto diskSectors = readNumber(disk / "size");
+  auto location          = VolumeLocation{
+    .DiskNumber        = diskNumber,
+    .DiskCapacity      = CapacityBytes(diskSectors.value_or(0) * sysfsSectorBytes),
+    .PartitionNumber   = partitionNumber,
+    .PartitionCapacity = CapacityBytes(0),
+  };
+  if (partitionNumber == 0) {
+    location.PartitionCapacity = location.DiskCapacity;
+    return location;
+  }
+
+  auto ec = std::error_code();
+  for (const auto &entry : std::filesystem::directory_iterator(disk, ec)) {
+    if (readNumber(entry.path() / "partition") != static_cast<uint64_t>(partitionNumber)) continue;
+    const auto sectors = readNumber(entry.path() / "size");
+    if (not sectors) return std::nullopt;
+    location.PartitionCapacity = CapacityBytes(*sectors * sysfsSectorBytes);
+    return location;
+  }
+  return std::nullopt;
+}
+#endif
+
+}// namespace Blt
\ No newline at end of file
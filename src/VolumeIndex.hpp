@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "Unit.hpp"
+
+namespace Blt {
+
+/**
+ * What identifies a volume across reboots and hot-plug: the disk's GPT GUID or MBR signature as printed by
+ * `detail disk` (the device WWID or serial on Linux) and the byte offset the partition starts at.
+ */
+struct VolumeKey
+{
+  std::string DiskId;
+  uint64_t PartitionOffset;
+
+  friend auto operator==(const VolumeKey &, const VolumeKey &) -> bool = default;
+};
+
+struct VolumeKeyHash
+{
+  auto operator()(const VolumeKey &key) const noexcept -> std::size_t;
+};
+
+// Where a volume was found the last time the index was built, numbers are only valid until disks are re-enumerated
+struct VolumeLocation
+{
+  int DiskNumber;
+  CapacityBytes DiskCapacity;
+  int PartitionNumber;
+  CapacityBytes PartitionCapacity;
+};
+
+// Upper case without braces, so `{8a3e...}` from a user and `{8A3E...}` from diskpart are the same disk
+auto NormalizeDiskId(std::string_view diskId) -> std::string;
+
+class VolumeIndex
+{
+public:
+  void Insert(VolumeKey key, VolumeLocation location);
+
+  [[nodiscard]] auto Resolve(const VolumeKey &key) const -> std::optional<VolumeLocation>;
+
+  [[nodiscard]] auto Size() const -> std::size_t;
+
+  // Written to a sibling file, synced and renamed over `path`: no reader and no power loss sees half an index
+  auto Save(const std::filesystem::path &path) const -> bool;
+
+  static auto Load(const std::filesystem::path &path) -> std::optional<VolumeIndex>;
+
+private:
+  std::unordered_map<VolumeKey, VolumeLocation, VolumeKeyHash> entries_;
+};
+
+/**
+ * Whether a device of `actual` bytes is what a capacity given on the command line means. A capacity in whole
+ * KiB/MiB/GiB matches the size rounded to that unit, the way diskpart's list tables show it.
+ */
+auto MatchesListedCapacity(CapacityBytes given, CapacityBytes actual) -> bool;
+
+// %LOCALAPPDATA%\BitLockerTool\volumes.idx on Windows, $XDG_STATE_HOME/bitlockertool/volumes.idx elsewhere
+auto DefaultVolumeIndexPath() -> std::filesystem::path;
+
+#ifdef __linux__
+/**
+ * Builds the index from sysfs without spawning anything. Disks are numbered in name order among the block devices
+ * that can hold a partition table, partitions use the kernel's partition number. Loop devices are identified by
+ * their backing file.
+ * With a `device` (kernel name of a disk or one of its partitions) only the volumes on that disk are indexed.
+ */
+auto BuildVolumeIndexFromSysfs(const std::filesystem::path &sysBlock = "/sys/block", std::string_view device = {})
+  -> VolumeIndex;
+
+/**
+ * Kernel name of the block device at `location`, with disks numbered like BuildVolumeIndexFromSysfs numbers them,
+ * nullopt when there is none or its capacities do not match. Partition 0 is the disk itself, an image formatted
+ * without a partition table. A capacity taken from the command line is in whole KiB/MiB/GiB, it matches the device's
+ * size rounded to that unit the way diskpart's list tables are.
+ */
+auto FindSysfsDevice(const VolumeLocation &location, const std::filesystem::path &sysBlock = "/sys/block")
+  -> std::optional<std::string>;
+
+// Disk `diskNumber` and its partition `partitionNumber` with the capacities sysfs reports, nullopt if either is gone
+auto FindSysfsLocation(int diskNumber, int partitionNumber, const std::filesystem::path &sysBlock = "/sys/block")
+  -> std::optional<VolumeLocation>;
+#endif
+
+}// namespace Blt
\ No newline at end of file
@@ -0,0 +1,416 @@
+#include <fmt/format.h>
+#include <boost/asio.hpp>
+#include <boost/asio/connect_pipe.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/asio/use_future.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "DiskPart.hpp"
+#include "DiskPartProtocol.hpp"
+#include "FakeDiskPart.hpp"
+#include "Log.hpp"
+#include "TargetLookup.hpp"
+#include "VolumeIndex.hpp"
+
+namespace asio = boost::asio;
+
+using namespace boost::asio::experimental::awaitable_operators;
+
+#ifdef _WIN32
+constexpr auto nullDevice = "NUL";
+#else
+constexpr auto nullDevice = "/dev/null";
+#endif
+
+namespace {
+
+struct Tally
+{
+  uint64_t Allocations = 0;
+  uint64_t Bytes       = 0;
+};
+
+// What one session allocated, per state of the conversation, slot 0 is before the first state
+struct AllocationTracker
+{
+  const int *State = nullptr;
+  std::array<Tally, Blt::Detail::DiskPartStateCount + 1> PerState{};
+  Tally Total;
+  int64_t Live = 0;
+  int64_t Peak = 0;
+};
+
+// only the thread running the engine counts, the log writer and the diskpart stand-in have threads of their own
+thread_local AllocationTracker *tracker = nullptr;
+
+// In front of every block: where malloc put it and how much was asked for, so a free can be accounted too
+struct BlockHeader
+{
+  void *Raw;
+  std::size_t Size;
+};
+
+auto countedAllocate(std::size_t size, std::size_t alignment) noexcept -> void *
+{
+  alignment = std::max(alignment, alignof(BlockHeader));
+  auto *raw = std::malloc(size + sizeof(BlockHeader) + alignment);
+  if (raw == nullptr) return nullptr;
+  const auto address =
+    (reinterpret_cast<std::uintptr_t>(raw) + sizeof(BlockHeader) + alignment - 1) & ~(alignment - 1);
+  auto *block = reinterpret_cast<void *>(address);
+  std::construct_at(reinterpret_cast<BlockHeader *>(address) - 1, BlockHeader{.Raw = raw, .Size = size});
+
+  if (auto *active = tracker) {
+    const auto slot = active->State ? static_cast<std::size_t>(*active->State + 1) : 0;
+    ++active->PerState[slot].Allocations;
+    active->PerState[slot].Bytes += size;
+    ++active->Total.Allocations;
+    active->Total.Bytes += size;
+    active->Live += static_cast<int64_t>(size);
+    active->Peak = std::max(active->Peak, active->Live);
+  }
+  return block;
+}
+
+void countedFree(void *block) noexcept
+{
+  if (block == nullptr) return;
+  const auto header = *(static_cast<BlockHeader *>(block) - 1);
+  if (auto *active = tracker) active->Live -= static_cast<int64_t>(header.Size);
+  std::free(header.Raw);
+}
+
+auto throwingAllocate(std::size_t size, std::size_t alignment) -> void *
+{
+  if (auto *block = countedAllocate(size, alignment)) return block;
+  throw std::bad_alloc();
+}
+
+}// namespace
+
+// Replaced for the whole program, the nothrow forms forward to these
+auto operator new(std::size_t size) -> void * { return throwingAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+auto operator new[](std::size_t size) -> void * { return throwingAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+auto operator new(std::size_t size, std::align_val_t alignment) -> void *
+{
+  return throwingAllocate(size, static_cast<std::size_t>(alignment));
+}
+auto operator new[](std::size_t size, std::align_val_t alignment) -> void *
+{
+  return throwingAllocate(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void *block) noexcept { countedFree(block); }
+void operator delete[](void *block) noexcept { countedFree(block); }
+void operator delete(void *block, std::size_t) noexcept { countedFree(block); }
+void operator delete[](void *block, std::size_t) noexcept { countedFree(block); }
+void operator delete(void *block, std::align_val_t) noexcept { countedFree(block); }
+void operator delete[](void *block, std::align_val_t) noexcept { countedFree(block); }
+void operator delete(void *block, std::size_t, std::align_val_t) noexcept { countedFree(block); }
+void operator delete[](void *block, std::size_t, std::align_val_t) noexcept { countedFree(block); }
+
+namespace {
+
+constexpr auto stateNames = std::to_array<std::string_view>({
+  "(before StartUp)",
+  "StartUp",
+  "ListDisk",
+  "ReadListDisk",
+  "SelectDisk",
+  "ReadSelectDisk",
+  "ListPartition",
+  "ReadListPartition",
+  "SelectPartition",
+  "ReadSelectPartition",
+  "AssignLetter",
+  "ReadAssignLetter",
+  "RemoveLetter",
+  "ReadRemoveLetter",
+  "DetailDisk",
+  "ReadDetailDisk",
+  "DetailPartition",
+  "ReadDetailPartition",
+  "SelectVolume",
+  "ReadSelectVolume",
+  "Exit",
+});
+static_assert(stateNames.size() == Blt::Detail::DiskPartStateCount + 1, "a name for every DiskPartState");
+
+struct Budget
+{
+  uint64_t Allocations = 0;
+  int64_t PeakBytes    = 0;
+};
+
+// One operation as the engine runs it, how the target is given decides the route through the protocol
+struct Operation
+{
+  std::string_view Name;
+  bool Unmount   = false;
+  bool ByVolume  = false;
+  bool Journaled = false;
+  // a target given by numbers the way DiskPartMount and DiskPartUnmount run it, raced against the direct lookup
+  bool Hedged = false;
+};
+
+constexpr auto operations = std::to_array<Operation>({
+  {.Name = "mount-tables"},
+  {.Name = "mount-hedged", .Hedged = true},
+  {.Name = "mount-volume", .ByVolume = true},
+  {.Name = "unmount-tables", .Unmount = true},
+  {.Name = "unmount-hedged", .Unmount = true, .Hedged = true},
+  {.Name = "unmount-volume", .Unmount = true, .ByVolume = true},
+  {.Name = "unmount-journaled", .Unmount = true, .Journaled = true},
+});
+
+template<const auto &Protocol>
+auto Tracked(
+  Blt::DiskPartSession &session,
+  asio::readable_pipe &diskpartOut,
+  asio::writable_pipe &diskpartIn,
+  Blt::DiskPartTarget &target,
+  bool hedged,
+  AllocationTracker &counts) -> asio::awaitable<Blt::DiskPartError>
+{
+  counts.State = &session.Fields.State;
+  tracker      = &counts;
+  auto error   = Blt::DiskPartError::IO;
+  if (hedged) {
+    auto hedge =
+      Blt::TargetHedge(target.DiskNumber, target.DiskCapacity, target.PartitionNumber, target.PartitionCapacity);
+    target.Hedge = &hedge;
+    error        = co_await (
+      Blt::RunDiskPartProtocol<Protocol>(session, diskpartOut, diskpartIn, target) && hedge.Run(session.Fields));
+    target.Hedge = nullptr;
+  } else {
+    error = co_await Blt::RunDiskPartProtocol<Protocol>(session, diskpartOut, diskpartIn, target);
+  }
+  tracker = nullptr;
+  co_return error;
+}
+
+/**
+ * One full conversation of `operation` against the stand-in, counting from the first step to Exit.
+ * The stand-in runs on `fake`'s thread, the pipes and its coroutine are set up before counting starts.
+ */
+auto Session(asio::io_context &ioc, asio::io_context &fake, const Operation &operation, AllocationTracker &counts)
+  -> Blt::DiskPartError
+{
+  auto diskpartOut = asio::readable_pipe(ioc);
+  auto responseOut = asio::writable_pipe(fake);
+  auto commandIn   = asio::readable_pipe(fake);
+  auto diskpartIn  = asio::writable_pipe(ioc);
+  asio::connect_pipe(diskpartOut, responseOut);
+  asio::connect_pipe(commandIn, diskpartIn);
+  auto standIn = asio::co_spawn(fake, Blt::Bench::FakeDiskPart(commandIn, responseOut), asio::use_future);
+
+  const auto mount  = Blt::MountPoint{.Letter = 'X'};
+  const auto volume = operation.ByVolume
+                        ? std::optional<Blt::VolumeKey>(Blt::VolumeKey{
+                            .DiskId = Blt::NormalizeDiskId("{8A3E2F4C-5B6D-4E7F-8091-A2B3C4D5E6F7}"),
+                            .PartitionOffset = 536870912000})
+                        : std::nullopt;
+  auto target = Blt::DiskPartTarget{
+    .DiskNumber        = 0,
+    .DiskCapacity      = Blt::capacityCast<Blt::CapacityBytes>(Blt::Gibibytes(1863)),
+    .PartitionNumber   = 6,
+    .PartitionCapacity = Blt::capacityCast<Blt::CapacityBytes>(Blt::Gibibytes(362)),
+    .Mount             = mount,
+    .Volume            = volume,
+    .Journaled         = operation.Journaled,
+  };
+
+  auto error = Blt::DiskPartError::IO;
+  Blt::DiskPartSession session;
+  auto conversation =
+    operation.Unmount
+      ? Tracked<Blt::DiskPartUnmountProtocol>(session, diskpartOut, diskpartIn, target, operation.Hedged, counts)
+      : Tracked<Blt::DiskPartMountProtocol>(session, diskpartOut, diskpartIn, target, operation.Hedged, counts);
+  asio::co_spawn(ioc, std::move(conversation), [&error](std::exception_ptr, Blt::DiskPartError result) {
+    error = result;
+  });
+  ioc.restart();
+  ioc.run();
+  standIn.get();
+  return error;
+}
+
+// A budget per operation, nullopt for one listed as `- -` that is reported but not held to a budget until recorded
+using Budgets = std::map<std::string, std::optional<Budget>, std::less<>>;
+
+template<typename Number>
+auto ParseNumber(std::string_view text, Number &number) -> bool
+{
+  const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), number);
+  return error == std::errc() and end == text.data() + text.size();
+}
+
+// `<operation> <allocations> <peak bytes>` per line, '#' starts a comment. Empty when a line is anything else
+auto ReadBudgets(const std::string &path) -> std::optional<Budgets>
+{
+  auto file = std::ifstream(path);
+  if (not file) return std::nullopt;
+  auto budgets = Budgets();
+  for (auto line = std::string(); std::getline(file, line);) {
+    if (line.empty() or line.front() == '#') continue;
+    auto name        = std::string();
+    auto allocations = std::string();
+    auto peak        = std::string();
+    if (auto fields = std::istringstream(line); not(fields >> name >> allocations >> peak)) return std::nullopt;
+    if (allocations == "-" and peak == "-") {
+      budgets.emplace(std::move(name), std::nullopt);
+      continue;
+    }
+    auto budget = Budget();
+    if (not ParseNumber(allocations, budget.Allocations) or not ParseNumber(peak, budget.PeakBytes))
+      return std::nullopt;
+    budgets.emplace(std::move(name), budget);
+  }
+  return budgets;
+}
+
+// The comment lines of the budget file, in order, so recording only replaces the numbers
+auto ReadComments(const std::string &path) -> std::vector<std::string>
+{
+  auto file     = std::ifstream(path);
+  auto comments = std::vector<std::string>();
+  for (auto line = std::string(); std::getline(file, line);)
+    if (not line.empty() and line.front() == '#') comments.push_back(std::move(line));
+  return comments;
+}
+
+void PrintBreakdown(const AllocationTracker &counts)
+{
+  fmt::println(stderr, "  {:<22} {:>11} {:>11}", "state", "allocations", "bytes");
+  for (std::size_t slot = 0; slot < counts.PerState.size(); ++slot) {
+    if (counts.PerState[slot].Allocations == 0) continue;
+    fmt::println(
+      stderr,
+      "  {:<22} {:>11} {:>11}",
+      stateNames[slot],
+      counts.PerState[slot].Allocations,
+      counts.PerState[slot].Bytes);
+  }
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_AllocationTest  [--record] [budget file]
+ *
+ * Runs every mount and unmount route against the in-memory diskpart stand-in under a counting global allocator and
+ * compares the steady-state allocations and peak live bytes of one session with the budgets in AllocationBudgets.txt.
+ * An operation without a budget may not allocate at all after the warm-up, one listed as `- -` is only reported.
+ * Exits with failure and prints where in the conversation the allocations happened when a budget is exceeded, and
+ * when the budget file is missing or malformed.
+ * --record (or BLT_RECORD_ALLOCATION_BUDGETS=1) writes the current numbers as the new budgets instead of checking, the
+ * comments of the file stay as they are.
+ */
+int main(int argc, char **argv)
+{
+  const auto *recordVariable = std::getenv("BLT_RECORD_ALLOCATION_BUDGETS");
+  auto record                = recordVariable and std::string_view(recordVariable) == "1";
+  auto path                  = std::string(BLT_ALLOCATION_BUDGETS);
+  for (int arg = 1; arg < argc; ++arg) {
+    if (std::string_view(argv[arg]) == "--record") {
+      record = true;
+    } else {
+      path = argv[arg];
+    }
+  }
+  constexpr int warmUpRounds   = 50;
+  constexpr int measuredRounds = 200;
+
+  auto budgets  = ReadBudgets(path);
+  auto comments = ReadComments(path);
+  if (not budgets and not record) {
+    fmt::println(stderr, "unable to read the budgets from {}, --record writes them", path);
+    return EXIT_FAILURE;
+  }
+
+  // the steps log every command, keep the text out of the terminal like PipeBench does
+  if (std::freopen(nullDevice, "w", stdout) == nullptr) return EXIT_FAILURE;
+  Blt::LogSink::Instance().Start(Blt::LogOptions{});
+
+  asio::io_context ioc;
+  asio::io_context fake;
+  auto fakeWork   = asio::make_work_guard(fake);
+  auto fakeThread = std::thread([&fake] { fake.run(); });
+
+  auto measured = std::map<std::string, Budget, std::less<>>();
+  auto exceeded = false;
+  for (const auto &operation : operations) {
+    // asio's recycled operation memory, its frame cache and the log sink settle during warm-up, what remains is per
+    // session
+    for (int round = 0; round < warmUpRounds; ++round) {
+      auto ignored = AllocationTracker();
+      Session(ioc, fake, operation, ignored);
+    }
+
+    auto worst    = AllocationTracker();
+    auto failures = 0;
+    for (int round = 0; round < measuredRounds; ++round) {
+      auto counts = AllocationTracker();
+      if (Session(ioc, fake, operation, counts) != Blt::DiskPartError::Success) ++failures;
+      if (counts.Total.Allocations > worst.Total.Allocations or counts.Peak > worst.Peak) worst = counts;
+    }
+    measured[std::string(operation.Name)] = Budget{.Allocations = worst.Total.Allocations, .PeakBytes = worst.Peak};
+
+    auto budget     = std::optional<Budget>();
+    auto unrecorded = false;
+    // an operation the file does not list gets none at all: the session arena and asio's frame cache serve a warmed
+    // up session
+    if (not record) {
+      const auto found = budgets->find(operation.Name);
+      budget           = found != budgets->end() ? found->second : Budget{};
+      unrecorded       = not budget;
+    }
+    const auto over =
+      budget and (worst.Total.Allocations > budget->Allocations or worst.Peak > budget->PeakBytes);
+    fmt::println(
+      stderr,
+      "{:<18} {} allocations, {} bytes peak{}, failures {}",
+      operation.Name,
+      worst.Total.Allocations,
+      worst.Peak,
+      budget       ? fmt::format(" (budget {}, {} bytes)", budget->Allocations, budget->PeakBytes)
+      : unrecorded ? std::string(" (no budget recorded yet)")
+                   : std::string(),
+      failures);
+    if (over or failures != 0) {
+      exceeded = true;
+      PrintBreakdown(worst);
+    }
+  }
+
+  fakeWork.reset();
+  fakeThread.join();
+  Blt::LogSink::Instance().Stop();
+
+  if (record) {
+    if (comments.empty())
+      comments.emplace_back("# operation allocations peak-bytes, one mount or unmount session at steady state");
+    auto file = std::ofstream(path);
+    for (const auto &comment : comments) file << comment << '\n';
+    for (const auto &[name, budget] : measured)
+      file << fmt::format("{} {} {}\n", name, budget.Allocations, budget.PeakBytes);
+    fmt::println(stderr, "budgets recorded to {}", path);
+  }
+  return exceeded ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <cstdlib>
+#include <string_view>
+
+namespace Blt::Test {
+
+// Checks that failed so far in this test program
+inline auto Failures = 0;
+
+// Prints `what` and counts it when `condition` does not hold
+inline void Check(bool condition, std::string_view what)
+{
+  if (condition) return;
+  fmt::println("FAILED: {}", what);
+  ++Failures;
+}
+
+// The exit code of the test program, after printing how many checks failed or that all passed
+inline auto Summary() -> int
+{
+  if (Failures > 0) {
+    fmt::println("{} checks failed", Failures);
+    return EXIT_FAILURE;
+  }
+  fmt::println("all checks passed");
+  return EXIT_SUCCESS;
+}
+
+}// namespace Blt::Test
\ No newline at end of file
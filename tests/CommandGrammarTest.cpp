@@ -0,0 +1,151 @@
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "Check.hpp"
+#include "CommandGrammar.hpp"
+
+namespace {
+
+using Blt::Test::Check;
+
+template<typename Char, std::size_t Size>
+constexpr auto Parse(const std::array<std::basic_string_view<Char>, Size> &argv, Blt::ParsedArguments<Char> &out)
+  -> std::optional<Blt::ArgumentError>
+{
+  return Blt::ParseArgv<Char>(std::span<const std::basic_string_view<Char>>(argv), out);
+}
+
+// The parse stops at argv[`argument`] with `code`, expecting `expected`
+template<std::size_t Size>
+constexpr auto FailsAt(
+  const std::array<std::string_view, Size> &argv,
+  std::size_t argument,
+  std::string_view expected,
+  Blt::ParseCommandLineError code = Blt::ParseCommandLineError::ParseFailed) -> bool
+{
+  auto out         = Blt::ParsedArguments<char>();
+  const auto error = Parse(argv, out);
+  return error and error->Code == code and error->Argument == argument and error->Expected == expected;
+}
+
+constexpr auto NumberedMount() -> bool
+{
+  using namespace std::string_view_literals;
+  auto out = Blt::ParsedArguments<char>();
+  if (Parse(std::to_array({"blt"sv, "mount"sv, "1:2:GiB"sv, "3:512:MiB"sv, "X"sv}), out)) return false;
+  if (out.Rule == nullptr or out.Rule->Action != Blt::CommandAction::Mount or out.TargetCount != 1) return false;
+  const auto &target = out.Targets[0];
+  return target.Shape == Blt::TargetShape::Numbered and target.DiskNumber == 1
+     and target.DiskCapacity == Blt::CapacityBytes(uint64_t{2} << 30) and target.PartitionNumber == 3
+     and target.PartitionCapacity == Blt::CapacityBytes(uint64_t{512} << 20) and target.Mount == "X"
+     and target.MountArgument == 4;
+}
+static_assert(NumberedMount());
+
+constexpr auto VolumeTargetsAndOptions() -> bool
+{
+  using namespace std::string_view_literals;
+  auto out = Blt::ParsedArguments<char>();
+  if (Parse(
+        std::to_array(
+          {"blt"sv, "--timeout=30"sv, "watch"sv, "disk-a@1048576"sv, "*"sv, "disk-b@0"sv, "Y"sv, "--timeout=90"sv}),
+        out))
+    return false;
+  return out.Rule->Action == Blt::CommandAction::Watch and out.TargetCount == 2
+     and out.Targets[0].DiskId == "disk-a" and out.Targets[0].PartitionOffset == 1048576 and out.Targets[0].Mount == "*"
+     and out.Targets[1].DiskId == "disk-b" and out.Option(Blt::CommandOption::SessionTimeout) == 90
+     and not out.Option(Blt::CommandOption::Probe);
+}
+static_assert(VolumeTargetsAndOptions());
+
+constexpr auto UnlockKeys() -> bool
+{
+  using namespace std::string_view_literals;
+  auto out = Blt::ParsedArguments<char>();
+  if (Parse(std::to_array({"blt"sv, "unlock"sv, "file:keys"sv, "D"sv, "E"sv}), out)) return false;
+  return out.Keys == "file:keys" and out.TargetCount == 2 and out.Targets[1].Mount == "E";
+}
+static_assert(UnlockKeys());
+
+// argv as Windows hands it over, parsed without converting
+constexpr auto WideArguments() -> bool
+{
+  using namespace std::string_view_literals;
+  auto out = Blt::ParsedArguments<wchar_t>();
+  if (Parse(std::to_array({L"blt"sv, L"unmount"sv, L"disk-a@4096"sv, L"Z"sv}), out)) return false;
+  return out.Rule->Action == Blt::CommandAction::Unmount and out.Targets[0].DiskId == L"disk-a"
+     and out.Targets[0].PartitionOffset == 4096;
+}
+static_assert(WideArguments());
+
+constexpr auto Refusals() -> bool
+{
+  using namespace std::string_view_literals;
+  return FailsAt(
+           std::to_array({"blt"sv, "format"sv}),
+           1,
+           "mount, unmount, index, watch, unlock or verify-audit",
+           Blt::ParseCommandLineError::UnknownAction)
+     and FailsAt(
+           std::to_array({"blt"sv, "mount"sv, "1:2:TiB"sv}),
+           2,
+           "KiB, MiB or GiB",
+           Blt::ParseCommandLineError::UnsupportedCapacityUnit)
+     and FailsAt(
+           std::to_array({"blt"sv, "unmount"sv, "disk-a@0"sv, "*"sv}),
+           3,
+           "a drive letter or an absolute folder, `*` only where a mount starts")
+     and FailsAt(
+           std::to_array({"blt"sv, "mount"sv, "disk-a@0"sv, "X"sv, "1:2:GiB"sv}),
+           4,
+           "<disk id>@<partition offset>")
+     and FailsAt(std::to_array({"blt"sv, "--timeout=0"sv}), 1, "a number in the option's range")
+     and FailsAt(
+           std::to_array({"blt"sv, "--retries=3"sv}), 1, "an option: --timeout=<seconds> or --probe=<milliseconds>")
+     and FailsAt(std::to_array({"blt"sv, "index"sv, "X"sv}), 2, "no further argument");
+}
+static_assert(Refusals());
+
+// What is missing at the end depends on the action: only a mount can end on `*`
+constexpr auto MissingAtTheEnd() -> bool
+{
+  using namespace std::string_view_literals;
+  return FailsAt(
+           std::to_array({"blt"sv}),
+           1,
+           "mount, unmount, index, watch, unlock or verify-audit",
+           Blt::ParseCommandLineError::UnknownAction)
+     and FailsAt(std::to_array({"blt"sv, "mount"sv}), 2, "<disk>:<capacity>:<unit> or <disk id>@<partition offset>")
+     and FailsAt(std::to_array({"blt"sv, "unlock"sv}), 2, "a key source")
+     and FailsAt(std::to_array({"blt"sv, "mount"sv, "1:2:GiB"sv}), 3, "<partition>:<capacity>:<unit>")
+     and FailsAt(std::to_array({"blt"sv, "mount"sv, "disk-a@0"sv}), 3, "a drive letter, an absolute folder or `*`")
+     and FailsAt(std::to_array({"blt"sv, "watch"sv, "disk-a@0"sv}), 3, "a drive letter, an absolute folder or `*`")
+     and FailsAt(std::to_array({"blt"sv, "unmount"sv, "disk-a@0"sv}), 3, "a drive letter or an absolute folder")
+     and FailsAt(
+           std::to_array({"blt"sv, "unmount"sv, "1:2:GiB"sv, "3:512:MiB"sv}), 4, "a drive letter or an absolute folder");
+}
+static_assert(MissingAtTheEnd());
+
+}// namespace
+
+/**
+ * BitLockerTool_CommandGrammarTest
+ *
+ * ParseArgv on narrow and wide argv: what every target shape and option parses to, and where and with what
+ * diagnostic a refused argument list stops. The grammar is constexpr and every check is a static_assert as well, a
+ * change that breaks one already fails the build. Prints every check that failed and exits non-zero if one did.
+ */
+int main()
+{
+  Check(NumberedMount(), "a numbered target parses its numbers and capacities");
+  Check(VolumeTargetsAndOptions(), "volume targets parse and a repeated option keeps the last value");
+  Check(UnlockKeys(), "unlock takes its key source ahead of the targets");
+  Check(WideArguments(), "wide argv parses without converting");
+  Check(Refusals(), "a refused argument stops the parse with its position and what was expected");
+  Check(MissingAtTheEnd(), "a missing argument names what the action expects next");
+
+  return Blt::Test::Summary();
+}
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include <fmt/format.h>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/use_future.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <unistd.h>
+
+#include "Check.hpp"
+#include "Luks.hpp"
+
+namespace asio = boost::asio;
+
+namespace {
+
+using Blt::Test::Check;
+
+void WriteFile(const std::filesystem::path &path, std::string_view content)
+{
+  auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  file << content;
+}
+
+auto ReadFile(const std::filesystem::path &path) -> std::string
+{
+  auto file = std::ifstream(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+template<typename Operation>
+auto Run(Operation operation) -> Blt::LuksResult
+{
+  asio::io_context ioc;
+  auto result = asio::co_spawn(ioc, std::move(operation), asio::use_future);
+  ioc.run();
+  return result.get();
+}
+
+/**
+ * A scratch directory with a sysfs tree of one disk (loop0, 1 GiB) holding one partition (loop0p1, 512 MiB), the
+ * helper symlinks the backend is pointed at through BLT_CRYPTSETUP_PATH and friends, a key file and a mount root.
+ */
+class Scratch
+{
+public:
+  Scratch()
+    : root_(std::filesystem::temp_directory_path() / fmt::format("blt-luks-test-{}", ::getpid()))
+  {
+    std::filesystem::remove_all(root_);
+    std::filesystem::create_directories(root_ / "sys" / "loop0" / "loop0p1");
+    std::filesystem::create_directories(Bin());
+    WriteFile(root_ / "sys" / "loop0" / "size", "2097152\n");
+    WriteFile(root_ / "sys" / "loop0" / "loop0p1" / "partition", "1\n");
+    WriteFile(root_ / "sys" / "loop0" / "loop0p1" / "size", "1048576\n");
+    WriteFile(
+      Keys(),
+      fmt::format("/dev/loop0p1 password correct horse\n{} recovery-password 000000-000000\n", RecoveryFolder()));
+    for (const auto *tool : {"cryptsetup", "mount", "umount"})
+      std::filesystem::create_symlink(BLT_FAKE_HELPER, Bin() / tool);
+  }
+  ~Scratch() { std::filesystem::remove_all(root_); }
+
+  Scratch(const Scratch &)            = delete;
+  Scratch &operator=(const Scratch &) = delete;
+
+  [[nodiscard]] auto Root() const -> const std::filesystem::path & { return root_; }
+  [[nodiscard]] auto Bin() const -> std::filesystem::path { return root_ / "bin"; }
+  [[nodiscard]] auto Keys() const -> std::filesystem::path { return root_ / "keys"; }
+  [[nodiscard]] auto Mounts() const -> std::filesystem::path { return root_ / "mounts"; }
+  [[nodiscard]] auto RecoveryFolder() const -> std::string { return (root_ / "recovery").string(); }
+
+  // What the helpers were started with since the last call
+  auto TakeLog() -> std::string
+  {
+    auto log = ReadFile(Bin() / "helpers.log");
+    std::filesystem::remove(Bin() / "helpers.log");
+    return log;
+  }
+
+  // `tool` exits with `code` from now on, 0 goes back to succeeding
+  void ExitWith(std::string_view tool, int code)
+  {
+    const auto path = Bin() / fmt::format("{}.exit", tool);
+    if (code == 0) {
+      std::filesystem::remove(path);
+    } else {
+      WriteFile(path, fmt::format("{}\n", code));
+    }
+  }
+
+private:
+  std::filesystem::path root_;
+};
+
+auto Partition() -> Blt::VolumeLocation
+{
+  return Blt::VolumeLocation{
+    .DiskNumber        = 0,
+    .DiskCapacity      = Blt::CapacityBytes(uint64_t{1} << 30),
+    .PartitionNumber   = 1,
+    .PartitionCapacity = Blt::CapacityBytes(uint64_t{512} << 20),
+  };
+}
+
+auto Target(Blt::MountPoint mount) -> Blt::LuksTarget
+{
+  return Blt::LuksTarget{.Location = Partition(), .Volume = std::nullopt, .Mount = std::move(mount)};
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_LuksTest
+ *
+ * Attach and detach of the LUKS backend with fake-helper.sh standing in for cryptsetup, mount and umount, through
+ * the same BLT_*_PATH overrides and FindExecutable the CLI uses: the command lines and the key on stdin, every exit
+ * code a helper can fail with, a helper that can not be started, and the pooled folder going back when an attach
+ * fails. Prints every check that failed and exits non-zero if one did.
+ */
+int main()
+{
+  auto scratch = Scratch();
+  ::setenv("BLT_CRYPTSETUP_PATH", (scratch.Bin() / "cryptsetup").c_str(), 1);
+  ::setenv("BLT_MOUNT_PATH", (scratch.Bin() / "mount").c_str(), 1);
+  ::setenv("BLT_UMOUNT_PATH", (scratch.Bin() / "umount").c_str(), 1);
+
+  Blt::Spawner cryptsetup{[] { return Blt::FindExecutable("cryptsetup", "BLT_CRYPTSETUP_PATH"); }};
+  Blt::Spawner mount{[] { return Blt::FindExecutable("mount", "BLT_MOUNT_PATH"); }};
+  Blt::Spawner umount{[] { return Blt::FindExecutable("umount", "BLT_UMOUNT_PATH"); }};
+  auto keys = Blt::KeySource::Open(scratch.Keys().string());
+  if (not keys) {
+    fmt::println("FAILED: unable to open {}", scratch.Keys().string());
+    return EXIT_FAILURE;
+  }
+  auto pool    = Blt::MountPool(Blt::FreeDriveLetters, scratch.Mounts());
+  auto backend = Blt::LuksBackend(
+    Blt::LuksCommands{.Cryptsetup = cryptsetup, .Mount = mount, .Umount = umount},
+    std::move(*keys),
+    pool,
+    scratch.Root() / "sys");
+  const auto automatic = Blt::MountPoint{.Letter = 0, .Folder = {}, .Automatic = true};
+  const auto pooled    = (scratch.Mounts() / "volume-0").string();
+
+  // a password goes to stdin without a newline, the mapper device is mounted at the first pooled folder
+  auto attached = Run(backend.Attach(Target(automatic)));
+  Check(attached.Error == Blt::LuksError::Success, "attach succeeds");
+  Check(attached.Device == "loop0p1", "attach finds loop0p1 in sysfs");
+  Check(attached.Mount.Folder == pooled, "attach mounts at the first pooled folder");
+  Check(
+    scratch.TakeLog()
+      == fmt::format(
+        "cryptsetup open --type luks --key-file - /dev/loop0p1 blt-loop0p1\n"
+        "stdin correct horse|\n"
+        "mount /dev/mapper/blt-loop0p1 {}\n",
+        pooled),
+    "attach opens with the password on stdin and mounts the mapper device");
+
+  auto detached = Run(backend.Detach(Target(attached.Mount)));
+  Check(detached.Error == Blt::LuksError::Success, "detach succeeds");
+  Check(
+    scratch.TakeLog() == fmt::format("umount {}\ncryptsetup close blt-loop0p1\n", pooled),
+    "detach unmounts the folder and closes the mapper device");
+  auto reused = pool.Acquire();
+  Check(reused and reused->Folder == pooled, "detach gives the pooled folder back");
+  if (reused) pool.Release(*reused);
+
+  // the folder of a failed attach is handed out again
+  scratch.ExitWith("cryptsetup", 2);
+  auto refused = Run(backend.Attach(Target(automatic)));
+  Check(refused.Error == Blt::LuksError::OpenFailed, "a failing cryptsetup open is OpenFailed");
+  Check(not scratch.TakeLog().contains("mount "), "nothing is mounted after a failed open");
+  auto released = pool.Acquire();
+  Check(released and released->Folder == refused.Mount.Folder, "the folder of a failed attach goes back to the pool");
+  if (released) pool.Release(*released);
+  scratch.ExitWith("cryptsetup", 0);
+
+  scratch.ExitWith("mount", 32);
+  auto unmounted = Run(backend.Attach(Target(automatic)));
+  Check(unmounted.Error == Blt::LuksError::MountFailed, "a failing mount is MountFailed");
+  Check(
+    scratch.TakeLog().ends_with("cryptsetup close blt-loop0p1\n"), "a failed mount closes the mapper device again");
+  scratch.ExitWith("mount", 0);
+
+  scratch.ExitWith("umount", 1);
+  auto busy = Run(backend.Detach(Target(Blt::MountPoint{.Letter = 0, .Folder = pooled, .Automatic = false})));
+  Check(busy.Error == Blt::LuksError::UnmountFailed, "a failing umount is UnmountFailed");
+  Check(not scratch.TakeLog().contains("cryptsetup"), "the mapper device stays open while it is mounted");
+  scratch.ExitWith("umount", 0);
+
+  scratch.ExitWith("cryptsetup", 4);
+  auto stuck = Run(backend.Detach(Target(Blt::MountPoint{.Letter = 0, .Folder = pooled, .Automatic = false})));
+  Check(stuck.Error == Blt::LuksError::CloseFailed, "a failing cryptsetup close is CloseFailed");
+  scratch.ExitWith("cryptsetup", 0);
+  scratch.TakeLog();
+
+  // refused before any helper runs
+  auto wrongSize = Target(automatic);
+  wrongSize.Location.PartitionCapacity = Blt::CapacityBytes(uint64_t{256} << 20);
+  Check(Run(backend.Attach(std::move(wrongSize))).Error == Blt::LuksError::NoDevice, "another capacity is NoDevice");
+  Check(
+    Run(backend.Attach(Target(Blt::MountPoint{.Letter = 'X', .Folder = {}, .Automatic = false}))).Error
+      == Blt::LuksError::NoMountPoint,
+    "a drive letter is NoMountPoint");
+  Check(
+    Run(backend.Attach(Target(Blt::MountPoint{.Letter = 0, .Folder = scratch.RecoveryFolder(), .Automatic = false})))
+        .Error
+      == Blt::LuksError::UnsupportedKey,
+    "a recovery password is UnsupportedKey");
+  Check(scratch.TakeLog().empty(), "no helper runs for a refused attach");
+
+  // the path stays resolved, the helper behind it is gone
+  std::filesystem::remove(scratch.Bin() / "cryptsetup");
+  Check(Run(backend.Attach(Target(automatic))).Error == Blt::LuksError::SpawnFailed, "a missing helper is SpawnFailed");
+
+  return Blt::Test::Summary();
+}
\ No newline at end of file
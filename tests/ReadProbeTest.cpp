@@ -0,0 +1,124 @@
+#include <fmt/format.h>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_future.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "Check.hpp"
+#include "ReadProbe.hpp"
+
+namespace asio = boost::asio;
+
+namespace {
+
+using Blt::Test::Check;
+
+// `bytes` of a pattern that is never all zero, written through the cache like any image
+auto CreateImage(const std::filesystem::path &path, std::size_t bytes) -> bool
+{
+  auto image = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  auto block = std::vector<uint64_t>(64 * 1024 / sizeof(uint64_t));
+  for (std::size_t word = 0; word < block.size(); ++word) block[word] = word * 0x9e3779b97f4a7c15 + 1;
+  for (std::size_t written = 0; written < bytes and image; written += block.size() * sizeof(uint64_t)) {
+    const auto chunk = std::min(bytes - written, block.size() * sizeof(uint64_t));
+    image.write(reinterpret_cast<const char *>(block.data()), static_cast<std::streamsize>(chunk));
+  }
+  return static_cast<bool>(image.flush());
+}
+
+/**
+ * ProbeReads of `path` on an io_context of its own. With `truncateAfter` the file is cut to nothing that long into the
+ * probe, on the same thread while the reads are in flight.
+ */
+auto Run(
+  const std::filesystem::path &path,
+  Blt::ProbeOptions options,
+  std::optional<std::chrono::milliseconds> truncateAfter = std::nullopt) -> Blt::ProbeResult
+{
+  asio::io_context ioc;
+  auto probe    = asio::co_spawn(ioc, Blt::ProbeReads(path, options), asio::use_future);
+  auto truncate = asio::steady_timer(ioc);
+  if (truncateAfter) {
+    truncate.expires_after(*truncateAfter);
+    truncate.async_wait([&](boost::system::error_code ec) {
+      if (not ec) std::filesystem::resize_file(path, 0);
+    });
+  }
+  ioc.run();
+  return probe.get();
+}
+
+// Short phases, the test is about what the probe reports and not about the drive
+constexpr auto Quick = Blt::ProbeOptions{.Phase = std::chrono::milliseconds(100), .Windows = 4};
+
+}// namespace
+
+/**
+ * BitLockerTool_ReadProbeTest
+ *
+ * ProbeReads against image files in the working directory, which ctest makes the build directory: a probe that reads
+ * an image through, block sizes that are not aligned, and the ways a probe fails (no such file, an empty image, one
+ * smaller than a sequential or a random read, an image truncated while it is read). A build without asynchronous file reads must
+ * report Unsupported for all of them. O_DIRECT has to work where the build directory is, tmpfs refuses it on kernels
+ * before 6.6. Prints every check that failed and exits non-zero if one did.
+ */
+int main()
+{
+  const auto stamp   = std::chrono::steady_clock::now().time_since_epoch().count();
+  const auto image   = std::filesystem::current_path() / fmt::format("blt-probe-test-{}.img", stamp);
+  const auto small   = std::filesystem::current_path() / fmt::format("blt-probe-test-{}-small.img", stamp);
+  const auto empty   = std::filesystem::current_path() / fmt::format("blt-probe-test-{}-empty.img", stamp);
+  const auto missing = std::filesystem::current_path() / fmt::format("blt-probe-test-{}-missing.img", stamp);
+  if (not CreateImage(image, 8 << 20) or not CreateImage(small, 64 << 10) or not CreateImage(empty, 0)) {
+    fmt::println("FAILED: unable to write the images to {}", std::filesystem::current_path().string());
+    return EXIT_FAILURE;
+  }
+
+#ifdef BOOST_ASIO_HAS_FILE
+  const auto probe = Run(image, Quick);
+  Check(probe.Error == Blt::ProbeError::Success, "an image probes successfully");
+  Check(probe.BytesRead > 0, "a probe reads something");
+  Check(probe.BytesRead % 4096 == 0, "direct reads move whole aligned blocks");
+  Check(probe.SequentialMBps.Mean > 0 and probe.RandomIops.Mean > 0, "both phases report a rate");
+  Check(probe.RandomP50 <= probe.RandomP99, "the random latency percentiles are ordered");
+
+  auto unaligned            = Quick;
+  unaligned.SequentialBlock = 1000;
+  unaligned.RandomBlock     = 512;
+  unaligned.Windows         = 0;
+  const auto rounded        = Run(image, unaligned);
+  Check(rounded.Error == Blt::ProbeError::Success, "unaligned block sizes and no windows are rounded up");
+  Check(rounded.BytesRead % 4096 == 0, "unaligned block sizes still read whole aligned blocks");
+
+  Check(Run(missing, Quick).Error == Blt::ProbeError::OpenFailed, "a missing file is OpenFailed");
+  Check(Run(empty, Quick).Error == Blt::ProbeError::TooSmall, "an empty image is TooSmall");
+  Check(Run(small, Quick).Error == Blt::ProbeError::TooSmall, "an image below one sequential read is TooSmall");
+  auto wide        = Quick;
+  wide.RandomBlock = 16 << 20;
+  Check(Run(image, wide).Error == Blt::ProbeError::TooSmall, "an image below one random read is TooSmall");
+
+  auto longer     = Quick;
+  longer.Phase    = std::chrono::milliseconds(500);
+  const auto gone = Run(image, longer, std::chrono::milliseconds(50));
+  Check(gone.Error == Blt::ProbeError::ReadFailed, "an image truncated during the probe is ReadFailed");
+  Check(gone.BytesRead > 0, "a failed probe reports what it read until then");
+#else
+  for (const auto &path : {image, small, empty, missing})
+    Check(Run(path, Quick).Error == Blt::ProbeError::Unsupported, "a build without file reads is Unsupported");
+#endif
+
+  auto ec = std::error_code();
+  for (const auto &path : {image, small, empty}) std::filesystem::remove(path, ec);
+  return Blt::Test::Summary();
+}
\ No newline at end of file
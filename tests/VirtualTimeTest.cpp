@@ -0,0 +1,302 @@
+#include <fmt/format.h>
+#include <fmt/chrono.h>
+#include <boost/asio.hpp>
+#include <boost/asio/connect_pipe.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "DiskPart.hpp"
+#include "DiskPartProtocol.hpp"
+#include "FakeDiskPart.hpp"
+#include "Interrupt.hpp"
+#include "Log.hpp"
+#include "SessionClock.hpp"
+#include "SessionLock.hpp"
+
+#ifndef BLT_VIRTUAL_TIME
+#error "the scenarios only finish quickly with the session timers on virtual time"
+#endif
+
+namespace asio = boost::asio;
+
+using namespace boost::asio::experimental::awaitable_operators;
+using namespace std::chrono_literals;
+
+#ifdef _WIN32
+constexpr auto nullDevice = "NUL";
+#else
+constexpr auto nullDevice = "/dev/null";
+#endif
+
+namespace {
+
+using Reply = std::function<std::string(std::string_view, bool &)>;
+
+// What a stalled VDS looks like once diskpart gives up waiting on it
+constexpr auto busyReply = std::string_view(
+  "\r\nVirtual Disk Service error:\r\nThe service is busy.\r\n\r\nDISKPART> ");
+
+struct Scenario
+{
+  std::string_view Name;
+  Reply Answer;
+  // Interrupt::Request after this much virtual time
+  std::optional<Blt::VirtualClock::duration> InterruptAfter;
+  // something that ignores the interrupt keeps the io_context busy, the teardown grace has to end it
+  bool Lingering = false;
+
+  std::string Expected;
+  // the virtual time the scenario takes, a range where StepRetry's jitter decides
+  Blt::VirtualClock::duration EndsFrom;
+  Blt::VirtualClock::duration EndsBy = EndsFrom;
+  bool ExpectedForced = false;
+};
+
+// Everything but `list disk` is answered, the conversation hangs on reading the disk table
+auto StallOnListDisk(std::string_view command, bool &exit) -> std::string
+{
+  return command == "list disk" ? std::string() : Blt::Bench::FakeDiskPartReply(command, exit);
+}
+
+auto Ended(Blt::DiskPartError error) -> std::string
+{
+  return fmt::format("conversation ended with {}", fmt::underlying(error));
+}
+
+/**
+ * The mount conversation against a stand-in answering with `answer`, raced against the session timeout and the
+ * interrupt the same way Engine::attach races them.
+ */
+auto Race(Reply answer, Blt::Interrupt &interrupt, std::string &outcome) -> asio::awaitable<void>
+{
+  auto executor    = co_await asio::this_coro::executor;
+  auto diskpartOut = asio::readable_pipe(executor);
+  auto responseOut = asio::writable_pipe(executor);
+  auto commandIn   = asio::readable_pipe(executor);
+  auto diskpartIn  = asio::writable_pipe(executor);
+  asio::connect_pipe(diskpartOut, responseOut);
+  asio::connect_pipe(commandIn, diskpartIn);
+
+  const auto mount  = Blt::MountPoint{.Letter = 'X'};
+  const auto volume = std::optional<Blt::VolumeKey>();
+  auto target       = Blt::DiskPartTarget{
+          .DiskNumber        = 0,
+          .DiskCapacity      = Blt::capacityCast<Blt::CapacityBytes>(Blt::Gibibytes(1863)),
+          .PartitionNumber   = 6,
+          .PartitionCapacity = Blt::capacityCast<Blt::CapacityBytes>(Blt::Gibibytes(362)),
+          .Mount             = mount,
+          .Volume            = volume,
+  };
+
+  Blt::DiskPartSession session;
+  Blt::SessionTimer timeout{executor, 100s};
+  auto result = co_await (
+    (Blt::RunDiskPartProtocol<Blt::DiskPartMountProtocol>(session, diskpartOut, diskpartIn, target)
+     && Blt::Bench::FakeDiskPart(commandIn, responseOut, std::move(answer)))
+    || timeout.async_wait(asio::as_tuple(asio::use_awaitable)) || interrupt.Wait());
+  if (result.index() == 0) {
+    outcome = Ended(std::get<0>(result));
+  } else if (result.index() == 1) {
+    outcome = "timed out";
+  } else {
+    outcome = "interrupted";
+  }
+}
+
+auto Run(const Scenario &scenario) -> bool
+{
+  asio::io_context ioc;
+  auto interrupt = Blt::Interrupt(ioc, 5s);
+  auto outcome   = std::string("did not finish");
+  asio::co_spawn(
+    ioc,
+    [&]() -> asio::awaitable<void> {
+      co_await Race(scenario.Answer, interrupt, outcome);
+      if (not scenario.Lingering) interrupt.Done();
+    },
+    asio::detached);
+  auto requester = Blt::SessionTimer(ioc);
+  if (scenario.InterruptAfter) {
+    requester.expires_after(*scenario.InterruptAfter);
+    requester.async_wait([&interrupt](const boost::system::error_code &ec) {
+      if (not ec) interrupt.Request();
+    });
+  }
+  auto lingering = Blt::SessionTimer(ioc, 1h);
+  if (scenario.Lingering) lingering.async_wait([](const boost::system::error_code &) {});
+
+  const auto wallStart = std::chrono::steady_clock::now();
+  const auto elapsed   = Blt::RunVirtualTime(ioc);
+  const auto wall =
+    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - wallStart);
+
+  const auto passed = outcome == scenario.Expected and elapsed >= scenario.EndsFrom and elapsed <= scenario.EndsBy
+                      and interrupt.Forced() == scenario.ExpectedForced;
+  fmt::println(
+    stderr,
+    "{:<22} {:<6} {} after {} virtual{}, {} wall",
+    scenario.Name,
+    passed ? "ok" : "FAILED",
+    outcome,
+    std::chrono::duration_cast<std::chrono::milliseconds>(elapsed),
+    interrupt.Forced() ? ", teardown abandoned" : "",
+    wall);
+  if (not passed)
+    fmt::println(
+      stderr,
+      "{:<22} expected {} after {} to {}{}",
+      "",
+      scenario.Expected,
+      std::chrono::duration_cast<std::chrono::milliseconds>(scenario.EndsFrom),
+      std::chrono::duration_cast<std::chrono::milliseconds>(scenario.EndsBy),
+      scenario.ExpectedForced ? ", teardown abandoned" : "");
+  return passed;
+}
+
+/**
+ * Two acquires of one session lock, the second queues behind a lease the first holds for 30s and polls the board on
+ * the session clock, so it gets the session within a poll of the release after milliseconds of wall time.
+ */
+auto QueueBehindHolder() -> bool
+{
+  const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+  const auto path  = std::filesystem::temp_directory_path() / fmt::format("blt-virtual-time-{}.lock", stamp);
+  auto lock        = Blt::SessionLock::Open(path);
+  if (not lock) {
+    fmt::println(stderr, "{:<22} {:<6} unable to open {}", "queued for session", "FAILED", path.string());
+    return false;
+  }
+
+  asio::io_context ioc;
+  auto waited = std::optional<std::chrono::milliseconds>();
+  asio::co_spawn(
+    ioc,
+    [&]() -> asio::awaitable<void> {
+      const auto held = co_await lock->Acquire(30s);
+      if (not held) co_return;
+      asio::co_spawn(
+        ioc,
+        [&]() -> asio::awaitable<void> {
+          if (const auto lease = co_await lock->Acquire(30s)) waited = lease->Waited();
+        },
+        asio::detached);
+      auto holding = Blt::SessionTimer(ioc, 30s);
+      co_await holding.async_wait(asio::as_tuple(asio::use_awaitable));
+    },
+    asio::detached);
+
+  const auto wallStart = std::chrono::steady_clock::now();
+  const auto elapsed   = Blt::RunVirtualTime(ioc);
+  const auto wall =
+    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - wallStart);
+  auto ec = std::error_code();
+  std::filesystem::remove(path, ec);
+
+  const auto poll   = Blt::SessionLockOptions().Poll;
+  const auto passed = waited and *waited >= 30s and *waited <= 30s + poll and elapsed <= 30s + poll;
+  fmt::println(
+    stderr,
+    "{:<22} {:<6} {} after {} virtual, {} wall",
+    "queued for session",
+    passed ? "ok" : "FAILED",
+    waited ? fmt::format("waited {}", *waited) : std::string("never got the session"),
+    std::chrono::duration_cast<std::chrono::milliseconds>(elapsed),
+    wall);
+  return passed;
+}
+
+auto Scenarios() -> std::vector<Scenario>
+{
+  using Blt::Bench::FakeDiskPartReply;
+  auto scenarios = std::vector<Scenario>();
+  scenarios.push_back({
+    .Name     = "answers",
+    .Answer   = FakeDiskPartReply,
+    .Expected = Ended(Blt::DiskPartError::Success),
+    .EndsFrom = 0s,
+  });
+  // `list disk` never comes back, only the session timeout ends the conversation
+  scenarios.push_back({
+    .Name     = "stalled read",
+    .Answer   = StallOnListDisk,
+    .Expected = "timed out",
+    .EndsFrom = 100s,
+  });
+  // the same stall, cut short by an interrupt whose teardown finishes within the grace
+  scenarios.push_back({
+    .Name           = "interrupted",
+    .Answer         = StallOnListDisk,
+    .InterruptAfter = 2s,
+    .Expected       = "interrupted",
+    .EndsFrom       = 2s,
+  });
+  scenarios.push_back({
+    .Name           = "teardown abandoned",
+    .Answer         = StallOnListDisk,
+    .InterruptAfter = 2s,
+    .Lingering      = true,
+    .Expected       = "interrupted",
+    .EndsFrom       = 7s,
+    .ExpectedForced = true,
+  });
+  // VDS busy twice, StepRetry waits [125ms, 250ms] and [250ms, 500ms] before the third `select disk` goes through
+  scenarios.push_back({
+    .Name = "busy, then answers",
+    .Answer =
+      [busy = 2](std::string_view command, bool &exit) mutable {
+        if (command.starts_with("select disk ") and busy-- > 0) return std::string(busyReply);
+        return FakeDiskPartReply(command, exit);
+      },
+    .Expected = Ended(Blt::DiskPartError::Success),
+    .EndsFrom = 375ms,
+    .EndsBy   = 750ms,
+  });
+  // five re-issues with ceilings from 250ms to 4s, then StepRetry gives up
+  scenarios.push_back({
+    .Name = "busy until given up",
+    .Answer =
+      [](std::string_view command, bool &exit) {
+        return command.starts_with("select disk ") ? std::string(busyReply) : FakeDiskPartReply(command, exit);
+      },
+    .Expected = Ended(Blt::DiskPartError::ServiceBusy),
+    .EndsFrom = 3875ms,
+    .EndsBy   = 7750ms,
+  });
+  return scenarios;
+}
+
+}// namespace
+
+/**
+ * BitLockerTool_VirtualTimeTest
+ *
+ * Runs the timeout, interrupt and retry paths of a mount conversation against the in-memory diskpart stand-in with
+ * every session timer on virtual time, so the 100s session timeout and the teardown grace pass in milliseconds, and
+ * a wait in the session lock's queue the same way.
+ * Prints the outcome, the virtual and the wall time of each scenario and exits with failure when one ended
+ * differently than expected.
+ */
+int main()
+{
+  // the steps log every command, keep the text out of the terminal like PipeBench does
+  if (std::freopen(nullDevice, "w", stdout) == nullptr) return EXIT_FAILURE;
+  Blt::LogSink::Instance().Start(Blt::LogOptions{});
+
+  auto failed = 0;
+  for (const auto &scenario : Scenarios())
+    if (not Run(scenario)) ++failed;
+  if (not QueueBehindHolder()) ++failed;
+
+  Blt::LogSink::Instance().Stop();
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
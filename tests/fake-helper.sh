@@ -0,0 +1,14 @@
+#!/bin/sh
+# Stands in for cryptsetup, mount and umount, started through a symlink named after the tool it replaces.
+# Appends "<tool> <arguments>" to helpers.log next to the symlink and, for `--key-file -`, what came in on stdin
+# between "stdin " and "|". Exits with the number in <tool>.exit next to the symlink when there is one.
+dir=$(dirname "$0")
+name=$(basename "$0")
+echo "$name $*" >> "$dir/helpers.log"
+if [ "$1" = open ] && [ "$5" = - ]; then
+  printf 'stdin ' >> "$dir/helpers.log"
+  cat >> "$dir/helpers.log"
+  printf '|\n' >> "$dir/helpers.log"
+fi
+if [ -f "$dir/$name.exit" ]; then exit "$(cat "$dir/$name.exit")"; fi
+exit 0